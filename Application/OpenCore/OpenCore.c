@@ -94,6 +94,18 @@ OcStartImage (
     LaunchInText ? EfiConsoleControlScreenText : EfiConsoleControlScreenGraphics
     );
 
+  //
+  // Include picker phases into the profile before leaving.
+  //
+  OcProfileReport ();
+
+  //
+  // Log file writes are batched, make sure everything reaches the disk
+  // before the boot image starts. Messages logged while macOS booter runs
+  // are saved by OcAfterBootCompatLib at ExitBootServices.
+  //
+  OcFlushLogProtocol ();
+
   Status = gBS->StartImage (
     ImageHandle,
     ExitDataSize,
@@ -118,23 +130,31 @@ OcMain (
 {
   EFI_STATUS                Status;
   OC_PRIVILEGE_CONTEXT      *Privilege;
+  UINT32                    Phase;
 
   DEBUG ((DEBUG_INFO, "OC: OcMiscEarlyInit...\n"));
+  Phase = OcProfileBegin ("OcMiscEarlyInit");
   Status = OcMiscEarlyInit (
     Storage,
     &mOpenCoreConfiguration,
     mOpenCoreVaultKey
     );
+  OcProfileEnd (Phase);
 
   if (EFI_ERROR (Status)) {
     return;
   }
 
+  Phase = OcProfileBegin ("OcCpuScanProcessor");
   OcCpuScanProcessor (&mOpenCoreCpuInfo);
+  OcProfileEnd (Phase);
 
   DEBUG ((DEBUG_INFO, "OC: OcLoadNvramSupport...\n"));
+  Phase = OcProfileBegin ("OcLoadNvramSupport");
   OcLoadNvramSupport (Storage, &mOpenCoreConfiguration);
+  OcProfileEnd (Phase);
   DEBUG ((DEBUG_INFO, "OC: OcMiscMiddleInit...\n"));
+  Phase = OcProfileBegin ("OcMiscMiddleInit");
   OcMiscMiddleInit (
     Storage,
     &mOpenCoreConfiguration,
@@ -143,22 +163,37 @@ OcMain (
     mStorageHandle,
     mOpenCoreConfiguration.Booter.Quirks.ForceBooterSignature ? mOpenCoreBooterHash : NULL
     );
+  OcProfileEnd (Phase);
   DEBUG ((DEBUG_INFO, "OC: OcLoadUefiSupport...\n"));
+  Phase = OcProfileBegin ("OcLoadUefiSupport");
   OcLoadUefiSupport (Storage, &mOpenCoreConfiguration, &mOpenCoreCpuInfo, mOpenCoreBooterHash);
+  OcProfileEnd (Phase);
   DEBUG_CODE_BEGIN ();
   DEBUG ((DEBUG_INFO, "OC: OcMiscLoadSystemReport...\n"));
+  Phase = OcProfileBegin ("OcMiscLoadSystemReport");
   OcMiscLoadSystemReport (&mOpenCoreConfiguration, mStorageHandle);
+  OcProfileEnd (Phase);
   DEBUG_CODE_END ();
   DEBUG ((DEBUG_INFO, "OC: OcLoadAcpiSupport...\n"));
+  Phase = OcProfileBegin ("OcLoadAcpiSupport");
   OcLoadAcpiSupport (&mOpenCoreStorage, &mOpenCoreConfiguration);
+  OcProfileEnd (Phase);
   DEBUG ((DEBUG_INFO, "OC: OcLoadPlatformSupport...\n"));
+  Phase = OcProfileBegin ("OcLoadPlatformSupport");
   OcLoadPlatformSupport (&mOpenCoreConfiguration, &mOpenCoreCpuInfo);
+  OcProfileEnd (Phase);
   DEBUG ((DEBUG_INFO, "OC: OcLoadDevPropsSupport...\n"));
+  Phase = OcProfileBegin ("OcLoadDevPropsSupport");
   OcLoadDevPropsSupport (&mOpenCoreConfiguration);
+  OcProfileEnd (Phase);
   DEBUG ((DEBUG_INFO, "OC: OcMiscLateInit...\n"));
+  Phase = OcProfileBegin ("OcMiscLateInit");
   OcMiscLateInit (Storage, &mOpenCoreConfiguration);
+  OcProfileEnd (Phase);
   DEBUG ((DEBUG_INFO, "OC: OcLoadKernelSupport...\n"));
+  Phase = OcProfileBegin ("OcLoadKernelSupport");
   OcLoadKernelSupport (&mOpenCoreStorage, &mOpenCoreConfiguration, &mOpenCoreCpuInfo);
+  OcProfileEnd (Phase);
 
   if (mOpenCoreConfiguration.Misc.Security.EnablePassword) {
     mOpenCorePrivilege.CurrentLevel = OcPrivilegeUnauthorized;
@@ -171,6 +206,8 @@ OcMain (
     Privilege = NULL;
   }
 
+  OcProfileReport ();
+
   DEBUG ((DEBUG_INFO, "OC: All green, starting boot management...\n"));
 
   OcMiscBoot (
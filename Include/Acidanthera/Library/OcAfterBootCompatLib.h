@@ -180,6 +180,14 @@ typedef struct OC_ABC_SETTINGS_ {
   ///
   BOOLEAN  SyncRuntimePermissions;
   ///
+  /// Serve small boot.efi pool allocations from OpenCore-managed pages.
+  ///
+  BOOLEAN  CachePoolAllocations;
+  ///
+  /// Record boot.efi memory services calls and write them to the log before ExitBootServices.
+  ///
+  BOOLEAN  TraceBootServices;
+  ///
   /// List of physical addresses to not be devirtualised by DevirtualiseMmio.
   ///
   EFI_PHYSICAL_ADDRESS *MmioWhitelist;
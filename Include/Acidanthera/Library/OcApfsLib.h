@@ -15,6 +15,10 @@
 #ifndef OC_APFS_LIB_H
 #define OC_APFS_LIB_H
 
+#include <Guid/AppleApfsInfo.h>
+#include <IndustryStandard/Apfs.h>
+#include <Library/OcStorageLib.h>
+
 /**
   Latest known from High Sierra version 10.13.6 (17G66).
 **/
@@ -51,6 +55,36 @@
 #define OC_APFS_VERSION_ANY ((UINT64) (-1))
 #define OC_APFS_DATE_ANY    ((UINT32) (-1))
 
+/**
+  APFS volume information read directly from container metadata.
+**/
+typedef struct {
+  ///
+  /// Volume UUID, matches APPLE_APFS_VOLUME_INFO Uuid.
+  ///
+  EFI_GUID                VolumeUuid;
+  ///
+  /// Volume role, matches APPLE_APFS_VOLUME_INFO Role.
+  ///
+  APPLE_APFS_VOLUME_ROLE  Role;
+  ///
+  /// Volume index within the container.
+  ///
+  UINT32                  FsIndex;
+  ///
+  /// Volume contents are encrypted.
+  ///
+  BOOLEAN                 Encrypted;
+  ///
+  /// Volume is a sealed system volume.
+  ///
+  BOOLEAN                 Sealed;
+  ///
+  /// Null terminated UTF-8 volume name.
+  ///
+  CHAR8                   Name[APFS_VOLNAME_LEN];
+} OC_APFS_VOLUME_METADATA;
+
 /**
   Configure APFS driver loading for subsequent connections.
 
@@ -71,6 +105,18 @@ OcApfsConfigure (
   IN BOOLEAN  IgnoreVerbose
   );
 
+/**
+  Configure persistent cache of the newest started APFS driver.
+  Containers known to carry the cached driver skip driver reading,
+  the signature is verified on every load.
+
+  @param[in] Storage   OpenCore storage to keep the cache in, NULL to disable.
+**/
+VOID
+OcApfsConfigureCache (
+  IN OC_STORAGE_CONTEXT  *Storage  OPTIONAL
+  );
+
 /**
   Connect APFS driver to partitions on media handle.
 
@@ -111,4 +157,39 @@ OcApfsConnectDevices (
   IN BOOLEAN      Monitor
   );
 
+/**
+  Read volume information from the latest checkpoint of APFS container
+  without loading APFS driver. Metadata objects are cached until the
+  container is modified. Fusion containers are not supported.
+
+  @param[in]  Handle         Device handle (APFS container).
+  @param[out] ContainerUuid  Container UUID.
+  @param[out] Volumes        Volume information, to be freed with FreePool.
+  @param[out] VolumeCount    Number of volumes.
+
+  @retval EFI_SUCCESS if at least one volume was found.
+**/
+EFI_STATUS
+OcApfsReadContainerMetadata (
+  IN  EFI_HANDLE               Handle,
+  OUT EFI_GUID                 *ContainerUuid,
+  OUT OC_APFS_VOLUME_METADATA  **Volumes,
+  OUT UINT32                   *VolumeCount
+  );
+
+/**
+  Get next transaction identifier from the latest checkpoint of APFS
+  container. It changes whenever the container is modified.
+
+  @param[in]  Handle   Device handle (APFS container).
+  @param[out] NextXid  Next transaction identifier.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+OcApfsGetContainerNextXid (
+  IN  EFI_HANDLE  Handle,
+  OUT UINT64      *NextXid
+  );
+
 #endif // OC_APFS_LIB_H
@@ -62,10 +62,11 @@ typedef struct OC_PICKER_CONTEXT_ OC_PICKER_CONTEXT;
 #define OC_ATTR_USE_GENERIC_LABEL_IMAGE  BIT2
 #define OC_ATTR_HIDE_THEMED_ICONS        BIT3
 #define OC_ATTR_USE_POINTER_CONTROL      BIT4
+#define OC_ATTR_USE_ADAPTIVE_PACING      BIT5
 #define OC_ATTR_ALL_BITS (\
   OC_ATTR_USE_VOLUME_ICON         | OC_ATTR_USE_DISK_LABEL_FILE | \
   OC_ATTR_USE_GENERIC_LABEL_IMAGE | OC_ATTR_HIDE_THEMED_ICONS   | \
-  OC_ATTR_USE_POINTER_CONTROL)
+  OC_ATTR_USE_POINTER_CONTROL     | OC_ATTR_USE_ADAPTIVE_PACING)
 
 /**
   Default timeout for IDLE timeout during menu picker navigation
@@ -210,6 +211,10 @@ typedef struct OC_BOOT_ENTRY_ {
   //
   BOOLEAN                   ExposeDevicePath;
   //
+  // Set when this entry was restored from the scan cache without scanning.
+  //
+  BOOLEAN                   IsCached;
+  //
   // Load option data (usually "boot args") size.
   //
   UINT32                    LoadOptionsSize;
@@ -716,6 +721,10 @@ struct OC_PICKER_CONTEXT_ {
   //
   BOOLEAN                    HideAuxiliary;
   //
+  // Reuse boot entries of unchanged filesystems from the previous scan.
+  //
+  BOOLEAN                    ScanCache;
+  //
   // Enable audio assistant during picker playback.
   //
   BOOLEAN                    PickerAudioAssist;
@@ -964,6 +973,7 @@ OcShowSimpleBootMenu (
   @param[in]  ParentHandle   Parent image handle.
 
   @retval EFI_SUCCESS        The image was found, started, and ended succesfully.
+  @retval EFI_NOT_READY      Cached boot entry is outdated, boot entries need rescanning.
 **/
 EFI_STATUS
 OcLoadBootEntry (
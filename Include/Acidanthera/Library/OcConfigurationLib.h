@@ -135,6 +135,7 @@
 #define OC_BOOTER_QUIRKS_FIELDS(_, __) \
   _(BOOLEAN                     , AllowRelocationBlock      ,     , FALSE  , ()) \
   _(BOOLEAN                     , AvoidRuntimeDefrag        ,     , FALSE  , ()) \
+  _(BOOLEAN                     , CachePoolAllocations      ,     , FALSE  , ()) \
   _(BOOLEAN                     , DevirtualiseMmio          ,     , FALSE  , ()) \
   _(BOOLEAN                     , DisableSingleUser         ,     , FALSE  , ()) \
   _(BOOLEAN                     , DisableVariableWrite      ,     , FALSE  , ()) \
@@ -151,7 +152,8 @@
   _(BOOLEAN                     , RebuildAppleMemoryMap     ,     , FALSE  , ()) \
   _(BOOLEAN                     , SetupVirtualMap           ,     , FALSE  , ()) \
   _(BOOLEAN                     , SignalAppleOS             ,     , FALSE  , ()) \
-  _(BOOLEAN                     , SyncRuntimePermissions    ,     , FALSE  , ())
+  _(BOOLEAN                     , SyncRuntimePermissions    ,     , FALSE  , ()) \
+  _(BOOLEAN                     , TraceBootServices         ,     , FALSE  , ())
   OC_DECLARE (OC_BOOTER_QUIRKS)
 
 ///
@@ -337,6 +339,7 @@
   _(BOOLEAN                     , PickerAudioAssist           ,     , FALSE                               , ())                   \
   _(BOOLEAN                     , HideAuxiliary               ,     , FALSE                               , ())                   \
   _(BOOLEAN                     , PollAppleHotKeys            ,     , FALSE                               , ())                   \
+  _(BOOLEAN                     , ScanCache                   ,     , FALSE                               , ())                   \
   _(BOOLEAN                     , ShowPicker                  ,     , FALSE                               , ())
   OC_DECLARE (OC_MISC_BOOT)
 
@@ -579,7 +582,8 @@ typedef enum {
   _(BOOLEAN                     , EnableJumpstart    ,     , FALSE                         , ()) \
   _(BOOLEAN                     , GlobalConnect      ,     , FALSE                         , ()) \
   _(BOOLEAN                     , HideVerbose        ,     , FALSE                         , ()) \
-  _(BOOLEAN                     , JumpstartHotPlug   ,     , FALSE                         , ())
+  _(BOOLEAN                     , JumpstartHotPlug   ,     , FALSE                         , ()) \
+  _(BOOLEAN                     , JumpstartCache     ,     , FALSE                         , ())
   OC_DECLARE (OC_UEFI_APFS)
 
 ///
@@ -663,6 +667,7 @@ typedef enum {
   _(BOOLEAN                     , ActivateHpetSupport         ,     , FALSE  , ()) \
   _(BOOLEAN                     , DisableSecurityPolicy       ,     , FALSE  , ()) \
   _(BOOLEAN                     , IgnoreInvalidFlexRatio      ,     , FALSE  , ()) \
+  _(BOOLEAN                     , ParallelMemoryCopy          ,     , FALSE  , ()) \
   _(BOOLEAN                     , ReleaseUsbOwnership         ,     , FALSE  , ()) \
   _(BOOLEAN                     , RequestBootVarRouting       ,     , FALSE  , ()) \
   _(BOOLEAN                     , UnblockFsConnect            ,     , FALSE  , ())
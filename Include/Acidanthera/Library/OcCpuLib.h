@@ -234,4 +234,44 @@ OcGetTSCFrequency (
   VOID
   );
 
+/**
+  Enable splitting large memory copies and fills across application
+  processors via MP services. Parallel processing is disabled on
+  ExitBootServices, after which operations run on the BSP only.
+
+  @retval EFI_SUCCESS when application processors are available.
+**/
+EFI_STATUS
+OcParallelMemoryInit (
+  VOID
+  );
+
+/**
+  Copy memory using all enabled processors when possible.
+  Falls back to CopyMem for small, overlapping, or early/late requests.
+
+  @param[out]  Destination   Destination buffer.
+  @param[in]   Source        Source buffer.
+  @param[in]   Length        Amount of bytes to copy.
+**/
+VOID
+OcParallelCopyMem (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       Length
+  );
+
+/**
+  Zero memory using all enabled processors when possible.
+  Falls back to ZeroMem for small or early/late requests.
+
+  @param[out]  Buffer   Buffer to zero.
+  @param[in]   Length   Amount of bytes to zero.
+**/
+VOID
+OcParallelZeroMem (
+  OUT VOID   *Buffer,
+  IN  UINTN  Length
+  );
+
 #endif // OC_CPU_LIB_H_
@@ -0,0 +1,35 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef OC_CRC32_LIB_H
+#define OC_CRC32_LIB_H
+
+/**
+  Calculate CRC-32 (ISO-HDLC, as used by GPT, EFI table headers and zlib).
+  Compatible with EFI_BOOT_SERVICES.CalculateCrc32 and zlib crc32 results.
+
+  @param[in]  Crc         CRC-32 of the preceding data or 0.
+  @param[in]  Buffer      Buffer to checksum.
+  @param[in]  BufferSize  Buffer size in bytes.
+
+  @return  CRC-32 of the preceding data and the buffer.
+**/
+UINT32
+OcCrc32 (
+  IN UINT32      Crc,
+  IN CONST VOID  *Buffer,
+  IN UINTN       BufferSize
+  );
+
+#endif // OC_CRC32_LIB_H
@@ -76,6 +76,65 @@ OcConfigureLogProtocol (
   IN EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *LogFileSystem  OPTIONAL
   );
 
+/**
+  Write pending log data to the log file, if file logging is enabled.
+  Must be called before handing control to the operating system,
+  as file writes are batched.
+
+  @retval EFI_SUCCESS          Pending log data was written.
+  @retval EFI_ALREADY_STARTED  Log file is already up to date.
+  @retval EFI_NOT_READY        File I/O is impossible at current TPL.
+  @retval EFI_NOT_FOUND        File logging is not active.
+**/
+EFI_STATUS
+OcFlushLogProtocol (
+  VOID
+  );
+
+/**
+  Invalid boot phase profiling scope.
+**/
+#define OC_PROFILE_NO_PHASE  MAX_UINT32
+
+/**
+  Begin a boot phase profiling scope. Scopes nest, and repeated
+  scopes with the same name and parent are accumulated.
+
+  @param[in] Name  Phase name, must stay valid until the last report.
+
+  @returns Scope handle for OcProfileEnd.
+  @retval OC_PROFILE_NO_PHASE  There is no room for the phase.
+**/
+UINT32
+OcProfileBegin (
+  IN CONST CHAR8  *Name
+  );
+
+/**
+  End a boot phase profiling scope, and any scopes nested in it
+  that are still open.
+
+  @param[in] Scope  Scope handle returned by OcProfileBegin.
+**/
+VOID
+OcProfileEnd (
+  IN UINT32  Scope
+  );
+
+/**
+  Write per-phase summary of the profiled scopes to the log, and
+  to a -profile.txt file next to the log file when file logging is on.
+  Running scopes are accounted up to the current moment.
+
+  @retval EFI_SUCCESS      The report was written to the file.
+  @retval EFI_NOT_STARTED  No scopes were profiled.
+  @retval EFI_NOT_FOUND    File logging is not active.
+**/
+EFI_STATUS
+OcProfileReport (
+  VOID
+  );
+
 /**
   Install and initialise the Apple Debug Log protocol.
 
@@ -353,6 +353,23 @@ OcCountSplitDescriptors (
   VOID
   );
 
+/**
+  Count exact amount of descriptors OcSplitMemoryMapByAttributes adds
+  to the memory map. Memory map and attributes table must be sorted.
+
+  @param[in]  MemoryMapSize   Memory map size in bytes.
+  @param[in]  MemoryMap       Memory map to inspect.
+  @param[in]  DescriptorSize  Memory map descriptor size in bytes.
+
+  @retval amount of descriptors added by splitting.
+**/
+UINTN
+OcCountSplitDescriptorsByMap (
+  IN UINTN                  MemoryMapSize,
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                  DescriptorSize
+  );
+
 /**
   Split memory map by memory attributes if available.
   Requires sorted memory map!
@@ -429,9 +446,25 @@ typedef struct OC_VMEM_CONTEXT_ {
   ///
   UINT8  *MemoryPool;
   ///
+  /// Start of the memory pool.
+  ///
+  UINT8  *MemoryPoolStart;
+  ///
   /// Free pages in the memory pool.
   ///
   UINTN  FreePages;
+  ///
+  /// Pages consumed by page tables created during mapping.
+  ///
+  UINTN  PageTablePages;
+  ///
+  /// Page tables replaced by large pages, reused for new page tables.
+  ///
+  VOID   *FreePageTables;
+  ///
+  /// CPU supports 1 GB pages.
+  ///
+  BOOLEAN  Supports1GbPages;
 } OC_VMEM_CONTEXT;
 
 /**
@@ -487,7 +520,8 @@ VmMapVirtualPage (
 
 /**
   Map (remap) a range of 4K pages at physical address to given virtual address
-  in the specified page table.
+  in the specified page table. Aligned spans are mapped with 2 MB and, when
+  supported by the CPU, 1 GB pages.
 
   @param[in,out]  Context       Virtual memory pool context.
   @param[in]      PageTable     Page table to update.
@@ -506,6 +540,19 @@ VmMapVirtualPages (
   IN     EFI_PHYSICAL_ADDRESS            PhysicalAddr
   );
 
+/**
+  Get the number of pages consumed by page tables created during mapping.
+  Page tables replaced by large pages are not counted.
+
+  @param[in]  Context       Virtual memory pool context.
+
+  @retval number of page table pages allocated from the pool.
+**/
+UINTN
+VmGetPageTablePages (
+  IN CONST OC_VMEM_CONTEXT  *Context
+  );
+
 /**
   Flushes TLB caches.
 **/
@@ -514,6 +561,20 @@ VmFlushCaches (
   VOID
   );
 
+/**
+  Built-in allocator usage statistics.
+  Sizes are in bytes and include allocator block headers.
+**/
+typedef struct UMM_HEAP_STATS_ {
+  UINT32  TotalSize;
+  UINT32  UsedSize;
+  UINT32  PeakUsedSize;
+  UINT32  FreeSize;
+  UINT32  LargestFreeBlock;
+  UINT32  AllocationCount;
+  UINT32  FailedAllocations;
+} UMM_HEAP_STATS;
+
 /**
   Check whether built-in allocator is initialized.
 
@@ -561,4 +622,14 @@ UmmFree (
   IN VOID  *Ptr
   );
 
+/**
+  Obtain built-in allocator usage statistics.
+
+  @param[out]  Stats  Usage statistics.
+**/
+VOID
+UmmGetStatistics (
+  OUT UMM_HEAP_STATS  *Stats
+  );
+
 #endif // OC_MEMORY_LIB_H
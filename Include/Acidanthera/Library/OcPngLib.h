@@ -19,6 +19,19 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #ifndef OC_PNG_LIB_H
 #define OC_PNG_LIB_H
 
+#include <Protocol/GraphicsOutput.h>
+
+/**
+  Reusable PNG decoding context holding scratch buffers.
+  Must be zeroed before first use and released with OcPngContextFree.
+**/
+typedef struct {
+  UINT8   *Inflated;
+  UINTN   InflatedSize;
+  UINT8   *Idat;
+  UINTN   IdatSize;
+} OC_PNG_CONTEXT;
+
 /**
   Retrieves PNG image dimensions
 
@@ -64,6 +77,47 @@ OcDecodePng (
   OUT  BOOLEAN  *HasAlphaType OPTIONAL
   );
 
+/**
+  Decodes PNG image directly into a BGRA pixel buffer.
+
+  This is a fast path for 8-bit non-interlaced grayscale and truecolour
+  images with or without alpha, which covers theme assets. Other images
+  are rejected with EFI_UNSUPPORTED and should be decoded with OcDecodePng.
+
+  @param  Context                Decoding context for scratch reuse, optional.
+  @param  Buffer                 Buffer with desired png image
+  @param  Size                   Size of input image
+  @param  Pixels                 Output pixel buffer, to be freed by the caller
+  @param  Width                  Image width at output
+  @param  Height                 Image height at output
+  @param  PremultiplyAlpha       Premultiply colour channels with alpha
+
+  @return EFI_SUCCESS            The function completed successfully.
+  @return EFI_UNSUPPORTED        Image format is not handled by this path.
+  @return EFI_OUT_OF_RESOURCES   There are not enough resources to decode.
+  @return EFI_INVALID_PARAMETER  Passed wrong parameter
+**/
+EFI_STATUS
+OcDecodePngToBlt (
+  IN OUT OC_PNG_CONTEXT                 *Context  OPTIONAL,
+  IN     CONST VOID                     *Buffer,
+  IN     UINTN                          Size,
+  OUT    EFI_GRAPHICS_OUTPUT_BLT_PIXEL  **Pixels,
+  OUT    UINT32                         *Width,
+  OUT    UINT32                         *Height,
+  IN     BOOLEAN                        PremultiplyAlpha
+  );
+
+/**
+  Frees scratch buffers of PNG decoding context.
+
+  @param  Context                Decoding context.
+**/
+VOID
+OcPngContextFree (
+  IN OUT OC_PNG_CONTEXT  *Context
+  );
+
 /**
   Encodes raw pixel buffer into PNG image data
 
@@ -56,6 +56,8 @@
 #define APFS_OBJ_NOHEADER                    0x20000000U
 #define APFS_OBJ_ENCRYPTED                   0x10000000U
 #define APFS_OBJ_NONPERSISTENT               0x08000000U
+#define APFS_OBJECT_TYPE_MASK                0x0000ffffU
+#define APFS_OBJECT_TYPE_FLAGS_MASK          0xffff0000U
 
 //
 // Container Superblock definitions
@@ -71,6 +73,8 @@
 #define APFS_NX_MINIMUM_BLOCK_SIZE           BASE_4KB
 #define APFS_NX_DEFAULT_BLOCK_SIZE           BASE_4KB
 #define APFS_NX_MAXIMUM_BLOCK_SIZE           BASE_64KB
+#define APFS_NX_XP_DESC_BLOCKS_MASK          0x7fffffffU
+#define APFS_NX_XP_DESC_NONCONTIGUOUS        0x80000000U
 
 //
 // EfiBootRecord block definitions
@@ -78,10 +82,33 @@
 #define APFS_NX_EFI_JUMPSTART_MAGIC   SIGNATURE_32 ('J', 'S', 'D', 'R')
 #define APFS_NX_EFI_JUMPSTART_VERSION 1
 
+//
+// Volume Superblock definitions
+//
+#define APFS_SIGNATURE                       SIGNATURE_32 ('A', 'P', 'S', 'B')
+#define APFS_FS_UNENCRYPTED                  0x00000001ULL
+#define APFS_INCOMPAT_SEALED_VOLUME          0x00000020ULL
+
 #define APFS_MAX_HIST           8
 #define APFS_MODIFIED_NAMELEN   32
 #define APFS_VOLNAME_LEN        256
 
+//
+// Object map definitions
+//
+#define APFS_OMAP_VAL_DELETED                0x00000001U
+#define APFS_OMAP_VAL_SAVED                  0x00000002U
+#define APFS_OMAP_VAL_ENCRYPTED              0x00000004U
+#define APFS_OMAP_VAL_NOHEADER               0x00000008U
+
+//
+// B-tree node definitions
+//
+#define APFS_BTNODE_ROOT                     0x0001U
+#define APFS_BTNODE_LEAF                     0x0002U
+#define APFS_BTNODE_FIXED_KV_SIZE            0x0004U
+#define APFS_BTREE_NODE_MAX_DEPTH            16
+
 //
 // Fusion things
 //
@@ -344,6 +371,96 @@ typedef struct APFS_NX_EFI_JUMPSTART_ {
   APFS_PHYSICAL_RANGE  RecordExtents[];
 } APFS_NX_EFI_JUMPSTART;
 
+/**
+  OMAP object map.
+**/
+typedef struct APFS_OMAP_PHYS_ {
+  APFS_OBJ_PHYS  BlockHeader;
+  UINT32         Flags;
+  UINT32         SnapshotCount;
+  //
+  // Normally APFS_OBJ_PHYSICAL | APFS_OBJECT_TYPE_BTREE.
+  //
+  UINT32         TreeType;
+  UINT32         SnapshotTreeType;
+  //
+  // Physical address of the mapping B-tree root node.
+  //
+  UINT64         TreeOid;
+  UINT64         SnapshotTreeOid;
+  UINT64         MostRecentSnap;
+  UINT64         PendingRevertMin;
+  UINT64         PendingRevertMax;
+} APFS_OMAP_PHYS;
+
+/**
+  Object map B-tree key.
+**/
+typedef struct APFS_OMAP_KEY_ {
+  UINT64  Oid;
+  UINT64  Xid;
+} APFS_OMAP_KEY;
+
+/**
+  Object map B-tree leaf value.
+**/
+typedef struct APFS_OMAP_VAL_ {
+  UINT32  Flags;
+  UINT32  Size;
+  UINT64  PhysicalAddr;
+} APFS_OMAP_VAL;
+
+/**
+  Location within B-tree node.
+**/
+typedef struct APFS_NLOC_ {
+  UINT16  Offset;
+  UINT16  Length;
+} APFS_NLOC;
+
+/**
+  Table of contents entry for fixed size keys and values.
+  Key offset is relative to key area start, value offset
+  is counted backwards from value area end.
+**/
+typedef struct APFS_KVOFF_ {
+  UINT16  KeyOffset;
+  UINT16  ValueOffset;
+} APFS_KVOFF;
+
+/**
+  B-tree node header, followed by node data.
+**/
+typedef struct APFS_BTREE_NODE_PHYS_ {
+  APFS_OBJ_PHYS  BlockHeader;
+  UINT16         Flags;
+  UINT16         Level;
+  UINT32         KeyCount;
+  APFS_NLOC      TableSpace;
+  APFS_NLOC      FreeSpace;
+  APFS_NLOC      KeyFreeList;
+  APFS_NLOC      ValueFreeList;
+  UINT8          Data[];
+} APFS_BTREE_NODE_PHYS;
+
+STATIC_ASSERT (sizeof (APFS_BTREE_NODE_PHYS) == 56, "APFS_BTREE_NODE_PHYS has unexpected size");
+
+/**
+  B-tree information stored at the end of root nodes.
+**/
+typedef struct APFS_BTREE_INFO_ {
+  UINT32  Flags;
+  UINT32  NodeSize;
+  UINT32  KeySize;
+  UINT32  ValueSize;
+  UINT32  LongestKey;
+  UINT32  LongestValue;
+  UINT64  KeyCount;
+  UINT64  NodeCount;
+} APFS_BTREE_INFO;
+
+STATIC_ASSERT (sizeof (APFS_BTREE_INFO) == 40, "APFS_BTREE_INFO has unexpected size");
+
 #pragma pack(pop)
 
 #endif // APFS_H
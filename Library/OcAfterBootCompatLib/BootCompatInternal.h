@@ -52,6 +52,39 @@
 **/
 #define RT_DESC_ENTRY_NUM        ((UINTN) 64)
 
+/**
+  Maximum size of processed memory map kept between GetMemoryMap calls.
+  Enough for 680 descriptors of 48 bytes, larger maps are not cached.
+**/
+#define MEMORY_MAP_CACHE_SIZE    ((UINTN) EFI_PAGE_SIZE * 8)
+
+/**
+  Size of the arena serving small boot.efi pool allocations.
+**/
+#define POOL_CACHE_SIZE          ((UINTN) SIZE_8MB)
+
+/**
+  Number of pages in the pool cache arena.
+**/
+#define POOL_CACHE_PAGE_NUM      EFI_SIZE_TO_PAGES (POOL_CACHE_SIZE)
+
+/**
+  Smallest pool cache size class, 16 bytes. Must fit a free list link.
+**/
+#define POOL_CACHE_MIN_SHIFT     4U
+#define POOL_CACHE_MIN_SIZE      ((UINTN) 1U << POOL_CACHE_MIN_SHIFT)
+
+/**
+  Number of pool cache size classes, 16 to 2048 bytes.
+**/
+#define POOL_CACHE_CLASS_NUM     8U
+#define POOL_CACHE_MAX_SIZE      (POOL_CACHE_MIN_SIZE << (POOL_CACHE_CLASS_NUM - 1))
+
+/**
+  Number of most recent boot services trace events kept, must be a power of two.
+**/
+#define BOOT_TRACE_ENTRY_NUM     1024U
+
 /**
   Kernel static vaddr mapping base.
 **/
@@ -279,6 +312,163 @@ typedef struct SERVICES_OVERRIDE_STATE_ {
   BOOLEAN                       AwaitingPerfAlloc;
 } SERVICES_OVERRIDE_STATE;
 
+/**
+  Processed memory map snapshot served while the firmware memory map is unchanged.
+**/
+typedef struct MEMORY_MAP_CACHE_STATE_ {
+  ///
+  /// Memory map key the snapshot was made for.
+  ///
+  UINTN                         MapKey;
+  ///
+  /// Memory map size in bytes as returned by the firmware.
+  ///
+  UINTN                         FirmwareMapSize;
+  ///
+  /// Processed memory map size in bytes.
+  ///
+  UINTN                         MapSize;
+  ///
+  /// Memory map descriptor size in bytes.
+  ///
+  UINTN                         DescriptorSize;
+  ///
+  /// Amount of nested boot.efi the snapshot was processed for.
+  ///
+  UINTN                         AppleBootNestedCount;
+  ///
+  /// Amount of GetMemoryMap calls served from the snapshot.
+  ///
+  UINT32                        Hits;
+  ///
+  /// Amount of GetMemoryMap calls processed from scratch.
+  ///
+  UINT32                        Misses;
+  ///
+  /// TRUE when Map contains a valid snapshot.
+  ///
+  BOOLEAN                       Valid;
+  ///
+  /// Processed memory map.
+  ///
+  UINT8                         Map[MEMORY_MAP_CACHE_SIZE];
+} MEMORY_MAP_CACHE_STATE;
+
+/**
+  Size-class cache serving small boot.efi pool allocations from own pages.
+**/
+typedef struct POOL_CACHE_STATE_ {
+  ///
+  /// Arena base address, 0 when there is no arena.
+  ///
+  EFI_PHYSICAL_ADDRESS          Base;
+  ///
+  /// Amount of arena pages dedicated to size classes.
+  ///
+  UINTN                         UsedPages;
+  ///
+  /// Amount of blocks handed out and not yet freed.
+  ///
+  UINTN                         LiveCount;
+  ///
+  /// Free block lists per size class.
+  ///
+  VOID                          *FreeBlocks[POOL_CACHE_CLASS_NUM];
+  ///
+  /// Size class index + 1 per arena page, 0 for unused pages.
+  ///
+  UINT8                         PageClass[POOL_CACHE_PAGE_NUM];
+  ///
+  /// Amount of allocations served per size class.
+  ///
+  UINT32                        Allocations[POOL_CACHE_CLASS_NUM];
+  ///
+  /// Amount of blocks returned to the cache.
+  ///
+  UINT32                        Frees;
+  ///
+  /// Amount of allocations of other types or sizes forwarded to the firmware.
+  ///
+  UINT32                        Passthrough;
+  ///
+  /// Amount of allocations forwarded to the firmware due to full arena.
+  ///
+  UINT32                        Exhausted;
+} POOL_CACHE_STATE;
+
+/**
+  Traced UEFI Boot Services calls.
+**/
+typedef enum BOOT_TRACE_EVENT_ {
+  BootTraceAllocatePages,
+  BootTraceFreePages,
+  BootTraceGetMemoryMap,
+  BootTraceAllocatePool,
+  BootTraceFreePool,
+  BootTraceExitBootServices,
+  BootTraceEventMax
+} BOOT_TRACE_EVENT;
+
+/**
+  Boot services trace event.
+**/
+typedef struct BOOT_TRACE_ENTRY_ {
+  ///
+  /// TSC value at call start.
+  ///
+  UINT64                        Tsc;
+  ///
+  /// Call duration in TSC ticks, saturated.
+  ///
+  UINT32                        Duration;
+  ///
+  /// Event type, BOOT_TRACE_EVENT.
+  ///
+  UINT8                         Event;
+  ///
+  /// Status code with BIT7 set for errors.
+  ///
+  UINT8                         Status;
+  ///
+  /// Requested memory type when applicable.
+  ///
+  UINT16                        MemoryType;
+  ///
+  /// Event-specific address.
+  ///
+  UINT64                        Address;
+  ///
+  /// Event-specific size.
+  ///
+  UINT64                        Size;
+} BOOT_TRACE_ENTRY;
+
+/**
+  Boot services trace ring buffer filled while boot.efi is running.
+**/
+typedef struct BOOT_TRACE_STATE_ {
+  ///
+  /// Total amount of recorded events.
+  ///
+  UINT32                        EventCount;
+  ///
+  /// TRUE once the trace was written to the log.
+  ///
+  BOOLEAN                       Dumped;
+  ///
+  /// Amount of calls per event type.
+  ///
+  UINT32                        Calls[BootTraceEventMax];
+  ///
+  /// Total call duration per event type in TSC ticks.
+  ///
+  UINT64                        Ticks[BootTraceEventMax];
+  ///
+  /// Most recent events, EventCount % BOOT_TRACE_ENTRY_NUM is the next one.
+  ///
+  BOOT_TRACE_ENTRY              Entries[BOOT_TRACE_ENTRY_NUM];
+} BOOT_TRACE_STATE;
+
 /**
   Apple kernel support internal state..
 **/
@@ -405,6 +595,18 @@ typedef struct BOOT_COMPAT_CONTEXT_ {
   ///
   SERVICES_OVERRIDE_STATE  ServiceState;
   ///
+  /// Processed memory map snapshot.
+  ///
+  MEMORY_MAP_CACHE_STATE   MemoryMapCache;
+  ///
+  /// Small pool allocation cache.
+  ///
+  POOL_CACHE_STATE         PoolCache;
+  ///
+  /// Boot services trace.
+  ///
+  BOOT_TRACE_STATE         Trace;
+  ///
   /// Apple kernel support internal state.
   ///
   KERNEL_SUPPORT_STATE     KernelState;
@@ -584,6 +786,150 @@ AppleSlideGetRelocationSize (
   IN OUT BOOT_COMPAT_CONTEXT   *BootCompat
   );
 
+/**
+  Start tracing a boot services call.
+
+  @param[in]  BootCompat    Boot compatibility context.
+
+  @retval Current TSC value or 0 when the call is not traced.
+**/
+UINT64
+AppleTraceBegin (
+  IN BOOT_COMPAT_CONTEXT       *BootCompat
+  );
+
+/**
+  Record traced boot services call. No memory is allocated here.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+  @param[in]      StartTsc      AppleTraceBegin result, nothing is recorded for 0.
+  @param[in]      Event         Traced call type.
+  @param[in]      Status        Call status.
+  @param[in]      MemoryType    Requested memory type or 0.
+  @param[in]      Address       Event-specific address.
+  @param[in]      Size          Event-specific size.
+**/
+VOID
+AppleTraceEnd (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat,
+  IN     UINT64                StartTsc,
+  IN     BOOT_TRACE_EVENT      Event,
+  IN     EFI_STATUS            Status,
+  IN     UINT32                MemoryType,
+  IN     UINT64                Address,
+  IN     UINT64                Size
+  );
+
+/**
+  Record boot services call without duration, for calls that cannot
+  be measured, e.g. ExitBootServices, which runs after the trace is written.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+  @param[in]      Event         Traced call type.
+  @param[in]      Status        Call status.
+  @param[in]      MemoryType    Requested memory type or 0.
+  @param[in]      Address       Event-specific address.
+  @param[in]      Size          Event-specific size.
+**/
+VOID
+AppleTraceInstant (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat,
+  IN     BOOT_TRACE_EVENT      Event,
+  IN     EFI_STATUS            Status,
+  IN     UINT32                MemoryType,
+  IN     UINT64                Address,
+  IN     UINT64                Size
+  );
+
+/**
+  Reset boot services trace for a new boot.efi instance.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+**/
+VOID
+AppleTraceReset (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat
+  );
+
+/**
+  Write boot services trace to the log once. The log may allocate memory,
+  so the memory map key is outdated afterwards.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+
+  @retval TRUE when the trace was written.
+**/
+BOOLEAN
+AppleTraceDump (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat
+  );
+
+/**
+  Prepare pool cache for boot.efi and reset its statistics.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+**/
+VOID
+ApplePoolCacheStart (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat
+  );
+
+/**
+  Report pool cache statistics and release the arena when unused.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+**/
+VOID
+ApplePoolCacheStop (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat
+  );
+
+/**
+  Report pool cache allocation mix to the log.
+
+  @param[in]  BootCompat    Boot compatibility context.
+**/
+VOID
+ApplePoolCacheReport (
+  IN BOOT_COMPAT_CONTEXT       *BootCompat
+  );
+
+/**
+  Allocate pool memory from the pool cache.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+  @param[in]      PoolType      AllocatePool memory type argument.
+  @param[in]      Size          AllocatePool size argument.
+  @param[out]     Buffer        AllocatePool buffer argument.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_UNSUPPORTED when the allocation is not cacheable.
+  @retval EFI_OUT_OF_RESOURCES when the arena is full.
+**/
+EFI_STATUS
+ApplePoolCacheAllocate (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat,
+  IN     EFI_MEMORY_TYPE       PoolType,
+  IN     UINTN                 Size,
+     OUT VOID                  **Buffer
+  );
+
+/**
+  Free pool memory allocated from the pool cache.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+  @param[in]      Buffer        FreePool buffer argument.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_NOT_FOUND when the buffer does not belong to the pool cache.
+  @retval EFI_INVALID_PARAMETER when the buffer is not a valid block.
+**/
+EFI_STATUS
+ApplePoolCacheFree (
+  IN OUT BOOT_COMPAT_CONTEXT   *BootCompat,
+  IN     VOID                  *Buffer
+  );
+
 /**
   Allocate memory from a relocation block when zero slide is unavailable.
   EfiLoaderData at address.
@@ -0,0 +1,227 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "BootCompatInternal.h"
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/OcCpuLib.h>
+
+//
+// Event names are parsed by Utilities/AbcTrace, keep them in sync.
+//
+STATIC CONST CHAR8 *mBootTraceEventNames[BootTraceEventMax] = {
+  "AllocatePages",
+  "FreePages",
+  "GetMemoryMap",
+  "AllocatePool",
+  "FreePool",
+  "ExitBootServices"
+};
+
+UINT64
+AppleTraceBegin (
+  IN BOOT_COMPAT_CONTEXT  *BootCompat
+  )
+{
+  if (!BootCompat->Settings.TraceBootServices
+    || BootCompat->ServiceState.AppleBootNestedCount == 0
+    || BootCompat->Trace.Dumped) {
+    return 0;
+  }
+
+  return AsmReadTsc ();
+}
+
+/**
+  Store boot services trace event.
+
+  @param[in,out]  BootCompat    Boot compatibility context.
+  @param[in]      StartTsc      Event TSC value.
+  @param[in]      Duration      Event duration in TSC ticks.
+  @param[in]      Event         Traced call type.
+  @param[in]      Status        Call status.
+  @param[in]      MemoryType    Requested memory type or 0.
+  @param[in]      Address       Event-specific address.
+  @param[in]      Size          Event-specific size.
+**/
+STATIC
+VOID
+TraceRecord (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat,
+  IN     UINT64               StartTsc,
+  IN     UINT64               Duration,
+  IN     BOOT_TRACE_EVENT     Event,
+  IN     EFI_STATUS           Status,
+  IN     UINT32               MemoryType,
+  IN     UINT64               Address,
+  IN     UINT64               Size
+  )
+{
+  BOOT_TRACE_STATE  *Trace;
+  BOOT_TRACE_ENTRY  *Entry;
+
+  Trace = &BootCompat->Trace;
+
+  ++Trace->Calls[Event];
+  Trace->Ticks[Event] += Duration;
+
+  Entry = &Trace->Entries[Trace->EventCount & (BOOT_TRACE_ENTRY_NUM - 1)];
+  ++Trace->EventCount;
+
+  Entry->Tsc        = StartTsc;
+  Entry->Duration   = (UINT32) MIN (Duration, MAX_UINT32);
+  Entry->Event      = (UINT8) Event;
+  Entry->Status     = (UINT8) ((Status & 0x7FU) | (EFI_ERROR (Status) ? BIT7 : 0));
+  Entry->MemoryType = (UINT16) MemoryType;
+  Entry->Address    = Address;
+  Entry->Size       = Size;
+}
+
+VOID
+AppleTraceEnd (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat,
+  IN     UINT64               StartTsc,
+  IN     BOOT_TRACE_EVENT     Event,
+  IN     EFI_STATUS           Status,
+  IN     UINT32               MemoryType,
+  IN     UINT64               Address,
+  IN     UINT64               Size
+  )
+{
+  if (StartTsc == 0) {
+    return;
+  }
+
+  TraceRecord (
+    BootCompat,
+    StartTsc,
+    AsmReadTsc () - StartTsc,
+    Event,
+    Status,
+    MemoryType,
+    Address,
+    Size
+    );
+}
+
+VOID
+AppleTraceInstant (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat,
+  IN     BOOT_TRACE_EVENT     Event,
+  IN     EFI_STATUS           Status,
+  IN     UINT32               MemoryType,
+  IN     UINT64               Address,
+  IN     UINT64               Size
+  )
+{
+  UINT64  StartTsc;
+
+  StartTsc = AppleTraceBegin (BootCompat);
+  if (StartTsc == 0) {
+    return;
+  }
+
+  TraceRecord (
+    BootCompat,
+    StartTsc,
+    0,
+    Event,
+    Status,
+    MemoryType,
+    Address,
+    Size
+    );
+}
+
+VOID
+AppleTraceReset (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat
+  )
+{
+  BOOT_TRACE_STATE  *Trace;
+
+  Trace = &BootCompat->Trace;
+
+  Trace->EventCount = 0;
+  Trace->Dumped     = FALSE;
+  ZeroMem (Trace->Calls, sizeof (Trace->Calls));
+  ZeroMem (Trace->Ticks, sizeof (Trace->Ticks));
+}
+
+BOOLEAN
+AppleTraceDump (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat
+  )
+{
+  BOOT_TRACE_STATE  *Trace;
+  BOOT_TRACE_ENTRY  *Entry;
+  UINT64            Frequency;
+  UINT32            Index;
+  UINT32            Kept;
+  UINT32            Event;
+
+  Trace = &BootCompat->Trace;
+
+  if (!BootCompat->Settings.TraceBootServices || Trace->Dumped) {
+    return FALSE;
+  }
+
+  //
+  // Stop recording, the calls made by the log itself are of no interest.
+  //
+  Trace->Dumped = TRUE;
+
+  Frequency = OcGetTSCFrequency ();
+  Kept      = MIN (Trace->EventCount, BOOT_TRACE_ENTRY_NUM);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCABC: TR begin %u events %u kept TSC %Lu Hz\n",
+    Trace->EventCount,
+    Kept,
+    Frequency
+    ));
+
+  for (Event = 0; Event < BootTraceEventMax; ++Event) {
+    DEBUG ((
+      DEBUG_INFO,
+      "OCABC: TR sum %a %u calls %Lu us\n",
+      mBootTraceEventNames[Event],
+      Trace->Calls[Event],
+      Frequency != 0 ? DivU64x64Remainder (MultU64x32 (Trace->Ticks[Event], 1000000), Frequency, NULL) : 0
+      ));
+  }
+
+  for (Index = Trace->EventCount - Kept; Index != Trace->EventCount; ++Index) {
+    Entry = &Trace->Entries[Index & (BOOT_TRACE_ENTRY_NUM - 1)];
+    DEBUG ((
+      DEBUG_INFO,
+      "OCABC: TR %u %a %Lx %x %02x %x %Lx %Lx\n",
+      Index,
+      mBootTraceEventNames[Entry->Event],
+      Entry->Tsc,
+      Entry->Duration,
+      Entry->Status,
+      Entry->MemoryType,
+      Entry->Address,
+      Entry->Size
+      ));
+  }
+
+  DEBUG ((DEBUG_INFO, "OCABC: TR end\n"));
+
+  return TRUE;
+}
@@ -243,6 +243,13 @@ PerformRtMemoryVirtualMapping (
     Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize);
   }
 
+  RUNTIME_DEBUG ((
+    DEBUG_INFO,
+    "OCABC: RT mapping used %u page table pages, %u free\n",
+    (UINT32) VmGetPageTablePages (&KernelState->VmContext),
+    (UINT32) KernelState->VmContext.FreePages
+    ));
+
   VmFlushCaches ();
 
   Status = gRT->SetVirtualAddressMap (
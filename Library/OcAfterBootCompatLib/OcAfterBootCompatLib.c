@@ -127,7 +127,7 @@ OcAbcInitialize (
 
   DEBUG ((
     DEBUG_INFO,
-    "OCABC: FEXITBS %d PRMRG %d CSLIDE %d MSLIDE %d PRSRV %d RBMAP %d VMAP %d APPLOS %d RTPERMS %d\n",
+    "OCABC: FEXITBS %d PRMRG %d CSLIDE %d MSLIDE %d PRSRV %d RBMAP %d VMAP %d APPLOS %d RTPERMS %d PLCACHE %d TRACE %d\n",
     Settings->ForceExitBootServices,
     Settings->ProtectMemoryRegions,
     Settings->ProvideCustomSlide,
@@ -136,7 +136,9 @@ OcAbcInitialize (
     Settings->RebuildAppleMemoryMap,
     Settings->SetupVirtualMap,
     Settings->SignalAppleOS,
-    Settings->SyncRuntimePermissions
+    Settings->SyncRuntimePermissions,
+    Settings->CachePoolAllocations,
+    Settings->TraceBootServices
     ));
 
   DEBUG_CODE_BEGIN ();
@@ -0,0 +1,327 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "BootCompatInternal.h"
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/OcMemoryLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+/**
+  Freed pool cache block, linked into its size class free list.
+**/
+typedef struct POOL_CACHE_FREE_BLOCK_ {
+  struct POOL_CACHE_FREE_BLOCK_  *Next;
+} POOL_CACHE_FREE_BLOCK;
+
+/**
+  Get size class index for the allocation size.
+
+  @param[in]  Size  Allocation size in bytes, not above POOL_CACHE_MAX_SIZE.
+
+  @retval Size class index.
+**/
+STATIC
+UINT32
+PoolCacheGetClass (
+  IN UINTN  Size
+  )
+{
+  if (Size <= POOL_CACHE_MIN_SIZE) {
+    return 0;
+  }
+
+  return (UINT32) HighBitSet32 ((UINT32) (Size - 1)) + 1 - POOL_CACHE_MIN_SHIFT;
+}
+
+/**
+  Dedicate a new arena page to the size class and put its blocks
+  onto the class free list.
+
+  @param[in,out]  Cache  Pool cache state.
+  @param[in]      Class  Size class index.
+
+  @retval TRUE when the free list is no longer empty.
+**/
+STATIC
+BOOLEAN
+PoolCacheRefill (
+  IN OUT POOL_CACHE_STATE  *Cache,
+  IN     UINT32            Class
+  )
+{
+  UINT8                  *Page;
+  UINTN                  BlockSize;
+  UINTN                  Offset;
+  POOL_CACHE_FREE_BLOCK  *Block;
+
+  if (Cache->UsedPages >= POOL_CACHE_PAGE_NUM) {
+    return FALSE;
+  }
+
+  Page      = (UINT8 *) (UINTN) Cache->Base + EFI_PAGES_TO_SIZE (Cache->UsedPages);
+  BlockSize = POOL_CACHE_MIN_SIZE << Class;
+
+  Cache->PageClass[Cache->UsedPages] = (UINT8) (Class + 1);
+  ++Cache->UsedPages;
+
+  //
+  // Link backwards so that the blocks are handed out in address order.
+  //
+  Offset = EFI_PAGE_SIZE;
+  while (Offset >= BlockSize) {
+    Offset                  -= BlockSize;
+    Block                    = (POOL_CACHE_FREE_BLOCK *) (Page + Offset);
+    Block->Next              = Cache->FreeBlocks[Class];
+    Cache->FreeBlocks[Class] = Block;
+  }
+
+  return TRUE;
+}
+
+VOID
+ApplePoolCacheStart (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat
+  )
+{
+  EFI_STATUS        Status;
+  POOL_CACHE_STATE  *Cache;
+
+  Cache = &BootCompat->PoolCache;
+
+  ZeroMem (Cache->Allocations, sizeof (Cache->Allocations));
+  Cache->Frees       = 0;
+  Cache->Passthrough = 0;
+  Cache->Exhausted   = 0;
+
+  //
+  // Reuse the arena left after previous boot.efi with live allocations.
+  //
+  if (Cache->Base != 0) {
+    return;
+  }
+
+  //
+  // Legacy 32-bit boot.efi cannot access memory above 4 GB,
+  // and the lower memory is better left for the kernel.
+  //
+  Cache->Base = BASE_4GB;
+  Status = OcAllocatePagesFromTop (
+    EfiLoaderData,
+    POOL_CACHE_PAGE_NUM,
+    &Cache->Base,
+    BootCompat->ServicePtrs.GetMemoryMap,
+    BootCompat->ServicePtrs.AllocatePages,
+    NULL
+    );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCABC: Pool cache allocation failure - %r\n", Status));
+    Cache->Base = 0;
+    return;
+  }
+
+  Cache->UsedPages = 0;
+  Cache->LiveCount = 0;
+  ZeroMem (Cache->FreeBlocks, sizeof (Cache->FreeBlocks));
+  ZeroMem (Cache->PageClass, sizeof (Cache->PageClass));
+
+  DEBUG ((DEBUG_INFO, "OCABC: Pool cache at 0x%Lx\n", Cache->Base));
+}
+
+VOID
+ApplePoolCacheStop (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat
+  )
+{
+  POOL_CACHE_STATE      *Cache;
+  EFI_PHYSICAL_ADDRESS  ReleaseBase;
+  EFI_TPL               OldTpl;
+
+  Cache = &BootCompat->PoolCache;
+
+  ApplePoolCacheReport (BootCompat);
+
+  //
+  // Blocks still in use stay valid until freed, the arena is released with the last one.
+  //
+  ReleaseBase = 0;
+  OldTpl      = gBS->RaiseTPL (TPL_NOTIFY);
+  if (Cache->Base != 0 && Cache->LiveCount == 0) {
+    ReleaseBase = Cache->Base;
+    Cache->Base = 0;
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  if (ReleaseBase != 0) {
+    BootCompat->ServicePtrs.FreePages (ReleaseBase, POOL_CACHE_PAGE_NUM);
+  }
+}
+
+VOID
+ApplePoolCacheReport (
+  IN BOOT_COMPAT_CONTEXT  *BootCompat
+  )
+{
+  POOL_CACHE_STATE  *Cache;
+
+  Cache = &BootCompat->PoolCache;
+
+  if (Cache->Base == 0) {
+    return;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCABC: Pool cache 16:%u 32:%u 64:%u 128:%u 256:%u 512:%u 1K:%u 2K:%u\n",
+    Cache->Allocations[0],
+    Cache->Allocations[1],
+    Cache->Allocations[2],
+    Cache->Allocations[3],
+    Cache->Allocations[4],
+    Cache->Allocations[5],
+    Cache->Allocations[6],
+    Cache->Allocations[7]
+    ));
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCABC: Pool cache frees %u live %u passthrough %u exhausted %u pages %u/%u\n",
+    Cache->Frees,
+    (UINT32) Cache->LiveCount,
+    Cache->Passthrough,
+    Cache->Exhausted,
+    (UINT32) Cache->UsedPages,
+    (UINT32) POOL_CACHE_PAGE_NUM
+    ));
+}
+
+EFI_STATUS
+ApplePoolCacheAllocate (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat,
+  IN     EFI_MEMORY_TYPE      PoolType,
+  IN     UINTN                Size,
+     OUT VOID                 **Buffer
+  )
+{
+  EFI_STATUS             Status;
+  POOL_CACHE_STATE       *Cache;
+  POOL_CACHE_FREE_BLOCK  *Block;
+  UINT32                 Class;
+  EFI_TPL                OldTpl;
+
+  Cache = &BootCompat->PoolCache;
+
+  if (Buffer == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Event notifications may allocate and free pool while boot.efi is
+  // inside the hook, protect the free lists like the firmware allocator does.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  if (Cache->Base == 0) {
+    Status = EFI_UNSUPPORTED;
+  } else if (PoolType != EfiLoaderData || Size == 0 || Size > POOL_CACHE_MAX_SIZE) {
+    //
+    // Only boot.efi own small allocations are served, the rest
+    // must keep the memory type accounting done by the firmware.
+    //
+    ++Cache->Passthrough;
+    Status = EFI_UNSUPPORTED;
+  } else {
+    Class = PoolCacheGetClass (Size);
+    if (Cache->FreeBlocks[Class] == NULL && !PoolCacheRefill (Cache, Class)) {
+      ++Cache->Exhausted;
+      Status = EFI_OUT_OF_RESOURCES;
+    } else {
+      Block                    = Cache->FreeBlocks[Class];
+      Cache->FreeBlocks[Class] = Block->Next;
+
+      ++Cache->Allocations[Class];
+      ++Cache->LiveCount;
+
+      *Buffer = Block;
+      Status  = EFI_SUCCESS;
+    }
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+EFI_STATUS
+ApplePoolCacheFree (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat,
+  IN     VOID                 *Buffer
+  )
+{
+  EFI_STATUS             Status;
+  POOL_CACHE_STATE       *Cache;
+  POOL_CACHE_FREE_BLOCK  *Block;
+  EFI_PHYSICAL_ADDRESS   ReleaseBase;
+  UINTN                  Offset;
+  UINT8                  Class;
+  EFI_TPL                OldTpl;
+
+  Cache       = &BootCompat->PoolCache;
+  ReleaseBase = 0;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  if (Cache->Base == 0
+    || (UINTN) Buffer < Cache->Base
+    || (UINTN) Buffer >= Cache->Base + EFI_PAGES_TO_SIZE (Cache->UsedPages)) {
+    Status = EFI_NOT_FOUND;
+  } else {
+    Offset = (UINTN) Buffer - (UINTN) Cache->Base;
+    Class  = Cache->PageClass[Offset >> EFI_PAGE_SHIFT];
+    if (Class == 0 || (Offset & ((POOL_CACHE_MIN_SIZE << (Class - 1)) - 1)) != 0) {
+      Status = EFI_INVALID_PARAMETER;
+    } else {
+      Block                        = Buffer;
+      Block->Next                  = Cache->FreeBlocks[Class - 1];
+      Cache->FreeBlocks[Class - 1] = Block;
+
+      ++Cache->Frees;
+      --Cache->LiveCount;
+
+      //
+      // Release the arena once the last block of exited boot.efi is freed.
+      //
+      if (Cache->LiveCount == 0 && BootCompat->ServiceState.AppleBootNestedCount == 0) {
+        ReleaseBase = Cache->Base;
+        Cache->Base = 0;
+      }
+
+      Status = EFI_SUCCESS;
+    }
+  }
+
+  gBS->RestoreTPL (OldTpl);
+
+  if (Status == EFI_INVALID_PARAMETER) {
+    DEBUG ((DEBUG_INFO, "OCABC: Pool cache free of invalid block %p\n", Buffer));
+  }
+
+  if (ReleaseBase != 0) {
+    BootCompat->ServicePtrs.FreePages (ReleaseBase, POOL_CACHE_PAGE_NUM);
+  }
+
+  return Status;
+}
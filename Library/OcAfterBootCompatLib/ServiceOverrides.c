@@ -436,6 +436,194 @@ ApplyBooterPatches (
   }
 }
 
+/**
+  Drop processed memory map snapshot after memory allocation changes.
+
+  @param[in,out]  BootCompat  Boot compatibility context.
+**/
+STATIC
+VOID
+InvalidateMemoryMapCache (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat
+  )
+{
+  BootCompat->MemoryMapCache.Valid = FALSE;
+}
+
+/**
+  Serve processed memory map from the snapshot if the firmware memory map
+  did not change since it was made.
+
+  @param[in,out]  BootCompat      Boot compatibility context.
+  @param[in]      BufferSize      Caller memory map buffer size in bytes.
+  @param[in,out]  MemoryMapSize   Firmware memory map size, updated on success.
+  @param[out]     MemoryMap       Caller memory map buffer.
+  @param[in]      MapKey          Firmware memory map key.
+  @param[in]      DescriptorSize  Memory map descriptor size in bytes.
+
+  @retval TRUE when memory map was served from the snapshot.
+**/
+STATIC
+BOOLEAN
+LookupMemoryMapCache (
+  IN OUT BOOT_COMPAT_CONTEXT    *BootCompat,
+  IN     UINTN                  BufferSize,
+  IN OUT UINTN                  *MemoryMapSize,
+     OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  MapKey,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  MEMORY_MAP_CACHE_STATE  *Cache;
+
+  Cache = &BootCompat->MemoryMapCache;
+
+  if (!Cache->Valid
+    || Cache->MapKey != MapKey
+    || Cache->FirmwareMapSize != *MemoryMapSize
+    || Cache->DescriptorSize != DescriptorSize
+    || Cache->AppleBootNestedCount != BootCompat->ServiceState.AppleBootNestedCount
+    || Cache->MapSize > BufferSize) {
+    ++Cache->Misses;
+    return FALSE;
+  }
+
+  CopyMem (MemoryMap, Cache->Map, Cache->MapSize);
+  *MemoryMapSize = Cache->MapSize;
+  ++Cache->Hits;
+  return TRUE;
+}
+
+/**
+  Remember processed memory map for subsequent GetMemoryMap calls.
+
+  @param[in,out]  BootCompat       Boot compatibility context.
+  @param[in]      FirmwareMapSize  Firmware memory map size in bytes.
+  @param[in]      MemoryMapSize    Processed memory map size in bytes.
+  @param[in]      MemoryMap        Processed memory map.
+  @param[in]      MapKey           Firmware memory map key.
+  @param[in]      DescriptorSize   Memory map descriptor size in bytes.
+**/
+STATIC
+VOID
+StoreMemoryMapCache (
+  IN OUT BOOT_COMPAT_CONTEXT    *BootCompat,
+  IN     UINTN                  FirmwareMapSize,
+  IN     UINTN                  MemoryMapSize,
+  IN     EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  MapKey,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  MEMORY_MAP_CACHE_STATE  *Cache;
+
+  Cache = &BootCompat->MemoryMapCache;
+
+  if (MemoryMapSize > sizeof (Cache->Map)) {
+    Cache->Valid = FALSE;
+    return;
+  }
+
+  CopyMem (Cache->Map, MemoryMap, MemoryMapSize);
+  Cache->MapKey               = MapKey;
+  Cache->FirmwareMapSize      = FirmwareMapSize;
+  Cache->MapSize              = MemoryMapSize;
+  Cache->DescriptorSize       = DescriptorSize;
+  Cache->AppleBootNestedCount = BootCompat->ServiceState.AppleBootNestedCount;
+  Cache->Valid                = TRUE;
+}
+
+/**
+  Mark OpenRuntime executable area as runtime code in the memory map.
+
+  @param[in,out]  BootCompat      Boot compatibility context.
+  @param[in]      MemoryMapSize   Memory map size in bytes.
+  @param[in,out]  MemoryMap       Memory map to update.
+  @param[in]      DescriptorSize  Memory map descriptor size in bytes.
+**/
+STATIC
+VOID
+SyncRuntimeDescriptors (
+  IN OUT BOOT_COMPAT_CONTEXT    *BootCompat,
+  IN     UINTN                  MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  Address;
+  UINTN                 Pages;
+
+  if (!BootCompat->Settings.SyncRuntimePermissions || BootCompat->ServiceState.FwRuntime == NULL) {
+    return;
+  }
+
+  //
+  // Some types of firmware mark runtime drivers loaded after EndOfDxe as EfiRuntimeServicesData:
+  // REF: https://github.com/acidanthera/bugtracker/issues/791#issuecomment-607935508
+  //
+  Status = BootCompat->ServiceState.FwRuntime->GetExecArea (&Address, &Pages);
+
+  if (!EFI_ERROR (Status)) {
+    OcUpdateDescriptors (
+      MemoryMapSize,
+      MemoryMap,
+      DescriptorSize,
+      Address,
+      EfiRuntimeServicesCode,
+      0,
+      0
+      );
+  }
+}
+
+/**
+  Count descriptors splitting the memory map by attributes adds.
+  Memory map snapshot buffer is used as scratch space, and the upper
+  bound is returned when the memory map does not fit there.
+
+  @param[in,out]  BootCompat      Boot compatibility context.
+  @param[in]      DescriptorSize  Memory map descriptor size in bytes.
+
+  @retval amount of descriptors added by splitting.
+**/
+STATIC
+UINTN
+CountSplitDescriptors (
+  IN OUT BOOT_COMPAT_CONTEXT  *BootCompat,
+  IN     UINTN                DescriptorSize
+  )
+{
+  EFI_STATUS             Status;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  UINTN                  MemoryMapSize;
+  UINTN                  MapKey;
+  UINT32                 DescriptorVersion;
+
+  InvalidateMemoryMapCache (BootCompat);
+
+  MemoryMap     = (EFI_MEMORY_DESCRIPTOR *) BootCompat->MemoryMapCache.Map;
+  MemoryMapSize = sizeof (BootCompat->MemoryMapCache.Map);
+  Status = BootCompat->ServicePtrs.GetMemoryMap (
+    &MemoryMapSize,
+    MemoryMap,
+    &MapKey,
+    &DescriptorSize,
+    &DescriptorVersion
+    );
+  if (EFI_ERROR (Status)) {
+    return OcCountSplitDescriptors ();
+  }
+
+  //
+  // Only runtime descriptors are split, so other alterations do not matter.
+  //
+  SyncRuntimeDescriptors (BootCompat, MemoryMapSize, MemoryMap, DescriptorSize);
+  OcSortMemoryMap (MemoryMapSize, MemoryMap, DescriptorSize);
+
+  return OcCountSplitDescriptorsByMap (MemoryMapSize, MemoryMap, DescriptorSize);
+}
+
 /**
   UEFI Boot Services AllocatePages override.
   Returns pages from free memory block to boot.efi for kernel boot image.
@@ -454,6 +642,7 @@ OcAllocatePages (
   BOOT_COMPAT_CONTEXT     *BootCompat;
   BOOLEAN                 IsPerfAlloc;
   BOOLEAN                 IsCallGateAlloc;
+  UINT64                  TraceTsc;
 
   //
   // Filter out garbage right away.
@@ -465,6 +654,7 @@ OcAllocatePages (
   BootCompat      = GetBootCompatContext ();
   IsPerfAlloc     = FALSE;
   IsCallGateAlloc = FALSE;
+  TraceTsc        = AppleTraceBegin (BootCompat);
 
   if (BootCompat->ServiceState.AwaitingPerfAlloc) {
     if (BootCompat->ServiceState.AppleBootNestedCount > 0) {
@@ -512,7 +702,18 @@ OcAllocatePages (
 
   DEBUG ((DEBUG_VERBOSE, "OCABC: AllocPages %u 0x%Lx (%u) - %r\n", Type, *Memory, NumberOfPages, Status));
 
+  AppleTraceEnd (
+    BootCompat,
+    TraceTsc,
+    BootTraceAllocatePages,
+    Status,
+    MemoryType,
+    *Memory,
+    EFI_PAGES_TO_SIZE ((UINT64) NumberOfPages)
+    );
+
   if (!EFI_ERROR (Status)) {
+    InvalidateMemoryMapCache (BootCompat);
     FixRuntimeAttributes (BootCompat, MemoryType);
 
     if (BootCompat->ServiceState.AppleBootNestedCount > 0) {
@@ -549,8 +750,10 @@ OcFreePages (
 {
   EFI_STATUS              Status;
   BOOT_COMPAT_CONTEXT     *BootCompat;
+  UINT64                  TraceTsc;
 
   BootCompat  = GetBootCompatContext ();
+  TraceTsc    = AppleTraceBegin (BootCompat);
 
   Status = BootCompat->ServicePtrs.FreePages (
     Memory,
@@ -558,21 +761,30 @@ OcFreePages (
     );
 
   if (!EFI_ERROR (Status)) {
+    InvalidateMemoryMapCache (BootCompat);
     FixRuntimeAttributes (BootCompat, EfiRuntimeServicesData);
   }
 
+  AppleTraceEnd (
+    BootCompat,
+    TraceTsc,
+    BootTraceFreePages,
+    Status,
+    0,
+    Memory,
+    EFI_PAGES_TO_SIZE ((UINT64) Pages)
+    );
+
   return Status;
 }
 
 /**
-  UEFI Boot Services GetMemoryMap override.
+  Obtain firmware memory map and apply any alterations as necessary.
   Returns shrinked memory map as XNU can handle up to PMAP_MEMORY_REGIONS_SIZE (128) entries.
-  Also applies any further memory map alterations as necessary.
 **/
 STATIC
 EFI_STATUS
-EFIAPI
-OcGetMemoryMap (
+InternalGetMemoryMap (
   IN OUT UINTN                  *MemoryMapSize,
   IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
      OUT UINTN                  *MapKey,
@@ -583,9 +795,8 @@ OcGetMemoryMap (
   EFI_STATUS            Status;
   EFI_STATUS            Status2;
   BOOT_COMPAT_CONTEXT   *BootCompat;
-  EFI_PHYSICAL_ADDRESS  Address;
-  UINTN                 Pages;
   UINTN                 OriginalSize;
+  UINTN                 FirmwareMapSize;
 
   BootCompat = GetBootCompatContext ();
 
@@ -602,7 +813,7 @@ OcGetMemoryMap (
   // Reserve larger area for the memory map when we need to split it.
   //
   if (BootCompat->ServiceState.AppleBootNestedCount > 0 && Status == EFI_BUFFER_TOO_SMALL) {
-    *MemoryMapSize += OcCountSplitDescriptors () * *DescriptorSize;
+    *MemoryMapSize += CountSplitDescriptors (BootCompat, *DescriptorSize) * *DescriptorSize;
     return EFI_BUFFER_TOO_SMALL;
   }
 
@@ -610,26 +821,30 @@ OcGetMemoryMap (
     return Status;
   }
 
-  if (BootCompat->Settings.SyncRuntimePermissions && BootCompat->ServiceState.FwRuntime != NULL) {
-    //
-    // Some types of firmware mark runtime drivers loaded after EndOfDxe as EfiRuntimeServicesData:
-    // REF: https://github.com/acidanthera/bugtracker/issues/791#issuecomment-607935508
-    //
-    Status2 = BootCompat->ServiceState.FwRuntime->GetExecArea (&Address, &Pages);
-
-    if (!EFI_ERROR (Status2)) {
-      OcUpdateDescriptors (
-        *MemoryMapSize,
-        MemoryMap,
-        *DescriptorSize,
-        Address,
-        EfiRuntimeServicesCode,
-        0,
-        0
-        );
-    }
+  //
+  // boot.efi requests the memory map many times in a row, and unless
+  // the map key changed or memory was allocated the processed map is the same.
+  //
+  FirmwareMapSize = *MemoryMapSize;
+  if (BootCompat->ServiceState.AppleBootNestedCount > 0
+    && LookupMemoryMapCache (
+      BootCompat,
+      OriginalSize,
+      MemoryMapSize,
+      MemoryMap,
+      *MapKey,
+      *DescriptorSize
+      )) {
+    return Status;
   }
 
+  SyncRuntimeDescriptors (
+    BootCompat,
+    *MemoryMapSize,
+    MemoryMap,
+    *DescriptorSize
+    );
+
   if (BootCompat->ServiceState.AppleBootNestedCount > 0) {
     if (BootCompat->Settings.ProtectMemoryRegions) {
       ProtectMemoryRegions (
@@ -673,11 +888,64 @@ OcGetMemoryMap (
     // during hibernate wake to be able to iterate memory map.
     //
     BootCompat->ServiceState.MemoryMapDescriptorSize = *DescriptorSize;
+
+    StoreMemoryMapCache (
+      BootCompat,
+      FirmwareMapSize,
+      *MemoryMapSize,
+      MemoryMap,
+      *MapKey,
+      *DescriptorSize
+      );
   }
 
   return Status;
 }
 
+/**
+  UEFI Boot Services GetMemoryMap override.
+  Returns shrinked memory map as XNU can handle up to PMAP_MEMORY_REGIONS_SIZE (128) entries.
+  Also applies any further memory map alterations as necessary.
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+OcGetMemoryMap (
+  IN OUT UINTN                  *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+     OUT UINTN                  *MapKey,
+     OUT UINTN                  *DescriptorSize,
+     OUT UINT32                 *DescriptorVersion
+  )
+{
+  EFI_STATUS            Status;
+  BOOT_COMPAT_CONTEXT   *BootCompat;
+  UINT64                TraceTsc;
+
+  BootCompat = GetBootCompatContext ();
+  TraceTsc   = AppleTraceBegin (BootCompat);
+
+  Status = InternalGetMemoryMap (
+    MemoryMapSize,
+    MemoryMap,
+    MapKey,
+    DescriptorSize,
+    DescriptorVersion
+    );
+
+  AppleTraceEnd (
+    BootCompat,
+    TraceTsc,
+    BootTraceGetMemoryMap,
+    Status,
+    0,
+    !EFI_ERROR (Status) ? *MapKey : 0,
+    MemoryMapSize != NULL ? *MemoryMapSize : 0
+    );
+
+  return Status;
+}
+
 /**
   UEFI Boot Services AllocatePool override.
   Ensures synchronised memory attribute table.
@@ -693,19 +961,48 @@ OcAllocatePool (
 {
   EFI_STATUS              Status;
   BOOT_COMPAT_CONTEXT     *BootCompat;
+  UINT64                  TraceTsc;
 
   BootCompat  = GetBootCompatContext ();
+  TraceTsc    = AppleTraceBegin (BootCompat);
 
-  Status = BootCompat->ServicePtrs.AllocatePool (
-    PoolType,
-    Size,
-    Buffer
-    );
+  //
+  // Small boot.efi allocations do not change the firmware memory map when cached.
+  //
+  Status = EFI_UNSUPPORTED;
+  if (BootCompat->Settings.CachePoolAllocations
+    && BootCompat->ServiceState.AppleBootNestedCount > 0) {
+    Status = ApplePoolCacheAllocate (
+      BootCompat,
+      PoolType,
+      Size,
+      Buffer
+      );
+  }
 
-  if (!EFI_ERROR (Status)) {
-    FixRuntimeAttributes (BootCompat, PoolType);
+  if (EFI_ERROR (Status)) {
+    Status = BootCompat->ServicePtrs.AllocatePool (
+      PoolType,
+      Size,
+      Buffer
+      );
+
+    if (!EFI_ERROR (Status)) {
+      InvalidateMemoryMapCache (BootCompat);
+      FixRuntimeAttributes (BootCompat, PoolType);
+    }
   }
 
+  AppleTraceEnd (
+    BootCompat,
+    TraceTsc,
+    BootTraceAllocatePool,
+    Status,
+    PoolType,
+    !EFI_ERROR (Status) ? (UINTN) *Buffer : 0,
+    Size
+    );
+
   return Status;
 }
 
@@ -722,17 +1019,37 @@ OcFreePool (
 {
   EFI_STATUS              Status;
   BOOT_COMPAT_CONTEXT     *BootCompat;
+  UINT64                  TraceTsc;
 
   BootCompat  = GetBootCompatContext ();
+  TraceTsc    = AppleTraceBegin (BootCompat);
 
-  Status = BootCompat->ServicePtrs.FreePool (
-    Buffer
-    );
+  Status = EFI_NOT_FOUND;
+  if (BootCompat->Settings.CachePoolAllocations) {
+    Status = ApplePoolCacheFree (BootCompat, Buffer);
+  }
 
-  if (!EFI_ERROR (Status)) {
-    FixRuntimeAttributes (BootCompat, EfiRuntimeServicesData);
+  if (Status == EFI_NOT_FOUND) {
+    Status = BootCompat->ServicePtrs.FreePool (
+      Buffer
+      );
+
+    if (!EFI_ERROR (Status)) {
+      InvalidateMemoryMapCache (BootCompat);
+      FixRuntimeAttributes (BootCompat, EfiRuntimeServicesData);
+    }
   }
 
+  AppleTraceEnd (
+    BootCompat,
+    TraceTsc,
+    BootTraceFreePool,
+    Status,
+    0,
+    (UINTN) Buffer,
+    0
+    );
+
   return Status;
 }
 
@@ -776,6 +1093,9 @@ OcStartImage (
   // Clear monitoring vars
   //
   BootCompat->ServiceState.KernelCallGate = 0;
+  InvalidateMemoryMapCache (BootCompat);
+  BootCompat->MemoryMapCache.Hits   = 0;
+  BootCompat->MemoryMapCache.Misses = 0;
 
   if (AppleLoadedImage != NULL) {
     //
@@ -783,6 +1103,15 @@ OcStartImage (
     //
     ++BootCompat->ServiceState.AppleBootNestedCount;
 
+    if (BootCompat->Settings.CachePoolAllocations
+      && BootCompat->ServiceState.AppleBootNestedCount == 1) {
+      ApplePoolCacheStart (BootCompat);
+    }
+
+    if (BootCompat->ServiceState.AppleBootNestedCount == 1) {
+      AppleTraceReset (BootCompat);
+    }
+
     //
     // VMware uses OSInfo->SetName call by EfiBoot to ensure that we are allowed
     // to run this version of macOS on VMware. The relevant EfiBoot image handle
@@ -905,13 +1234,25 @@ OcStartImage (
     );
 
   if (AppleLoadedImage != NULL) {
+    DEBUG ((
+      DEBUG_INFO,
+      "OCABC: Memory map cache hits %u misses %u\n",
+      BootCompat->MemoryMapCache.Hits,
+      BootCompat->MemoryMapCache.Misses
+      ));
+
     //
     // We failed but other operating systems should be loadable.
     //
     --BootCompat->ServiceState.AppleBootNestedCount;
 
     if (BootCompat->ServiceState.AppleBootNestedCount == 0) {
+      AppleTraceDump (BootCompat);
       AppleRelocationRelease (BootCompat);
+
+      if (BootCompat->Settings.CachePoolAllocations) {
+        ApplePoolCacheStop (BootCompat);
+      }
     }
   }
 
@@ -933,9 +1274,23 @@ OcExitBootServices (
   EFI_STATUS               Status;
   BOOT_COMPAT_CONTEXT      *BootCompat;
   UINTN                    Index;
+  BOOLEAN                  ForceExit;
 
   BootCompat = GetBootCompatContext ();
 
+  //
+  // The trace is written before calling the firmware, so only the call
+  // moment is recorded.
+  //
+  AppleTraceInstant (
+    BootCompat,
+    BootTraceExitBootServices,
+    EFI_SUCCESS,
+    0,
+    MapKey,
+    0
+    );
+
   //
   // Handle events in case we have any.
   //
@@ -964,6 +1319,24 @@ OcExitBootServices (
       );
   }
 
+  //
+  // Writing the trace to the log may allocate memory and outdate MapKey.
+  // Changes to boot services memory are harmless, as with ForceExitBootServices.
+  //
+  ForceExit = BootCompat->Settings.ForceExitBootServices;
+  if (AppleTraceDump (BootCompat)) {
+    ForceExit = TRUE;
+  }
+
+  //
+  // Save everything logged while boot.efi was running, including the trace,
+  // as file logging is impossible after ExitBootServices. Writing may outdate
+  // MapKey, which is harmless, as only boot services memory changes.
+  //
+  if (!EFI_ERROR (OcFlushLogProtocol ())) {
+    ForceExit = TRUE;
+  }
+
   //
   // Enable custom SetVirtualAddressMap.
   //
@@ -971,7 +1344,7 @@ OcExitBootServices (
     BootCompat->ServiceState.FwRuntime->OnSetAddressMap (NULL, TRUE);
   }
 
-  if (BootCompat->Settings.ForceExitBootServices) {
+  if (ForceExit) {
     Status = ForceExitBootServices (
       ImageHandle,
       MapKey,
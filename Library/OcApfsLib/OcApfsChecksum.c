@@ -0,0 +1,155 @@
+/** @file
+  Copyright (C) 2020, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "OcApfsInternal.h"
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+
+STATIC
+UINT64
+ApfsFletcher64 (
+  VOID    *Data,
+  UINTN   DataSize
+  )
+{
+  UINT32        *Walker;
+  UINT32        *WalkerEnd;
+  UINT64        Sum1;
+  UINT64        Sum2;
+  UINT64        Words;
+  UINT64        Weighted;
+  UINT32        Rem;
+
+  //
+  // For APFS we have the following guarantees (checked outside).
+  // - DataSize is always divisible by 4 (UINT32), the only potential exceptions
+  //   are multiples of block sizes of 1 and 2, which we do not support and filter out.
+  // - DataSize is always between 0x1000-8 and 0x10000-8, i.e. within UINT16.
+  //
+  ASSERT (DataSize >= APFS_NX_MINIMUM_BLOCK_SIZE - sizeof (UINT64));
+  ASSERT (DataSize <= APFS_NX_MAXIMUM_BLOCK_SIZE - sizeof (UINT64));
+  ASSERT (DataSize % sizeof (UINT32) == 0);
+
+  Sum1 = 0;
+  Sum2 = 0;
+
+  Walker     = Data;
+  WalkerEnd  = Walker + DataSize / sizeof (UINT32);
+
+  //
+  // Do usual Fletcher-64 rounds without modulo due to impossible overflow.
+  // Sum1 never overflows, because 0xFFFFFFFF * (0x10000-8) < MAX_UINT64.
+  // Sum2 never overflows, because 0xFFFFFFFF * (0x4000-1) * 0x1FFF < MAX_UINT64.
+  //
+  // Four words are consumed per round to break the dependency of Sum2 on
+  // every Sum1 update. With words W0..W3 the round is equivalent to four
+  // ordinary ones: Sum2 += 4 * Sum1 + 4 * W0 + 3 * W1 + 2 * W2 + W3.
+  // Sum2 is exactly the same after each round, so the bounds above hold.
+  //
+  while (WalkerEnd - Walker >= 4) {
+    Words    = (UINT64) Walker[0] + Walker[1] + Walker[2] + Walker[3];
+    Weighted = ((UINT64) Walker[0] << 2U) + ((UINT64) Walker[1] << 1U)
+      + Walker[1] + ((UINT64) Walker[2] << 1U) + Walker[3];
+
+    Sum2   += (Sum1 << 2U) + Weighted;
+    Sum1   += Words;
+    Walker += 4;
+  }
+
+  while (Walker < WalkerEnd) {
+    Sum1 += *Walker;
+    Sum2 += Sum1;
+    ++Walker;
+  }
+
+  //
+  // Split Fletcher-64 halves.
+  // As per Chinese remainder theorem, perform the modulo now.
+  // No overflows also possible as seen from Sum1/Sum2 upper bounds above.
+  //
+
+  Sum2 += Sum1;
+  APFS_MOD_MAX_UINT32 (Sum2, &Rem);
+  Sum2  = ~Rem;
+
+  Sum1 += Sum2;
+  APFS_MOD_MAX_UINT32 (Sum1, &Rem);
+  Sum1  = ~Rem;
+
+  return (Sum1 << 32U) | Sum2;
+}
+
+BOOLEAN
+InternalApfsBlockChecksumVerify (
+  IN APFS_OBJ_PHYS  *Block,
+  IN UINTN          DataSize
+  )
+{
+  UINT64  NewChecksum;
+
+  ASSERT (DataSize > sizeof (*Block));
+
+  NewChecksum = ApfsFletcher64 (
+    &Block->ObjectOid,
+    DataSize - sizeof (Block->Checksum)
+    );
+
+  if (NewChecksum == Block->Checksum) {
+    return TRUE;
+  }
+
+  DEBUG ((DEBUG_INFO, "OCJS: Checksum mismatch for %Lx\n", Block->ObjectOid));
+  return FALSE;
+}
+
+UINTN
+InternalApfsBlocksChecksumVerify (
+  IN  VOID     *Blocks,
+  IN  UINT32   BlockSize,
+  IN  UINTN    BlockCount,
+  OUT BOOLEAN  *Valid  OPTIONAL
+  )
+{
+  APFS_OBJ_PHYS  *Block;
+  UINTN          Index;
+  UINTN          ValidCount;
+  BOOLEAN        IsValid;
+
+  ASSERT (BlockSize >= APFS_NX_MINIMUM_BLOCK_SIZE);
+  ASSERT (BlockSize <= APFS_NX_MAXIMUM_BLOCK_SIZE);
+
+  ValidCount = 0;
+
+  for (Index = 0; Index < BlockCount; ++Index) {
+    Block = (APFS_OBJ_PHYS *) ((UINT8 *) Blocks + Index * BlockSize);
+
+    //
+    // Mismatches are expected when scanning, e.g. for unused checkpoint blocks.
+    //
+    IsValid = ApfsFletcher64 (
+      &Block->ObjectOid,
+      BlockSize - sizeof (Block->Checksum)
+      ) == Block->Checksum;
+
+    if (IsValid) {
+      ++ValidCount;
+    }
+
+    if (Valid != NULL) {
+      Valid[Index] = IsValid;
+    }
+  }
+
+  return ValidCount;
+}
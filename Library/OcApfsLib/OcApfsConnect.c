@@ -14,6 +14,7 @@
 
 #include "OcApfsInternal.h"
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcApfsLib.h>
@@ -21,6 +22,7 @@
 #include <Library/OcAppleSecureBootLib.h>
 #include <Library/OcBootManagementLib.h>
 #include <Library/OcConsoleLib.h>
+#include <Library/OcCryptoLib.h>
 #include <Library/OcDriverConnectionLib.h>
 #include <Library/OcGuardLib.h>
 #include <Library/UefiBootServicesTableLib.h>
@@ -48,6 +50,20 @@ STATIC UINT64 mApfsBlacklistedVersions[] = {
   4294966999999999999ULL
 };
 
+//
+// Drivers started or rejected during this boot, multiple containers often
+// carry the same one. Failures which may be transient are not recorded.
+//
+#define APFS_KNOWN_DRIVER_MAX  8
+
+typedef struct {
+  UINT8       Digest[SHA256_DIGEST_SIZE];
+  EFI_STATUS  Status;
+} APFS_KNOWN_DRIVER;
+
+STATIC APFS_KNOWN_DRIVER  mApfsKnownDrivers[APFS_KNOWN_DRIVER_MAX];
+STATIC UINT32             mApfsKnownDriverCount;
+
 STATIC
 EFI_STATUS
 ApfsCheckOpenCoreScanPolicy (
@@ -229,12 +245,46 @@ ApfsRegisterPartition (
   return EFI_SUCCESS;
 }
 
+STATIC
+APFS_KNOWN_DRIVER *
+ApfsFindKnownDriver (
+  IN CONST UINT8  *Digest
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < mApfsKnownDriverCount; ++Index) {
+    if (CompareMem (mApfsKnownDrivers[Index].Digest, Digest, SHA256_DIGEST_SIZE) == 0) {
+      return &mApfsKnownDrivers[Index];
+    }
+  }
+
+  return NULL;
+}
+
+STATIC
+VOID
+ApfsAddKnownDriver (
+  IN CONST UINT8  *Digest,
+  IN EFI_STATUS   Status
+  )
+{
+  if (mApfsKnownDriverCount == APFS_KNOWN_DRIVER_MAX) {
+    return;
+  }
+
+  CopyMem (mApfsKnownDrivers[mApfsKnownDriverCount].Digest, Digest, SHA256_DIGEST_SIZE);
+  mApfsKnownDrivers[mApfsKnownDriverCount].Status = Status;
+  ++mApfsKnownDriverCount;
+}
+
 STATIC
 EFI_STATUS
 ApfsStartDriver (
-  IN APFS_PRIVATE_DATA  *PrivateData,
-  IN VOID               *DriverBuffer,
-  IN UINT32             DriverSize
+  IN     APFS_PRIVATE_DATA  *PrivateData,
+  IN     CONST UINT8        *RawDigest,
+  IN     VOID               *DriverBuffer,
+  IN OUT UINT32             *DriverSize
   )
 {
   EFI_STATUS                 Status;
@@ -247,7 +297,7 @@ ApfsStartDriver (
 
   Status = PeCoffVerifyAppleSignature (
     DriverBuffer,
-    &DriverSize
+    DriverSize
     );
   if (EFI_ERROR (Status)) {
     DEBUG ((
@@ -256,15 +306,17 @@ ApfsStartDriver (
       &PrivateData->LocationInfo.ContainerUuid,
       Status
       ));
+    ApfsAddKnownDriver (RawDigest, Status);
     return Status;
   }
 
   Status = ApfsVerifyDriverVersion (
     PrivateData,
     DriverBuffer,
-    DriverSize
+    *DriverSize
     );
   if (EFI_ERROR (Status)) {
+    ApfsAddKnownDriver (RawDigest, Status);
     return Status;
   }
 
@@ -301,7 +353,7 @@ ApfsStartDriver (
     gImageHandle,
     DevicePath,
     DriverBuffer,
-    DriverSize,
+    *DriverSize,
     &ImageHandle
     );
   if (EFI_ERROR (Status)) {
@@ -352,6 +404,16 @@ ApfsStartDriver (
     return Status;
   }
 
+  ApfsAddKnownDriver (RawDigest, EFI_SUCCESS);
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+ApfsConnectContainer (
+  IN APFS_PRIVATE_DATA  *PrivateData
+  )
+{
   DEBUG ((
     DEBUG_INFO,
     "OCJS: Connecting %a%a APFS driver on handle %p\n",
@@ -386,8 +448,6 @@ ApfsStartDriver (
     //
     gBS->ConnectController (PrivateData->LocationInfo.ControllerHandle, NULL, NULL, TRUE);
   }
-
-  return EFI_SUCCESS;
 }
 
 STATIC
@@ -397,11 +457,17 @@ ApfsConnectDevice (
   IN EFI_BLOCK_IO_PROTOCOL  *BlockIo
   )
 {
-  EFI_STATUS           Status;
-  APFS_NX_SUPERBLOCK   *SuperBlock;
-  APFS_PRIVATE_DATA    *PrivateData;
-  VOID                 *DriverBuffer;
-  UINT32               DriverSize;
+  EFI_STATUS             Status;
+  APFS_NX_SUPERBLOCK     *SuperBlock;
+  APFS_PRIVATE_DATA      *PrivateData;
+  APFS_NX_EFI_JUMPSTART  *JumpStart;
+  APFS_KNOWN_DRIVER      *KnownDriver;
+  VOID                   *DriverBuffer;
+  VOID                   *StartBuffer;
+  UINT32                 DriverSize;
+  UINT32                 StartSize;
+  UINT8                  RawDigest[SHA256_DIGEST_SIZE];
+  BOOLEAN                Cached;
 
   //
   // This may still be not APFS but some other file system.
@@ -430,14 +496,78 @@ ApfsConnectDevice (
     return EFI_NOT_READY;
   }
 
-  Status = InternalApfsReadDriver (PrivateData, &DriverSize, &DriverBuffer);
+  Status = InternalApfsReadJumpStart (PrivateData, &JumpStart);
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  Status = ApfsStartDriver (PrivateData, DriverBuffer, DriverSize);
+  //
+  // Skip reading the driver started from this container during previous boots.
+  //
+  Cached = InternalApfsDriverCacheLookup (
+    PrivateData,
+    JumpStart,
+    RawDigest,
+    &DriverBuffer,
+    &DriverSize
+    );
+  if (!Cached) {
+    Status = InternalApfsReadDriver (PrivateData, JumpStart, &DriverSize, &DriverBuffer);
+    if (EFI_ERROR (Status)) {
+      FreePool (JumpStart);
+      return Status;
+    }
+
+    Sha256 (RawDigest, DriverBuffer, DriverSize);
+  }
+
+  KnownDriver = ApfsFindKnownDriver (RawDigest);
+  if (KnownDriver != NULL) {
+    //
+    // The same driver is already running or was rejected.
+    //
+    DEBUG ((
+      DEBUG_INFO,
+      "OCJS: Reusing driver result for %g - %r\n",
+      &PrivateData->LocationInfo.ContainerUuid,
+      KnownDriver->Status
+      ));
+    Status = KnownDriver->Status;
+  } else {
+    //
+    // Verification sanitises the image in place, keep the original for caching.
+    //
+    StartSize   = DriverSize;
+    StartBuffer = AllocateCopyPool (DriverSize, DriverBuffer);
+    if (StartBuffer != NULL) {
+      Status = ApfsStartDriver (PrivateData, RawDigest, StartBuffer, &StartSize);
+      FreePool (StartBuffer);
+    } else {
+      Status = EFI_OUT_OF_RESOURCES;
+    }
+
+    if (!EFI_ERROR (Status) && !Cached
+      && !InternalApfsDriverCacheMatch (PrivateData, JumpStart, RawDigest)) {
+      InternalApfsDriverCacheUpdate (
+        PrivateData,
+        JumpStart,
+        RawDigest,
+        DriverBuffer,
+        DriverSize
+        );
+    }
+  }
+
   FreePool (DriverBuffer);
-  return Status;
+
+  FreePool (JumpStart);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ApfsConnectContainer (PrivateData);
+  return EFI_SUCCESS;
 }
 
 VOID
@@ -480,6 +610,19 @@ OcApfsConnectHandle (
   IN EFI_HANDLE  Handle,
   IN BOOLEAN     VerifyPolicy
   )
+{
+  EFI_STATUS  Status;
+
+  Status = InternalApfsConnectHandle (Handle, VerifyPolicy);
+  InternalApfsDriverCacheFlush ();
+  return Status;
+}
+
+EFI_STATUS
+InternalApfsConnectHandle (
+  IN EFI_HANDLE  Handle,
+  IN BOOLEAN     VerifyPolicy
+  )
 {
   EFI_STATUS             Status;
   VOID                   *TempProtocol;
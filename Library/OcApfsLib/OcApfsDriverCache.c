@@ -0,0 +1,322 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "OcApfsInternal.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcApfsLib.h>
+#include <Library/OcCryptoLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/OcPeCoffExtLib.h>
+#include <Library/OcStorageLib.h>
+
+#define APFS_DRIVER_CACHE_PATH        L"JumpstartCache.bin"
+#define APFS_DRIVER_CACHE_SIGNATURE   SIGNATURE_32 ('A', 'J', 'S', 'C')
+#define APFS_DRIVER_CACHE_VERSION     2
+#define APFS_DRIVER_CACHE_CONTAINERS  16
+#define APFS_DRIVER_CACHE_MAX_SIZE    BASE_16MB
+
+#pragma pack(push, 1)
+
+//
+// Container JumpStart known to carry the cached driver.
+//
+typedef struct {
+  EFI_GUID  ContainerUuid;
+  UINT64    JumpStartChecksum;
+  UINT64    EfiFileLen;
+} APFS_DRIVER_CACHE_CONTAINER;
+
+//
+// Followed by driver image as stored in the container.
+//
+typedef struct {
+  UINT32                       Signature;
+  UINT32                       Version;
+  UINT64                       DriverVersion;
+  UINT32                       DriverSize;
+  UINT32                       ContainerCount;
+  UINT8                        RawDigest[SHA256_DIGEST_SIZE];
+  APFS_DRIVER_CACHE_CONTAINER  Containers[APFS_DRIVER_CACHE_CONTAINERS];
+} APFS_DRIVER_CACHE_HEADER;
+
+#pragma pack(pop)
+
+STATIC OC_STORAGE_CONTEXT        *mApfsDriverCacheStorage;
+STATIC APFS_DRIVER_CACHE_HEADER  *mApfsDriverCache;
+STATIC BOOLEAN                   mApfsDriverCacheLoaded;
+STATIC BOOLEAN                   mApfsDriverCacheChanged;
+
+/**
+  Load the cache file once and validate it.
+**/
+STATIC
+VOID
+ApfsDriverCacheLoad (
+  VOID
+  )
+{
+  APFS_DRIVER_CACHE_HEADER  *Cache;
+  UINT32                    CacheSize;
+  UINT8                     Digest[SHA256_DIGEST_SIZE];
+
+  if (mApfsDriverCacheLoaded) {
+    return;
+  }
+
+  mApfsDriverCacheLoaded = TRUE;
+
+  Cache = OcStorageReadFileUnicode (
+    mApfsDriverCacheStorage,
+    APFS_DRIVER_CACHE_PATH,
+    &CacheSize
+    );
+  if (Cache == NULL) {
+    return;
+  }
+
+  if (CacheSize < sizeof (*Cache)
+    || Cache->Signature != APFS_DRIVER_CACHE_SIGNATURE
+    || Cache->Version != APFS_DRIVER_CACHE_VERSION
+    || Cache->DriverSize != CacheSize - sizeof (*Cache)
+    || Cache->ContainerCount > APFS_DRIVER_CACHE_CONTAINERS) {
+    DEBUG ((DEBUG_INFO, "OCJS: Ignoring malformed driver cache of %u bytes\n", CacheSize));
+    FreePool (Cache);
+    return;
+  }
+
+  //
+  // Guard against corruption, the digest identifies the driver across containers.
+  //
+  Sha256 (Digest, (UINT8 *) (Cache + 1), Cache->DriverSize);
+  if (CompareMem (Digest, Cache->RawDigest, sizeof (Digest)) != 0) {
+    DEBUG ((DEBUG_INFO, "OCJS: Ignoring driver cache with digest mismatch\n"));
+    FreePool (Cache);
+    return;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCJS: Loaded driver cache %Lu for %u containers\n",
+    Cache->DriverVersion,
+    Cache->ContainerCount
+    ));
+
+  mApfsDriverCache = Cache;
+}
+
+VOID
+InternalApfsDriverCacheFlush (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+
+  if (!mApfsDriverCacheChanged) {
+    return;
+  }
+
+  mApfsDriverCacheChanged = FALSE;
+
+  Status = SetFileData (
+    mApfsDriverCacheStorage->Storage,
+    APFS_DRIVER_CACHE_PATH,
+    mApfsDriverCache,
+    sizeof (*mApfsDriverCache) + mApfsDriverCache->DriverSize
+    );
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCJS: Saving driver cache %Lu for %u containers - %r\n",
+    mApfsDriverCache->DriverVersion,
+    mApfsDriverCache->ContainerCount,
+    Status
+    ));
+}
+
+/**
+  Find container JumpStart in the cache.
+
+  @param[in]  PrivateData   Container private data.
+  @param[in]  JumpStart     Container JumpStart record.
+
+  @retval TRUE when found.
+**/
+STATIC
+BOOLEAN
+ApfsDriverCacheHasContainer (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart
+  )
+{
+  UINT32  Index;
+
+  for (Index = 0; Index < mApfsDriverCache->ContainerCount; ++Index) {
+    if (CompareGuid (&mApfsDriverCache->Containers[Index].ContainerUuid, &PrivateData->LocationInfo.ContainerUuid)
+      && mApfsDriverCache->Containers[Index].JumpStartChecksum == JumpStart->BlockHeader.Checksum
+      && mApfsDriverCache->Containers[Index].EfiFileLen == JumpStart->EfiFileLen) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Record container JumpStart in the cache, replacing the oldest one when full.
+
+  @param[in]  PrivateData   Container private data.
+  @param[in]  JumpStart     Container JumpStart record.
+**/
+STATIC
+VOID
+ApfsDriverCacheAddContainer (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart
+  )
+{
+  APFS_DRIVER_CACHE_CONTAINER  *Container;
+
+  if (mApfsDriverCache->ContainerCount == APFS_DRIVER_CACHE_CONTAINERS) {
+    CopyMem (
+      &mApfsDriverCache->Containers[0],
+      &mApfsDriverCache->Containers[1],
+      (APFS_DRIVER_CACHE_CONTAINERS - 1) * sizeof (mApfsDriverCache->Containers[0])
+      );
+    --mApfsDriverCache->ContainerCount;
+  }
+
+  Container = &mApfsDriverCache->Containers[mApfsDriverCache->ContainerCount];
+  CopyGuid (&Container->ContainerUuid, &PrivateData->LocationInfo.ContainerUuid);
+  Container->JumpStartChecksum = JumpStart->BlockHeader.Checksum;
+  Container->EfiFileLen        = JumpStart->EfiFileLen;
+  ++mApfsDriverCache->ContainerCount;
+}
+
+VOID
+OcApfsConfigureCache (
+  IN OC_STORAGE_CONTEXT  *Storage  OPTIONAL
+  )
+{
+  mApfsDriverCacheStorage = Storage;
+}
+
+BOOLEAN
+InternalApfsDriverCacheLookup (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  OUT UINT8                  *RawDigest,
+  OUT VOID                   **DriverBuffer,
+  OUT UINT32                 *DriverSize
+  )
+{
+  if (mApfsDriverCacheStorage == NULL) {
+    return FALSE;
+  }
+
+  ApfsDriverCacheLoad ();
+
+  if (mApfsDriverCache == NULL || !ApfsDriverCacheHasContainer (PrivateData, JumpStart)) {
+    return FALSE;
+  }
+
+  //
+  // Verification sanitises the image in place, so hand out a copy.
+  //
+  *DriverBuffer = AllocateCopyPool (mApfsDriverCache->DriverSize, mApfsDriverCache + 1);
+  if (*DriverBuffer == NULL) {
+    return FALSE;
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCJS: Using cached driver %Lu for %g\n",
+    mApfsDriverCache->DriverVersion,
+    &PrivateData->LocationInfo.ContainerUuid
+    ));
+
+  CopyMem (RawDigest, mApfsDriverCache->RawDigest, SHA256_DIGEST_SIZE);
+  *DriverSize = mApfsDriverCache->DriverSize;
+  return TRUE;
+}
+
+BOOLEAN
+InternalApfsDriverCacheMatch (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  IN  CONST UINT8            *RawDigest
+  )
+{
+  if (mApfsDriverCache == NULL
+    || CompareMem (RawDigest, mApfsDriverCache->RawDigest, SHA256_DIGEST_SIZE) != 0) {
+    return FALSE;
+  }
+
+  ApfsDriverCacheAddContainer (PrivateData, JumpStart);
+  mApfsDriverCacheChanged = TRUE;
+  return TRUE;
+}
+
+VOID
+InternalApfsDriverCacheUpdate (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  IN  CONST UINT8            *RawDigest,
+  IN  CONST VOID             *DriverBuffer,
+  IN  UINT32                 DriverSize
+  )
+{
+  EFI_STATUS                Status;
+  APFS_DRIVER_VERSION       *DriverVersion;
+  APFS_DRIVER_CACHE_HEADER  *Cache;
+
+  if (mApfsDriverCacheStorage == NULL
+    || DriverSize > APFS_DRIVER_CACHE_MAX_SIZE - sizeof (*Cache)) {
+    return;
+  }
+
+  Status = PeCoffGetApfsDriverVersion ((VOID *) DriverBuffer, DriverSize, &DriverVersion);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  //
+  // Keep the newest driver, it can start all older containers.
+  //
+  if (mApfsDriverCache != NULL && mApfsDriverCache->DriverVersion >= DriverVersion->Version) {
+    return;
+  }
+
+  Cache = AllocateZeroPool (sizeof (*Cache) + DriverSize);
+  if (Cache == NULL) {
+    return;
+  }
+
+  Cache->Signature     = APFS_DRIVER_CACHE_SIGNATURE;
+  Cache->Version       = APFS_DRIVER_CACHE_VERSION;
+  Cache->DriverVersion = DriverVersion->Version;
+  Cache->DriverSize    = DriverSize;
+  CopyMem (Cache->RawDigest, RawDigest, SHA256_DIGEST_SIZE);
+  CopyMem (Cache + 1, DriverBuffer, DriverSize);
+
+  if (mApfsDriverCache != NULL) {
+    FreePool (mApfsDriverCache);
+  }
+
+  mApfsDriverCache = Cache;
+  ApfsDriverCacheAddContainer (PrivateData, JumpStart);
+  mApfsDriverCacheChanged = TRUE;
+}
@@ -19,6 +19,7 @@
 #include <IndustryStandard/Apfs.h>
 #include <Protocol/BlockIo.h>
 #include <Protocol/ApfsEfiBootRecordInfo.h>
+#include <Library/OcApfsLib.h>
 
 #define APFS_PRIVATE_DATA_SIGNATURE  SIGNATURE_32 ('A', 'F', 'J', 'S')
 
@@ -98,17 +99,147 @@ typedef struct APFS_PRIVATE_DATA_ {
 **/
 extern LIST_ENTRY  mApfsPrivateDataList;
 
+/**
+  Verify APFS object checksum.
+
+  @param[in]  Block     APFS object.
+  @param[in]  DataSize  APFS object size, normally block size.
+
+  @retval TRUE when checksum matches.
+**/
+BOOLEAN
+InternalApfsBlockChecksumVerify (
+  IN APFS_OBJ_PHYS  *Block,
+  IN UINTN          DataSize
+  );
+
+/**
+  Verify checksums of consecutive APFS objects, e.g. a checkpoint area
+  read at once. Mismatches are not logged.
+
+  @param[in]  Blocks      APFS objects, one per block.
+  @param[in]  BlockSize   APFS block size.
+  @param[in]  BlockCount  Amount of blocks.
+  @param[out] Valid       Per block checksum match, optional.
+
+  @retval Amount of blocks with matching checksum.
+**/
+UINTN
+InternalApfsBlocksChecksumVerify (
+  IN  VOID     *Blocks,
+  IN  UINT32   BlockSize,
+  IN  UINTN    BlockCount,
+  OUT BOOLEAN  *Valid  OPTIONAL
+  );
+
 EFI_STATUS
 InternalApfsReadSuperBlock (
   IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo,
   OUT APFS_NX_SUPERBLOCK     **SuperBlockPtr
   );
 
+/**
+  Read volume information from APFS container on the device.
+  See OcApfsReadContainerMetadata for details.
+**/
+EFI_STATUS
+InternalApfsReadContainerMetadata (
+  IN  EFI_BLOCK_IO_PROTOCOL    *BlockIo,
+  OUT EFI_GUID                 *ContainerUuid,
+  OUT OC_APFS_VOLUME_METADATA  **Volumes,
+  OUT UINT32                   *VolumeCount
+  );
+
+EFI_STATUS
+InternalApfsReadJumpStart (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  OUT APFS_NX_EFI_JUMPSTART  **JumpStart
+  );
+
 EFI_STATUS
 InternalApfsReadDriver (
-  IN  APFS_PRIVATE_DATA    *PrivateData,
-  OUT UINT32               *DriverSize,
-  OUT VOID                 **DriverBuffer
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  OUT UINT32                 *DriverSize,
+  OUT VOID                   **DriverBuffer
+  );
+
+/**
+  Find the cached driver previously started from this container JumpStart.
+  The driver still needs to be verified before use.
+
+  @param[in]  PrivateData   Container private data.
+  @param[in]  JumpStart     Container JumpStart record.
+  @param[out] RawDigest     SHA-256 of the driver as stored in the container.
+  @param[out] DriverBuffer  Driver image as stored in the container, caller frees.
+  @param[out] DriverSize    Driver image size.
+
+  @retval TRUE when the driver can be used without reading.
+**/
+BOOLEAN
+InternalApfsDriverCacheLookup (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  OUT UINT8                  *RawDigest,
+  OUT VOID                   **DriverBuffer,
+  OUT UINT32                 *DriverSize
+  );
+
+/**
+  Remember the container JumpStart for later lookups when it carries
+  the cached driver.
+
+  @param[in]  PrivateData   Container private data.
+  @param[in]  JumpStart     Container JumpStart record.
+  @param[in]  RawDigest     SHA-256 of the driver as stored in the container.
+
+  @retval TRUE when the driver is cached.
+**/
+BOOLEAN
+InternalApfsDriverCacheMatch (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  IN  CONST UINT8            *RawDigest
+  );
+
+/**
+  Store started driver when it is newer than the cached one.
+
+  @param[in]  PrivateData   Container private data.
+  @param[in]  JumpStart     Container JumpStart record.
+  @param[in]  RawDigest     SHA-256 of the driver as stored in the container.
+  @param[in]  DriverBuffer  Driver image as stored in the container.
+  @param[in]  DriverSize    Driver image size.
+**/
+VOID
+InternalApfsDriverCacheUpdate (
+  IN  APFS_PRIVATE_DATA      *PrivateData,
+  IN  APFS_NX_EFI_JUMPSTART  *JumpStart,
+  IN  CONST UINT8            *RawDigest,
+  IN  CONST VOID             *DriverBuffer,
+  IN  UINT32                 DriverSize
+  );
+
+/**
+  Write the cache file once changed, done once per connection pass.
+**/
+VOID
+InternalApfsDriverCacheFlush (
+  VOID
+  );
+
+/**
+  Connect APFS container without writing the driver cache.
+
+  @param[in] Handle        Handle to connect.
+  @param[in] VerifyPolicy  Verify OpenCore scan policy.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+InternalApfsConnectHandle (
+  IN EFI_HANDLE  Handle,
+  IN BOOLEAN     VerifyPolicy
   );
 
 VOID
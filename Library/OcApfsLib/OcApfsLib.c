@@ -47,11 +47,13 @@ ApfsNewPartitionArrived (
       &Handle
       );
     if (!EFI_ERROR (Status)) {
-      OcApfsConnectHandle (Handle, TRUE);
+      InternalApfsConnectHandle (Handle, TRUE);
     } else {
       break;
     }
   }
+
+  InternalApfsDriverCacheFlush ();
 }
 
 STATIC
@@ -148,7 +150,7 @@ OcApfsConnectParentDevice (
         }
       }
 
-      Status2 = OcApfsConnectHandle (
+      Status2 = InternalApfsConnectHandle (
         HandleBuffer[Index],
         VerifyPolicy
         );
@@ -157,6 +159,8 @@ OcApfsConnectParentDevice (
       }
     }
 
+    InternalApfsDriverCacheFlush ();
+
     FreePool (HandleBuffer);
   } else {
     DEBUG ((DEBUG_INFO, "OCJS: BlockIo buffer error - %r\n", Status));
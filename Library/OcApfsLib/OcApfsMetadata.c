@@ -0,0 +1,621 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "OcApfsInternal.h"
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcApfsLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+//
+// Amount of metadata objects kept between calls.
+//
+#define APFS_METADATA_CACHE_SIZE      32
+
+//
+// Largest checkpoint descriptor area scanned at once.
+//
+#define APFS_METADATA_MAX_XP_DESC     BASE_4MB
+
+typedef struct {
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+  UINT32                 MediaId;
+  UINT32                 BlockSize;
+  UINT64                 Xid;
+  UINT64                 Paddr;
+  UINT64                 LastUse;
+  APFS_OBJ_PHYS          *Block;
+} APFS_METADATA_CACHE_ENTRY;
+
+typedef struct {
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+  UINT32                 BlockSize;
+  UINT32                 LbaMultiplier;
+  UINT64                 TotalBlocks;
+  //
+  // Checkpoint transaction, cached objects are only valid within it.
+  //
+  UINT64                 Xid;
+} APFS_METADATA_CONTEXT;
+
+STATIC APFS_METADATA_CACHE_ENTRY  mApfsMetadataCache[APFS_METADATA_CACHE_SIZE];
+STATIC UINT64                     mApfsMetadataCacheClock;
+
+/**
+  Read physical metadata object with verified checksum.
+
+  @param[in]  Context   Container context.
+  @param[in]  Paddr     Object physical address.
+  @param[out] Block     Object owned by the cache, valid until the next read.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+ApfsMetadataReadObject (
+  IN  APFS_METADATA_CONTEXT  *Context,
+  IN  UINT64                 Paddr,
+  OUT APFS_OBJ_PHYS          **Block
+  )
+{
+  EFI_STATUS                 Status;
+  APFS_METADATA_CACHE_ENTRY  *Entry;
+  APFS_METADATA_CACHE_ENTRY  *Victim;
+  UINT32                     MediaId;
+  UINTN                      Index;
+
+  if (Paddr == 0 || Paddr >= Context->TotalBlocks) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  MediaId = Context->BlockIo->Media->MediaId;
+  Victim  = &mApfsMetadataCache[0];
+
+  for (Index = 0; Index < APFS_METADATA_CACHE_SIZE; ++Index) {
+    Entry = &mApfsMetadataCache[Index];
+    if (Entry->BlockIo == Context->BlockIo
+      && Entry->MediaId == MediaId
+      && Entry->BlockSize == Context->BlockSize
+      && Entry->Xid == Context->Xid
+      && Entry->Paddr == Paddr) {
+      Entry->LastUse = ++mApfsMetadataCacheClock;
+      *Block         = Entry->Block;
+      return EFI_SUCCESS;
+    }
+
+    if (Entry->LastUse < Victim->LastUse) {
+      Victim = Entry;
+    }
+  }
+
+  //
+  // Reuse the least recently used entry.
+  //
+  if (Victim->Block != NULL && Victim->BlockSize != Context->BlockSize) {
+    FreePool (Victim->Block);
+    Victim->Block = NULL;
+  }
+
+  Victim->BlockIo = NULL;
+  Victim->LastUse = 0;
+
+  if (Victim->Block == NULL) {
+    Victim->Block = AllocatePool (Context->BlockSize);
+    if (Victim->Block == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  Status = Context->BlockIo->ReadBlocks (
+    Context->BlockIo,
+    MediaId,
+    MultU64x32 (Paddr, Context->LbaMultiplier),
+    Context->BlockSize,
+    Victim->Block
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (!InternalApfsBlockChecksumVerify (Victim->Block, Context->BlockSize)) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Victim->BlockIo   = Context->BlockIo;
+  Victim->MediaId   = MediaId;
+  Victim->BlockSize = Context->BlockSize;
+  Victim->Xid       = Context->Xid;
+  Victim->Paddr     = Paddr;
+  Victim->LastUse   = ++mApfsMetadataCacheClock;
+
+  *Block = Victim->Block;
+  return EFI_SUCCESS;
+}
+
+/**
+  Find the newest valid container superblock in the checkpoint descriptor area.
+  Falls back to the superblock copy at block 0.
+
+  @param[in]      Context     Container context.
+  @param[in,out]  SuperBlock  Superblock from block 0, replaced with the newest one.
+**/
+STATIC
+VOID
+ApfsMetadataFindCheckpoint (
+  IN     APFS_METADATA_CONTEXT  *Context,
+  IN OUT APFS_NX_SUPERBLOCK     **SuperBlock
+  )
+{
+  EFI_STATUS          Status;
+  APFS_NX_SUPERBLOCK  *Latest;
+  APFS_NX_SUPERBLOCK  *Candidate;
+  UINT8               *DescArea;
+  BOOLEAN             *Valid;
+  UINT32              DescBlocks;
+  UINTN               DescSize;
+  UINTN               Index;
+
+  Latest     = *SuperBlock;
+  DescBlocks = Latest->XpDescBlocks & APFS_NX_XP_DESC_BLOCKS_MASK;
+
+  //
+  // Non-contiguous descriptor areas are stored in a B-tree, which is rare.
+  //
+  if ((Latest->XpDescBlocks & APFS_NX_XP_DESC_NONCONTIGUOUS) != 0
+    || DescBlocks == 0
+    || DescBlocks > APFS_METADATA_MAX_XP_DESC / Context->BlockSize
+    || Latest->XpDescBase <= 0
+    || (UINT64) Latest->XpDescBase >= Context->TotalBlocks
+    || Context->TotalBlocks - (UINT64) Latest->XpDescBase < DescBlocks) {
+    DEBUG ((DEBUG_INFO, "OCJS: Using block 0 superblock with %X desc blocks\n", Latest->XpDescBlocks));
+    return;
+  }
+
+  DescSize = (UINTN) DescBlocks * Context->BlockSize;
+  DescArea = AllocatePool (DescSize);
+  Valid    = AllocatePool (DescBlocks * sizeof (*Valid));
+  if (DescArea == NULL || Valid == NULL) {
+    if (DescArea != NULL) {
+      FreePool (DescArea);
+    }
+    if (Valid != NULL) {
+      FreePool (Valid);
+    }
+    return;
+  }
+
+  Status = Context->BlockIo->ReadBlocks (
+    Context->BlockIo,
+    Context->BlockIo->Media->MediaId,
+    MultU64x32 ((UINT64) Latest->XpDescBase, Context->LbaMultiplier),
+    DescSize,
+    DescArea
+    );
+  if (EFI_ERROR (Status)) {
+    FreePool (DescArea);
+    FreePool (Valid);
+    return;
+  }
+
+  //
+  // Descriptor area mixes superblocks with checkpoint maps,
+  // and unused blocks are expected to fail verification.
+  //
+  InternalApfsBlocksChecksumVerify (DescArea, Context->BlockSize, DescBlocks, Valid);
+
+  for (Index = 0; Index < DescBlocks; ++Index) {
+    Candidate = (APFS_NX_SUPERBLOCK *) (DescArea + Index * Context->BlockSize);
+    if (Valid[Index]
+      && Candidate->BlockHeader.ObjectType == (APFS_OBJ_EPHEMERAL | APFS_OBJECT_TYPE_NX_SUPERBLOCK)
+      && Candidate->Magic == APFS_NX_SIGNATURE
+      && Candidate->BlockSize == Context->BlockSize
+      && CompareGuid (&Candidate->Uuid, &(*SuperBlock)->Uuid)
+      && Candidate->BlockHeader.ObjectXid > Latest->BlockHeader.ObjectXid) {
+      Latest = Candidate;
+    }
+  }
+
+  if (Latest != *SuperBlock) {
+    DEBUG ((
+      DEBUG_INFO,
+      "OCJS: Using checkpoint %Lu over block 0 %Lu\n",
+      Latest->BlockHeader.ObjectXid,
+      (*SuperBlock)->BlockHeader.ObjectXid
+      ));
+    CopyMem (*SuperBlock, Latest, Context->BlockSize);
+  }
+
+  FreePool (DescArea);
+  FreePool (Valid);
+}
+
+/**
+  Get object map B-tree node entry. Entries are copied out,
+  as table of contents offsets do not guarantee alignment.
+
+  @param[in]  Node       B-tree node.
+  @param[in]  BlockSize  APFS block size.
+  @param[in]  Index      Entry index.
+  @param[in]  ValueSize  Entry value size.
+  @param[out] Key        Entry key.
+  @param[out] Value      Entry value, ValueSize bytes.
+
+  @retval TRUE on success.
+**/
+STATIC
+BOOLEAN
+ApfsMetadataGetOmapEntry (
+  IN  APFS_BTREE_NODE_PHYS  *Node,
+  IN  UINT32                BlockSize,
+  IN  UINT32                Index,
+  IN  UINT32                ValueSize,
+  OUT APFS_OMAP_KEY         *Key,
+  OUT VOID                  *Value
+  )
+{
+  APFS_KVOFF  *Toc;
+  UINTN       KeyStart;
+  UINTN       ValueEnd;
+
+  KeyStart = sizeof (*Node) + (UINTN) Node->TableSpace.Offset + Node->TableSpace.Length;
+  ValueEnd = BlockSize;
+  if ((Node->Flags & APFS_BTNODE_ROOT) != 0) {
+    ValueEnd -= sizeof (APFS_BTREE_INFO);
+  }
+
+  if (KeyStart > ValueEnd
+    || ((UINT64) Index + 1) * sizeof (*Toc) > Node->TableSpace.Length) {
+    return FALSE;
+  }
+
+  Toc = (APFS_KVOFF *) (Node->Data + Node->TableSpace.Offset) + Index;
+
+  if (KeyStart + Toc->KeyOffset + sizeof (*Key) > ValueEnd
+    || Toc->ValueOffset < ValueSize
+    || Toc->ValueOffset > ValueEnd - KeyStart) {
+    return FALSE;
+  }
+
+  CopyMem (Key, (UINT8 *) Node + KeyStart + Toc->KeyOffset, sizeof (*Key));
+  CopyMem (Value, (UINT8 *) Node + ValueEnd - Toc->ValueOffset, ValueSize);
+  return TRUE;
+}
+
+/**
+  Translate virtual object identifier with container object map.
+
+  @param[in]  Context   Container context.
+  @param[in]  TreeOid   Object map B-tree root node address.
+  @param[in]  Oid       Virtual object identifier.
+  @param[out] Paddr     Object physical address.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+ApfsMetadataOmapLookup (
+  IN  APFS_METADATA_CONTEXT  *Context,
+  IN  UINT64                 TreeOid,
+  IN  UINT64                 Oid,
+  OUT UINT64                 *Paddr
+  )
+{
+  EFI_STATUS            Status;
+  APFS_BTREE_NODE_PHYS  *Node;
+  APFS_OMAP_KEY         Key;
+  APFS_OMAP_VAL         Value;
+  UINT64                NodeOid;
+  UINT32                NodeType;
+  UINT32                Level;
+  UINT32                Depth;
+  UINT32                Low;
+  UINT32                High;
+  UINT32                Middle;
+  UINT32                ValueSize;
+  BOOLEAN               IsLeaf;
+
+  NodeOid  = TreeOid;
+  NodeType = APFS_OBJ_PHYSICAL | APFS_OBJECT_TYPE_BTREE;
+  Level    = APFS_BTREE_NODE_MAX_DEPTH;
+
+  for (Depth = 0; Depth < APFS_BTREE_NODE_MAX_DEPTH; ++Depth) {
+    Status = ApfsMetadataReadObject (Context, NodeOid, (APFS_OBJ_PHYS **) &Node);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    //
+    // Levels must strictly decrease down to leaves at level 0.
+    //
+    IsLeaf = (Node->Flags & APFS_BTNODE_LEAF) != 0;
+    if (Node->BlockHeader.ObjectType != NodeType
+      || Node->BlockHeader.ObjectSubType != APFS_OBJECT_TYPE_OMAP
+      || Node->BlockHeader.ObjectOid != NodeOid
+      || (Node->Flags & APFS_BTNODE_FIXED_KV_SIZE) == 0
+      || Node->Level >= Level
+      || IsLeaf != (Node->Level == 0)
+      || Node->KeyCount == 0
+      || Node->KeyCount > Node->TableSpace.Length / sizeof (APFS_KVOFF)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Level     = Node->Level;
+    ValueSize = IsLeaf ? sizeof (APFS_OMAP_VAL) : sizeof (UINT64);
+
+    //
+    // Find the last key not above the requested one.
+    // Keys are sorted by identifier and then by transaction.
+    //
+    Low  = 0;
+    High = Node->KeyCount;
+    while (Low < High) {
+      Middle = Low + (High - Low) / 2;
+      if (!ApfsMetadataGetOmapEntry (Node, Context->BlockSize, Middle, ValueSize, &Key, &Value)) {
+        return EFI_VOLUME_CORRUPTED;
+      }
+
+      if (Key.Oid < Oid || (Key.Oid == Oid && Key.Xid <= Context->Xid)) {
+        Low = Middle + 1;
+      } else {
+        High = Middle;
+      }
+    }
+
+    if (Low == 0) {
+      return EFI_NOT_FOUND;
+    }
+
+    //
+    // Index node values are child node addresses.
+    //
+    if (!ApfsMetadataGetOmapEntry (
+      Node,
+      Context->BlockSize,
+      Low - 1,
+      ValueSize,
+      &Key,
+      IsLeaf ? (VOID *) &Value : (VOID *) &NodeOid
+      )) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    if (IsLeaf) {
+      if (Key.Oid != Oid || (Value.Flags & APFS_OMAP_VAL_DELETED) != 0) {
+        return EFI_NOT_FOUND;
+      }
+
+      *Paddr = Value.PhysicalAddr;
+      return EFI_SUCCESS;
+    }
+
+    NodeType = APFS_OBJ_PHYSICAL | APFS_OBJECT_TYPE_BTREE_NODE;
+  }
+
+  return EFI_VOLUME_CORRUPTED;
+}
+
+/**
+  Read the newest container superblock and initialise container context.
+
+  @param[in]  BlockIo     Container device.
+  @param[out] Context     Container context.
+  @param[out] SuperBlock  Newest container superblock, to be freed with FreePool.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+ApfsMetadataReadSuperBlock (
+  IN  EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  OUT APFS_METADATA_CONTEXT  *Context,
+  OUT APFS_NX_SUPERBLOCK     **SuperBlock
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = InternalApfsReadSuperBlock (BlockIo, SuperBlock);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Objects may only reside within the device, the container may have
+  // been resized since block 0 was written.
+  //
+  Context->BlockIo       = BlockIo;
+  Context->BlockSize     = (*SuperBlock)->BlockSize;
+  Context->LbaMultiplier = (*SuperBlock)->BlockSize / BlockIo->Media->BlockSize;
+  Context->TotalBlocks   = DivU64x32 (BlockIo->Media->LastBlock + 1, Context->LbaMultiplier);
+  Context->Xid           = 0;
+
+  ApfsMetadataFindCheckpoint (Context, SuperBlock);
+
+  if ((*SuperBlock)->TotalBlocks == 0 || (*SuperBlock)->TotalBlocks > Context->TotalBlocks) {
+    FreePool (*SuperBlock);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  Context->TotalBlocks = (*SuperBlock)->TotalBlocks;
+  Context->Xid         = (*SuperBlock)->BlockHeader.ObjectXid;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+InternalApfsReadContainerMetadata (
+  IN  EFI_BLOCK_IO_PROTOCOL    *BlockIo,
+  OUT EFI_GUID                 *ContainerUuid,
+  OUT OC_APFS_VOLUME_METADATA  **Volumes,
+  OUT UINT32                   *VolumeCount
+  )
+{
+  EFI_STATUS               Status;
+  APFS_METADATA_CONTEXT    Context;
+  APFS_NX_SUPERBLOCK       *SuperBlock;
+  APFS_OMAP_PHYS           *Omap;
+  APFS_APFS_SUPERBLOCK     *Volume;
+  OC_APFS_VOLUME_METADATA  *Metadata;
+  UINT64                   TreeOid;
+  UINT64                   Paddr;
+  UINT32                   MaxFileSystems;
+  UINT32                   Count;
+  UINT32                   Index;
+
+  Status = ApfsMetadataReadSuperBlock (BlockIo, &Context, &SuperBlock);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Fusion containers need both devices for address translation.
+  //
+  if (!IsZeroGuid (&SuperBlock->FusionUuid)) {
+    FreePool (SuperBlock);
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = ApfsMetadataReadObject (&Context, SuperBlock->ObjectMapOid, (APFS_OBJ_PHYS **) &Omap);
+  if (EFI_ERROR (Status)
+    || Omap->BlockHeader.ObjectType != (APFS_OBJ_PHYSICAL | APFS_OBJECT_TYPE_OMAP)
+    || Omap->TreeType != (APFS_OBJ_PHYSICAL | APFS_OBJECT_TYPE_BTREE)) {
+    DEBUG ((DEBUG_INFO, "OCJS: Invalid object map %Lx - %r\n", SuperBlock->ObjectMapOid, Status));
+    FreePool (SuperBlock);
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  TreeOid        = Omap->TreeOid;
+  MaxFileSystems = MIN (SuperBlock->MaxFileSystems, APFS_NX_MAX_FILE_SYSTEMS);
+
+  Metadata = AllocateZeroPool (MAX (MaxFileSystems, 1) * sizeof (*Metadata));
+  if (Metadata == NULL) {
+    FreePool (SuperBlock);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Count = 0;
+  for (Index = 0; Index < MaxFileSystems; ++Index) {
+    if (SuperBlock->FileSystemOid[Index] == 0) {
+      continue;
+    }
+
+    Status = ApfsMetadataOmapLookup (&Context, TreeOid, SuperBlock->FileSystemOid[Index], &Paddr);
+    if (!EFI_ERROR (Status)) {
+      Status = ApfsMetadataReadObject (&Context, Paddr, (APFS_OBJ_PHYS **) &Volume);
+    }
+
+    if (!EFI_ERROR (Status)
+      && ((Volume->BlockHeader.ObjectType & APFS_OBJECT_TYPE_MASK) != APFS_OBJECT_TYPE_FS
+        || Volume->BlockHeader.ObjectOid != SuperBlock->FileSystemOid[Index]
+        || Volume->Magic != APFS_SIGNATURE)) {
+      Status = EFI_VOLUME_CORRUPTED;
+    }
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "OCJS: Skipping volume %Lx - %r\n", SuperBlock->FileSystemOid[Index], Status));
+      continue;
+    }
+
+    CopyGuid (&Metadata[Count].VolumeUuid, &Volume->VolumeUuid);
+    Metadata[Count].Role      = Volume->Role;
+    Metadata[Count].FsIndex   = Volume->FsIndex;
+    Metadata[Count].Encrypted = (Volume->FsFlags & APFS_FS_UNENCRYPTED) == 0;
+    Metadata[Count].Sealed    = (Volume->IncompatibleFeatures & APFS_INCOMPAT_SEALED_VOLUME) != 0;
+    CopyMem (Metadata[Count].Name, Volume->VolumeName, sizeof (Metadata[Count].Name) - 1);
+
+    DEBUG ((
+      DEBUG_INFO,
+      "OCJS: Volume %u %g role %X %a\n",
+      Metadata[Count].FsIndex,
+      &Metadata[Count].VolumeUuid,
+      Metadata[Count].Role,
+      Metadata[Count].Name
+      ));
+
+    ++Count;
+  }
+
+  if (Count == 0) {
+    FreePool (Metadata);
+    FreePool (SuperBlock);
+    return EFI_NOT_FOUND;
+  }
+
+  CopyGuid (ContainerUuid, &SuperBlock->Uuid);
+  *Volumes     = Metadata;
+  *VolumeCount = Count;
+
+  FreePool (SuperBlock);
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OcApfsReadContainerMetadata (
+  IN  EFI_HANDLE               Handle,
+  OUT EFI_GUID                 *ContainerUuid,
+  OUT OC_APFS_VOLUME_METADATA  **Volumes,
+  OUT UINT32                   *VolumeCount
+  )
+{
+  EFI_STATUS             Status;
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+
+  Status = gBS->HandleProtocol (
+    Handle,
+    &gEfiBlockIoProtocolGuid,
+    (VOID **) &BlockIo
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return InternalApfsReadContainerMetadata (
+    BlockIo,
+    ContainerUuid,
+    Volumes,
+    VolumeCount
+    );
+}
+
+EFI_STATUS
+OcApfsGetContainerNextXid (
+  IN  EFI_HANDLE  Handle,
+  OUT UINT64      *NextXid
+  )
+{
+  EFI_STATUS             Status;
+  EFI_BLOCK_IO_PROTOCOL  *BlockIo;
+  APFS_METADATA_CONTEXT  Context;
+  APFS_NX_SUPERBLOCK     *SuperBlock;
+
+  Status = gBS->HandleProtocol (
+    Handle,
+    &gEfiBlockIoProtocolGuid,
+    (VOID **) &BlockIo
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = ApfsMetadataReadSuperBlock (BlockIo, &Context, &SuperBlock);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *NextXid = SuperBlock->NextXid;
+
+  FreePool (SuperBlock);
+  return EFI_SUCCESS;
+}
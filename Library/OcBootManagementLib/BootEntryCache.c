@@ -0,0 +1,821 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "BootManagementInternal.h"
+
+#include <IndustryStandard/Apfs.h>
+
+#include <Protocol/BlockIo.h>
+#include <Protocol/DevicePath.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcApfsLib.h>
+#include <Library/OcDebugLogLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#define OC_SCAN_CACHE_SIGNATURE  SIGNATURE_32 ('O', 'C', 'S', 'C')
+#define OC_SCAN_CACHE_VERSION    1
+#define OC_SCAN_CACHE_MAX_SIZE   BASE_256KB
+
+//
+// Entry types produced by filesystem scanning and loadable from cache.
+//
+#define OC_SCAN_CACHE_ENTRY_TYPES  (OC_BOOT_APPLE_ANY | OC_BOOT_WINDOWS | OC_BOOT_UNKNOWN)
+
+//
+// Volume header location and fields used to detect HFS+ modification.
+//
+#define OC_SCAN_CACHE_HFS_HEADER        1024
+#define OC_SCAN_CACHE_HFS_SIGNATURE     0x482B
+#define OC_SCAN_CACHE_HFSX_SIGNATURE    0x4858
+#define OC_SCAN_CACHE_HFS_MODIFY_DATE   20
+#define OC_SCAN_CACHE_HFS_WRITE_COUNT   68
+
+#pragma pack(push, 1)
+
+typedef struct {
+  UINT32  Signature;
+  UINT32  Version;
+  UINT32  Settings;
+  UINT32  RecordCount;
+} OC_SCAN_CACHE_HEADER;
+
+//
+// Followed by filesystem device path and entries.
+//
+typedef struct {
+  UINT32  Size;
+  UINT64  Token;
+  UINT16  DevicePathSize;
+  UINT8   EntryCount;
+  UINT8   HasSelfRecovery;
+} OC_SCAN_CACHE_RECORD;
+
+//
+// Followed by device path, name, and path name.
+//
+typedef struct {
+  UINT32  Type;
+  UINT16  DevicePathSize;
+  UINT16  NameSize;
+  UINT16  PathNameSize;
+  UINT8   IsFolder;
+  UINT8   IsGeneric;
+  UINT8   IsExternal;
+  UINT8   Reserved;
+} OC_SCAN_CACHE_ENTRY;
+
+#pragma pack(pop)
+
+struct OC_SCAN_CACHE_ {
+  //
+  // Loader filesystem holding the cache file.
+  //
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *LoaderFs;
+  //
+  // Cache file contents loaded from the disk, NULL when missing or invalid.
+  //
+  UINT8                            *Data;
+  UINT32                           DataSize;
+  //
+  // Cache file contents for the current scan.
+  //
+  UINT8                            *Out;
+  UINT32                           OutSize;
+  UINT32                           OutAllocated;
+  UINT32                           OutCount;
+  //
+  // Settings affecting the scan results.
+  //
+  UINT32                           Settings;
+  //
+  // Filesystem and its modification token from the last lookup.
+  //
+  OC_BOOT_FILESYSTEM               *LookupFs;
+  EFI_DEVICE_PATH_PROTOCOL         *LookupDevicePath;
+  UINTN                            LookupDevicePathSize;
+  UINT64                           LookupToken;
+  //
+  // Statistics.
+  //
+  UINT32                           Hits;
+  UINT32                           Misses;
+};
+
+/**
+  Update FNV-1a hash with data.
+**/
+STATIC
+UINT32
+ScanCacheHash (
+  IN UINT32       Hash,
+  IN CONST VOID   *Data,
+  IN UINTN        Size
+  )
+{
+  CONST UINT8  *Bytes;
+  UINTN        Index;
+
+  Bytes = Data;
+  for (Index = 0; Index < Size; ++Index) {
+    Hash = (Hash ^ Bytes[Index]) * 16777619U;
+  }
+
+  return Hash;
+}
+
+/**
+  Hash picker settings affecting the entries found on a filesystem.
+
+  @param[in]  Context   Picker context.
+
+  @retval Settings hash.
+**/
+STATIC
+UINT32
+ScanCacheGetSettings (
+  IN OC_PICKER_CONTEXT  *Context
+  )
+{
+  UINT32  Hash;
+  UINTN   Index;
+
+  Hash = 2166136261U;
+  Hash = ScanCacheHash (Hash, &Context->ScanPolicy, sizeof (Context->ScanPolicy));
+  Hash = ScanCacheHash (Hash, &Context->DmgLoading, sizeof (Context->DmgLoading));
+  Hash = ScanCacheHash (Hash, &Context->HideAuxiliary, sizeof (Context->HideAuxiliary));
+
+  for (Index = 0; Index < Context->NumCustomBootPaths; ++Index) {
+    Hash = ScanCacheHash (
+      Hash,
+      Context->CustomBootPaths[Index],
+      StrSize (Context->CustomBootPaths[Index])
+      );
+  }
+
+  return Hash;
+}
+
+/**
+  Obtain the filesystem modification token from its on-disk superblock.
+  Only APFS containers and HFS+ volumes are supported, as their
+  superblocks record every modification.
+
+  @param[in]  DevicePath  Filesystem device path.
+  @param[out] Token       Modification token.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+ScanCacheGetToken (
+  IN  EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  OUT UINT64                    *Token
+  )
+{
+  EFI_STATUS                Status;
+  EFI_DEVICE_PATH_PROTOCOL  *RemainingDevicePath;
+  EFI_HANDLE                DiskHandle;
+  OC_DISK_CONTEXT           DiskContext;
+  UINT8                     *Buffer;
+  UINTN                     BufferSize;
+  APFS_NX_SUPERBLOCK        *Superblock;
+  UINT8                     *HfsHeader;
+  UINT16                    HfsSignature;
+
+  //
+  // APFS volumes have no block devices, resolve to their container.
+  //
+  RemainingDevicePath = DevicePath;
+  Status = gBS->LocateDevicePath (
+    &gEfiBlockIoProtocolGuid,
+    &RemainingDevicePath,
+    &DiskHandle
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = OcDiskInitializeContext (&DiskContext, DiskHandle, TRUE);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  BufferSize = ALIGN_VALUE (SIZE_4KB, DiskContext.BlockSize);
+  Buffer     = AllocatePool (BufferSize);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = OcDiskRead (&DiskContext, 0, BufferSize, Buffer);
+  if (EFI_ERROR (Status)) {
+    FreePool (Buffer);
+    return Status;
+  }
+
+  Superblock = (APFS_NX_SUPERBLOCK *) Buffer;
+  HfsHeader  = Buffer + OC_SCAN_CACHE_HFS_HEADER;
+  HfsSignature = (UINT16) ((HfsHeader[0] << 8U) | HfsHeader[1]);
+
+  if (Superblock->Magic == APFS_NX_SIGNATURE) {
+    //
+    // Block 0 superblock is only updated occasionally,
+    // use the newest checkpoint instead.
+    //
+    Status = OcApfsGetContainerNextXid (DiskHandle, Token);
+  } else if (HfsSignature == OC_SCAN_CACHE_HFS_SIGNATURE
+    || HfsSignature == OC_SCAN_CACHE_HFSX_SIGNATURE) {
+    *Token = LShiftU64 (
+      SwapBytes32 (ReadUnaligned32 ((UINT32 *) &HfsHeader[OC_SCAN_CACHE_HFS_MODIFY_DATE])),
+      32
+      ) | SwapBytes32 (ReadUnaligned32 ((UINT32 *) &HfsHeader[OC_SCAN_CACHE_HFS_WRITE_COUNT]));
+  } else {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  FreePool (Buffer);
+  return Status;
+}
+
+/**
+  Append data to the cache file for the current scan.
+
+  @param[in,out]  Cache   Scan cache.
+  @param[in]      Data    Data to append.
+  @param[in]      Size    Data size.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+ScanCacheAppend (
+  IN OUT OC_SCAN_CACHE  *Cache,
+  IN     CONST VOID     *Data,
+  IN     UINTN          Size
+  )
+{
+  UINT8   *NewOut;
+  UINT32  NewAllocated;
+
+  if (Size > OC_SCAN_CACHE_MAX_SIZE - Cache->OutSize) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  if (Cache->OutSize + Size > Cache->OutAllocated) {
+    NewAllocated = MAX (Cache->OutAllocated * 2, SIZE_4KB);
+    while (NewAllocated < Cache->OutSize + Size) {
+      NewAllocated *= 2;
+    }
+
+    NewOut = ReallocatePool (Cache->OutAllocated, NewAllocated, Cache->Out);
+    if (NewOut == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Cache->Out          = NewOut;
+    Cache->OutAllocated = NewAllocated;
+  }
+
+  CopyMem (&Cache->Out[Cache->OutSize], Data, Size);
+  Cache->OutSize += (UINT32) Size;
+  return EFI_SUCCESS;
+}
+
+/**
+  Validate cached string.
+
+  @param[in]  String  String.
+  @param[in]  Size    String size in bytes with terminator.
+
+  @retval TRUE when the string is valid.
+**/
+STATIC
+BOOLEAN
+ScanCacheIsStringValid (
+  IN CONST UINT8  *String,
+  IN UINTN        Size
+  )
+{
+  CHAR16  Char;
+
+  if (Size < sizeof (CHAR16) || Size % sizeof (CHAR16) != 0) {
+    return FALSE;
+  }
+
+  CopyMem (&Char, &String[Size - sizeof (CHAR16)], sizeof (Char));
+  return Char == CHAR_NULL;
+}
+
+/**
+  Create boot entries from a cache record.
+
+  @param[in]  Record      Cache record.
+  @param[in]  RecordSize  Cache record size.
+  @param[out] Entries     List to insert boot entries into.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+ScanCacheRestoreEntries (
+  IN  CONST UINT8  *Record,
+  IN  UINT32       RecordSize,
+  OUT LIST_ENTRY   *Entries
+  )
+{
+  OC_SCAN_CACHE_RECORD  Header;
+  OC_SCAN_CACHE_ENTRY   CachedEntry;
+  OC_BOOT_ENTRY         *BootEntry;
+  UINT32                Offset;
+  UINT32                Index;
+  CONST UINT8           *Data;
+  CONST UINT8           *FsDevicePath;
+  UINT32                FsDevicePathSize;
+
+  CopyMem (&Header, Record, sizeof (Header));
+  Offset = sizeof (Header) + Header.DevicePathSize;
+
+  //
+  // Entry device paths must be within the filesystem, compare them
+  // to the filesystem device path without its end node.
+  //
+  if (Header.DevicePathSize < END_DEVICE_PATH_LENGTH) {
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  FsDevicePath     = &Record[sizeof (Header)];
+  FsDevicePathSize = Header.DevicePathSize - END_DEVICE_PATH_LENGTH;
+
+  for (Index = 0; Index < Header.EntryCount; ++Index) {
+    if (RecordSize - Offset < sizeof (CachedEntry)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    CopyMem (&CachedEntry, &Record[Offset], sizeof (CachedEntry));
+    Offset += sizeof (CachedEntry);
+
+    if (RecordSize - Offset < (UINT32) CachedEntry.DevicePathSize + CachedEntry.NameSize + CachedEntry.PathNameSize) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    Data = &Record[Offset];
+    if (CachedEntry.Type == 0
+      || (CachedEntry.Type & ~OC_SCAN_CACHE_ENTRY_TYPES) != 0
+      || CachedEntry.DevicePathSize <= FsDevicePathSize
+      || CompareMem (Data, FsDevicePath, FsDevicePathSize) != 0
+      || !IsDevicePathValid ((CONST EFI_DEVICE_PATH_PROTOCOL *) Data, CachedEntry.DevicePathSize)
+      || !ScanCacheIsStringValid (Data + CachedEntry.DevicePathSize, CachedEntry.NameSize)
+      || !ScanCacheIsStringValid (Data + CachedEntry.DevicePathSize + CachedEntry.NameSize, CachedEntry.PathNameSize)) {
+      return EFI_VOLUME_CORRUPTED;
+    }
+
+    BootEntry = AllocateZeroPool (sizeof (*BootEntry));
+    if (BootEntry == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    InsertTailList (Entries, &BootEntry->Link);
+
+    BootEntry->DevicePath = AllocateCopyPool (CachedEntry.DevicePathSize, Data);
+    Data                 += CachedEntry.DevicePathSize;
+    BootEntry->Name       = AllocateCopyPool (CachedEntry.NameSize, Data);
+    Data                 += CachedEntry.NameSize;
+    BootEntry->PathName   = AllocateCopyPool (CachedEntry.PathNameSize, Data);
+    if (BootEntry->DevicePath == NULL || BootEntry->Name == NULL || BootEntry->PathName == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    BootEntry->Type       = CachedEntry.Type;
+    BootEntry->IsFolder   = CachedEntry.IsFolder != 0;
+    BootEntry->IsGeneric  = CachedEntry.IsGeneric != 0;
+    BootEntry->IsExternal = CachedEntry.IsExternal != 0;
+    BootEntry->IsCached   = TRUE;
+
+    Offset += (UINT32) CachedEntry.DevicePathSize + CachedEntry.NameSize + CachedEntry.PathNameSize;
+  }
+
+  return Offset == RecordSize ? EFI_SUCCESS : EFI_VOLUME_CORRUPTED;
+}
+
+/**
+  Find cache record matching the filesystem of the last lookup.
+
+  @param[in]  Cache       Scan cache.
+  @param[out] RecordSize  Record size.
+
+  @retval Record or NULL.
+**/
+STATIC
+CONST UINT8 *
+ScanCacheFindRecord (
+  IN  OC_SCAN_CACHE  *Cache,
+  OUT UINT32         *RecordSize
+  )
+{
+  OC_SCAN_CACHE_HEADER  Header;
+  OC_SCAN_CACHE_RECORD  Record;
+  UINT32                Offset;
+  UINT32                Index;
+
+  if (Cache->Data == NULL) {
+    return NULL;
+  }
+
+  CopyMem (&Header, Cache->Data, sizeof (Header));
+  Offset = sizeof (Header);
+
+  for (Index = 0; Index < Header.RecordCount; ++Index) {
+    if (Cache->DataSize - Offset < sizeof (Record)) {
+      break;
+    }
+
+    CopyMem (&Record, &Cache->Data[Offset], sizeof (Record));
+    if (Record.Size < sizeof (Record) + Record.DevicePathSize
+      || Record.Size > Cache->DataSize - Offset) {
+      break;
+    }
+
+    if (Record.DevicePathSize == Cache->LookupDevicePathSize
+      && CompareMem (&Cache->Data[Offset + sizeof (Record)], Cache->LookupDevicePath, Record.DevicePathSize) == 0) {
+      if (Record.Token != Cache->LookupToken) {
+        return NULL;
+      }
+
+      *RecordSize = Record.Size;
+      return &Cache->Data[Offset];
+    }
+
+    Offset += Record.Size;
+  }
+
+  return NULL;
+}
+
+/**
+  Release boot entries not yet registered.
+
+  @param[in,out]  Entries  Boot entry list.
+**/
+STATIC
+VOID
+ScanCacheFreeEntries (
+  IN OUT LIST_ENTRY  *Entries
+  )
+{
+  OC_BOOT_ENTRY  *BootEntry;
+
+  while (!IsListEmpty (Entries)) {
+    BootEntry = BASE_CR (GetFirstNode (Entries), OC_BOOT_ENTRY, Link);
+    RemoveEntryList (&BootEntry->Link);
+    if (BootEntry->DevicePath != NULL) {
+      FreePool (BootEntry->DevicePath);
+    }
+    if (BootEntry->Name != NULL) {
+      FreePool (BootEntry->Name);
+    }
+    if (BootEntry->PathName != NULL) {
+      FreePool (BootEntry->PathName);
+    }
+    FreePool (BootEntry);
+  }
+}
+
+OC_SCAN_CACHE *
+InternalScanCacheLoad (
+  IN OC_PICKER_CONTEXT  *Context
+  )
+{
+  EFI_STATUS            Status;
+  OC_SCAN_CACHE         *Cache;
+  OC_SCAN_CACHE_HEADER  Header;
+
+  if (!Context->ScanCache || Context->LoaderHandle == NULL) {
+    return NULL;
+  }
+
+  Cache = AllocateZeroPool (sizeof (*Cache));
+  if (Cache == NULL) {
+    return NULL;
+  }
+
+  Status = gBS->HandleProtocol (
+    Context->LoaderHandle,
+    &gEfiSimpleFileSystemProtocolGuid,
+    (VOID **) &Cache->LoaderFs
+    );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCB: No loader filesystem for scan cache - %r\n", Status));
+    FreePool (Cache);
+    return NULL;
+  }
+
+  Cache->Settings = ScanCacheGetSettings (Context);
+  Cache->Data     = ReadFile (Cache->LoaderFs, OC_SCAN_CACHE_PATH, &Cache->DataSize, OC_SCAN_CACHE_MAX_SIZE);
+
+  if (Cache->Data != NULL) {
+    if (Cache->DataSize >= sizeof (Header)) {
+      CopyMem (&Header, Cache->Data, sizeof (Header));
+    } else {
+      ZeroMem (&Header, sizeof (Header));
+    }
+
+    if (Header.Signature != OC_SCAN_CACHE_SIGNATURE
+      || Header.Version != OC_SCAN_CACHE_VERSION
+      || Header.Settings != Cache->Settings) {
+      DEBUG ((DEBUG_INFO, "OCB: Discarding outdated scan cache of %u bytes\n", Cache->DataSize));
+      FreePool (Cache->Data);
+      Cache->Data = NULL;
+    }
+  }
+
+  //
+  // Reserve the header, it is filled on saving.
+  //
+  ZeroMem (&Header, sizeof (Header));
+  Status = ScanCacheAppend (Cache, &Header, sizeof (Header));
+  if (EFI_ERROR (Status)) {
+    InternalScanCacheFree (Cache, FALSE);
+    return NULL;
+  }
+
+  return Cache;
+}
+
+EFI_STATUS
+InternalScanCacheLookup (
+  IN OUT OC_SCAN_CACHE       *Cache,
+  IN OUT OC_BOOT_FILESYSTEM  *FileSystem,
+     OUT LIST_ENTRY          *Entries
+  )
+{
+  EFI_STATUS            Status;
+  CONST UINT8           *Record;
+  UINT32                RecordSize;
+  OC_SCAN_CACHE_RECORD  Header;
+
+  Cache->LookupFs = NULL;
+  InitializeListHead (Entries);
+
+  //
+  // The loader filesystem is where the cache is written to.
+  //
+  if (FileSystem->LoaderFs) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = gBS->HandleProtocol (
+    FileSystem->Handle,
+    &gEfiDevicePathProtocolGuid,
+    (VOID **) &Cache->LookupDevicePath
+    );
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Cache->LookupDevicePathSize = GetDevicePathSize (Cache->LookupDevicePath);
+  if (Cache->LookupDevicePathSize > MAX_UINT16) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = ScanCacheGetToken (Cache->LookupDevicePath, &Cache->LookupToken);
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Cache->LookupFs = FileSystem;
+
+  Record = ScanCacheFindRecord (Cache, &RecordSize);
+  if (Record == NULL) {
+    ++Cache->Misses;
+    return EFI_NOT_FOUND;
+  }
+
+  Status = ScanCacheRestoreEntries (Record, RecordSize, Entries);
+  if (!EFI_ERROR (Status)) {
+    Status = ScanCacheAppend (Cache, Record, RecordSize);
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCB: Ignoring scan cache record for fs %p - %r\n", FileSystem->Handle, Status));
+    ScanCacheFreeEntries (Entries);
+    ++Cache->Misses;
+    return EFI_NOT_FOUND;
+  }
+
+  ++Cache->OutCount;
+  ++Cache->Hits;
+
+  CopyMem (&Header, Record, sizeof (Header));
+  FileSystem->HasSelfRecovery = Header.HasSelfRecovery != 0;
+
+  //
+  // The record is already in the new cache file.
+  //
+  Cache->LookupFs = NULL;
+
+  return EFI_SUCCESS;
+}
+
+VOID
+InternalScanCacheStore (
+  IN OUT OC_SCAN_CACHE       *Cache,
+  IN     OC_BOOT_FILESYSTEM  *FileSystem
+  )
+{
+  EFI_STATUS            Status;
+  LIST_ENTRY            *Link;
+  OC_BOOT_ENTRY         *BootEntry;
+  OC_SCAN_CACHE_RECORD  Record;
+  OC_SCAN_CACHE_ENTRY   CachedEntry;
+  UINT32                RecordOffset;
+  UINTN                 DevicePathSize;
+  UINTN                 NameSize;
+  UINTN                 PathNameSize;
+
+  if (Cache->LookupFs != FileSystem) {
+    return;
+  }
+
+  Cache->LookupFs = NULL;
+  RecordOffset    = Cache->OutSize;
+
+  ZeroMem (&Record, sizeof (Record));
+  Record.Token           = Cache->LookupToken;
+  Record.DevicePathSize  = (UINT16) Cache->LookupDevicePathSize;
+  Record.HasSelfRecovery = FileSystem->HasSelfRecovery;
+
+  Status = ScanCacheAppend (Cache, &Record, sizeof (Record));
+  if (!EFI_ERROR (Status)) {
+    Status = ScanCacheAppend (Cache, Cache->LookupDevicePath, Cache->LookupDevicePathSize);
+  }
+
+  for (
+    Link = GetFirstNode (&FileSystem->BootEntries);
+    !EFI_ERROR (Status) && !IsNull (&FileSystem->BootEntries, Link);
+    Link = GetNextNode (&FileSystem->BootEntries, Link)) {
+    BootEntry = BASE_CR (Link, OC_BOOT_ENTRY, Link);
+
+    //
+    // Entries without their files (e.g. custom) and entries with options
+    // are not produced by scanning.
+    //
+    if (BootEntry->DevicePath == NULL || BootEntry->Name == NULL
+      || BootEntry->PathName == NULL || BootEntry->LoadOptions != NULL
+      || (BootEntry->Type & ~OC_SCAN_CACHE_ENTRY_TYPES) != 0
+      || Record.EntryCount == MAX_UINT8) {
+      Status = EFI_UNSUPPORTED;
+      break;
+    }
+
+    DevicePathSize = GetDevicePathSize (BootEntry->DevicePath);
+    NameSize       = StrSize (BootEntry->Name);
+    PathNameSize   = StrSize (BootEntry->PathName);
+    if (DevicePathSize > MAX_UINT16 || NameSize > MAX_UINT16 || PathNameSize > MAX_UINT16) {
+      Status = EFI_UNSUPPORTED;
+      break;
+    }
+
+    ZeroMem (&CachedEntry, sizeof (CachedEntry));
+    CachedEntry.Type           = BootEntry->Type;
+    CachedEntry.DevicePathSize = (UINT16) DevicePathSize;
+    CachedEntry.NameSize       = (UINT16) NameSize;
+    CachedEntry.PathNameSize   = (UINT16) PathNameSize;
+    CachedEntry.IsFolder       = BootEntry->IsFolder;
+    CachedEntry.IsGeneric      = BootEntry->IsGeneric;
+    CachedEntry.IsExternal     = BootEntry->IsExternal;
+
+    Status = ScanCacheAppend (Cache, &CachedEntry, sizeof (CachedEntry));
+    if (!EFI_ERROR (Status)) {
+      Status = ScanCacheAppend (Cache, BootEntry->DevicePath, DevicePathSize);
+    }
+    if (!EFI_ERROR (Status)) {
+      Status = ScanCacheAppend (Cache, BootEntry->Name, NameSize);
+    }
+    if (!EFI_ERROR (Status)) {
+      Status = ScanCacheAppend (Cache, BootEntry->PathName, PathNameSize);
+    }
+
+    ++Record.EntryCount;
+  }
+
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCB: Not caching fs %p - %r\n", FileSystem->Handle, Status));
+    Cache->OutSize = RecordOffset;
+    return;
+  }
+
+  Record.Size = Cache->OutSize - RecordOffset;
+  CopyMem (&Cache->Out[RecordOffset], &Record, sizeof (Record));
+  ++Cache->OutCount;
+}
+
+VOID
+InternalScanCacheFree (
+  IN OUT OC_SCAN_CACHE  *Cache,
+  IN     BOOLEAN        Save
+  )
+{
+  EFI_STATUS            Status;
+  EFI_FILE_PROTOCOL     *Root;
+  OC_SCAN_CACHE_HEADER  Header;
+
+  if (Save && Cache->Out != NULL) {
+    Header.Signature   = OC_SCAN_CACHE_SIGNATURE;
+    Header.Version     = OC_SCAN_CACHE_VERSION;
+    Header.Settings    = Cache->Settings;
+    Header.RecordCount = Cache->OutCount;
+    CopyMem (Cache->Out, &Header, sizeof (Header));
+
+    DEBUG ((
+      DEBUG_INFO,
+      "OCB: Scan cache %u hits %u misses, %u records in %u bytes\n",
+      Cache->Hits,
+      Cache->Misses,
+      Cache->OutCount,
+      Cache->OutSize
+      ));
+
+    //
+    // Avoid writing to the loader filesystem when nothing changed.
+    //
+    if (Cache->Data == NULL
+      || Cache->DataSize != Cache->OutSize
+      || CompareMem (Cache->Data, Cache->Out, Cache->OutSize) != 0) {
+      Status = Cache->LoaderFs->OpenVolume (Cache->LoaderFs, &Root);
+      if (!EFI_ERROR (Status)) {
+        Status = SetFileData (Root, OC_SCAN_CACHE_PATH, Cache->Out, Cache->OutSize);
+        Root->Close (Root);
+      }
+
+      DEBUG ((DEBUG_INFO, "OCB: Saving scan cache - %r\n", Status));
+    }
+  }
+
+  if (Cache->Data != NULL) {
+    FreePool (Cache->Data);
+  }
+
+  if (Cache->Out != NULL) {
+    FreePool (Cache->Out);
+  }
+
+  FreePool (Cache);
+}
+
+VOID
+InternalScanCacheInvalidate (
+  IN OUT OC_PICKER_CONTEXT  *Context
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *LoaderFs;
+  EFI_FILE_PROTOCOL                *Root;
+  EFI_FILE_PROTOCOL                *File;
+
+  //
+  // Scan everything in full until the next boot.
+  //
+  Context->ScanCache = FALSE;
+
+  Status = gBS->HandleProtocol (
+    Context->LoaderHandle,
+    &gEfiSimpleFileSystemProtocolGuid,
+    (VOID **) &LoaderFs
+    );
+  if (!EFI_ERROR (Status)) {
+    Status = LoaderFs->OpenVolume (LoaderFs, &Root);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = SafeFileOpen (
+      Root,
+      &File,
+      OC_SCAN_CACHE_PATH,
+      EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE,
+      0
+      );
+    if (!EFI_ERROR (Status)) {
+      Status = File->Delete (File);
+    }
+
+    Root->Close (Root);
+  }
+
+  DEBUG ((DEBUG_INFO, "OCB: Invalidating scan cache - %r\n", Status));
+}
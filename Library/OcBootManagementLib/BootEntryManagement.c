@@ -36,6 +36,7 @@
 #include <Library/UefiLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/PrintLib.h>
+#include <Library/TimerLib.h>
 
 /*
   Expands DevicePath from short-form to full-form.
@@ -1506,9 +1507,8 @@ AddFileSystemEntryForCustom (
   return Status;
 }
 
-STATIC
 VOID
-FreeFileSystemEntry (
+InternalFreeFileSystemEntry (
   IN OUT OC_BOOT_CONTEXT     *BootContext,
   IN     OC_BOOT_FILESYSTEM  *FileSystemEntry
   )
@@ -1635,7 +1635,7 @@ OcFreeBootContext (
   while (!IsListEmpty (&Context->FileSystems)) {
     Link = GetFirstNode (&Context->FileSystems);
     FileSystem = BASE_CR (Link, OC_BOOT_FILESYSTEM, Link);
-    FreeFileSystemEntry (Context, FileSystem);
+    InternalFreeFileSystemEntry (Context, FileSystem);
   }
 
   FreePool (Context);
@@ -1734,6 +1734,11 @@ OcScanForBootEntries (
   OC_BOOT_FILESYSTEM               *CustomFileSystem;
   OC_BOOT_FILESYSTEM               *CustomFileSystemDefault;
   UINT32                           DefaultCustomIndex;
+  UINT64                           StartTime;
+  OC_SCAN_CACHE                    *ScanCache;
+  LIST_ENTRY                       CachedEntries;
+  OC_BOOT_ENTRY                    *CachedEntry;
+  EFI_STATUS                       CacheStatus;
 
   //
   // Obtain the list of filesystems filtered by scan policy.
@@ -1746,6 +1751,8 @@ OcScanForBootEntries (
     return NULL;
   }
 
+  InternalProbeFileSystems (BootContext);
+
   DEBUG ((DEBUG_INFO, "OCB: Found %u potentially bootable filesystems\n", (UINT32) BootContext->FileSystemCount));
 
   //
@@ -1791,6 +1798,8 @@ OcScanForBootEntries (
 
   DEBUG ((DEBUG_INFO, "OCB: Processing blessed list\n"));
 
+  ScanCache = InternalScanCacheLoad (Context);
+
   //
   // Create primary boot options on filesystems without options
   // and alternate boot options on all filesystems.
@@ -1800,25 +1809,58 @@ OcScanForBootEntries (
     !IsNull (&BootContext->FileSystems, Link);
     Link = GetNextNode (&BootContext->FileSystems, Link)) {
     FileSystem = BASE_CR (Link, OC_BOOT_FILESYSTEM, Link);
+    StartTime  = GetTimeInNanoSecond (GetPerformanceCounter ());
 
     //
-    // No entries, so we process this directory with Apple Bless.
+    // Filesystems with entries from BootOrder are always scanned,
+    // unmodified ones without entries may reuse the previous results.
     //
-    if (IsListEmpty (&FileSystem->BootEntries)) {
-      AddBootEntryFromBless (
-        BootContext,
-        FileSystem,
-        gAppleBootPolicyPredefinedPaths,
-        gAppleBootPolicyNumPredefinedPaths,
-        FALSE,
-        FALSE
-        );
+    CacheStatus = EFI_UNSUPPORTED;
+    if (ScanCache != NULL && IsListEmpty (&FileSystem->BootEntries)) {
+      CacheStatus = InternalScanCacheLookup (ScanCache, FileSystem, &CachedEntries);
     }
 
-    //
-    // Record predefined recoveries.
-    //
-    AddBootEntryFromSelfRecovery (BootContext, FileSystem);
+    if (!EFI_ERROR (CacheStatus)) {
+      while (!IsListEmpty (&CachedEntries)) {
+        CachedEntry = BASE_CR (GetFirstNode (&CachedEntries), OC_BOOT_ENTRY, Link);
+        RemoveEntryList (&CachedEntry->Link);
+        RegisterBootOption (BootContext, FileSystem, CachedEntry);
+      }
+    } else {
+      //
+      // No entries, so we process this directory with Apple Bless.
+      //
+      if (IsListEmpty (&FileSystem->BootEntries)) {
+        AddBootEntryFromBless (
+          BootContext,
+          FileSystem,
+          gAppleBootPolicyPredefinedPaths,
+          gAppleBootPolicyNumPredefinedPaths,
+          FALSE,
+          FALSE
+          );
+      }
+
+      //
+      // Record predefined recoveries.
+      //
+      AddBootEntryFromSelfRecovery (BootContext, FileSystem);
+
+      if (CacheStatus == EFI_NOT_FOUND) {
+        InternalScanCacheStore (ScanCache, FileSystem);
+      }
+    }
+
+    DEBUG ((
+      DEBUG_INFO,
+      "OCB: Scanned fs %p in %Lu us\n",
+      FileSystem->Handle,
+      DivU64x32 (GetTimeInNanoSecond (GetPerformanceCounter ()) - StartTime, 1000)
+      ));
+  }
+
+  if (ScanCache != NULL) {
+    InternalScanCacheFree (ScanCache, TRUE);
   }
 
   if (CustomFileSystem != NULL) {
@@ -2029,6 +2071,92 @@ OcEnumerateEntries (
   return Entries;
 }
 
+/**
+  Check that boot entry restored from scan cache still matches the
+  filesystem contents as it would be found by scanning.
+
+  @param[in]  BootEntry  Cached boot entry.
+
+  @retval EFI_SUCCESS  Boot entry is up to date.
+**/
+STATIC
+EFI_STATUS
+ValidateCachedBootEntry (
+  IN OC_BOOT_ENTRY  *BootEntry
+  )
+{
+  EFI_STATUS                Status;
+  EFI_DEVICE_PATH_PROTOCOL  *RemainingDevicePath;
+  EFI_FILE_PROTOCOL         *File;
+  EFI_FILE_INFO             *FileInfo;
+  BOOLEAN                   IsDirectory;
+  OC_BOOT_ENTRY             ScannedEntry;
+
+  //
+  // Loaders are files and DMG loaders are folders.
+  //
+  RemainingDevicePath = BootEntry->DevicePath;
+  Status = OcOpenFileByDevicePath (
+    &RemainingDevicePath,
+    &File,
+    EFI_FILE_MODE_READ,
+    0
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  FileInfo = GetFileInfo (
+    File,
+    &gEfiFileInfoGuid,
+    sizeof (EFI_FILE_INFO),
+    NULL
+    );
+
+  File->Close (File);
+
+  if (FileInfo == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  IsDirectory = (FileInfo->Attribute & EFI_FILE_DIRECTORY) != 0;
+  FreePool (FileInfo);
+
+  if (IsDirectory != BootEntry->IsFolder) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Describe the entry again to ensure it is of the same type.
+  //
+  ZeroMem (&ScannedEntry, sizeof (ScannedEntry));
+  ScannedEntry.DevicePath = BootEntry->DevicePath;
+  ScannedEntry.Type       = OcGetBootDevicePathType (
+    ScannedEntry.DevicePath,
+    &ScannedEntry.IsFolder,
+    &ScannedEntry.IsGeneric
+    );
+
+  if (ScannedEntry.IsFolder != BootEntry->IsFolder
+    || ScannedEntry.IsGeneric != BootEntry->IsGeneric) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = InternalDescribeBootEntry (&ScannedEntry);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (ScannedEntry.Type != BootEntry->Type) {
+    Status = EFI_NOT_FOUND;
+  }
+
+  FreePool (ScannedEntry.Name);
+  FreePool (ScannedEntry.PathName);
+
+  return Status;
+}
+
 EFI_STATUS
 OcLoadBootEntry (
   IN  OC_PICKER_CONTEXT  *Context,
@@ -2045,6 +2173,18 @@ OcLoadBootEntry (
     return BootEntry->SystemAction ();
   }
 
+  //
+  // Cached entry may refer to files no longer present or changed, rescan in full.
+  //
+  if (BootEntry->IsCached) {
+    Status = ValidateCachedBootEntry (BootEntry);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "OCB: Cached entry %s is outdated - %r\n", BootEntry->Name, Status));
+      InternalScanCacheInvalidate (Context);
+      return EFI_NOT_READY;
+    }
+  }
+
   Status = InternalLoadBootEntry (
     Context,
     BootEntry,
@@ -2063,6 +2203,13 @@ OcLoadBootEntry (
     }
   } else {
     DEBUG ((DEBUG_WARN, "OCB: LoadImage failed - %r\n", Status));
+
+    //
+    // Cached entry may refer to files no longer present, rescan in full.
+    //
+    if (BootEntry->IsCached) {
+      InternalScanCacheInvalidate (Context);
+    }
   }
 
   return Status;
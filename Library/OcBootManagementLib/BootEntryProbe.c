@@ -0,0 +1,296 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "BootManagementInternal.h"
+
+#include <Protocol/BlockIo2.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/OcDebugLogLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+typedef enum {
+  FsProbePending,
+  FsProbeDone,
+  FsProbeAbandoned
+} FS_PROBE_STATE;
+
+typedef struct {
+  OC_BOOT_FILESYSTEM       *FileSystem;
+  EFI_BLOCK_IO2_TOKEN      Token;
+  VOID                     *Buffer;
+  UINTN                    Pages;
+  volatile FS_PROBE_STATE  State;
+  EFI_STATUS               Status;
+  UINT64                   StartTime;
+  UINT64                   EndTime;
+} FS_PROBE;
+
+/**
+  Release probe resources.
+
+  @param[in]  Probe  Probe to free.
+**/
+STATIC
+VOID
+FsProbeFree (
+  IN FS_PROBE  *Probe
+  )
+{
+  if (Probe->Token.Event != NULL) {
+    gBS->CloseEvent (Probe->Token.Event);
+  }
+
+  FreePages (Probe->Buffer, Probe->Pages);
+  FreePool (Probe);
+}
+
+/**
+  Probe read completion notification.
+
+  @param[in]  Event    Token event.
+  @param[in]  Context  Probe.
+**/
+STATIC
+VOID
+EFIAPI
+FsProbeComplete (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  FS_PROBE  *Probe;
+
+  Probe = Context;
+
+  //
+  // The scan gave up on this filesystem, only the cleanup is left.
+  //
+  if (Probe->State == FsProbeAbandoned) {
+    FsProbeFree (Probe);
+    return;
+  }
+
+  Probe->EndTime = GetTimeInNanoSecond (GetPerformanceCounter ());
+  Probe->Status  = Probe->Token.TransactionStatus;
+  Probe->State   = FsProbeDone;
+}
+
+/**
+  Issue the initial read on the filesystem block device.
+
+  @param[in]  FileSystem  Filesystem to probe.
+
+  @retval Probe or NULL when the filesystem cannot be probed asynchronously.
+**/
+STATIC
+FS_PROBE *
+FsProbeStart (
+  IN OC_BOOT_FILESYSTEM  *FileSystem
+  )
+{
+  EFI_STATUS              Status;
+  EFI_BLOCK_IO2_PROTOCOL  *BlockIo2;
+  FS_PROBE                *Probe;
+  UINT64                  MediaSize;
+  UINTN                   Size;
+
+  Status = gBS->HandleProtocol (
+    FileSystem->Handle,
+    &gEfiBlockIo2ProtocolGuid,
+    (VOID **) &BlockIo2
+    );
+  if (EFI_ERROR (Status)
+    || !BlockIo2->Media->MediaPresent
+    || BlockIo2->Media->BlockSize == 0
+    || BlockIo2->Media->IoAlign > EFI_PAGE_SIZE) {
+    return NULL;
+  }
+
+  MediaSize = MultU64x32 (BlockIo2->Media->LastBlock + 1, BlockIo2->Media->BlockSize);
+  Size      = ALIGN_VALUE (OC_FS_PROBE_SIZE, BlockIo2->Media->BlockSize);
+  if (Size > MediaSize) {
+    return NULL;
+  }
+
+  Probe = AllocateZeroPool (sizeof (*Probe));
+  if (Probe == NULL) {
+    return NULL;
+  }
+
+  Probe->FileSystem = FileSystem;
+  Probe->Pages      = EFI_SIZE_TO_PAGES (Size);
+  Probe->Buffer     = AllocatePages (Probe->Pages);
+  if (Probe->Buffer == NULL) {
+    FreePool (Probe);
+    return NULL;
+  }
+
+  Status = gBS->CreateEvent (
+    EVT_NOTIFY_SIGNAL,
+    TPL_CALLBACK,
+    FsProbeComplete,
+    Probe,
+    &Probe->Token.Event
+    );
+  if (EFI_ERROR (Status)) {
+    Probe->Token.Event = NULL;
+    FsProbeFree (Probe);
+    return NULL;
+  }
+
+  Probe->State     = FsProbePending;
+  Probe->StartTime = GetTimeInNanoSecond (GetPerformanceCounter ());
+
+  Status = BlockIo2->ReadBlocksEx (
+    BlockIo2,
+    BlockIo2->Media->MediaId,
+    0,
+    &Probe->Token,
+    Size,
+    Probe->Buffer
+    );
+  if (EFI_ERROR (Status)) {
+    //
+    // The token is not signaled on immediate failure.
+    //
+    Probe->EndTime = GetTimeInNanoSecond (GetPerformanceCounter ());
+    Probe->Status  = Status;
+    Probe->State   = FsProbeDone;
+  }
+
+  return Probe;
+}
+
+VOID
+InternalProbeFileSystems (
+  IN OUT OC_BOOT_CONTEXT  *BootContext
+  )
+{
+  FS_PROBE            **Probes;
+  FS_PROBE            *Probe;
+  LIST_ENTRY          *Link;
+  OC_BOOT_FILESYSTEM  *FileSystem;
+  UINTN               ProbeCount;
+  UINTN               Index;
+  UINTN               Pending;
+  UINT64              Waited;
+  EFI_TPL             OldTpl;
+  BOOLEAN             Abandoned;
+  BOOLEAN             Drop;
+
+  if (BootContext->FileSystemCount == 0) {
+    return;
+  }
+
+  Probes = AllocateZeroPool (BootContext->FileSystemCount * sizeof (*Probes));
+  if (Probes == NULL) {
+    return;
+  }
+
+  //
+  // Issue the first read on every filesystem at once, so that slow
+  // devices spin up or wake concurrently instead of one by one
+  // when the filesystems are opened.
+  //
+  ProbeCount = 0;
+  for (
+    Link = GetFirstNode (&BootContext->FileSystems);
+    !IsNull (&BootContext->FileSystems, Link);
+    Link = GetNextNode (&BootContext->FileSystems, Link)) {
+    FileSystem = BASE_CR (Link, OC_BOOT_FILESYSTEM, Link);
+    Probe      = FsProbeStart (FileSystem);
+    if (Probe != NULL) {
+      Probes[ProbeCount++] = Probe;
+    }
+  }
+
+  //
+  // Wait for completion notifications until all probes are done or time out.
+  //
+  Waited = 0;
+  do {
+    Pending = 0;
+    for (Index = 0; Index < ProbeCount; ++Index) {
+      if (Probes[Index]->State == FsProbePending) {
+        ++Pending;
+      }
+    }
+
+    if (Pending == 0 || Waited >= OC_FS_PROBE_TIMEOUT) {
+      break;
+    }
+
+    gBS->Stall (OC_FS_PROBE_POLL_INTERVAL);
+    Waited += OC_FS_PROBE_POLL_INTERVAL;
+  } while (TRUE);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCB: Probed %u of %u filesystems in %Lu us, %u timed out\n",
+    (UINT32) ProbeCount,
+    (UINT32) BootContext->FileSystemCount,
+    Waited,
+    (UINT32) Pending
+    ));
+
+  for (Index = 0; Index < ProbeCount; ++Index) {
+    Probe      = Probes[Index];
+    FileSystem = Probe->FileSystem;
+
+    //
+    // The notification may arrive any time while the state is pending,
+    // abandoned probes are freed by it and must not be touched afterwards.
+    //
+    OldTpl    = gBS->RaiseTPL (TPL_CALLBACK);
+    Abandoned = Probe->State == FsProbePending;
+    if (Abandoned) {
+      Probe->State = FsProbeAbandoned;
+    }
+    gBS->RestoreTPL (OldTpl);
+
+    if (Abandoned) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCB: Probe of fs %p timed out after %Lu us\n",
+        FileSystem->Handle,
+        Waited
+        ));
+      Drop = FALSE;
+    } else {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCB: Probe of fs %p took %Lu us - %r\n",
+        FileSystem->Handle,
+        Probe->EndTime >= Probe->StartTime ? DivU64x32 (Probe->EndTime - Probe->StartTime, 1000) : 0,
+        Probe->Status
+        ));
+      Drop = Probe->Status == EFI_NO_MEDIA && !FileSystem->LoaderFs;
+      FsProbeFree (Probe);
+    }
+
+    //
+    // Slow devices may still respond, only filesystems reporting
+    // no media are skipped.
+    //
+    if (Drop) {
+      InternalFreeFileSystemEntry (BootContext, FileSystem);
+    }
+  }
+
+  FreePool (Probes);
+}
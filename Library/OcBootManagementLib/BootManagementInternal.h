@@ -196,6 +196,121 @@ InternalFileSystemForHandle (
   IN BOOLEAN          LazyScan
   );
 
+/**
+  Remove filesystem entry from context and free it with its boot entries.
+
+  @param[in,out] BootContext      Context of filesystems.
+  @param[in]     FileSystemEntry  Filesystem entry to free.
+**/
+VOID
+InternalFreeFileSystemEntry (
+  IN OUT OC_BOOT_CONTEXT     *BootContext,
+  IN     OC_BOOT_FILESYSTEM  *FileSystemEntry
+  );
+
+/**
+  Size of the initial read issued to filesystem devices when probing.
+**/
+#define OC_FS_PROBE_SIZE           SIZE_4KB
+
+/**
+  Time in microseconds to wait for filesystem devices to respond to probing.
+**/
+#define OC_FS_PROBE_TIMEOUT        5000000
+
+/**
+  Probe completion polling interval in microseconds.
+**/
+#define OC_FS_PROBE_POLL_INTERVAL  100
+
+/**
+  Issue initial reads on all filesystem devices concurrently and wait
+  for them to complete. Filesystems without media are removed, except
+  the loader filesystem. Filesystems not responding within timeout are
+  kept, only the wait for them is stopped.
+
+  @param[in,out] BootContext  Context of filesystems without boot entries.
+**/
+VOID
+InternalProbeFileSystems (
+  IN OUT OC_BOOT_CONTEXT  *BootContext
+  );
+
+/**
+  Boot entry scan cache file name at the loader filesystem root.
+**/
+#define OC_SCAN_CACHE_PATH  L"opencore-scan-cache.bin"
+
+/**
+  Boot entry scan cache.
+**/
+typedef struct OC_SCAN_CACHE_ OC_SCAN_CACHE;
+
+/**
+  Load boot entry scan cache from the loader filesystem.
+
+  @param[in]  Context  Picker context.
+
+  @retval Scan cache or NULL when disabled or unavailable.
+**/
+OC_SCAN_CACHE *
+InternalScanCacheLoad (
+  IN OC_PICKER_CONTEXT  *Context
+  );
+
+/**
+  Restore boot entries of an unmodified filesystem from scan cache.
+  On miss the filesystem is remembered for InternalScanCacheStore.
+
+  @param[in,out] Cache       Scan cache.
+  @param[in,out] FileSystem  Filesystem without boot entries.
+  @param[out]    Entries     Restored boot entries to register.
+
+  @retval EFI_SUCCESS      Boot entries were restored.
+  @retval EFI_NOT_FOUND    Filesystem needs scanning and can be stored.
+  @retval EFI_UNSUPPORTED  Filesystem cannot be cached.
+**/
+EFI_STATUS
+InternalScanCacheLookup (
+  IN OUT OC_SCAN_CACHE       *Cache,
+  IN OUT OC_BOOT_FILESYSTEM  *FileSystem,
+     OUT LIST_ENTRY          *Entries
+  );
+
+/**
+  Store boot entries of the filesystem scanned after lookup miss.
+
+  @param[in,out] Cache       Scan cache.
+  @param[in]     FileSystem  Scanned filesystem.
+**/
+VOID
+InternalScanCacheStore (
+  IN OUT OC_SCAN_CACHE       *Cache,
+  IN     OC_BOOT_FILESYSTEM  *FileSystem
+  );
+
+/**
+  Free scan cache, optionally saving it when changed.
+
+  @param[in,out] Cache  Scan cache.
+  @param[in]     Save   Write the cache file.
+**/
+VOID
+InternalScanCacheFree (
+  IN OUT OC_SCAN_CACHE  *Cache,
+  IN     BOOLEAN        Save
+  );
+
+/**
+  Delete scan cache file and disable scan caching until reboot.
+
+  @param[in,out] Context  Picker context.
+**/
+VOID
+InternalScanCacheInvalidate (
+  IN OUT OC_PICKER_CONTEXT  *Context
+  );
+
 /**
   Resets selected NVRAM variables and reboots the system.
 **/
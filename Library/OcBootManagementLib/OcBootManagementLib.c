@@ -559,6 +559,7 @@ OcRunBootPicker (
   OC_BOOT_CONTEXT                    *BootContext;
   OC_BOOT_ENTRY                      *Chosen;
   BOOLEAN                            SaidWelcome;
+  UINT32                             Phase;
 
   SaidWelcome = FALSE;
 
@@ -614,7 +615,9 @@ OcRunBootPicker (
     // Turbo-boost scanning when bypassing picker.
     //
     if (Context->PickerCommand == OcPickerDefault) {
+      Phase       = OcProfileBegin ("OcScanForDefaultBootEntry");
       BootContext = OcScanForDefaultBootEntry (Context);
+      OcProfileEnd (Phase);
     } else {
       ASSERT (
         Context->PickerCommand == OcPickerShowPicker
@@ -622,7 +625,9 @@ OcRunBootPicker (
         || Context->PickerCommand == OcPickerBootAppleRecovery
         );
 
+      Phase       = OcProfileBegin ("OcScanForBootEntries");
       BootContext = OcScanForBootEntries (Context);
+      OcProfileEnd (Phase);
     }
 
     //
@@ -738,6 +743,15 @@ OcRunBootPicker (
         gImageHandle
         );
 
+      //
+      // Scan cache is outdated, retry with full scanning.
+      //
+      if (Status == EFI_NOT_READY) {
+        DEBUG ((DEBUG_INFO, "OCB: Rescanning boot entries without cache\n"));
+        OcFreeBootContext (BootContext);
+        continue;
+      }
+
       //
       // Do not wait on successful return code.
       //
@@ -16,6 +16,7 @@
 
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcCompressionLib.h>
+#include <Library/OcCrc32Lib.h>
 
 voidpf ZLIB_INTERNAL zcalloc (opaque, items, size)
     voidpf opaque;
@@ -34,6 +35,30 @@ void ZLIB_INTERNAL zcfree (opaque, ptr)
   FreePool (ptr);
 }
 
+//
+// CRC-32 is only needed for gzip streams, use the shared implementation
+// instead of carrying a second set of tables.
+//
+uLong ZEXPORT crc32_z (crc, buf, len)
+    uLong crc;
+    const Bytef *buf;
+    z_size_t len;
+{
+  if (buf == Z_NULL) {
+    return 0;
+  }
+
+  return OcCrc32 ((UINT32) crc, buf, len);
+}
+
+uLong ZEXPORT crc32 (crc, buf, len)
+    uLong crc;
+    const Bytef *buf;
+    uInt len;
+{
+  return crc32_z (crc, buf, len);
+}
+
 UINT8 *
 CompressZLIB (
   OUT UINT8        *Dst,
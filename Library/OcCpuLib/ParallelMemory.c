@@ -0,0 +1,327 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+
+#include <Protocol/MpService.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/OcCpuLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include "OcCpuInternals.h"
+
+///
+/// Smaller jobs are not worth waking application processors.
+///
+#define OC_PARALLEL_MEMORY_MIN_SIZE    BASE_8MB
+
+///
+/// Amount of memory processed by a CPU at a time.
+///
+#define OC_PARALLEL_MEMORY_CHUNK_SIZE  BASE_1MB
+
+typedef struct {
+  UINT8            *Destination;
+  CONST UINT8      *Source;
+  UINTN            Length;
+  UINT32           ChunkCount;
+  volatile UINT32  NextChunk;
+} OC_PARALLEL_MEMORY_JOB;
+
+STATIC EFI_MP_SERVICES_PROTOCOL  *mParallelMpServices;
+STATIC UINTN                     mParallelApCount;
+STATIC BOOLEAN                   mParallelBusy;
+STATIC EFI_EVENT                 mParallelExitBootServicesEvent;
+
+/**
+  Process job chunks until none are left. Runs on both BSP and APs,
+  so no UEFI services may be called here.
+
+  @param[in,out]  Job   Job to process.
+**/
+STATIC
+VOID
+ParallelMemoryRun (
+  IN OUT OC_PARALLEL_MEMORY_JOB  *Job
+  )
+{
+  UINT32  Chunk;
+  UINTN   Offset;
+  UINTN   Size;
+
+  while (TRUE) {
+    Chunk = AsmIncrementUint32 (&Job->NextChunk) - 1;
+    if (Chunk >= Job->ChunkCount) {
+      break;
+    }
+
+    Offset = (UINTN) Chunk * OC_PARALLEL_MEMORY_CHUNK_SIZE;
+    Size   = MIN (Job->Length - Offset, OC_PARALLEL_MEMORY_CHUNK_SIZE);
+
+    if (Job->Source != NULL) {
+      CopyMem (Job->Destination + Offset, Job->Source + Offset, Size);
+    } else {
+      ZeroMem (Job->Destination + Offset, Size);
+    }
+  }
+}
+
+STATIC
+VOID
+EFIAPI
+ParallelMemoryWorker (
+  IN VOID  *Buffer
+  )
+{
+  ParallelMemoryRun (Buffer);
+}
+
+STATIC
+VOID
+EFIAPI
+ParallelMemoryExitBootServices (
+  IN EFI_EVENT  Event,
+  IN VOID       *Context
+  )
+{
+  //
+  // MP services are gone, later jobs run on the BSP only.
+  //
+  mParallelMpServices = NULL;
+}
+
+/**
+  Check whether the job can be split across application processors.
+
+  @param[in]  Destination   Destination buffer.
+  @param[in]  Source        Source buffer or NULL for zeroing.
+  @param[in]  Length        Job length in bytes.
+
+  @retval TRUE when the job should run in parallel.
+**/
+STATIC
+BOOLEAN
+ParallelMemoryUsable (
+  IN CONST VOID  *Destination,
+  IN CONST VOID  *Source  OPTIONAL,
+  IN UINTN       Length
+  )
+{
+  EFI_TPL  OldTpl;
+
+  if (mParallelMpServices == NULL || mParallelBusy
+    || Length < OC_PARALLEL_MEMORY_MIN_SIZE) {
+    return FALSE;
+  }
+
+  //
+  // Overlapping copies need ordered processing.
+  //
+  if (Source != NULL
+    && (UINTN) Source < (UINTN) Destination + Length
+    && (UINTN) Destination < (UINTN) Source + Length) {
+    return FALSE;
+  }
+
+  //
+  // Waiting for APs requires TPL_APPLICATION.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+  gBS->RestoreTPL (OldTpl);
+
+  return OldTpl == TPL_APPLICATION;
+}
+
+/**
+  Run the job on all enabled processors.
+
+  @param[in,out]  Job   Job to process.
+**/
+STATIC
+VOID
+ParallelMemoryDispatch (
+  IN OUT OC_PARALLEL_MEMORY_JOB  *Job
+  )
+{
+  EFI_STATUS  Status;
+  EFI_EVENT   Event;
+  UINT64      StartTsc;
+  UINT64      EndTsc;
+  UINT64      Frequency;
+
+  mParallelBusy = TRUE;
+  StartTsc      = AsmReadTsc ();
+
+  Job->ChunkCount = (UINT32) ((Job->Length + OC_PARALLEL_MEMORY_CHUNK_SIZE - 1) / OC_PARALLEL_MEMORY_CHUNK_SIZE);
+  Job->NextChunk  = 0;
+
+  Status = gBS->CreateEvent (0, TPL_NOTIFY, NULL, NULL, &Event);
+  if (!EFI_ERROR (Status)) {
+    //
+    // Let the BSP take its share while the APs work.
+    //
+    Status = mParallelMpServices->StartupAllAPs (
+      mParallelMpServices,
+      ParallelMemoryWorker,
+      FALSE,
+      Event,
+      0,
+      Job,
+      NULL
+      );
+    if (!EFI_ERROR (Status)) {
+      ParallelMemoryRun (Job);
+      while (gBS->CheckEvent (Event) == EFI_NOT_READY) {
+        CpuPause ();
+      }
+    }
+
+    gBS->CloseEvent (Event);
+  }
+
+  if (EFI_ERROR (Status)) {
+    //
+    // Some firmware only supports blocking mode, where the BSP waits.
+    //
+    Status = mParallelMpServices->StartupAllAPs (
+      mParallelMpServices,
+      ParallelMemoryWorker,
+      FALSE,
+      NULL,
+      0,
+      Job,
+      NULL
+      );
+  }
+
+  //
+  // Process whatever is left, or everything on failure.
+  //
+  ParallelMemoryRun (Job);
+
+  EndTsc        = AsmReadTsc ();
+  mParallelBusy = FALSE;
+
+  Frequency = OcGetTSCFrequency ();
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCCPU: Parallel %a of %Lu KB on %u APs took %Lu us - %r\n",
+    Job->Source != NULL ? "copy" : "zero",
+    (UINT64) (Job->Length / BASE_1KB),
+    (UINT32) mParallelApCount,
+    Frequency != 0 ? DivU64x64Remainder (MultU64x32 (EndTsc - StartTsc, 1000000), Frequency, NULL) : 0,
+    Status
+    ));
+}
+
+EFI_STATUS
+OcParallelMemoryInit (
+  VOID
+  )
+{
+  EFI_STATUS                Status;
+  EFI_MP_SERVICES_PROTOCOL  *MpServices;
+  UINTN                     NumberOfProcessors;
+  UINTN                     NumberOfEnabledProcessors;
+
+  if (mParallelMpServices != NULL) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  Status = gBS->LocateProtocol (
+    &gEfiMpServiceProtocolGuid,
+    NULL,
+    (VOID **) &MpServices
+    );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCCPU: No MP services for parallel memory - %r\n", Status));
+    return Status;
+  }
+
+  Status = MpServices->GetNumberOfProcessors (
+    MpServices,
+    &NumberOfProcessors,
+    &NumberOfEnabledProcessors
+    );
+  if (!EFI_ERROR (Status) && NumberOfEnabledProcessors <= 1) {
+    Status = EFI_UNSUPPORTED;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->CreateEvent (
+      EVT_SIGNAL_EXIT_BOOT_SERVICES,
+      TPL_NOTIFY,
+      ParallelMemoryExitBootServices,
+      NULL,
+      &mParallelExitBootServicesEvent
+      );
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCCPU: Parallel memory operations with %u enabled CPUs - %r\n",
+    (UINT32) NumberOfEnabledProcessors,
+    Status
+    ));
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  mParallelApCount    = NumberOfEnabledProcessors - 1;
+  mParallelMpServices = MpServices;
+
+  return EFI_SUCCESS;
+}
+
+VOID
+OcParallelCopyMem (
+  OUT VOID        *Destination,
+  IN  CONST VOID  *Source,
+  IN  UINTN       Length
+  )
+{
+  OC_PARALLEL_MEMORY_JOB  Job;
+
+  if (!ParallelMemoryUsable (Destination, Source, Length)) {
+    CopyMem (Destination, Source, Length);
+    return;
+  }
+
+  Job.Destination = Destination;
+  Job.Source      = Source;
+  Job.Length      = Length;
+  ParallelMemoryDispatch (&Job);
+}
+
+VOID
+OcParallelZeroMem (
+  OUT VOID   *Buffer,
+  IN  UINTN  Length
+  )
+{
+  OC_PARALLEL_MEMORY_JOB  Job;
+
+  if (!ParallelMemoryUsable (Buffer, NULL, Length)) {
+    ZeroMem (Buffer, Length);
+    return;
+  }
+
+  Job.Destination = Buffer;
+  Job.Source      = NULL;
+  Job.Length      = Length;
+  ParallelMemoryDispatch (&Job);
+}
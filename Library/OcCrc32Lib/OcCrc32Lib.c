@@ -0,0 +1,125 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/OcCrc32Lib.h>
+
+//
+// Reflected CRC-32 polynomial 0x04C11DB7.
+//
+#define OC_CRC32_POLYNOMIAL  0xEDB88320U
+
+//
+// Bytes consumed per slice-by-8 round.
+//
+#define OC_CRC32_SLICES      8
+
+STATIC UINT32   mCrc32Table[OC_CRC32_SLICES][256];
+STATIC BOOLEAN  mCrc32TableReady;
+
+/**
+  Build slice-by-8 lookup tables. Table 0 is the usual bytewise table,
+  table N advances the CRC of a byte followed by N zero bytes.
+
+  Generation always produces the same values, so being interrupted
+  by another caller building the tables is harmless.
+**/
+STATIC
+VOID
+Crc32InitTables (
+  VOID
+  )
+{
+  UINT32  Index;
+  UINT32  Slice;
+  UINT32  Bit;
+  UINT32  Crc;
+
+  for (Index = 0; Index < ARRAY_SIZE (mCrc32Table[0]); ++Index) {
+    Crc = Index;
+    for (Bit = 0; Bit < 8; ++Bit) {
+      Crc = (Crc >> 1U) ^ ((Crc & 1U) != 0 ? OC_CRC32_POLYNOMIAL : 0);
+    }
+
+    mCrc32Table[0][Index] = Crc;
+  }
+
+  for (Index = 0; Index < ARRAY_SIZE (mCrc32Table[0]); ++Index) {
+    Crc = mCrc32Table[0][Index];
+    for (Slice = 1; Slice < OC_CRC32_SLICES; ++Slice) {
+      Crc = (Crc >> 8U) ^ mCrc32Table[0][Crc & 0xFFU];
+      mCrc32Table[Slice][Index] = Crc;
+    }
+  }
+
+  mCrc32TableReady = TRUE;
+}
+
+UINT32
+OcCrc32 (
+  IN UINT32      Crc,
+  IN CONST VOID  *Buffer,
+  IN UINTN       BufferSize
+  )
+{
+  CONST UINT8  *Walker;
+  UINT32       Low;
+  UINT32       High;
+
+  if (!mCrc32TableReady) {
+    Crc32InitTables ();
+  }
+
+  Crc    = ~Crc;
+  Walker = Buffer;
+
+  //
+  // Align to UINT32 for the word reads below.
+  //
+  while (BufferSize > 0 && ((UINTN) Walker & (sizeof (UINT32) - 1)) != 0) {
+    Crc = (Crc >> 8U) ^ mCrc32Table[0][(Crc ^ *Walker) & 0xFFU];
+    ++Walker;
+    --BufferSize;
+  }
+
+  //
+  // Slice-by-8: eight independent table lookups per round instead of
+  // eight dependent ones. UEFI platforms are always little endian.
+  //
+  while (BufferSize >= OC_CRC32_SLICES) {
+    Low  = *(CONST UINT32 *) Walker ^ Crc;
+    High = *(CONST UINT32 *) (Walker + sizeof (UINT32));
+
+    Crc = mCrc32Table[7][Low & 0xFFU]
+      ^ mCrc32Table[6][(Low >> 8U) & 0xFFU]
+      ^ mCrc32Table[5][(Low >> 16U) & 0xFFU]
+      ^ mCrc32Table[4][Low >> 24U]
+      ^ mCrc32Table[3][High & 0xFFU]
+      ^ mCrc32Table[2][(High >> 8U) & 0xFFU]
+      ^ mCrc32Table[1][(High >> 16U) & 0xFFU]
+      ^ mCrc32Table[0][High >> 24U];
+
+    Walker     += OC_CRC32_SLICES;
+    BufferSize -= OC_CRC32_SLICES;
+  }
+
+  while (BufferSize > 0) {
+    Crc = (Crc >> 8U) ^ mCrc32Table[0][(Crc ^ *Walker) & 0xFFU];
+    ++Walker;
+    --BufferSize;
+  }
+
+  return ~Crc;
+}
@@ -139,6 +139,112 @@ GetLogPath (
   return LogPath;
 }
 
+/**
+  Append data to the log buffer at the write cursor.
+  The buffer is kept null-terminated, and entries not fitting are dropped.
+
+  @param[in,out] Buffer      Log buffer.
+  @param[in]     BufferSize Log buffer size including null terminator.
+  @param[in,out] BufferUsed Log buffer write cursor.
+  @param[in]     Data       Data to append.
+  @param[in]     DataSize   Data size without null terminator.
+
+  @retval EFI_SUCCESS           Data was appended.
+  @retval EFI_BUFFER_TOO_SMALL  No room left for the data.
+**/
+STATIC
+EFI_STATUS
+InternalLogAppend (
+  IN OUT CHAR8        *Buffer,
+  IN     UINTN        BufferSize,
+  IN OUT UINTN        *BufferUsed,
+  IN     CONST CHAR8  *Data,
+  IN     UINTN        DataSize
+  )
+{
+  if (*BufferUsed >= BufferSize || BufferSize - *BufferUsed <= DataSize) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (&Buffer[*BufferUsed], Data, DataSize);
+  *BufferUsed += DataSize;
+  Buffer[*BufferUsed] = '\0';
+  return EFI_SUCCESS;
+}
+
+/**
+  Write the log buffer to the log file if there is unsaved data.
+
+  @param[in,out] OcLog  Log protocol.
+  @param[in]     Force  Ignore size and time thresholds.
+
+  @retval EFI_SUCCESS          Unsaved data was written.
+  @retval EFI_ALREADY_STARTED  There is no unsaved data.
+  @retval EFI_NOT_READY        Writing is postponed or impossible at current TPL.
+**/
+STATIC
+EFI_STATUS
+InternalLogFlushFile (
+  IN OUT OC_LOG_PROTOCOL  *OcLog,
+  IN     BOOLEAN          Force
+  )
+{
+  OC_LOG_PRIVATE_DATA  *Private;
+  UINT64               CurrentTsc;
+  UINT64               ElapsedMs;
+
+  Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog);
+
+  if ((OcLog->Options & OC_LOG_FILE) == 0 || OcLog->FileSystem == NULL
+    || Private->AsciiBufferFlushed == Private->AsciiBufferUsed) {
+    return EFI_ALREADY_STARTED;
+  }
+
+  //
+  // File I/O is only possible below TPL_NOTIFY.
+  //
+  if (EfiGetCurrentTpl () > TPL_CALLBACK) {
+    return EFI_NOT_READY;
+  }
+
+  CurrentTsc = AsmReadTsc ();
+
+  if (!Force && Private->AsciiBufferUsed - Private->AsciiBufferFlushed < OC_LOG_FILE_FLUSH_SIZE) {
+    //
+    // Without TSC frequency we cannot measure time, so rely on size only.
+    //
+    if (Private->TscFrequency == 0) {
+      return EFI_NOT_READY;
+    }
+
+    ElapsedMs = DivU64x64Remainder (
+      MultU64x32 (CurrentTsc - Private->FlushTsc, 1000),
+      Private->TscFrequency,
+      NULL
+      );
+    if (ElapsedMs < OC_LOG_FILE_FLUSH_TIME_MS) {
+      return EFI_NOT_READY;
+    }
+  }
+
+  //
+  // Always overwriting file completely is most reliable.
+  // I know it is slow, but fixed size write is more reliable with broken FAT32 driver.
+  // To keep it affordable writes are batched, and flushes are forced on errors
+  // and before handing control to the operating system.
+  //
+  SetFileData (
+    OcLog->FileSystem,
+    OcLog->FilePath,
+    Private->AsciiBuffer,
+    (UINT32) Private->AsciiBufferSize
+    );
+
+  Private->AsciiBufferFlushed = Private->AsciiBufferUsed;
+  Private->FlushTsc           = CurrentTsc;
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 EFIAPI
 OcLogAddEntry  (
@@ -277,26 +383,33 @@ OcLogAddEntry  (
     // Write to internal buffer.
     //
 
-    Status = AsciiStrCatS (Private->AsciiBuffer, Private->AsciiBufferSize, Private->TimingTxt);
-    if (!EFI_ERROR (Status)) {
-      Status = AsciiStrCatS (Private->AsciiBuffer, Private->AsciiBufferSize, Private->LineBuffer);
+    if (Private->AsciiBufferUsed < Private->AsciiBufferSize
+      && Private->AsciiBufferSize - Private->AsciiBufferUsed > TimingLength + LineLength) {
+      InternalLogAppend (
+        Private->AsciiBuffer,
+        Private->AsciiBufferSize,
+        &Private->AsciiBufferUsed,
+        Private->TimingTxt,
+        TimingLength
+        );
+      Status = InternalLogAppend (
+        Private->AsciiBuffer,
+        Private->AsciiBufferSize,
+        &Private->AsciiBufferUsed,
+        Private->LineBuffer,
+        LineLength
+        );
+    } else {
+      Status = EFI_BUFFER_TOO_SMALL;
     }
 
     //
     // Write to a file.
-    // Always overwriting file completely is most reliable.
-    // I know it is slow, but fixed size write is more reliable with broken FAT32 driver.
     //
-    if ((OcLog->Options & OC_LOG_FILE) != 0 && OcLog->FileSystem != NULL) {
-      if (EfiGetCurrentTpl () <= TPL_CALLBACK) {
-        SetFileData (
-          OcLog->FileSystem,
-          OcLog->FilePath,
-          Private->AsciiBuffer,
-          (UINT32) Private->AsciiBufferSize
-          );
-      }
-    }
+    InternalLogFlushFile (
+      OcLog,
+      (ErrorLevel & (DEBUG_ERROR | OcLog->HaltLevel)) != 0
+      );
 
     //
     // Write to a variable.
@@ -306,11 +419,13 @@ OcLogAddEntry  (
       // Do not log timing information to NVRAM, it is already large.
       // This check is here, because Microsoft is retarded and asserts.
       //
-      if (Private->NvramBufferSize - AsciiStrSize (Private->NvramBuffer) >= AsciiStrLen (Private->LineBuffer)) {
-        Status = AsciiStrCatS (Private->NvramBuffer, Private->NvramBufferSize, Private->LineBuffer);
-      } else {
-        Status = EFI_BUFFER_TOO_SMALL;
-      }
+      Status = InternalLogAppend (
+        Private->NvramBuffer,
+        Private->NvramBufferSize,
+        &Private->NvramBufferUsed,
+        Private->LineBuffer,
+        LineLength
+        );
       if (!EFI_ERROR (Status)) {
         Attributes = EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_RUNTIME_ACCESS;
         if ((OcLog->Options & OC_LOG_NONVOLATILE) != 0) {
@@ -321,7 +436,7 @@ OcLogAddEntry  (
           OC_LOG_VARIABLE_NAME,
           &gOcVendorVariableGuid,
           Attributes,
-          AsciiStrLen (Private->NvramBuffer),
+          Private->NvramBufferUsed,
           Private->NvramBuffer
           );
 
@@ -346,6 +461,7 @@ OcLogAddEntry  (
   if ((ErrorLevel & OcLog->HaltLevel) != 0
     && AsciiStrnCmp (FormatString, "\nASSERT_RETURN_ERROR", L_STR_LEN ("\nASSERT_RETURN_ERROR")) != 0
     && AsciiStrnCmp (FormatString, "\nASSERT_EFI_ERROR", L_STR_LEN ("\nASSERT_EFI_ERROR")) != 0) {
+    InternalLogFlushFile (OcLog, TRUE);
     gST->ConOut->OutputString (gST->ConOut, L"Halting on critical error\r\n");
     gBS->Stall (SECONDS_TO_MICROSECONDS (1));
     CpuDeadLoop ();
@@ -385,7 +501,18 @@ OcLogSaveLog (
   IN EFI_DEVICE_PATH_PROTOCOL  *FilePath OPTIONAL
   )
 {
-  return EFI_NOT_FOUND;
+  //
+  // Only saving to the configured log file is supported.
+  //
+  if (NonVolatile != 0 || FilePath != NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if ((This->Options & OC_LOG_FILE) == 0 || This->FileSystem == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  return InternalLogFlushFile (This, TRUE);
 }
 
 EFI_STATUS
@@ -536,13 +663,16 @@ OcConfigureLogProtocol (
 
   if (LogRoot != NULL) {
     if (!EFI_ERROR (Status)) {
-      if (OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog)->AsciiBufferSize > 0) {
+      Private = OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog);
+      if (Private->AsciiBufferSize > 0) {
         SetFileData (
           LogRoot,
           LogPath,
-          OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog)->AsciiBuffer,
-          (UINT32) OC_LOG_PRIVATE_DATA_FROM_OC_LOG_THIS (OcLog)->AsciiBufferSize
+          Private->AsciiBuffer,
+          (UINT32) Private->AsciiBufferSize
           );
+        Private->AsciiBufferFlushed = Private->AsciiBufferUsed;
+        Private->FlushTsc           = AsmReadTsc ();
       }
     } else {
       LogRoot->Close (LogRoot);
@@ -552,3 +682,18 @@ OcConfigureLogProtocol (
 
   return Status;
 }
+
+EFI_STATUS
+OcFlushLogProtocol (
+  VOID
+  )
+{
+  OC_LOG_PROTOCOL  *OcLog;
+
+  OcLog = InternalGetOcLog ();
+  if (OcLog == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  return OcLog->SaveLog (OcLog, 0, NULL);
+}
@@ -0,0 +1,344 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+#include <Protocol/OcLog.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/OcCpuLib.h>
+#include <Library/OcDebugLogLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/OcStringLib.h>
+#include <Library/PrintLib.h>
+
+#include "OcLogInternal.h"
+
+#define OC_PROFILE_MAX_PHASES  64
+#define OC_PROFILE_MAX_DEPTH   16
+#define OC_PROFILE_NAME_WIDTH  40
+#define OC_PROFILE_REPORT_SIZE (OC_PROFILE_MAX_PHASES * 128 + 512)
+
+typedef struct {
+  CONST CHAR8  *Name;
+  UINT32       Parent;
+  UINT32       Depth;
+  UINT32       Calls;
+  BOOLEAN      Active;
+  UINT64       StartTsc;
+  UINT64       TotalTicks;
+  UINT64       ChildTicks;
+} OC_PROFILE_PHASE;
+
+STATIC OC_PROFILE_PHASE  mProfilePhases[OC_PROFILE_MAX_PHASES];
+STATIC UINT32            mProfilePhaseCount;
+STATIC UINT32            mProfileStack[OC_PROFILE_MAX_DEPTH];
+STATIC UINT32            mProfileStackDepth;
+STATIC UINT64            mProfileStartTsc;
+STATIC CHAR8             mProfileReport[OC_PROFILE_REPORT_SIZE];
+STATIC UINTN             mProfileReportSize;
+STATIC CHAR16            mProfilePath[OC_LOG_FILE_PATH_BUFFER_SIZE];
+
+UINT32
+OcProfileBegin (
+  IN CONST CHAR8  *Name
+  )
+{
+  OC_PROFILE_PHASE  *Phase;
+  UINT32            Parent;
+  UINT32            Index;
+
+  if (mProfileStackDepth == OC_PROFILE_MAX_DEPTH) {
+    return OC_PROFILE_NO_PHASE;
+  }
+
+  Parent = mProfileStackDepth > 0 ? mProfileStack[mProfileStackDepth - 1] : OC_PROFILE_NO_PHASE;
+
+  //
+  // Repeated phases accumulate into the same record.
+  //
+  for (Index = 0; Index < mProfilePhaseCount; ++Index) {
+    if (mProfilePhases[Index].Parent == Parent
+      && !mProfilePhases[Index].Active
+      && AsciiStrCmp (mProfilePhases[Index].Name, Name) == 0) {
+      break;
+    }
+  }
+
+  if (Index == mProfilePhaseCount) {
+    if (mProfilePhaseCount == OC_PROFILE_MAX_PHASES) {
+      return OC_PROFILE_NO_PHASE;
+    }
+
+    ++mProfilePhaseCount;
+    Phase         = &mProfilePhases[Index];
+    Phase->Name   = Name;
+    Phase->Parent = Parent;
+    Phase->Depth  = mProfileStackDepth;
+  }
+
+  Phase         = &mProfilePhases[Index];
+  Phase->Active = TRUE;
+  mProfileStack[mProfileStackDepth++] = Index;
+
+  Phase->StartTsc = AsmReadTsc ();
+  if (mProfileStartTsc == 0) {
+    mProfileStartTsc = Phase->StartTsc;
+  }
+
+  return Index;
+}
+
+VOID
+OcProfileEnd (
+  IN UINT32  Scope
+  )
+{
+  OC_PROFILE_PHASE  *Phase;
+  UINT64            EndTsc;
+  UINT64            Duration;
+  UINT32            Index;
+
+  EndTsc = AsmReadTsc ();
+
+  if (Scope >= mProfilePhaseCount || !mProfilePhases[Scope].Active) {
+    return;
+  }
+
+  //
+  // Close any nested phases left open, e.g. on early returns.
+  //
+  do {
+    Index    = mProfileStack[--mProfileStackDepth];
+    Phase    = &mProfilePhases[Index];
+    Duration = EndTsc - Phase->StartTsc;
+
+    Phase->Active      = FALSE;
+    Phase->TotalTicks += Duration;
+    ++Phase->Calls;
+
+    if (Phase->Parent != OC_PROFILE_NO_PHASE) {
+      mProfilePhases[Phase->Parent].ChildTicks += Duration;
+    }
+  } while (Index != Scope);
+}
+
+/**
+  Convert TSC ticks to microseconds.
+**/
+STATIC
+UINT64
+ProfileTicksToUs (
+  IN UINT64  Ticks,
+  IN UINT64  Frequency
+  )
+{
+  if (Frequency == 0) {
+    return 0;
+  }
+
+  return DivU64x64Remainder (MultU64x32 (Ticks, 1000000), Frequency, NULL);
+}
+
+/**
+  Append a formatted line to the profile report.
+**/
+STATIC
+VOID
+EFIAPI
+ProfileReportLine (
+  IN CONST CHAR8  *Format,
+  ...
+  )
+{
+  VA_LIST  Marker;
+
+  if (mProfileReportSize >= sizeof (mProfileReport) - 1) {
+    return;
+  }
+
+  VA_START (Marker, Format);
+  mProfileReportSize += AsciiVSPrint (
+    &mProfileReport[mProfileReportSize],
+    sizeof (mProfileReport) - mProfileReportSize,
+    Format,
+    Marker
+    );
+  VA_END (Marker);
+}
+
+/**
+  Append phases with the specified parent and their children to the report.
+**/
+STATIC
+VOID
+ProfileReportPhases (
+  IN UINT32  Parent,
+  IN UINT64  CurrentTsc,
+  IN UINT64  Frequency,
+  IN UINT64  ElapsedTicks
+  )
+{
+  OC_PROFILE_PHASE  *Phase;
+  UINT32            Index;
+  UINT64            Total;
+  UINT64            Self;
+  UINT64            TotalUs;
+  UINT64            SelfUs;
+  CHAR8             Name[OC_PROFILE_NAME_WIDTH + 1];
+  UINTN             Indent;
+
+  for (Index = 0; Index < mProfilePhaseCount; ++Index) {
+    Phase = &mProfilePhases[Index];
+    if (Phase->Parent != Parent) {
+      continue;
+    }
+
+    //
+    // Account running phases up to now.
+    //
+    Total = Phase->TotalTicks;
+    if (Phase->Active) {
+      Total += CurrentTsc - Phase->StartTsc;
+    }
+
+    Self    = Total > Phase->ChildTicks ? Total - Phase->ChildTicks : 0;
+    TotalUs = ProfileTicksToUs (Total, Frequency);
+    SelfUs  = ProfileTicksToUs (Self, Frequency);
+
+    Indent = MIN (Phase->Depth * 2, OC_PROFILE_NAME_WIDTH);
+    SetMem (Name, Indent, ' ');
+    AsciiStrnCpyS (&Name[Indent], sizeof (Name) - Indent, Phase->Name, sizeof (Name) - Indent - 1);
+
+    ProfileReportLine (
+      "%-40a %5u %7Lu.%03Lu %7Lu.%03Lu %3Lu%%%a\n",
+      Name,
+      Phase->Calls,
+      DivU64x32 (TotalUs, 1000),
+      ModU64x32 (TotalUs, 1000),
+      DivU64x32 (SelfUs, 1000),
+      ModU64x32 (SelfUs, 1000),
+      ElapsedTicks != 0 ? DivU64x64Remainder (MultU64x32 (Total, 100), ElapsedTicks, NULL) : 0,
+      Phase->Active ? " (running)" : ""
+      );
+
+    ProfileReportPhases (Index, CurrentTsc, Frequency, ElapsedTicks);
+  }
+}
+
+/**
+  Get profile report path next to the log file.
+
+  @param[in]  LogPath  Log file path.
+
+  @retval Profile report path or NULL.
+**/
+STATIC
+CONST CHAR16 *
+ProfileGetPath (
+  IN CONST CHAR16  *LogPath
+  )
+{
+  UINTN  Length;
+
+  Length = StrLen (LogPath);
+  if (Length > L_STR_LEN (L".txt")
+    && StrCmp (&LogPath[Length - L_STR_LEN (L".txt")], L".txt") == 0) {
+    Length -= L_STR_LEN (L".txt");
+  }
+
+  if (Length + L_STR_SIZE (L"-profile.txt") / sizeof (CHAR16) > ARRAY_SIZE (mProfilePath)) {
+    return NULL;
+  }
+
+  CopyMem (mProfilePath, LogPath, Length * sizeof (CHAR16));
+  CopyMem (&mProfilePath[Length], L"-profile.txt", L_STR_SIZE (L"-profile.txt"));
+  return mProfilePath;
+}
+
+EFI_STATUS
+OcProfileReport (
+  VOID
+  )
+{
+  OC_LOG_PROTOCOL  *OcLog;
+  CONST CHAR16     *Path;
+  UINT64           Frequency;
+  UINT64           CurrentTsc;
+  UINT64           ElapsedTicks;
+  UINT64           ElapsedUs;
+  CHAR8            *Line;
+  CHAR8            *LineEnd;
+
+  if (mProfilePhaseCount == 0) {
+    return EFI_NOT_STARTED;
+  }
+
+  CurrentTsc   = AsmReadTsc ();
+  Frequency    = OcGetTSCFrequency ();
+  ElapsedTicks = CurrentTsc - mProfileStartTsc;
+  ElapsedUs    = ProfileTicksToUs (ElapsedTicks, Frequency);
+
+  mProfileReportSize = 0;
+  ProfileReportLine (
+    "OpenCore boot phase profile, %Lu.%03Lu ms elapsed, TSC %Lu Hz\n\n",
+    DivU64x32 (ElapsedUs, 1000),
+    ModU64x32 (ElapsedUs, 1000),
+    Frequency
+    );
+  ProfileReportLine (
+    "%-40a %5a %11a %11a %4a\n",
+    "Phase",
+    "Calls",
+    "Total ms",
+    "Self ms",
+    "Share"
+    );
+  ProfileReportPhases (OC_PROFILE_NO_PHASE, CurrentTsc, Frequency, ElapsedTicks);
+
+  //
+  // Mirror the report into the log line by line.
+  //
+  Line = mProfileReport;
+  while (*Line != '\0') {
+    LineEnd = Line;
+    while (*LineEnd != '\0' && *LineEnd != '\n') {
+      ++LineEnd;
+    }
+
+    if (LineEnd != Line) {
+      DEBUG ((DEBUG_INFO, "OCPF: %.*a\n", (UINTN) (LineEnd - Line), Line));
+    }
+
+    Line = *LineEnd == '\n' ? LineEnd + 1 : LineEnd;
+  }
+
+  OcLog = InternalGetOcLog ();
+  if (OcLog == NULL || (OcLog->Options & OC_LOG_FILE) == 0
+    || OcLog->FileSystem == NULL || OcLog->FilePath == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Path = ProfileGetPath (OcLog->FilePath);
+  if (Path == NULL) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  return SetFileData (
+    OcLog->FileSystem,
+    Path,
+    mProfileReport,
+    (UINT32) mProfileReportSize
+    );
+}
@@ -825,6 +825,7 @@ OcMiscBoot (
   UINT32                 Index;
   UINT32                 EntryIndex;
   OC_INTERFACE_PROTOCOL  *Interface;
+  UINT32                 Phase;
   UINTN                  BlessOverrideSize;
   CHAR16                 **BlessOverride;
   CONST CHAR8            *AsciiPicker;
@@ -1021,6 +1022,7 @@ OcMiscBoot (
   Context->AllCustomEntryCount = EntryIndex;
   Context->PollAppleHotKeys    = Config->Misc.Boot.PollAppleHotKeys;
   Context->HideAuxiliary       = Config->Misc.Boot.HideAuxiliary;
+  Context->ScanCache           = Config->Misc.Boot.ScanCache;
   Context->PickerAudioAssist   = Config->Misc.Boot.PickerAudioAssist;
 
   DEBUG ((DEBUG_INFO, "OC: Ready for takeoff in %u us\n", (UINT32) Context->TakeoffDelay));
@@ -1034,7 +1036,9 @@ OcMiscBoot (
   }
 
   if (Interface != NULL) {
+    Phase  = OcProfileBegin ("PickerInterface");
     Status = Interface->PopulateContext (Interface, Storage, Context);
+    OcProfileEnd (Phase);
     if (EFI_ERROR (Status)) {
       DEBUG ((DEBUG_WARN, "OC: External interface failure, fallback to builtin - %r\n", Status));
     }
@@ -526,6 +526,7 @@ OcLoadBooterUefiSupport (
   ZeroMem (&AbcSettings, sizeof (AbcSettings));
 
   AbcSettings.AvoidRuntimeDefrag     = Config->Booter.Quirks.AvoidRuntimeDefrag;
+  AbcSettings.CachePoolAllocations   = Config->Booter.Quirks.CachePoolAllocations;
   AbcSettings.DevirtualiseMmio       = Config->Booter.Quirks.DevirtualiseMmio;
   AbcSettings.DisableSingleUser      = Config->Booter.Quirks.DisableSingleUser;
   AbcSettings.DisableVariableWrite   = Config->Booter.Quirks.DisableVariableWrite;
@@ -545,6 +546,7 @@ OcLoadBooterUefiSupport (
   AbcSettings.SetupVirtualMap        = Config->Booter.Quirks.SetupVirtualMap;
   AbcSettings.SignalAppleOS          = Config->Booter.Quirks.SignalAppleOS;
   AbcSettings.SyncRuntimePermissions = Config->Booter.Quirks.SyncRuntimePermissions;
+  AbcSettings.TraceBootServices      = Config->Booter.Quirks.TraceBootServices;
 
   //
   // Handle MmioWhitelist patches.
@@ -748,6 +750,10 @@ OcLoadUefiSupport (
     OcCpuCorrectTscSync (CpuInfo, Config->Uefi.Quirks.TscSyncTimeout);
   }
 
+  if (Config->Uefi.Quirks.ParallelMemoryCopy) {
+    OcParallelMemoryInit ();
+  }
+
   DEBUG ((
     DEBUG_INFO,
     "OC: RequestBootVarRouting %d\n",
@@ -805,6 +811,10 @@ OcLoadUefiSupport (
       Config->Uefi.Apfs.HideVerbose
       );
 
+    if (Config->Uefi.Apfs.JumpstartCache) {
+      OcApfsConfigureCache (Storage);
+    }
+
     OcApfsConnectDevices (
       Config->Uefi.Apfs.JumpstartHotPlug
       );
@@ -57,15 +57,45 @@ OcRealMemoryType (
   return MemoryAttribte->Type;
 }
 
+/**
+  Check whether memory map descriptor needs to be split by attribute.
+
+  @param[in]  MemoryMapEntry   Memory map descriptor, RTCode or RTData.
+  @param[in]  MemoryAttribute  Memory attribute to check.
+
+  @retval TRUE when the attribute is within the descriptor and changes its type.
+**/
+STATIC
+BOOLEAN
+OcShouldSplitByAttribute (
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry,
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryAttribute
+  )
+{
+  //
+  // No need to process the attribute of the same type.
+  //
+  return (MemoryAttribute->Type == EfiRuntimeServicesCode
+      || MemoryAttribute->Type == EfiRuntimeServicesData)
+    && MemoryAttribute->NumberOfPages > 0
+    && AREA_WITHIN_DESCRIPTOR (
+      MemoryMapEntry,
+      MemoryAttribute->PhysicalStart,
+      EFI_PAGES_TO_SIZE (MemoryAttribute->NumberOfPages))
+    && OcRealMemoryType (MemoryAttribute) != MemoryMapEntry->Type;
+}
+
 /**
   Split memory map descriptor by attribute.
 
+  When MemoryMapLimit is NULL no descriptors are inserted, and the descriptor
+  is updated in place to describe the remainder, which would be processed next.
+
   @param[in,out] RetMemoryMapEntry    Pointer to descriptor in the memory map, updated to next proccessed.
-  @param[in,out] CurrentEntryIndex    Current index of the descriptor in the memory map, updated on increase.
-  @param[in,out] CurrentEntryCount    Number of descriptors in the memory map, updated on increase.
-  @param[in]     TotalEntryCount      Max number of descriptors in the memory map.
+  @param[in]     MemoryMapLimit       First descriptor in the memory map, which cannot be overwritten, optional.
   @param[in]     MemoryAttribute      Memory attribute used for splitting.
   @param[in]     DescriptorSize       Memory map descriptor size.
+  @param[in,out] SplitCount           Number of inserted descriptors, incremented.
 
   @retval EFI_SUCCESS on success.
   @retval EFI_OUT_OF_RESOURCES when there are not enough free descriptor slots.
@@ -74,12 +104,10 @@ STATIC
 EFI_STATUS
 OcSplitMemoryEntryByAttribute (
   IN OUT EFI_MEMORY_DESCRIPTOR  **RetMemoryMapEntry,
-  IN OUT UINTN                  *CurrentEntryIndex,
-  IN OUT UINTN                  *CurrentEntryCount,
-  IN     UINTN                  TotalEntryCount,
+  IN     EFI_MEMORY_DESCRIPTOR  *MemoryMapLimit  OPTIONAL,
   IN     EFI_MEMORY_DESCRIPTOR  *MemoryAttribute,
-  IN     UINTN                  DescriptorSize
-
+  IN     UINTN                  DescriptorSize,
+  IN OUT UINTN                  *SplitCount
   )
 {
   EFI_MEMORY_DESCRIPTOR  *MemoryMapEntry;
@@ -94,28 +122,27 @@ OcSplitMemoryEntryByAttribute (
   // [DESC1] -> [DESC1][DESC2]
   //
   if (MemoryAttribute->PhysicalStart > MemoryMapEntry->PhysicalStart) {
-    if (*CurrentEntryCount == TotalEntryCount) {
-      return EFI_OUT_OF_RESOURCES;
-    }
+    DiffPages = (UINTN) EFI_SIZE_TO_PAGES (MemoryAttribute->PhysicalStart - MemoryMapEntry->PhysicalStart);
 
-    NewMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
-    DiffPages         = (UINTN) EFI_SIZE_TO_PAGES (MemoryAttribute->PhysicalStart - MemoryMapEntry->PhysicalStart);
-    CopyMem (
-      NewMemoryMapEntry,
-      MemoryMapEntry,
-      DescriptorSize * (*CurrentEntryCount - *CurrentEntryIndex)
-      );
-    MemoryMapEntry->NumberOfPages     = DiffPages;
-    NewMemoryMapEntry->PhysicalStart  = MemoryAttribute->PhysicalStart;
-    NewMemoryMapEntry->NumberOfPages -= DiffPages;
+    if (MemoryMapLimit != NULL) {
+      NewMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+      if (NewMemoryMapEntry >= MemoryMapLimit) {
+        return EFI_OUT_OF_RESOURCES;
+      }
 
-    MemoryMapEntry = NewMemoryMapEntry;
+      CopyMem (NewMemoryMapEntry, MemoryMapEntry, DescriptorSize);
+      MemoryMapEntry->NumberOfPages = DiffPages;
 
-    //
-    // Current processed entry is now the one we inserted.
-    //
-    ++(*CurrentEntryIndex);
-    ++(*CurrentEntryCount);
+      //
+      // Current processed entry is now the one we inserted.
+      //
+      MemoryMapEntry     = NewMemoryMapEntry;
+      *RetMemoryMapEntry = MemoryMapEntry;
+    }
+
+    MemoryMapEntry->PhysicalStart  = MemoryAttribute->PhysicalStart;
+    MemoryMapEntry->NumberOfPages -= DiffPages;
+    ++(*SplitCount);
   }
 
   ASSERT (MemoryAttribute->PhysicalStart == MemoryMapEntry->PhysicalStart);
@@ -127,7 +154,6 @@ OcSplitMemoryEntryByAttribute (
   //
   if (MemoryMapEntry->NumberOfPages == MemoryAttribute->NumberOfPages) {
     MemoryMapEntry->Type = OcRealMemoryType (MemoryAttribute);
-    *RetMemoryMapEntry = MemoryMapEntry;
     return EFI_SUCCESS;
   }
 
@@ -136,113 +162,134 @@ OcSplitMemoryEntryByAttribute (
   // Shorten current descriptor, update its type, and inseret the new one after it.
   // [DESC1] -> [DESC1*][DESC2]
   //
-  if (*CurrentEntryCount == TotalEntryCount) {
-    return EFI_OUT_OF_RESOURCES;
-  }
+  if (MemoryMapLimit != NULL) {
+    NewMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+    if (NewMemoryMapEntry >= MemoryMapLimit) {
+      return EFI_OUT_OF_RESOURCES;
+    }
 
-  NewMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
-  CopyMem (
-    NewMemoryMapEntry,
-    MemoryMapEntry,
-    DescriptorSize * (*CurrentEntryCount - *CurrentEntryIndex)
-    );
-  MemoryMapEntry->Type              = OcRealMemoryType (MemoryAttribute);
-  MemoryMapEntry->NumberOfPages     = MemoryAttribute->NumberOfPages;
-  NewMemoryMapEntry->PhysicalStart += EFI_PAGES_TO_SIZE (MemoryAttribute->NumberOfPages);
-  NewMemoryMapEntry->NumberOfPages -= MemoryAttribute->NumberOfPages;
+    CopyMem (NewMemoryMapEntry, MemoryMapEntry, DescriptorSize);
+    MemoryMapEntry->Type          = OcRealMemoryType (MemoryAttribute);
+    MemoryMapEntry->NumberOfPages = MemoryAttribute->NumberOfPages;
 
-  //
-  // Current processed entry is now the one we need to process.
-  //
-  ++(*CurrentEntryIndex);
-  ++(*CurrentEntryCount);
+    //
+    // Current processed entry is now the one we need to process.
+    //
+    MemoryMapEntry     = NewMemoryMapEntry;
+    *RetMemoryMapEntry = MemoryMapEntry;
+  }
 
-  *RetMemoryMapEntry = NewMemoryMapEntry;
+  MemoryMapEntry->PhysicalStart += EFI_PAGES_TO_SIZE (MemoryAttribute->NumberOfPages);
+  MemoryMapEntry->NumberOfPages -= MemoryAttribute->NumberOfPages;
+  ++(*SplitCount);
 
   return EFI_SUCCESS;
 }
 
+/**
+  Split runtime memory map descriptor by all attributes within it.
+  Memory map and attributes table must be sorted.
+
+  @param[in,out] RetMemoryMapEntry         Pointer to descriptor in the memory map, updated to last proccessed.
+  @param[in]     MemoryMapLimit            First descriptor in the memory map, which cannot be overwritten, optional.
+  @param[in]     MemoryAttributesTable     Memory attributes table.
+  @param[in,out] AttributeIndex            Index of the first unprocessed attribute, updated.
+  @param[in,out] RetMemoryAttributesEntry  First unprocessed attribute, updated.
+  @param[in]     DescriptorSize            Memory map descriptor size.
+  @param[in,out] SplitCount                Number of inserted descriptors, incremented.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_OUT_OF_RESOURCES when there are not enough free descriptor slots.
+**/
 STATIC
 EFI_STATUS
-OcExpandAttributeWrite (
-  IN OUT EFI_MEMORY_ATTRIBUTES_TABLE  *MemoryAttributesTable,
-  IN OUT EFI_MEMORY_DESCRIPTOR        *MemoryAttributesEntry OPTIONAL,
-  IN     UINTN                        MaxDescriptors,
-  IN     EFI_MEMORY_DESCRIPTOR        *MemoryMapEntry,
-  IN     EFI_PHYSICAL_ADDRESS         CurrentMapAddress
+OcSplitMemoryEntryByAttributes (
+  IN OUT EFI_MEMORY_DESCRIPTOR              **RetMemoryMapEntry,
+  IN     EFI_MEMORY_DESCRIPTOR              *MemoryMapLimit  OPTIONAL,
+  IN     CONST EFI_MEMORY_ATTRIBUTES_TABLE  *MemoryAttributesTable,
+  IN OUT UINTN                              *AttributeIndex,
+  IN OUT EFI_MEMORY_DESCRIPTOR              **RetMemoryAttributesEntry,
+  IN     UINTN                              DescriptorSize,
+  IN OUT UINTN                              *SplitCount
   )
 {
-  EFI_PHYSICAL_ADDRESS    NextMatAddress;
+  EFI_STATUS             Status;
+  EFI_MEMORY_DESCRIPTOR  *MemoryAttributesEntry;
 
-  //
-  // Simply abort on failing to write any new entry.
-  //
-  if (MemoryAttributesTable->NumberOfEntries >= MaxDescriptors) {
-    return EFI_OUT_OF_RESOURCES;
+  if ((*RetMemoryMapEntry)->Type != EfiRuntimeServicesCode
+    && (*RetMemoryMapEntry)->Type != EfiRuntimeServicesData) {
+    return EFI_SUCCESS;
   }
 
-  if (MemoryAttributesEntry != NULL) {
-    //
-    // Insert to the middle of MAT table at current MAT entry position.
-    // Assert that this MAT entry follows this map entry.
-    //
-    ASSERT (MemoryAttributesEntry->PhysicalStart > CurrentMapAddress);
+  //
+  // Split entry by as many attributes as possible.
+  // UEFI spec says attribute entries are fully within memory map entries,
+  // so attributes before this entry are skipped for good.
+  //
+  Status                = EFI_SUCCESS;
+  MemoryAttributesEntry = *RetMemoryAttributesEntry;
+  while (*AttributeIndex < MemoryAttributesTable->NumberOfEntries
+    && MemoryAttributesEntry->PhysicalStart <= LAST_DESCRIPTOR_ADDR (*RetMemoryMapEntry)) {
+    if (OcShouldSplitByAttribute (*RetMemoryMapEntry, MemoryAttributesEntry)) {
+      Status = OcSplitMemoryEntryByAttribute (
+        RetMemoryMapEntry,
+        MemoryMapLimit,
+        MemoryAttributesEntry,
+        DescriptorSize,
+        SplitCount
+        );
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+    }
 
-    //
-    // Create a free MAT entry inbetween.
-    //
-    CopyMem (
-      NEXT_MEMORY_DESCRIPTOR (MemoryAttributesEntry, MemoryAttributesTable->DescriptorSize),
+    ++(*AttributeIndex);
+    MemoryAttributesEntry = NEXT_MEMORY_DESCRIPTOR (
       MemoryAttributesEntry,
-      MemoryAttributesTable->NumberOfEntries * MemoryAttributesTable->DescriptorSize
-        - ((UINTN) MemoryAttributesEntry - (UINTN) MemoryAttributesTable - sizeof (*MemoryAttributesTable))
+      MemoryAttributesTable->DescriptorSize
       );
-
-    //
-    // Calculate the location of the next MAT entry to get the size of this one.
-    // This MAT entry will either:
-    // - fill the whole gap right away, by reaching the next MAT entry.
-    //   MA: [   GAP   ][ MAT ]
-    //   MM: [   MAP   ]
-    // - fill part of the gap up to MAP entry end.
-    //   MA: [   GAP      ][ MAT ]
-    //   MM: [   MAP  ][ OTHER MAP ]
-    //
-    NextMatAddress = LAST_DESCRIPTOR_ADDR (MemoryMapEntry) + 1;
-    if (MemoryAttributesEntry->PhysicalStart < NextMatAddress) {
-      NextMatAddress = MemoryAttributesEntry->PhysicalStart;
-    }
-  } else {
-    //
-    // Append to the end of MAT table.
-    //
-    MemoryAttributesEntry = (VOID *) ((UINTN) MemoryAttributesTable + sizeof (*MemoryAttributesTable)
-      + MemoryAttributesTable->NumberOfEntries * MemoryAttributesTable->DescriptorSize);
-    NextMatAddress = LAST_DESCRIPTOR_ADDR (MemoryMapEntry) + 1;
   }
 
-  //
-  // Write the new attribute.
-  //
+  *RetMemoryAttributesEntry = MemoryAttributesEntry;
+  return Status;
+}
+
+/**
+  Write memory attribute describing part of runtime memory map entry.
+
+  @param[out]  MemoryAttributesEntry   Memory attributes descriptor to write.
+  @param[in]   MemoryMapEntry          Memory map descriptor to describe.
+  @param[in]   StartAddress            First address of the new attribute.
+  @param[in]   EndAddress              Address following the new attribute.
+**/
+STATIC
+VOID
+OcExpandAttributeWrite (
+  OUT EFI_MEMORY_DESCRIPTOR        *MemoryAttributesEntry,
+  IN  EFI_MEMORY_DESCRIPTOR        *MemoryMapEntry,
+  IN  EFI_PHYSICAL_ADDRESS         StartAddress,
+  IN  EFI_PHYSICAL_ADDRESS         EndAddress
+  )
+{
   MemoryAttributesEntry->Type          = OcRealMemoryType (MemoryMapEntry);
-  MemoryAttributesEntry->PhysicalStart = CurrentMapAddress;
+  MemoryAttributesEntry->PhysicalStart = StartAddress;
   MemoryAttributesEntry->VirtualStart  = 0;
-  MemoryAttributesEntry->NumberOfPages = EFI_SIZE_TO_PAGES (NextMatAddress - CurrentMapAddress);
+  MemoryAttributesEntry->NumberOfPages = EFI_SIZE_TO_PAGES (EndAddress - StartAddress);
   MemoryAttributesEntry->Attribute     = EFI_MEMORY_RUNTIME;
   if (MemoryAttributesEntry->Type == EfiRuntimeServicesCode) {
     MemoryAttributesEntry->Attribute |= EFI_MEMORY_RO;
   } else {
     MemoryAttributesEntry->Attribute |= EFI_MEMORY_XP;
   }
-
-  ++MemoryAttributesTable->NumberOfEntries;
-
-  return EFI_SUCCESS;
 }
 
 /**
   Expand attributes table by adding memory map runtime entries into it.
-  Requires sorted memory map.
+  Requires sorted memory map and attributes table.
+
+  Both tables are merge-joined in a single pass. Existing attributes are
+  moved to the end of the table first, so that the result can be written
+  from the start without shifting the tail for every inserted entry.
 
   @param[in,out]  MemoryAttributesTable   Memory attributes table.
   @param[in,out]  MemoryAttributesEntry   Memory attributes descriptor.
@@ -253,6 +300,7 @@ OcExpandAttributeWrite (
 
   @retval EFI_SUCCESS on success.
   @retval EFI_NOT_FOUND nothing to do.
+  @retval EFI_OUT_OF_RESOURCES when there are not enough free descriptor slots.
 **/
 STATIC
 EFI_STATUS
@@ -267,13 +315,26 @@ OcExpandAttributesByMap (
 {
   EFI_STATUS             Status;
   UINTN                  MapIndex;
-  UINTN                  MatIndex;
+  UINTN                  MatDescriptorSize;
+  UINTN                  WriteCount;
+  EFI_MEMORY_DESCRIPTOR  *ReadEntry;
+  EFI_MEMORY_DESCRIPTOR  *WriteEntry;
+  EFI_MEMORY_DESCRIPTOR  *MatEnd;
   EFI_PHYSICAL_ADDRESS   NextMapAddress;
   EFI_PHYSICAL_ADDRESS   LastMatAddress;
   EFI_PHYSICAL_ADDRESS   CurrentMapAddress;
 
-  MatIndex = 0;
-  Status   = EFI_NOT_FOUND;
+  MatDescriptorSize = MemoryAttributesTable->DescriptorSize;
+  MatEnd     = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryAttributesEntry + MaxDescriptors * MatDescriptorSize);
+  ReadEntry  = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MatEnd
+    - MemoryAttributesTable->NumberOfEntries * MatDescriptorSize);
+  WriteEntry = MemoryAttributesEntry;
+  WriteCount = 0;
+  Status     = EFI_NOT_FOUND;
+
+  if (ReadEntry != WriteEntry) {
+    CopyMem (ReadEntry, WriteEntry, MemoryAttributesTable->NumberOfEntries * MatDescriptorSize);
+  }
 
   for (MapIndex = 0; MapIndex < MemoryMapDescriptors; ++MapIndex) {
     //
@@ -281,122 +342,92 @@ OcExpandAttributesByMap (
     //
     if (MemoryMap->Type != EfiRuntimeServicesCode
       && MemoryMap->Type != EfiRuntimeServicesData) {
-      goto NEXT_MEMORY_MAP_DESCRIPTOR;
+      MemoryMap = NEXT_MEMORY_DESCRIPTOR (MemoryMap, DescriptorSize);
+      continue;
     }
 
     NextMapAddress    = LAST_DESCRIPTOR_ADDR (MemoryMap) + 1;
     CurrentMapAddress = MemoryMap->PhysicalStart;
 
-    //
-    // Iterate MAT entries till we are over them or till
-    // we finish iterating this MAP entry memory.
-    //
-    while (MatIndex < MemoryAttributesTable->NumberOfEntries
-      && CurrentMapAddress < NextMapAddress) {
-      //
-      // Skip MAT entries, which are not RTCode or RTData.
-      //
-      if (MemoryAttributesEntry->Type != EfiRuntimeServicesCode
-        && MemoryAttributesEntry->Type != EfiRuntimeServicesData) {
-        goto NEXT_MEMORY_ATTRIBUTE_DESCRIPTOR;
-      }
-
-      //
-      // Skip MAT entries which end before this MAP entry. This should
-      // not happen normally, as each MAT entry is supposed to be within
-      // a single RTCode/RTData MAP entry according to UEFI spec, and
-      // our memory map is sorted.
-      //
-      LastMatAddress = LAST_DESCRIPTOR_ADDR (MemoryAttributesEntry);
-      if (LastMatAddress < MemoryMap->PhysicalStart) {
-        goto NEXT_MEMORY_ATTRIBUTE_DESCRIPTOR;
-      }
+    while (CurrentMapAddress < NextMapAddress) {
+      if (ReadEntry < MatEnd) {
+        //
+        // Keep MAT entries, which are not RTCode or RTData, or end before
+        // this MAP entry. The latter should not happen normally, as each MAT
+        // entry is supposed to be within a single RTCode/RTData MAP entry
+        // according to UEFI spec, and our memory map is sorted.
+        //
+        LastMatAddress = LAST_DESCRIPTOR_ADDR (ReadEntry);
+        if ((ReadEntry->Type != EfiRuntimeServicesCode
+            && ReadEntry->Type != EfiRuntimeServicesData)
+          || LastMatAddress < MemoryMap->PhysicalStart) {
+          goto KEEP_MEMORY_ATTRIBUTE_DESCRIPTOR;
+        }
 
-      //
-      // Advance MAP iterator if we found a MAT entry that follows the
-      // current MAP entry address.
-      //
-      if (CurrentMapAddress == MemoryAttributesEntry->PhysicalStart) {
         //
-        // MAT is required to be smaller or equal than MAP by UEFI spec.
-        // For now just assert on this, but if we find anybody violating this,
-        // we will have to adapt this code.
+        // Advance MAP iterator if we found a MAT entry that covers the
+        // current MAP entry address. MAT is required to be smaller or equal
+        // than MAP by UEFI spec.
         //
-        ASSERT (MemoryAttributesEntry->NumberOfPages <= MemoryMap->NumberOfPages);
-        CurrentMapAddress = LastMatAddress + 1;
-        goto NEXT_MEMORY_ATTRIBUTE_DESCRIPTOR;
+        if (ReadEntry->PhysicalStart <= CurrentMapAddress) {
+          ASSERT (ReadEntry->NumberOfPages <= MemoryMap->NumberOfPages);
+          if (LastMatAddress >= CurrentMapAddress) {
+            CurrentMapAddress = LastMatAddress + 1;
+          }
+          goto KEEP_MEMORY_ATTRIBUTE_DESCRIPTOR;
+        }
       }
 
       //
       // At this step we have a hole between the current MAP entry address
-      // and the MAT entry. Fill it in.
+      // and the next MAT entry, or the MAT entries are over. Fill it in
+      // up to the MAT entry or the MAP entry end.
+      // Writing reached reading, i.e. there are no free slots.
       //
-      Status = OcExpandAttributeWrite (
-        MemoryAttributesTable,
-        MemoryAttributesEntry,
-        MaxDescriptors,
-        MemoryMap,
-        CurrentMapAddress
-        );
-      if (EFI_ERROR (Status)) {
-        return Status;
+      if (WriteEntry == ReadEntry) {
+        Status = EFI_OUT_OF_RESOURCES;
+        break;
       }
 
-      //
-      // Advance MAP iterator with the entry we have just added and continue
-      // processing the next MAT entry.
-      //
-      CurrentMapAddress = LAST_DESCRIPTOR_ADDR (MemoryAttributesEntry) + 1;
+      LastMatAddress = NextMapAddress;
+      if (ReadEntry < MatEnd && ReadEntry->PhysicalStart < LastMatAddress) {
+        LastMatAddress = ReadEntry->PhysicalStart;
+      }
 
-NEXT_MEMORY_ATTRIBUTE_DESCRIPTOR:
-      MemoryAttributesEntry = NEXT_MEMORY_DESCRIPTOR (
-        MemoryAttributesEntry,
-        MemoryAttributesTable->DescriptorSize
-        );
-      ++MatIndex;
-    }
+      OcExpandAttributeWrite (WriteEntry, MemoryMap, CurrentMapAddress, LastMatAddress);
+      CurrentMapAddress = LastMatAddress;
+      WriteEntry        = NEXT_MEMORY_DESCRIPTOR (WriteEntry, MatDescriptorSize);
+      ++WriteCount;
+      Status = EFI_SUCCESS;
+      continue;
 
-    //
-    // We completed to process this MAP entry, proceed to the next one.
-    //
-    if (CurrentMapAddress == NextMapAddress) {
-      goto NEXT_MEMORY_MAP_DESCRIPTOR;
+KEEP_MEMORY_ATTRIBUTE_DESCRIPTOR:
+      if (WriteEntry != ReadEntry) {
+        CopyMem (WriteEntry, ReadEntry, MatDescriptorSize);
+      }
+
+      WriteEntry = NEXT_MEMORY_DESCRIPTOR (WriteEntry, MatDescriptorSize);
+      ReadEntry  = NEXT_MEMORY_DESCRIPTOR (ReadEntry, MatDescriptorSize);
+      ++WriteCount;
     }
 
-    //
-    // We have finished processing all the available MAT entries,
-    // but this MAP entry has more memory, which is not reflected
-    // in the MAT table. Add this memory and continue processing
-    // the next MAP entry.
-    //
-    ASSERT (CurrentMapAddress < NextMapAddress);
-    ASSERT (MatIndex == MemoryAttributesTable->NumberOfEntries);
-    Status = OcExpandAttributeWrite (
-      MemoryAttributesTable,
-      NULL,
-      MaxDescriptors,
-      MemoryMap,
-      CurrentMapAddress
-      );
-    if (EFI_ERROR (Status)) {
-      return Status;
+    if (Status == EFI_OUT_OF_RESOURCES) {
+      break;
     }
 
-    //
-    // Increment MatIndex to ensure that we no longer enter the MAT entry
-    // loop on the next iteration. Do not care updating CurrentMapAddress
-    // as we will overwrite it immediate on the next MAP entry iteration.
-    // Do not care updating MemoryAttribute as we will no longer use it.
-    //
-    ++MatIndex;
+    MemoryMap = NEXT_MEMORY_DESCRIPTOR (MemoryMap, DescriptorSize);
+  }
 
-NEXT_MEMORY_MAP_DESCRIPTOR:
-    MemoryMap = NEXT_MEMORY_DESCRIPTOR (
-      MemoryMap,
-      DescriptorSize
-      );
+  //
+  // Keep the remaining MAT entries.
+  //
+  if (WriteEntry != ReadEntry) {
+    CopyMem (WriteEntry, ReadEntry, (UINTN) MatEnd - (UINTN) ReadEntry);
   }
 
+  WriteCount += ((UINTN) MatEnd - (UINTN) ReadEntry) / MatDescriptorSize;
+  MemoryAttributesTable->NumberOfEntries = (UINT32) WriteCount;
+
   return Status;
 }
 
@@ -562,6 +593,54 @@ OcCountSplitDescriptors (
   return DescriptorCount;
 }
 
+UINTN
+OcCountSplitDescriptorsByMap (
+  IN UINTN                  MemoryMapSize,
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                  DescriptorSize
+  )
+{
+  CONST EFI_MEMORY_ATTRIBUTES_TABLE  *MemoryAttributesTable;
+  EFI_MEMORY_DESCRIPTOR              *MemoryAttributesEntry;
+  EFI_MEMORY_DESCRIPTOR              *MemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR              Current;
+  EFI_MEMORY_DESCRIPTOR              *CurrentEntry;
+  UINTN                              Index;
+  UINTN                              AttributeIndex;
+  UINTN                              SplitCount;
+
+  MemoryAttributesTable = OcGetMemoryAttributes (&MemoryAttributesEntry);
+  if (MemoryAttributesTable == NULL) {
+    return 0;
+  }
+
+  //
+  // Process every descriptor on a copy, which is updated in place
+  // with the remainder instead of inserting new descriptors.
+  //
+  AttributeIndex = 0;
+  SplitCount     = 0;
+  MemoryMapEntry = MemoryMap;
+  for (Index = 0; Index < MemoryMapSize / DescriptorSize; ++Index) {
+    CopyMem (&Current, MemoryMapEntry, sizeof (Current));
+    CurrentEntry = &Current;
+
+    OcSplitMemoryEntryByAttributes (
+      &CurrentEntry,
+      NULL,
+      MemoryAttributesTable,
+      &AttributeIndex,
+      &MemoryAttributesEntry,
+      DescriptorSize,
+      &SplitCount
+      );
+
+    MemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  }
+
+  return SplitCount;
+}
+
 EFI_STATUS
 OcSplitMemoryMapByAttributes (
   IN     UINTN                  MaxMemoryMapSize,
@@ -574,15 +653,13 @@ OcSplitMemoryMapByAttributes (
   CONST EFI_MEMORY_ATTRIBUTES_TABLE  *MemoryAttributesTable;
   EFI_MEMORY_DESCRIPTOR              *MemoryAttributesEntry;
   EFI_MEMORY_DESCRIPTOR              *MemoryMapEntry;
-  EFI_MEMORY_DESCRIPTOR              *LastAttributeEntry;
-  UINTN                              LastAttributeIndex;
-  UINTN                              Index;
-  UINTN                              Index2;
+  EFI_MEMORY_DESCRIPTOR              *ReadMemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR              *WriteMemoryMapEntry;
+  EFI_MEMORY_DESCRIPTOR              *MemoryMapEnd;
+  UINTN                              AttributeIndex;
   UINTN                              CurrentEntryCount;
   UINTN                              TotalEntryCount;
-  UINTN                              AttributeCount;
-  BOOLEAN                            CanSplit;
-  BOOLEAN                            InDescAttrs;
+  UINTN                              SplitCount;
 
   ASSERT (MaxMemoryMapSize >= *MemoryMapSize);
 
@@ -591,105 +668,66 @@ OcSplitMemoryMapByAttributes (
     return EFI_UNSUPPORTED;
   }
 
-  LastAttributeEntry = MemoryAttributesEntry;
-  LastAttributeIndex = 0;
-  MemoryMapEntry     = MemoryMap;
-  CurrentEntryCount  = *MemoryMapSize / DescriptorSize;
-  TotalEntryCount    = MaxMemoryMapSize / DescriptorSize;
-  AttributeCount     = MemoryAttributesTable->NumberOfEntries;
+  CurrentEntryCount = *MemoryMapSize / DescriptorSize;
+  TotalEntryCount   = MaxMemoryMapSize / DescriptorSize;
+  AttributeIndex    = 0;
+  SplitCount        = 0;
+
+  //
+  // Move the memory map to the end of the buffer, so that split descriptors
+  // can be written from the start in a single pass without shifting the tail.
+  // Writing never overtakes reading as long as there are free slots.
+  //
+  MemoryMapEnd        = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + TotalEntryCount * DescriptorSize);
+  ReadMemoryMapEntry  = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMapEnd - CurrentEntryCount * DescriptorSize);
+  WriteMemoryMapEntry = MemoryMap;
+  if (ReadMemoryMapEntry != MemoryMap) {
+    CopyMem (ReadMemoryMapEntry, MemoryMap, CurrentEntryCount * DescriptorSize);
+  }
 
   //
   // We assume that the memory map and attribute table are sorted.
   //
-  Index = 0;
-  while (Index < CurrentEntryCount) {
-    //
-    // Split entry by as many attributes as possible.
-    //
-    CanSplit = TRUE;
-    while ((MemoryMapEntry->Type == EfiRuntimeServicesCode
-      || MemoryMapEntry->Type == EfiRuntimeServicesData) && CanSplit) {
+  Status = EFI_SUCCESS;
+  while (ReadMemoryMapEntry < MemoryMapEnd) {
+    MemoryMapEntry = WriteMemoryMapEntry;
+    if (MemoryMapEntry != ReadMemoryMapEntry) {
+      CopyMem (MemoryMapEntry, ReadMemoryMapEntry, DescriptorSize);
+    }
+
+    ReadMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (ReadMemoryMapEntry, DescriptorSize);
+
+    Status = OcSplitMemoryEntryByAttributes (
+      &MemoryMapEntry,
+      ReadMemoryMapEntry,
+      MemoryAttributesTable,
+      &AttributeIndex,
+      &MemoryAttributesEntry,
+      DescriptorSize,
+      &SplitCount
+      );
+
+    WriteMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+
+    if (EFI_ERROR (Status)) {
       //
-      // Find corresponding memory attribute.
+      // Out of free slots, keep the rest of the memory map unsplit.
       //
-      InDescAttrs = FALSE;
-      MemoryAttributesEntry = LastAttributeEntry;
-      for (Index2 = LastAttributeIndex; Index2 < AttributeCount; ++Index2) {
-        if (MemoryAttributesEntry->Type == EfiRuntimeServicesCode
-          || MemoryAttributesEntry->Type == EfiRuntimeServicesData) {
-          //
-          // UEFI spec says attribute entries are fully within memory map entries.
-          // Find first one of a different type.
-          //
-          if (AREA_WITHIN_DESCRIPTOR (
-            MemoryMapEntry,
-            MemoryAttributesEntry->PhysicalStart,
-            EFI_PAGES_TO_SIZE (MemoryAttributesEntry->NumberOfPages))) {
-            //
-            // We are within descriptor attribute sequence.
-            //
-            InDescAttrs = TRUE;
-            //
-            // No need to process the attribute of the same type.
-            //
-            if (OcRealMemoryType (MemoryAttributesEntry) != MemoryMapEntry->Type) {
-              //
-              // Start with the next attribute on the second iteration.
-              //
-              LastAttributeEntry = NEXT_MEMORY_DESCRIPTOR (
-                MemoryAttributesEntry,
-                MemoryAttributesTable->DescriptorSize
-                );
-              LastAttributeIndex = Index2 + 1;
-              break;
-            }
-          } else if (InDescAttrs) {
-            //
-            // Reached the end of descriptor attribute sequence, abort.
-            //
-            InDescAttrs = FALSE;
-            break;
-          }
-        }
-
-        MemoryAttributesEntry = NEXT_MEMORY_DESCRIPTOR (
-          MemoryAttributesEntry,
-          MemoryAttributesTable->DescriptorSize
+      if (WriteMemoryMapEntry != ReadMemoryMapEntry) {
+        CopyMem (
+          WriteMemoryMapEntry,
+          ReadMemoryMapEntry,
+          (UINTN) MemoryMapEnd - (UINTN) ReadMemoryMapEntry
           );
       }
 
-      if (Index2 < AttributeCount && InDescAttrs) {
-        //
-        // Split current memory map entry.
-        //
-        Status = OcSplitMemoryEntryByAttribute (
-          &MemoryMapEntry,
-          &Index,
-          &CurrentEntryCount,
-          TotalEntryCount,
-          MemoryAttributesEntry,
-          DescriptorSize
-          );
-        if (EFI_ERROR (Status)) {
-          *MemoryMapSize = CurrentEntryCount * DescriptorSize;
-          return Status;
-        }
-        continue;
-      } else {
-        //
-        // Did not find a suitable attribute or processed all the attributes.
-        //
-        CanSplit = FALSE;
-      }
+      WriteMemoryMapEntry = (EFI_MEMORY_DESCRIPTOR *) (
+        (UINT8 *) WriteMemoryMapEntry + ((UINTN) MemoryMapEnd - (UINTN) ReadMemoryMapEntry)
+        );
+      break;
     }
-
-    MemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (
-      MemoryMapEntry,
-      DescriptorSize
-      );
-    ++Index;
   }
 
-  *MemoryMapSize = CurrentEntryCount * DescriptorSize;
-  return EFI_SUCCESS;
+  *MemoryMapSize = (UINTN) WriteMemoryMapEntry - (UINTN) MemoryMap;
+  return Status;
 }
@@ -111,6 +111,56 @@ OcDescToMemoryType (
   return Status;
 }
 
+/**
+  Count descriptors splitting current memory map by attributes adds.
+  Falls back to the upper bound when the memory map cannot be obtained.
+
+  @param[in]  MemoryMapSize   Current memory map size in bytes.
+  @param[in]  DescriptorSize  Memory map descriptor size in bytes.
+
+  @retval amount of descriptors added by splitting.
+**/
+STATIC
+UINTN
+CountCurrentSplitDescriptors (
+  IN UINTN  MemoryMapSize,
+  IN UINTN  DescriptorSize
+  )
+{
+  EFI_STATUS             Status;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  UINTN                  MapKey;
+  UINT32                 DescriptorVersion;
+  UINTN                  Count;
+
+  //
+  // Allocating the buffer adds at least one descriptor.
+  //
+  MemoryMapSize += MAX (DescriptorSize, 1024);
+  MemoryMap      = AllocatePool (MemoryMapSize);
+  if (MemoryMap == NULL) {
+    return OcCountSplitDescriptors ();
+  }
+
+  Status = gBS->GetMemoryMap (
+    &MemoryMapSize,
+    MemoryMap,
+    &MapKey,
+    &DescriptorSize,
+    &DescriptorVersion
+    );
+  if (EFI_ERROR (Status)) {
+    FreePool (MemoryMap);
+    return OcCountSplitDescriptors ();
+  }
+
+  OcSortMemoryMap (MemoryMapSize, MemoryMap, DescriptorSize);
+  Count = OcCountSplitDescriptorsByMap (MemoryMapSize, MemoryMap, DescriptorSize);
+  FreePool (MemoryMap);
+
+  return Count;
+}
+
 EFI_MEMORY_DESCRIPTOR *
 OcGetCurrentMemoryMap (
   OUT UINTN   *MemoryMapSize,
@@ -143,7 +193,7 @@ OcGetCurrentMemoryMap (
   }
 
   if (IncludeSplitSpace) {
-    ExtraSize = OcCountSplitDescriptors () * *DescriptorSize;
+    ExtraSize = CountCurrentSplitDescriptors (*MemoryMapSize, *DescriptorSize) * *DescriptorSize;
   } else {
     ExtraSize = 0;
   }
@@ -297,6 +347,54 @@ OcGetCurrentMemoryMapAlloc (
   return Status;
 }
 
+/**
+  Restore max-heap property for the memory map subtree rooted at Root.
+
+  @param[in,out] MemoryMap       Memory map.
+  @param[in]     DescriptorSize  Memory map descriptor size in bytes.
+  @param[in]     Root            Subtree root index.
+  @param[in]     EntryCount      Number of entries in the heap.
+**/
+STATIC
+VOID
+OcSiftDownMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize,
+  IN     UINTN                  Root,
+  IN     UINTN                  EntryCount
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *RootEntry;
+  EFI_MEMORY_DESCRIPTOR  *ChildEntry;
+  EFI_MEMORY_DESCRIPTOR  *NextChildEntry;
+  EFI_MEMORY_DESCRIPTOR  TempMemoryMap;
+  UINTN                  Child;
+
+  while (Root < EntryCount / 2) {
+    Child      = Root * 2 + 1;
+    ChildEntry = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + Child * DescriptorSize);
+
+    if (Child + 1 < EntryCount) {
+      NextChildEntry = NEXT_MEMORY_DESCRIPTOR (ChildEntry, DescriptorSize);
+      if (NextChildEntry->PhysicalStart > ChildEntry->PhysicalStart) {
+        ++Child;
+        ChildEntry = NextChildEntry;
+      }
+    }
+
+    RootEntry = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + Root * DescriptorSize);
+    if (RootEntry->PhysicalStart >= ChildEntry->PhysicalStart) {
+      break;
+    }
+
+    CopyMem (&TempMemoryMap, RootEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+    CopyMem (RootEntry, ChildEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+    CopyMem (ChildEntry, &TempMemoryMap, sizeof (EFI_MEMORY_DESCRIPTOR));
+
+    Root = Child;
+  }
+}
+
 VOID
 OcSortMemoryMap (
   IN UINTN                      MemoryMapSize,
@@ -308,23 +406,45 @@ OcSortMemoryMap (
   EFI_MEMORY_DESCRIPTOR       *NextMemoryMapEntry;
   EFI_MEMORY_DESCRIPTOR       *MemoryMapEnd;
   EFI_MEMORY_DESCRIPTOR       TempMemoryMap;
+  UINTN                       EntryCount;
+  UINTN                       Index;
 
+  //
+  // Firmware normally returns sorted memory maps, and we get called
+  // on every GetMemoryMap, so do a quick check first.
+  //
   MemoryMapEntry = MemoryMap;
+  MemoryMapEnd   = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + MemoryMapSize);
+  if (MemoryMapSize < 2 * DescriptorSize) {
+    return;
+  }
+
   NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
-  MemoryMapEnd = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + MemoryMapSize);
-  while (MemoryMapEntry < MemoryMapEnd) {
-    while (NextMemoryMapEntry < MemoryMapEnd) {
-      if (MemoryMapEntry->PhysicalStart > NextMemoryMapEntry->PhysicalStart) {
-        CopyMem (&TempMemoryMap, MemoryMapEntry, sizeof(EFI_MEMORY_DESCRIPTOR));
-        CopyMem (MemoryMapEntry, NextMemoryMapEntry, sizeof(EFI_MEMORY_DESCRIPTOR));
-        CopyMem (NextMemoryMapEntry, &TempMemoryMap, sizeof(EFI_MEMORY_DESCRIPTOR));
-      }
+  while (NextMemoryMapEntry < MemoryMapEnd
+    && MemoryMapEntry->PhysicalStart <= NextMemoryMapEntry->PhysicalStart) {
+    MemoryMapEntry     = NextMemoryMapEntry;
+    NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NextMemoryMapEntry, DescriptorSize);
+  }
 
-      NextMemoryMapEntry = NEXT_MEMORY_DESCRIPTOR (NextMemoryMapEntry, DescriptorSize);
-    }
+  if (NextMemoryMapEntry >= MemoryMapEnd) {
+    return;
+  }
 
-    MemoryMapEntry      = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
-    NextMemoryMapEntry  = NEXT_MEMORY_DESCRIPTOR (MemoryMapEntry, DescriptorSize);
+  //
+  // Heap sort, descriptors are strided, so avoid recursion and extra storage.
+  //
+  EntryCount = MemoryMapSize / DescriptorSize;
+
+  for (Index = EntryCount / 2; Index > 0; --Index) {
+    OcSiftDownMemoryMap (MemoryMap, DescriptorSize, Index - 1, EntryCount);
+  }
+
+  for (Index = EntryCount - 1; Index > 0; --Index) {
+    MemoryMapEntry = (EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) MemoryMap + Index * DescriptorSize);
+    CopyMem (&TempMemoryMap, MemoryMap, sizeof (EFI_MEMORY_DESCRIPTOR));
+    CopyMem (MemoryMap, MemoryMapEntry, sizeof (EFI_MEMORY_DESCRIPTOR));
+    CopyMem (MemoryMapEntry, &TempMemoryMap, sizeof (EFI_MEMORY_DESCRIPTOR));
+    OcSiftDownMemoryMap (MemoryMap, DescriptorSize, 0, Index);
   }
 }
 
@@ -410,11 +530,9 @@ OcShrinkMemoryMap (
       if (HasEntriesToRemove) {
         //
         // Have entries between PrevDesc and Desc which are joined to PrevDesc,
-        // we need to copy [Desc, end of list] to PrevDesc + 1
+        // compact by moving just Desc to PrevDesc + 1.
         //
-        CopyMem (PrevDesc, Desc, SizeFromDescToEnd);
-        Desc = PrevDesc;
-        HasEntriesToRemove = FALSE;
+        CopyMem (PrevDesc, Desc, DescriptorSize);
       }
     }
 
@@ -422,13 +540,6 @@ OcShrinkMemoryMap (
     SizeFromDescToEnd -= DescriptorSize;
   }
 
-  //
-  // Handle last entries if they were merged.
-  //
-  if (HasEntriesToRemove) {
-    *MemoryMapSize += DescriptorSize;
-  }
-
   return EFI_SUCCESS;
 }
 
@@ -477,11 +588,9 @@ OcDeduplicateDescriptors (
       if (HasEntriesToRemove) {
         //
         // Have same entries between PrevDesc and Desc which are replaced by PrevDesc,
-        // we need to copy [Desc, end of list] to PrevDesc + 1.
+        // compact by moving just Desc to PrevDesc + 1.
         //
-        CopyMem (PrevDesc, Desc, EntriesToGo * DescriptorSize);
-        Desc = PrevDesc;
-        HasEntriesToRemove = FALSE;
+        CopyMem (PrevDesc, Desc, DescriptorSize);
       }
     }
 
@@ -489,13 +598,6 @@ OcDeduplicateDescriptors (
     --EntriesToGo;
   }
 
-  //
-  // Handle last entries if they were deduplicated.
-  //
-  if (HasEntriesToRemove) {
-    ++(*EntryCount);
-  }
-
   return Status;
 }
 
@@ -54,6 +54,12 @@
  * ----------------------------------------------------------------------------
  */
 
+/*
+ * Legacy best-fit backend, UmmTlsf.c is used unless OC_UMM_LEGACY_BEST_FIT
+ * is defined.
+ */
+#ifdef OC_UMM_LEGACY_BEST_FIT
+
 #include <Library/OcMemoryLib.h>
 
 STATIC UINT8   *default_umm_heap;
@@ -99,6 +105,11 @@ typedef struct umm_block_t {
 umm_block *umm_heap = NULL;
 UINT32 umm_numblocks = 0;
 
+STATIC UINT32 umm_used_blocks;
+STATIC UINT32 umm_peak_used_blocks;
+STATIC UINT32 umm_alloc_count;
+STATIC UINT32 umm_failed_count;
+
 #define UMM_NUMBLOCKS (umm_numblocks)
 
 /* ------------------------------------------------------------------------ */
@@ -282,6 +293,10 @@ BOOLEAN UmmInitialized ( VOID ) {
 VOID UmmSetHeap( VOID *heap, UINT32 size ) {
   default_umm_heap = (UINT8 *)heap;
   default_umm_heap_size = size;
+  umm_used_blocks = 0;
+  umm_peak_used_blocks = 0;
+  umm_alloc_count = 0;
+  umm_failed_count = 0;
   umm_init();
 }
 
@@ -327,6 +342,9 @@ BOOLEAN UmmFree( VOID *ptr ) {
 
   DBGLOG_DEBUG( "Freeing block %6i\n", c );
 
+  umm_used_blocks -= (UMM_NBLOCK(c) & UMM_BLOCKNO_MASK) - c;
+  --umm_alloc_count;
+
   /* Now let's assimilate this block with the next one if possible. */
 
   umm_assimilate_up( c );
@@ -478,12 +496,19 @@ VOID *UmmMalloc( UINT32 size ) {
 
     DBGLOG_DEBUG(  "Can't allocate %5i blocks\n", blocks );
 
+    ++umm_failed_count;
+
     /* Release the critical section... */
     UMM_CRITICAL_EXIT();
 
     return( (VOID *)NULL );
   }
 
+  umm_used_blocks += blocks;
+  ++umm_alloc_count;
+  if( umm_used_blocks > umm_peak_used_blocks )
+    umm_peak_used_blocks = umm_used_blocks;
+
   /* Release the critical section... */
   UMM_CRITICAL_EXIT();
 
@@ -491,3 +516,34 @@ VOID *UmmMalloc( UINT32 size ) {
 }
 
 /* ------------------------------------------------------------------------ */
+
+VOID UmmGetStatistics( UMM_HEAP_STATS *Stats ) {
+  UINT32 c;
+  UINT32 blockSize;
+
+  Stats->TotalSize         = UmmInitialized() ? (UMM_NUMBLOCKS - 2) * sizeof(umm_block) : 0;
+  Stats->UsedSize          = umm_used_blocks * sizeof(umm_block);
+  Stats->PeakUsedSize      = umm_peak_used_blocks * sizeof(umm_block);
+  Stats->FreeSize          = 0;
+  Stats->LargestFreeBlock  = 0;
+  Stats->AllocationCount   = umm_alloc_count;
+  Stats->FailedAllocations = umm_failed_count;
+
+  if ( !UmmInitialized() )
+    return;
+
+  /* Walk the free list, the only way to learn about fragmentation here. */
+
+  c = UMM_NFREE(0);
+  while( c ) {
+    blockSize = ((UMM_NBLOCK(c) & UMM_BLOCKNO_MASK) - c) * sizeof(umm_block);
+    Stats->FreeSize += blockSize;
+    if( blockSize > Stats->LargestFreeBlock )
+      Stats->LargestFreeBlock = blockSize;
+    c = UMM_NFREE(c);
+  }
+}
+
+/* ------------------------------------------------------------------------ */
+
+#endif // OC_UMM_LEGACY_BEST_FIT
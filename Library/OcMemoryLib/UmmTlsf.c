@@ -0,0 +1,446 @@
+/** @file
+  Copyright (C) 2021, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+//
+// Two-level segregated fit allocator backend for the built-in allocator API.
+// Free blocks are kept in size class lists indexed by two bitmaps, so that
+// both allocation and free take constant time regardless of fragmentation.
+//
+// REF: M. Masmano et al., TLSF: a New Dynamic Memory Allocator for Real-Time Systems.
+//
+// The legacy best-fit backend (UmmMalloc.c) can be selected with OC_UMM_LEGACY_BEST_FIT.
+//
+
+#ifndef OC_UMM_LEGACY_BEST_FIT
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/OcMemoryLib.h>
+
+//
+// All blocks and allocations are aligned to 8 bytes.
+//
+#define TLSF_ALIGN_LOG2       3U
+#define TLSF_ALIGN            (1U << TLSF_ALIGN_LOG2)
+
+//
+// Every first level class is split into 16 second level classes.
+//
+#define TLSF_SL_LOG2          4U
+#define TLSF_SL_COUNT         (1U << TLSF_SL_LOG2)
+
+//
+// Blocks smaller than 128 bytes go to the first class with 8 byte granularity.
+//
+#define TLSF_FL_SHIFT         (TLSF_SL_LOG2 + TLSF_ALIGN_LOG2)
+#define TLSF_SMALL_BLOCK      (1U << TLSF_FL_SHIFT)
+
+//
+// Enough classes for 32-bit heap sizes.
+//
+#define TLSF_FL_COUNT         (32U - TLSF_FL_SHIFT + 1U)
+
+//
+// Block flags stored in the low bits of the size.
+//
+#define TLSF_BLOCK_FREE       BIT0
+#define TLSF_BLOCK_SIZE_MASK  (~(TLSF_ALIGN - 1U))
+
+//
+// Free list terminator, offset 0 is a valid block.
+//
+#define TLSF_NULL             MAX_UINT32
+
+#pragma pack(1)
+
+typedef struct {
+  //
+  // Size of the previous physical block, 0 for the first block.
+  //
+  UINT32  PrevSize;
+  //
+  // Size of this block including header with TLSF_BLOCK_FREE flag.
+  //
+  UINT32  SizeFlags;
+} TLSF_BLOCK_HEADER;
+
+typedef struct {
+  TLSF_BLOCK_HEADER  Header;
+  //
+  // Free list links, only valid for free blocks.
+  //
+  UINT32             NextFree;
+  UINT32             PrevFree;
+} TLSF_FREE_BLOCK;
+
+#pragma pack()
+
+#define TLSF_MIN_BLOCK_SIZE   ((UINT32) sizeof (TLSF_FREE_BLOCK))
+#define TLSF_HEADER_SIZE      ((UINT32) sizeof (TLSF_BLOCK_HEADER))
+
+STATIC UINT8            *mTlsfHeap;
+STATIC UINT32           mTlsfHeapSize;
+STATIC UINT32           mTlsfFlBitmap;
+STATIC UINT32           mTlsfSlBitmap[TLSF_FL_COUNT];
+STATIC UINT32           mTlsfFreeLists[TLSF_FL_COUNT][TLSF_SL_COUNT];
+STATIC UMM_HEAP_STATS   mTlsfStats;
+
+#define TLSF_BLOCK(Offset)      ((TLSF_FREE_BLOCK *) (mTlsfHeap + (Offset)))
+#define TLSF_BLOCK_SIZE(Offset) (TLSF_BLOCK (Offset)->Header.SizeFlags & TLSF_BLOCK_SIZE_MASK)
+#define TLSF_IS_FREE(Offset)    ((TLSF_BLOCK (Offset)->Header.SizeFlags & TLSF_BLOCK_FREE) != 0)
+
+/**
+  Map block size to its size class.
+
+  @param[in]  Size  Block size.
+  @param[out] Fl    First level index.
+  @param[out] Sl    Second level index.
+**/
+STATIC
+VOID
+TlsfMapping (
+  IN  UINT32  Size,
+  OUT UINT32  *Fl,
+  OUT UINT32  *Sl
+  )
+{
+  UINT32  Bit;
+
+  if (Size < TLSF_SMALL_BLOCK) {
+    *Fl = 0;
+    *Sl = Size / (TLSF_SMALL_BLOCK / TLSF_SL_COUNT);
+  } else {
+    Bit = (UINT32) HighBitSet32 (Size);
+    *Sl = (Size >> (Bit - TLSF_SL_LOG2)) ^ TLSF_SL_COUNT;
+    *Fl = Bit - TLSF_FL_SHIFT + 1;
+  }
+}
+
+/**
+  Insert free block into its size class.
+
+  @param[in]  Offset  Block offset.
+**/
+STATIC
+VOID
+TlsfInsertFree (
+  IN UINT32  Offset
+  )
+{
+  TLSF_FREE_BLOCK  *Block;
+  UINT32           Fl;
+  UINT32           Sl;
+  UINT32           Head;
+
+  Block = TLSF_BLOCK (Offset);
+  TlsfMapping (Block->Header.SizeFlags & TLSF_BLOCK_SIZE_MASK, &Fl, &Sl);
+
+  Head = mTlsfFreeLists[Fl][Sl];
+  Block->NextFree = Head;
+  Block->PrevFree = TLSF_NULL;
+  if (Head != TLSF_NULL) {
+    TLSF_BLOCK (Head)->PrevFree = Offset;
+  }
+
+  mTlsfFreeLists[Fl][Sl] = Offset;
+  mTlsfFlBitmap         |= 1U << Fl;
+  mTlsfSlBitmap[Fl]     |= 1U << Sl;
+
+  Block->Header.SizeFlags |= TLSF_BLOCK_FREE;
+}
+
+/**
+  Remove free block from its size class.
+
+  @param[in]  Offset  Block offset.
+**/
+STATIC
+VOID
+TlsfRemoveFree (
+  IN UINT32  Offset
+  )
+{
+  TLSF_FREE_BLOCK  *Block;
+  UINT32           Fl;
+  UINT32           Sl;
+
+  Block = TLSF_BLOCK (Offset);
+  TlsfMapping (Block->Header.SizeFlags & TLSF_BLOCK_SIZE_MASK, &Fl, &Sl);
+
+  if (Block->PrevFree != TLSF_NULL) {
+    TLSF_BLOCK (Block->PrevFree)->NextFree = Block->NextFree;
+  } else {
+    mTlsfFreeLists[Fl][Sl] = Block->NextFree;
+    if (Block->NextFree == TLSF_NULL) {
+      mTlsfSlBitmap[Fl] &= ~(1U << Sl);
+      if (mTlsfSlBitmap[Fl] == 0) {
+        mTlsfFlBitmap &= ~(1U << Fl);
+      }
+    }
+  }
+
+  if (Block->NextFree != TLSF_NULL) {
+    TLSF_BLOCK (Block->NextFree)->PrevFree = Block->PrevFree;
+  }
+
+  Block->Header.SizeFlags &= ~TLSF_BLOCK_FREE;
+}
+
+/**
+  Update previous size of the block following the one at Offset.
+
+  @param[in]  Offset  Block offset.
+**/
+STATIC
+VOID
+TlsfLinkNext (
+  IN UINT32  Offset
+  )
+{
+  TLSF_BLOCK (Offset + TLSF_BLOCK_SIZE (Offset))->Header.PrevSize = TLSF_BLOCK_SIZE (Offset);
+}
+
+BOOLEAN
+UmmInitialized (
+  VOID
+  )
+{
+  return mTlsfHeap != NULL;
+}
+
+VOID
+UmmSetHeap (
+  IN VOID    *Heap,
+  IN UINT32  Size
+  )
+{
+  UINT32  Align;
+  UINT32  Fl;
+  UINT32  Sl;
+
+  mTlsfHeap     = NULL;
+  mTlsfHeapSize = 0;
+  mTlsfFlBitmap = 0;
+
+  for (Fl = 0; Fl < TLSF_FL_COUNT; ++Fl) {
+    mTlsfSlBitmap[Fl] = 0;
+    for (Sl = 0; Sl < TLSF_SL_COUNT; ++Sl) {
+      mTlsfFreeLists[Fl][Sl] = TLSF_NULL;
+    }
+  }
+
+  mTlsfStats.TotalSize         = 0;
+  mTlsfStats.UsedSize          = 0;
+  mTlsfStats.PeakUsedSize      = 0;
+  mTlsfStats.AllocationCount   = 0;
+  mTlsfStats.FailedAllocations = 0;
+
+  Align = (UINT32) ((TLSF_ALIGN - ((UINTN) Heap & (TLSF_ALIGN - 1))) & (TLSF_ALIGN - 1));
+  if (Heap == NULL || Size < Align + TLSF_MIN_BLOCK_SIZE + TLSF_HEADER_SIZE) {
+    return;
+  }
+
+  //
+  // One free block spanning the whole heap, terminated by a used
+  // zero-sized sentinel block, so that merging never goes past the end.
+  //
+  mTlsfHeap     = (UINT8 *) Heap + Align;
+  mTlsfHeapSize = (Size - Align) & TLSF_BLOCK_SIZE_MASK;
+
+  TLSF_BLOCK (0)->Header.PrevSize  = 0;
+  TLSF_BLOCK (0)->Header.SizeFlags = mTlsfHeapSize - TLSF_HEADER_SIZE;
+  TLSF_BLOCK (mTlsfHeapSize - TLSF_HEADER_SIZE)->Header.SizeFlags = 0;
+  TlsfLinkNext (0);
+  TlsfInsertFree (0);
+
+  mTlsfStats.TotalSize = mTlsfHeapSize - TLSF_HEADER_SIZE;
+}
+
+VOID *
+UmmMalloc (
+  IN UINT32  Size
+  )
+{
+  UINT32  BlockSize;
+  UINT32  SearchSize;
+  UINT32  Fl;
+  UINT32  Sl;
+  UINT32  SlBitmap;
+  UINT32  FlBitmap;
+  UINT32  Offset;
+  UINT32  Remainder;
+
+  if (mTlsfHeap == NULL || Size == 0) {
+    return NULL;
+  }
+
+  if (Size > mTlsfHeapSize - TLSF_HEADER_SIZE) {
+    ++mTlsfStats.FailedAllocations;
+    return NULL;
+  }
+
+  BlockSize = (Size + TLSF_HEADER_SIZE + TLSF_ALIGN - 1) & TLSF_BLOCK_SIZE_MASK;
+  if (BlockSize < TLSF_MIN_BLOCK_SIZE) {
+    BlockSize = TLSF_MIN_BLOCK_SIZE;
+  }
+
+  //
+  // Round up to the next size class, so that any block in it fits.
+  //
+  SearchSize = BlockSize;
+  if (SearchSize >= TLSF_SMALL_BLOCK) {
+    SearchSize += (1U << ((UINT32) HighBitSet32 (SearchSize) - TLSF_SL_LOG2)) - 1;
+  }
+
+  if (SearchSize < BlockSize) {
+    ++mTlsfStats.FailedAllocations;
+    return NULL;
+  }
+
+  TlsfMapping (SearchSize, &Fl, &Sl);
+
+  SlBitmap = Fl < TLSF_FL_COUNT ? mTlsfSlBitmap[Fl] & (MAX_UINT32 << Sl) : 0;
+  if (SlBitmap == 0) {
+    FlBitmap = Fl + 1 < TLSF_FL_COUNT ? mTlsfFlBitmap & (MAX_UINT32 << (Fl + 1)) : 0;
+    if (FlBitmap == 0) {
+      ++mTlsfStats.FailedAllocations;
+      return NULL;
+    }
+
+    Fl       = (UINT32) LowBitSet32 (FlBitmap);
+    SlBitmap = mTlsfSlBitmap[Fl];
+  }
+
+  Sl     = (UINT32) LowBitSet32 (SlBitmap);
+  Offset = mTlsfFreeLists[Fl][Sl];
+
+  TlsfRemoveFree (Offset);
+
+  //
+  // Return the tail back to the free lists when it is large enough.
+  //
+  Remainder = TLSF_BLOCK_SIZE (Offset) - BlockSize;
+  if (Remainder >= TLSF_MIN_BLOCK_SIZE) {
+    TLSF_BLOCK (Offset)->Header.SizeFlags = BlockSize;
+    TLSF_BLOCK (Offset + BlockSize)->Header.SizeFlags = Remainder;
+    TlsfLinkNext (Offset);
+    TlsfLinkNext (Offset + BlockSize);
+    TlsfInsertFree (Offset + BlockSize);
+  }
+
+  mTlsfStats.UsedSize += TLSF_BLOCK_SIZE (Offset);
+  ++mTlsfStats.AllocationCount;
+  if (mTlsfStats.UsedSize > mTlsfStats.PeakUsedSize) {
+    mTlsfStats.PeakUsedSize = mTlsfStats.UsedSize;
+  }
+
+  return mTlsfHeap + Offset + TLSF_HEADER_SIZE;
+}
+
+BOOLEAN
+UmmFree (
+  IN VOID  *Ptr
+  )
+{
+  UINT32  Offset;
+  UINT32  Prev;
+  UINT32  Next;
+  UINT32  BlockSize;
+
+  if (mTlsfHeap == NULL || Ptr == NULL) {
+    return FALSE;
+  }
+
+  //
+  // Check whether the memory belongs to us and looks like an allocation.
+  //
+  if ((UINT8 *) Ptr < mTlsfHeap + TLSF_HEADER_SIZE
+    || (UINT8 *) Ptr >= mTlsfHeap + mTlsfHeapSize
+    || ((UINTN) Ptr & (TLSF_ALIGN - 1)) != 0) {
+    return FALSE;
+  }
+
+  Offset    = (UINT32) ((UINT8 *) Ptr - mTlsfHeap) - TLSF_HEADER_SIZE;
+  BlockSize = TLSF_BLOCK_SIZE (Offset);
+  if (TLSF_IS_FREE (Offset) || BlockSize < TLSF_MIN_BLOCK_SIZE
+    || BlockSize > mTlsfHeapSize - TLSF_HEADER_SIZE - Offset) {
+    return FALSE;
+  }
+
+  mTlsfStats.UsedSize -= BlockSize;
+  --mTlsfStats.AllocationCount;
+
+  //
+  // Merge with the next physical block.
+  //
+  Next = Offset + BlockSize;
+  if (TLSF_IS_FREE (Next)) {
+    TlsfRemoveFree (Next);
+    TLSF_BLOCK (Offset)->Header.SizeFlags = BlockSize + TLSF_BLOCK_SIZE (Next);
+  }
+
+  //
+  // Merge with the previous physical block.
+  //
+  if (Offset > 0) {
+    Prev = Offset - TLSF_BLOCK (Offset)->Header.PrevSize;
+    if (TLSF_IS_FREE (Prev)) {
+      //
+      // Keep the stale header marked free to reject repeated frees.
+      //
+      TLSF_BLOCK (Offset)->Header.SizeFlags |= TLSF_BLOCK_FREE;
+      TlsfRemoveFree (Prev);
+      TLSF_BLOCK (Prev)->Header.SizeFlags = TLSF_BLOCK_SIZE (Prev) + TLSF_BLOCK_SIZE (Offset);
+      Offset = Prev;
+    }
+  }
+
+  TlsfLinkNext (Offset);
+  TlsfInsertFree (Offset);
+
+  return TRUE;
+}
+
+VOID
+UmmGetStatistics (
+  OUT UMM_HEAP_STATS  *Stats
+  )
+{
+  UINT32  Fl;
+  UINT32  Sl;
+  UINT32  Offset;
+
+  *Stats = mTlsfStats;
+  Stats->FreeSize         = mTlsfStats.TotalSize - mTlsfStats.UsedSize;
+  Stats->LargestFreeBlock = 0;
+
+  //
+  // Largest free block is in the highest non-empty size class.
+  //
+  if (mTlsfFlBitmap != 0) {
+    Fl     = (UINT32) HighBitSet32 (mTlsfFlBitmap);
+    Sl     = (UINT32) HighBitSet32 (mTlsfSlBitmap[Fl]);
+    Offset = mTlsfFreeLists[Fl][Sl];
+    while (Offset != TLSF_NULL) {
+      if (TLSF_BLOCK_SIZE (Offset) - TLSF_HEADER_SIZE > Stats->LargestFreeBlock) {
+        Stats->LargestFreeBlock = TLSF_BLOCK_SIZE (Offset) - TLSF_HEADER_SIZE;
+      }
+
+      Offset = TLSF_BLOCK (Offset)->NextFree;
+    }
+  }
+}
+
+#endif // OC_UMM_LEGACY_BEST_FIT
@@ -15,6 +15,9 @@
 
 #include <Uefi.h>
 
+#include <Register/Cpuid.h>
+
+#include <Library/BaseLib.h>
 #include <Library/UefiLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/OcDebugLogLib.h>
@@ -178,8 +181,10 @@ VmAllocateMemoryPool (
   IN  EFI_GET_MEMORY_MAP  GetMemoryMap  OPTIONAL
   )
 {
-  EFI_STATUS              Status;
-  EFI_PHYSICAL_ADDRESS    Addr;
+  EFI_STATUS                   Status;
+  EFI_PHYSICAL_ADDRESS         Addr;
+  UINT32                       MaxExtId;
+  CPUID_EXTENDED_CPU_SIG_EDX   ExtSigEdx;
 
   Addr = BASE_4GB;
   Status = OcAllocatePagesFromTop (
@@ -192,8 +197,19 @@ VmAllocateMemoryPool (
     );
 
   if (!EFI_ERROR (Status)) {
-    Context->MemoryPool = (UINT8 *)(UINTN)Addr;
-    Context->FreePages  = NumPages;
+    Context->MemoryPool      = (UINT8 *)(UINTN)Addr;
+    Context->MemoryPoolStart = Context->MemoryPool;
+    Context->FreePages       = NumPages;
+    Context->PageTablePages  = 0;
+    Context->FreePageTables  = NULL;
+
+    AsmCpuid (CPUID_EXTENDED_FUNCTION, &MaxExtId, NULL, NULL, NULL);
+    ExtSigEdx.Uint32 = 0;
+    if (MaxExtId >= CPUID_EXTENDED_CPU_SIG) {
+      AsmCpuid (CPUID_EXTENDED_CPU_SIG, NULL, NULL, NULL, &ExtSigEdx.Uint32);
+    }
+
+    Context->Supports1GbPages = ExtSigEdx.Bits.Page1GB != 0;
   }
 
   return Status;
@@ -218,12 +234,107 @@ VmAllocatePages (
   return AllocatedPages;
 }
 
+/**
+  Allocate zeroed page for a page table and account for it.
+
+  @param[in,out]  Context   Virtual memory pool context.
+
+  @retval allocated page or NULL.
+**/
+STATIC
+VOID *
+VmAllocatePageTable (
+  IN OUT OC_VMEM_CONTEXT  *Context
+  )
+{
+  VOID  *Table;
+
+  if (Context->FreePageTables != NULL) {
+    Table = Context->FreePageTables;
+    Context->FreePageTables = *(VOID **) Table;
+  } else {
+    Table = VmAllocatePages (Context, 1);
+  }
+
+  if (Table != NULL) {
+    ZeroMem (Table, EFI_PAGE_SIZE);
+    ++Context->PageTablePages;
+  }
+
+  return Table;
+}
+
+/**
+  Return page table replaced by a large page for reuse. Page tables
+  referenced by a replaced page directory are returned as well.
+  Page tables not allocated from the pool are left intact.
+
+  @param[in,out]  Context      Virtual memory pool context.
+  @param[in]      Table        Replaced page table.
+  @param[in]      IsDirectory  Table is a page directory.
+**/
+STATIC
+VOID
+VmFreePageTable (
+  IN OUT OC_VMEM_CONTEXT  *Context,
+  IN     VOID             *Table,
+  IN     BOOLEAN          IsDirectory
+  )
+{
+  PAGE_MAP_AND_DIRECTORY_POINTER  *PDE;
+  UINTN                           Index;
+
+  if ((UINT8 *) Table < Context->MemoryPoolStart || (UINT8 *) Table >= Context->MemoryPool) {
+    return;
+  }
+
+  if (IsDirectory) {
+    PDE = (PAGE_MAP_AND_DIRECTORY_POINTER *) Table;
+    for (Index = 0; Index < 512; ++Index) {
+      if (PDE[Index].Bits.Present && !(PDE[Index].Bits.MustBeZero & 0x1)) {
+        VmFreePageTable (
+          Context,
+          (VOID *)(UINTN)(PDE[Index].Uint64 & PAGING_4K_ADDRESS_MASK_64),
+          FALSE
+          );
+      }
+    }
+  }
+
+  *(VOID **) Table = Context->FreePageTables;
+  Context->FreePageTables = Table;
+  --Context->PageTablePages;
+}
+
+UINTN
+VmGetPageTablePages (
+  IN CONST OC_VMEM_CONTEXT  *Context
+  )
+{
+  return Context->PageTablePages;
+}
+
+/**
+  Map (remap) given 4K, 2M, or 1G page at physical address to given
+  virtual address in the specified page table. Both addresses must be
+  aligned to the page size.
+
+  @param[in,out]  Context       Virtual memory pool context.
+  @param[in]      PageTable     Page table to update.
+  @param[in]      VirtualAddr   Virtual memory address to map at.
+  @param[in]      PhysicalAddr  Physical memory address to map from.
+  @param[in]      PageSize      BASE_4KB, BASE_2MB, or BASE_1GB.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
 EFI_STATUS
-VmMapVirtualPage (
+VmMapVirtualPageSize (
   IN OUT OC_VMEM_CONTEXT                 *Context,
-  IN OUT PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable  OPTIONAL,
+  IN OUT PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable,
   IN     EFI_VIRTUAL_ADDRESS             VirtualAddr,
-  IN     EFI_PHYSICAL_ADDRESS            PhysicalAddr
+  IN     EFI_PHYSICAL_ADDRESS            PhysicalAddr,
+  IN     UINT64                          PageSize
   )
 {
   EFI_PHYSICAL_ADDRESS            Start;
@@ -237,13 +348,10 @@ VmMapVirtualPage (
   PAGE_TABLE_4K_ENTRY             *PTE4KTmp;
   PAGE_TABLE_2M_ENTRY             *PTE2M;
   PAGE_TABLE_1G_ENTRY             *PTE1G;
+  VOID                            *OldTable;
   UINTN                           Index;
   BOOLEAN                         WriteProtected;
 
-  if (PageTable == NULL) {
-    PageTable = OcGetCurrentPageTable (NULL);
-  }
-
   WriteProtected = DisablePageTableWriteProtection ();
 
   VA.Uint64 = (UINT64) VirtualAddr;
@@ -272,7 +380,7 @@ VmMapVirtualPage (
   VA_FIX_SIGN_EXTEND (VAEnd);
 
   if (!PML4->Bits.Present) {
-    PDPE = (PAGE_MAP_AND_DIRECTORY_POINTER *) VmAllocatePages (Context, 1);
+    PDPE = (PAGE_MAP_AND_DIRECTORY_POINTER *) VmAllocatePageTable (Context);
 
     if (PDPE == NULL) {
       if (WriteProtected) {
@@ -281,8 +389,6 @@ VmMapVirtualPage (
       return EFI_NO_MAPPING;
     }
 
-    ZeroMem (PDPE, EFI_PAGE_SIZE);
-
     //
     // Init this whole 512 GB region with 512 1GB entry pages to map
     // the first 512 GB physical space.
@@ -314,8 +420,35 @@ VmMapVirtualPage (
   VAStart.Pg4K.PDPOffset = VA.Pg4K.PDPOffset;
   VAEnd.Pg4K.PDPOffset = VA.Pg4K.PDPOffset;
 
+  if (PageSize == BASE_1GB) {
+    //
+    // Put 1 GB page directly to PDPE. Any previous PDE array is dropped.
+    //
+    if (PDPE->Bits.Present && !(PDPE->Bits.MustBeZero & 0x1)) {
+      OldTable = (VOID *)(UINTN)(PDPE->Uint64 & PAGING_4K_ADDRESS_MASK_64);
+    } else {
+      OldTable = NULL;
+    }
+
+    PTE1G = (PAGE_TABLE_1G_ENTRY *) PDPE;
+    PTE1G->Uint64 = ((UINT64) PhysicalAddr) & PAGING_1G_ADDRESS_MASK_64;
+    PTE1G->Bits.ReadWrite = 1;
+    PTE1G->Bits.Present = 1;
+    PTE1G->Bits.MustBe1 = 1;
+
+    if (OldTable != NULL) {
+      VmFreePageTable (Context, OldTable, TRUE);
+    }
+
+    if (WriteProtected) {
+      EnablePageTableWriteProtection ();
+    }
+
+    return EFI_SUCCESS;
+  }
+
   if (!PDPE->Bits.Present || (PDPE->Bits.MustBeZero & 0x1)) {
-    PDE = (PAGE_MAP_AND_DIRECTORY_POINTER *) VmAllocatePages(Context, 1);
+    PDE = (PAGE_MAP_AND_DIRECTORY_POINTER *) VmAllocatePageTable (Context);
 
     if (PDE == NULL) {
       if (WriteProtected) {
@@ -324,8 +457,6 @@ VmMapVirtualPage (
       return EFI_NO_MAPPING;
     }
 
-    ZeroMem (PDE, EFI_PAGE_SIZE);
-
     if (PDPE->Bits.MustBeZero & 0x1) {
       //
       // This is 1 GB page. Init new PDE array to get the same
@@ -360,8 +491,35 @@ VmMapVirtualPage (
   VAStart.Pg4K.PDOffset = VA.Pg4K.PDOffset;
   VAEnd.Pg4K.PDOffset = VA.Pg4K.PDOffset;
 
+  if (PageSize == BASE_2MB) {
+    //
+    // Put 2 MB page directly to PDE. Any previous PTE array is dropped.
+    //
+    if (PDE->Bits.Present && !(PDE->Bits.MustBeZero & 0x1)) {
+      OldTable = (VOID *)(UINTN)(PDE->Uint64 & PAGING_4K_ADDRESS_MASK_64);
+    } else {
+      OldTable = NULL;
+    }
+
+    PTE2M = (PAGE_TABLE_2M_ENTRY *) PDE;
+    PTE2M->Uint64 = ((UINT64) PhysicalAddr) & PAGING_2M_ADDRESS_MASK_64;
+    PTE2M->Bits.ReadWrite = 1;
+    PTE2M->Bits.Present = 1;
+    PTE2M->Bits.MustBe1 = 1;
+
+    if (OldTable != NULL) {
+      VmFreePageTable (Context, OldTable, FALSE);
+    }
+
+    if (WriteProtected) {
+      EnablePageTableWriteProtection ();
+    }
+
+    return EFI_SUCCESS;
+  }
+
   if (!PDE->Bits.Present || (PDE->Bits.MustBeZero & 0x1)) {
-    PTE4K = (PAGE_TABLE_4K_ENTRY *) VmAllocatePages (Context, 1);
+    PTE4K = (PAGE_TABLE_4K_ENTRY *) VmAllocatePageTable (Context);
 
     if (PTE4K == NULL) {
       if (WriteProtected) {
@@ -370,8 +528,6 @@ VmMapVirtualPage (
       return EFI_NO_MAPPING;
     }
 
-    ZeroMem (PTE4K, EFI_PAGE_SIZE);
-
     if (PDE->Bits.MustBeZero & 0x1) {
       //
       // This is 2 MB page. Init new PTE array to get the same
@@ -419,6 +575,27 @@ VmMapVirtualPage (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+VmMapVirtualPage (
+  IN OUT OC_VMEM_CONTEXT                 *Context,
+  IN OUT PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable  OPTIONAL,
+  IN     EFI_VIRTUAL_ADDRESS             VirtualAddr,
+  IN     EFI_PHYSICAL_ADDRESS            PhysicalAddr
+  )
+{
+  if (PageTable == NULL) {
+    PageTable = OcGetCurrentPageTable (NULL);
+  }
+
+  return VmMapVirtualPageSize (
+    Context,
+    PageTable,
+    VirtualAddr,
+    PhysicalAddr,
+    BASE_4KB
+    );
+}
+
 EFI_STATUS
 VmMapVirtualPages (
   IN OUT OC_VMEM_CONTEXT                 *Context,
@@ -429,6 +606,8 @@ VmMapVirtualPages (
   )
 {
   EFI_STATUS  Status;
+  UINT64      PageSize;
+  UINT64      Alignment;
 
   if (PageTable == NULL) {
     PageTable = OcGetCurrentPageTable (NULL);
@@ -437,16 +616,34 @@ VmMapVirtualPages (
   Status = EFI_SUCCESS;
 
   while (NumPages > 0 && !EFI_ERROR (Status)) {
-    Status = VmMapVirtualPage (
+    //
+    // Use the largest page both addresses are aligned to and the remaining
+    // range fully covers. This saves page table pages and walks for large
+    // MMIO and runtime areas.
+    //
+    Alignment = VirtualAddr | PhysicalAddr;
+    if (Context->Supports1GbPages
+      && (Alignment & (BASE_1GB - 1)) == 0
+      && NumPages >= EFI_SIZE_TO_PAGES (BASE_1GB)) {
+      PageSize = BASE_1GB;
+    } else if ((Alignment & (BASE_2MB - 1)) == 0
+      && NumPages >= EFI_SIZE_TO_PAGES (BASE_2MB)) {
+      PageSize = BASE_2MB;
+    } else {
+      PageSize = BASE_4KB;
+    }
+
+    Status = VmMapVirtualPageSize (
       Context,
       PageTable,
       VirtualAddr,
-      PhysicalAddr
+      PhysicalAddr,
+      PageSize
       );
 
-    VirtualAddr  += EFI_PAGE_SIZE;
-    PhysicalAddr += EFI_PAGE_SIZE;
-    NumPages--;
+    VirtualAddr  += PageSize;
+    PhysicalAddr += PageSize;
+    NumPages     -= EFI_SIZE_TO_PAGES (PageSize);
   }
 
   return Status;
@@ -0,0 +1,547 @@
+/** @file
+
+OcPngLib - specialised PNG decoder for 8-bit non-interlaced images
+
+Copyright (c) 2021, vit9696. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-3-Clause
+
+**/
+#include <Base.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcGuardLib.h>
+#include <Library/OcPngLib.h>
+#include "lodepng.h"
+
+#define PNG_SIGNATURE_SIZE     8U
+#define PNG_CHUNK_HEADER_SIZE  8U
+#define PNG_CHUNK_CRC_SIZE     4U
+#define PNG_IHDR_SIZE          13U
+
+#define PNG_COLOR_GRAY         0U
+#define PNG_COLOR_RGB          2U
+#define PNG_COLOR_GRAY_ALPHA   4U
+#define PNG_COLOR_RGBA         6U
+
+#define PNG_FILTER_NONE        0U
+#define PNG_FILTER_SUB         1U
+#define PNG_FILTER_UP          2U
+#define PNG_FILTER_AVERAGE     3U
+#define PNG_FILTER_PAETH       4U
+
+STATIC CONST UINT8 mPngSignature[PNG_SIGNATURE_SIZE] = {
+  0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+};
+
+STATIC
+UINT32
+InternalPngRead32 (
+  IN CONST UINT8  *Data
+  )
+{
+  return SwapBytes32 (ReadUnaligned32 ((CONST UINT32 *) Data));
+}
+
+STATIC
+BOOLEAN
+InternalPngChunkIs (
+  IN CONST UINT8  *Chunk,
+  IN CONST CHAR8  *Type
+  )
+{
+  return CompareMem (Chunk + sizeof (UINT32), Type, sizeof (UINT32)) == 0;
+}
+
+STATIC
+BOOLEAN
+InternalPngReserve (
+  IN OUT UINT8  **Buffer,
+  IN OUT UINTN  *Capacity,
+  IN     UINTN  Size
+  )
+{
+  if (*Capacity >= Size) {
+    return TRUE;
+  }
+
+  if (*Buffer != NULL) {
+    FreePool (*Buffer);
+  }
+
+  *Buffer = AllocatePool (Size);
+  if (*Buffer == NULL) {
+    *Capacity = 0;
+    return FALSE;
+  }
+
+  *Capacity = Size;
+  return TRUE;
+}
+
+STATIC
+UINT8
+InternalPngPaeth (
+  IN UINT8  Left,
+  IN UINT8  Up,
+  IN UINT8  UpLeft
+  )
+{
+  INT32  Predictor;
+  INT32  DistLeft;
+  INT32  DistUp;
+  INT32  DistUpLeft;
+
+  Predictor  = (INT32) Left + Up - UpLeft;
+  DistLeft   = ABS (Predictor - Left);
+  DistUp     = ABS (Predictor - Up);
+  DistUpLeft = ABS (Predictor - UpLeft);
+
+  if (DistLeft <= DistUp && DistLeft <= DistUpLeft) {
+    return Left;
+  }
+
+  if (DistUp <= DistUpLeft) {
+    return Up;
+  }
+
+  return UpLeft;
+}
+
+/**
+  Reverts the filter of a scanline in place.
+
+  @param[in,out] Row        Scanline data without the filter type byte.
+  @param[in]     Prev       Previous, already unfiltered scanline or NULL.
+  @param[in]     RowBytes   Scanline length in bytes.
+  @param[in]     Bpp        Bytes per pixel.
+  @param[in]     Filter     Filter type.
+
+  @retval TRUE on success.
+**/
+STATIC
+BOOLEAN
+InternalPngUnfilterRow (
+  IN OUT UINT8        *Row,
+  IN     CONST UINT8  *Prev  OPTIONAL,
+  IN     UINT32       RowBytes,
+  IN     UINT32       Bpp,
+  IN     UINT8        Filter
+  )
+{
+  UINT32  Index;
+
+  switch (Filter) {
+    case PNG_FILTER_NONE:
+      break;
+
+    case PNG_FILTER_SUB:
+      for (Index = Bpp; Index < RowBytes; ++Index) {
+        Row[Index] = (UINT8) (Row[Index] + Row[Index - Bpp]);
+      }
+      break;
+
+    case PNG_FILTER_UP:
+      if (Prev != NULL) {
+        for (Index = 0; Index < RowBytes; ++Index) {
+          Row[Index] = (UINT8) (Row[Index] + Prev[Index]);
+        }
+      }
+      break;
+
+    case PNG_FILTER_AVERAGE:
+      if (Prev != NULL) {
+        for (Index = 0; Index < Bpp; ++Index) {
+          Row[Index] = (UINT8) (Row[Index] + (Prev[Index] >> 1U));
+        }
+        for (; Index < RowBytes; ++Index) {
+          Row[Index] = (UINT8) (Row[Index] + ((Row[Index - Bpp] + Prev[Index]) >> 1U));
+        }
+      } else {
+        for (Index = Bpp; Index < RowBytes; ++Index) {
+          Row[Index] = (UINT8) (Row[Index] + (Row[Index - Bpp] >> 1U));
+        }
+      }
+      break;
+
+    case PNG_FILTER_PAETH:
+      if (Prev != NULL) {
+        for (Index = 0; Index < Bpp; ++Index) {
+          Row[Index] = (UINT8) (Row[Index] + Prev[Index]);
+        }
+        for (; Index < RowBytes; ++Index) {
+          Row[Index] = (UINT8) (Row[Index] + InternalPngPaeth (
+            Row[Index - Bpp],
+            Prev[Index],
+            Prev[Index - Bpp]
+            ));
+        }
+      } else {
+        //
+        // Without the previous line Paeth always predicts the left pixel.
+        //
+        for (Index = Bpp; Index < RowBytes; ++Index) {
+          Row[Index] = (UINT8) (Row[Index] + Row[Index - Bpp]);
+        }
+      }
+      break;
+
+    default:
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+  Converts an unfiltered scanline to BGRA pixels, premultiplying on request.
+**/
+STATIC
+VOID
+InternalPngConvertRow (
+  OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Target,
+  IN  CONST UINT8                    *Row,
+  IN  UINT32                         Width,
+  IN  UINT32                         Bpp,
+  IN  BOOLEAN                        PremultiplyAlpha
+  )
+{
+  UINT32  Index;
+  UINT32  Pixel;
+  UINT8   Red;
+  UINT8   Green;
+  UINT8   Blue;
+  UINT8   Alpha;
+
+  if (Bpp == 4 && !PremultiplyAlpha) {
+    //
+    // RGBA to BGRA is a single word swizzle.
+    //
+    for (Index = 0; Index < Width; ++Index) {
+      Pixel = ReadUnaligned32 ((CONST UINT32 *) &Row[Index * 4]);
+      Pixel = (Pixel & 0xFF00FF00U) | ((Pixel >> 16U) & 0xFFU) | ((Pixel & 0xFFU) << 16U);
+      WriteUnaligned32 ((UINT32 *) &Target[Index], Pixel);
+    }
+    return;
+  }
+
+  for (Index = 0; Index < Width; ++Index, Row += Bpp) {
+    switch (Bpp) {
+      case 4:
+        Red   = Row[0];
+        Green = Row[1];
+        Blue  = Row[2];
+        Alpha = Row[3];
+        break;
+      case 3:
+        Red   = Row[0];
+        Green = Row[1];
+        Blue  = Row[2];
+        Alpha = 0xFF;
+        break;
+      case 2:
+        Red   = Green = Blue = Row[0];
+        Alpha = Row[1];
+        break;
+      default:
+        ASSERT (Bpp == 1);
+        Red   = Green = Blue = Row[0];
+        Alpha = 0xFF;
+        break;
+    }
+
+    if (PremultiplyAlpha && Alpha != 0xFF) {
+      Red   = (UINT8) ((Red   * Alpha) / 0xFF);
+      Green = (UINT8) ((Green * Alpha) / 0xFF);
+      Blue  = (UINT8) ((Blue  * Alpha) / 0xFF);
+    }
+
+    Target[Index].Blue     = Blue;
+    Target[Index].Green    = Green;
+    Target[Index].Red      = Red;
+    Target[Index].Reserved = Alpha;
+  }
+}
+
+VOID
+OcPngContextFree (
+  IN OUT OC_PNG_CONTEXT  *Context
+  )
+{
+  ASSERT (Context != NULL);
+
+  if (Context->Inflated != NULL) {
+    FreePool (Context->Inflated);
+  }
+
+  if (Context->Idat != NULL) {
+    FreePool (Context->Idat);
+  }
+
+  ZeroMem (Context, sizeof (*Context));
+}
+
+STATIC
+EFI_STATUS
+InternalDecodePngToBlt (
+  IN OUT OC_PNG_CONTEXT                 *Context,
+  IN     CONST UINT8                    *Buffer,
+  IN     UINTN                          Size,
+  OUT    EFI_GRAPHICS_OUTPUT_BLT_PIXEL  **Pixels,
+  OUT    UINT32                         *Width,
+  OUT    UINT32                         *Height,
+  IN     BOOLEAN                        PremultiplyAlpha
+  )
+{
+  LodePNGDecompressSettings      Settings;
+  unsigned                       Error;
+
+  CONST UINT8                    *Chunk;
+  CONST UINT8                    *Ihdr;
+  CONST UINT8                    *Idat;
+  UINTN                          Offset;
+  UINT32                         ChunkSize;
+  UINTN                          IdatSize;
+  UINT32                         NumIdat;
+  BOOLEAN                        HasEnd;
+
+  UINT32                         ImageWidth;
+  UINT32                         ImageHeight;
+  UINT8                          ColorType;
+  UINT32                         Bpp;
+  UINT32                         RowBytes;
+  UINTN                          RawSize;
+  UINTN                          PixelsSize;
+
+  UINT8                          *Inflated;
+  UINTN                          InflatedSize;
+  UINT8                          *Row;
+  CONST UINT8                    *Prev;
+  UINT32                         RowIndex;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Target;
+
+  if (Size < PNG_SIGNATURE_SIZE + PNG_CHUNK_HEADER_SIZE + PNG_IHDR_SIZE + PNG_CHUNK_CRC_SIZE
+    || CompareMem (Buffer, mPngSignature, PNG_SIGNATURE_SIZE) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Chunk = Buffer + PNG_SIGNATURE_SIZE;
+  if (InternalPngRead32 (Chunk) != PNG_IHDR_SIZE || !InternalPngChunkIs (Chunk, "IHDR")) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Ihdr        = Chunk + PNG_CHUNK_HEADER_SIZE;
+  ImageWidth  = InternalPngRead32 (&Ihdr[0]);
+  ImageHeight = InternalPngRead32 (&Ihdr[4]);
+  ColorType   = Ihdr[9];
+
+  if (ImageWidth == 0 || ImageHeight == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Only plain 8-bit non-interlaced images are handled here, this is what
+  // themes are made of.
+  //
+  if (Ihdr[8] != 8 || Ihdr[10] != 0 || Ihdr[11] != 0 || Ihdr[12] != 0) {
+    return EFI_UNSUPPORTED;
+  }
+
+  switch (ColorType) {
+    case PNG_COLOR_GRAY:
+      Bpp = 1;
+      break;
+    case PNG_COLOR_RGB:
+      Bpp = 3;
+      break;
+    case PNG_COLOR_GRAY_ALPHA:
+      Bpp = 2;
+      break;
+    case PNG_COLOR_RGBA:
+      Bpp = 4;
+      break;
+    default:
+      return EFI_UNSUPPORTED;
+  }
+
+  if (OcOverflowMulU32 (ImageWidth, Bpp, &RowBytes)
+    || OcOverflowAddMulUN (RowBytes, 1, ImageHeight, &RawSize)
+    || OcOverflowTriMulUN (ImageWidth, ImageHeight, sizeof (**Pixels), &PixelsSize)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Walk the chunks to validate them and locate the image data.
+  //
+  Idat     = NULL;
+  IdatSize = 0;
+  NumIdat  = 0;
+  HasEnd   = FALSE;
+  Offset   = PNG_SIGNATURE_SIZE;
+
+  while (!HasEnd) {
+    if (Size - Offset < PNG_CHUNK_HEADER_SIZE + PNG_CHUNK_CRC_SIZE) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Chunk     = Buffer + Offset;
+    ChunkSize = InternalPngRead32 (Chunk);
+    if (ChunkSize > Size - Offset - PNG_CHUNK_HEADER_SIZE - PNG_CHUNK_CRC_SIZE) {
+      return EFI_INVALID_PARAMETER;
+    }
+
+    if (InternalPngChunkIs (Chunk, "IDAT")) {
+      if (NumIdat == 0) {
+        Idat = Chunk + PNG_CHUNK_HEADER_SIZE;
+      }
+      IdatSize += ChunkSize;
+      ++NumIdat;
+    } else if (InternalPngChunkIs (Chunk, "IEND")) {
+      HasEnd = TRUE;
+    } else if (InternalPngChunkIs (Chunk, "tRNS")) {
+      //
+      // Colour keys are left to the generic decoder.
+      //
+      return EFI_UNSUPPORTED;
+    } else if (Offset != PNG_SIGNATURE_SIZE
+      && (Chunk[sizeof (UINT32)] & 0x20U) == 0
+      && !InternalPngChunkIs (Chunk, "PLTE")) {
+      //
+      // Unknown critical chunk (IHDR is only allowed first).
+      //
+      return EFI_UNSUPPORTED;
+    }
+
+    Offset += PNG_CHUNK_HEADER_SIZE + ChunkSize + PNG_CHUNK_CRC_SIZE;
+  }
+
+  if (NumIdat == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // The compressed stream may be split across several chunks, which must be
+  // concatenated before inflating. A single chunk is inflated in place.
+  //
+  if (NumIdat > 1) {
+    if (!InternalPngReserve (&Context->Idat, &Context->IdatSize, IdatSize)) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    IdatSize = 0;
+    Offset   = PNG_SIGNATURE_SIZE;
+    do {
+      Chunk     = Buffer + Offset;
+      ChunkSize = InternalPngRead32 (Chunk);
+      if (InternalPngChunkIs (Chunk, "IDAT")) {
+        CopyMem (&Context->Idat[IdatSize], Chunk + PNG_CHUNK_HEADER_SIZE, ChunkSize);
+        IdatSize += ChunkSize;
+      }
+      Offset += PNG_CHUNK_HEADER_SIZE + ChunkSize + PNG_CHUNK_CRC_SIZE;
+    } while (!InternalPngChunkIs (Chunk, "IEND"));
+
+    Idat = Context->Idat;
+  }
+
+  if (!InternalPngReserve (&Context->Inflated, &Context->InflatedSize, RawSize)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  lodepng_decompress_settings_init (&Settings);
+
+  //
+  // Inflate into the scratch buffer. lodepng only reallocates it when the
+  // stream is larger than expected, in which case the old buffer is freed.
+  //
+  Inflated     = Context->Inflated;
+  InflatedSize = Context->InflatedSize;
+  Error = lodepng_zlib_decompress (&Inflated, &InflatedSize, Idat, IdatSize, &Settings);
+  if (Inflated != Context->Inflated) {
+    Context->Inflated     = Inflated;
+    Context->InflatedSize = Inflated != NULL ? InflatedSize : 0;
+  }
+
+  if (Error != 0 || InflatedSize < RawSize) {
+    DEBUG ((DEBUG_INFO, "OCPNG: Error while inflating PNG image - %u\n", Error));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Target = AllocatePool (PixelsSize);
+  if (Target == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Unfilter each line and convert it right away while it is still cached.
+  //
+  Prev = NULL;
+  Row  = Inflated;
+  for (RowIndex = 0; RowIndex < ImageHeight; ++RowIndex) {
+    if (!InternalPngUnfilterRow (Row + 1, Prev, RowBytes, Bpp, Row[0])) {
+      FreePool (Target);
+      return EFI_INVALID_PARAMETER;
+    }
+
+    InternalPngConvertRow (
+      &Target[(UINTN) RowIndex * ImageWidth],
+      Row + 1,
+      ImageWidth,
+      Bpp,
+      PremultiplyAlpha
+      );
+
+    Prev = Row + 1;
+    Row += RowBytes + 1;
+  }
+
+  *Pixels = Target;
+  *Width  = ImageWidth;
+  *Height = ImageHeight;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OcDecodePngToBlt (
+  IN OUT OC_PNG_CONTEXT                 *Context  OPTIONAL,
+  IN     CONST VOID                     *Buffer,
+  IN     UINTN                          Size,
+  OUT    EFI_GRAPHICS_OUTPUT_BLT_PIXEL  **Pixels,
+  OUT    UINT32                         *Width,
+  OUT    UINT32                         *Height,
+  IN     BOOLEAN                        PremultiplyAlpha
+  )
+{
+  EFI_STATUS      Status;
+  OC_PNG_CONTEXT  LocalContext;
+
+  ASSERT (Buffer != NULL);
+  ASSERT (Pixels != NULL);
+  ASSERT (Width  != NULL);
+  ASSERT (Height != NULL);
+
+  if (Context != NULL) {
+    return InternalDecodePngToBlt (
+      Context,
+      Buffer,
+      Size,
+      Pixels,
+      Width,
+      Height,
+      PremultiplyAlpha
+      );
+  }
+
+  ZeroMem (&LocalContext, sizeof (LocalContext));
+  Status = InternalDecodePngToBlt (
+    &LocalContext,
+    Buffer,
+    Size,
+    Pixels,
+    Width,
+    Height,
+    PremultiplyAlpha
+    );
+  OcPngContextFree (&LocalContext);
+  return Status;
+}
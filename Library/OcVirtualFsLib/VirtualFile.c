@@ -18,6 +18,7 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/OcCpuLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/OcGuardLib.h>
@@ -184,7 +185,7 @@ VirtualFileRead (
     }
 
     if (ReadBufferSize > 0) {
-      CopyMem (Buffer, &Data->FileBuffer[Data->FilePosition], ReadBufferSize);
+      OcParallelCopyMem (Buffer, &Data->FileBuffer[Data->FilePosition], ReadBufferSize);
       Data->FilePosition += ReadBufferSize;
     }
 
@@ -33,24 +33,34 @@ BmfGetChar (
 
   for (Index = 0; Index < 2; ++Index) {
     //
-    // Binary Search for the character as the list is sorted.
+    // Common characters are resolved through the lookup table, which is
+    // authoritative for its range.
     //
-    Left  = 0;
-    //
-    // As duplicates are not allowed, Right can be ceiled with Char.
-    //
-    Right = MIN (Context->NumChars, Char) - 1;
-    while (Left <= Right) {
+    if (Char < BMF_GLYPH_TABLE_SIZE) {
+      if (Context->GlyphTable[Char] != NULL) {
+        return Context->GlyphTable[Char];
+      }
+    } else {
       //
-      // This cannot wrap around due to the file size limitation.
+      // Binary Search for the character as the list is sorted.
       //
-      Median = (Left + Right) / 2;
-      if (Chars[Median].id == Char) {
-        return &Chars[Median];
-      } else if (Chars[Median].id < Char) {
-        Left  = Median + 1;
-      } else {
-        Right = Median - 1;
+      Left  = 0;
+      //
+      // As duplicates are not allowed, Right can be ceiled with Char.
+      //
+      Right = MIN (Context->NumChars, Char) - 1;
+      while (Left <= Right) {
+        //
+        // This cannot wrap around due to the file size limitation.
+        //
+        Median = (Left + Right) / 2;
+        if (Chars[Median].id == Char) {
+          return &Chars[Median];
+        } else if (Chars[Median].id < Char) {
+          Left  = Median + 1;
+        } else {
+          Right = Median - 1;
+        }
       }
     }
 
@@ -73,13 +83,14 @@ BmfGetKerningPair (
   IN CHAR16             Char2
   )
 {
-  CONST BMF_KERNING_PAIR *Pairs;
+  CONST BMF_KERNING_PAIR  *Pairs;
+  CONST BMF_KERNING_RANGE *Range;
 
-  UINTN                  Left;
-  UINTN                  Right;
-  UINTN                  Median;
+  UINTN                   Left;
+  UINTN                   Right;
+  UINTN                   Median;
 
-  UINTN                  Index;
+  UINTN                   Index;
 
   ASSERT (Context != NULL);
 
@@ -89,6 +100,35 @@ BmfGetKerningPair (
     return NULL;
   }
 
+  if (Char1 < BMF_GLYPH_TABLE_SIZE) {
+    //
+    // The lookup table yields all pairs of the first character, search for
+    // the second character within them. The range is guaranteed to be in
+    // bounds, hence unsorted files only yield unexpected kerning.
+    //
+    Range = &Context->KerningTable[Char1];
+    if (Range->Count == 0) {
+      return NULL;
+    }
+
+    Left  = Range->Start;
+    Right = Range->Start + Range->Count - 1;
+    while (Left <= Right) {
+      Median = (Left + Right) / 2;
+      if (Pairs[Median].second == Char2) {
+        return &Pairs[Median];
+      } else if (Pairs[Median].second < Char2) {
+        Left  = Median + 1;
+      } else if (Median == Range->Start) {
+        break;
+      } else {
+        Right = Median - 1;
+      }
+    }
+
+    return NULL;
+  }
+
   //
   // Binary Search for the first character as the list is sorted.
   //
@@ -161,6 +201,7 @@ BmfContextInitialize (
   INT32                  Advance;
   CONST BMF_CHAR         *Chars;
   CONST BMF_KERNING_PAIR *Pairs;
+  BMF_KERNING_RANGE      *Range;
 
   CONST BMF_CHAR         *Char;
 
@@ -412,9 +453,33 @@ BmfContextInitialize (
   Context->Height  = Context->Common->lineHeight;
   Context->OffsetY = -MinY;
 
+  //
+  // Build the direct character lookup table. This must happen before any
+  // BmfGetChar call, as the table is authoritative for its range.
+  //
+  for (Index = 0; Index < Context->NumChars; ++Index) {
+    if (Chars[Index].id < BMF_GLYPH_TABLE_SIZE) {
+      Context->GlyphTable[Chars[Index].id] = &Chars[Index];
+    }
+  }
+
   Pairs = Context->KerningPairs;
   if (Pairs != NULL) { // According to the docs, kerning pairs are optional
     for (Index = 0; Index < Context->NumKerningPairs; ++Index) {
+      //
+      // Only the first contiguous run of each first character is recorded,
+      // so that the range cannot exceed the pairs block for unsorted files.
+      //
+      if (Pairs[Index].first < BMF_GLYPH_TABLE_SIZE) {
+        Range = &Context->KerningTable[Pairs[Index].first];
+        if (Range->Count == 0) {
+          Range->Start = (UINT32) Index;
+          Range->Count = 1;
+        } else if (Range->Start + Range->Count == Index) {
+          ++Range->Count;
+        }
+      }
+
       Char = BmfGetChar (Context, Pairs[Index].first);
       if (Char == NULL) {
         DEBUG ((
@@ -630,8 +695,9 @@ BlendMem (
   }
 }
 
+STATIC
 BOOLEAN
-GuiGetLabel (
+InternalGetLabel (
   OUT GUI_IMAGE               *LabelImage,
   IN  CONST GUI_FONT_CONTEXT  *Context,
   IN  CONST CHAR16            *String,
@@ -726,6 +792,103 @@ GuiGetLabel (
   return TRUE;
 }
 
+STATIC
+BOOLEAN
+InternalCopyLabel (
+  OUT GUI_IMAGE        *Target,
+  IN  CONST GUI_IMAGE  *Source
+  )
+{
+  Target->Buffer = AllocateCopyPool (
+    (UINT32) Source->Width * (UINT32) Source->Height * sizeof (*Source->Buffer),
+    Source->Buffer
+    );
+  if (Target->Buffer == NULL) {
+    return FALSE;
+  }
+
+  Target->Width  = Source->Width;
+  Target->Height = Source->Height;
+  return TRUE;
+}
+
+STATIC
+VOID
+InternalFreeLabelCacheEntry (
+  IN OUT BMF_LABEL_CACHE_ENTRY  *Entry
+  )
+{
+  if (Entry->String != NULL) {
+    FreePool (Entry->String);
+  }
+
+  if (Entry->Image.Buffer != NULL) {
+    FreePool (Entry->Image.Buffer);
+  }
+
+  ZeroMem (Entry, sizeof (*Entry));
+}
+
+BOOLEAN
+GuiGetLabel (
+  OUT    GUI_IMAGE         *LabelImage,
+  IN OUT GUI_FONT_CONTEXT  *Context,
+  IN     CONST CHAR16      *String,
+  IN     UINTN             StringLen,
+  IN     BOOLEAN           Inverted
+  )
+{
+  BOOLEAN               Result;
+  BMF_LABEL_CACHE_ENTRY *Entry;
+  UINT32                Index;
+
+  ASSERT (LabelImage != NULL);
+  ASSERT (Context    != NULL);
+  ASSERT (String     != NULL);
+
+  //
+  // Labels are identified by their string and colour, the font is implied by
+  // the context owning the cache. The caller owns the returned buffer, hence
+  // cached labels are always copied out.
+  //
+  for (Index = 0; Index < BMF_LABEL_CACHE_SIZE; ++Index) {
+    Entry = &Context->LabelCache[Index];
+    if (Entry->String != NULL
+     && Entry->StringLen == StringLen
+     && Entry->Inverted == Inverted
+     && CompareMem (Entry->String, String, StringLen * sizeof (*String)) == 0) {
+      ++Context->LabelCacheHits;
+      return InternalCopyLabel (LabelImage, &Entry->Image);
+    }
+  }
+
+  ++Context->LabelCacheMisses;
+
+  Result = InternalGetLabel (LabelImage, Context, String, StringLen, Inverted);
+  if (!Result) {
+    return FALSE;
+  }
+
+  //
+  // Replace the oldest entry. Failing to cache is not an error.
+  //
+  Entry = &Context->LabelCache[Context->LabelCacheNext];
+  InternalFreeLabelCacheEntry (Entry);
+
+  Entry->String = AllocateCopyPool (StringLen * sizeof (*String), String);
+  if (Entry->String != NULL) {
+    if (InternalCopyLabel (&Entry->Image, LabelImage)) {
+      Entry->StringLen = StringLen;
+      Entry->Inverted  = Inverted;
+      Context->LabelCacheNext = (Context->LabelCacheNext + 1) % BMF_LABEL_CACHE_SIZE;
+    } else {
+      InternalFreeLabelCacheEntry (Entry);
+    }
+  }
+
+  return TRUE;
+}
+
 BOOLEAN
 GuiFontConstruct (
   OUT GUI_FONT_CONTEXT  *Context,
@@ -775,7 +938,22 @@ GuiFontDestruct (
   IN GUI_FONT_CONTEXT  *Context
   )
 {
+  UINT32  Index;
+
   ASSERT (Context != NULL);
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCUI: Label cache %u hits %u misses\n",
+    Context->LabelCacheHits,
+    Context->LabelCacheMisses
+    ));
+
+  for (Index = 0; Index < BMF_LABEL_CACHE_SIZE; ++Index) {
+    InternalFreeLabelCacheEntry (&Context->LabelCache[Index]);
+  }
+  Context->LabelCacheNext = 0;
+
   if (Context->FontImage.Buffer != NULL) {
     FreePool (Context->FontImage.Buffer);
     Context->FontImage.Buffer = NULL;
@@ -11,6 +11,22 @@
 #include "BmfFile.h"
 #include "OpenCanopy.h"
 
+//
+// Number of leading character IDs resolved through the direct lookup tables.
+// Covers ASCII and Latin-1, which is what entry names are made of in practice.
+//
+#define BMF_GLYPH_TABLE_SIZE  256U
+
+//
+// Maximum number of rendered labels retained by the label cache.
+//
+#define BMF_LABEL_CACHE_SIZE  32U
+
+typedef struct {
+  UINT32  Start;
+  UINT32  Count;
+} BMF_KERNING_RANGE;
+
 typedef struct {
   CONST BMF_BLOCK_INFO          *Info;
   CONST BMF_BLOCK_COMMON        *Common;
@@ -21,12 +37,31 @@ typedef struct {
   UINT32                        NumKerningPairs;
   UINT16                        Height;
   INT16                         OffsetY;
+  //
+  // Direct character lookup, NULL when the character is not in the font.
+  //
+  CONST BMF_CHAR                *GlyphTable[BMF_GLYPH_TABLE_SIZE];
+  //
+  // Kerning pairs range by first character, Count is 0 when there are none.
+  //
+  BMF_KERNING_RANGE             KerningTable[BMF_GLYPH_TABLE_SIZE];
 } BMF_CONTEXT;
 
 typedef struct {
-  GUI_IMAGE   FontImage;
-  BMF_CONTEXT BmfContext;
-  VOID        *KerningData;
+  CHAR16      *String;
+  UINTN       StringLen;
+  BOOLEAN     Inverted;
+  GUI_IMAGE   Image;
+} BMF_LABEL_CACHE_ENTRY;
+
+typedef struct {
+  GUI_IMAGE             FontImage;
+  BMF_CONTEXT           BmfContext;
+  VOID                  *KerningData;
+  BMF_LABEL_CACHE_ENTRY LabelCache[BMF_LABEL_CACHE_SIZE];
+  UINT32                LabelCacheNext;
+  UINT32                LabelCacheHits;
+  UINT32                LabelCacheMisses;
 } GUI_FONT_CONTEXT;
 
 BOOLEAN
@@ -45,11 +80,11 @@ GuiFontDestruct (
 
 BOOLEAN
 GuiGetLabel (
-  OUT GUI_IMAGE               *LabelImage,
-  IN  CONST GUI_FONT_CONTEXT  *Context,
-  IN  CONST CHAR16            *String,
-  IN  UINTN                   StringLen,
-  IN  BOOLEAN                 Inverted
+  OUT    GUI_IMAGE         *LabelImage,
+  IN OUT GUI_FONT_CONTEXT  *Context,
+  IN     CONST CHAR16      *String,
+  IN     UINTN             StringLen,
+  IN     BOOLEAN           Inverted
   );
 
 #endif // BMF_LIB_H
@@ -99,7 +99,8 @@ InternalContextDestruct (
   }
 
   InternalSafeFreePool (Context->Background.Buffer);
-  InternalSafeFreePool (Context->FontContext.FontImage.Buffer);
+  GuiFontDestruct (&Context->FontContext);
+  GuiPngReleaseScratch ();
   /*
   InternalSafeFreePool (Context->Poof[0].Buffer);
   InternalSafeFreePool (Context->Poof[1].Buffer);
@@ -131,7 +132,7 @@ LoadImageFileFromStorage (
   UINT32        Index;
 
   ASSERT (ImageFilePath != NULL);
-  ASSERT (Scale == 1 || Scale == 2);
+  ASSERT (Scale > 0);
 
   ImageCount = Icon ? ICON_TYPE_COUNT : 1; ///< Icons can be external.
 
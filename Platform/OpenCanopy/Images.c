@@ -11,13 +11,20 @@
 #include <IndustryStandard/AppleDiskLabel.h>
 
 #include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/DebugLib.h>
 #include <Library/OcCompressionLib.h>
+#include <Library/OcGuardLib.h>
 #include <Library/OcPngLib.h>
 
 #include "OpenCanopy.h"
 
+//
+// PNG decoding scratch buffers shared by all theme images.
+//
+STATIC OC_PNG_CONTEXT mPngContext;
+
 //
 // Disk label palette.
 //
@@ -42,6 +49,218 @@ gAppleDiskLabelImagePalette[256] = {
   [0xd6] = 0
 };
 
+//
+// PNG-based icon records by their scale relative to the base 1x record.
+//
+STATIC
+CONST UINT32
+mIcnsRecordTypes[] = {
+  APPLE_ICNS_IC07,
+  APPLE_ICNS_IC13,
+  APPLE_ICNS_IC14
+};
+
+STATIC
+CONST UINT8
+mIcnsRecordScales[] = {
+  1,
+  2,
+  4
+};
+
+STATIC_ASSERT (
+  ARRAY_SIZE (mIcnsRecordTypes) == ARRAY_SIZE (mIcnsRecordScales),
+  "Icon record types and scales must match"
+  );
+
+/**
+  Computes the source coordinate and the 8-bit weight of the following
+  sample for bilinear interpolation of target coordinate Index.
+**/
+STATIC
+VOID
+InternalBilinearCoord (
+  IN  UINT32  Index,
+  IN  UINT32  SourceSize,
+  IN  UINT32  TargetSize,
+  OUT UINT32  *Coord,
+  OUT UINT32  *Weight
+  )
+{
+  UINT64  Position;
+
+  //
+  // Sample at pixel centres in 16.16 fixed point.
+  //
+  Position = DivU64x32 (
+    MultU64x32 ((UINT64) (2 * Index + 1) * SourceSize, 0x8000U),
+    TargetSize
+    );
+  if (Position < 0x8000U) {
+    Position = 0;
+  } else {
+    Position -= 0x8000U;
+  }
+
+  *Coord  = (UINT32) RShiftU64 (Position, 16);
+  *Weight = ((UINT32) Position >> 8U) & 0xFFU;
+
+  if (*Coord >= SourceSize - 1) {
+    *Coord  = SourceSize - 1;
+    *Weight = 0;
+  }
+}
+
+STATIC
+UINT8
+InternalBilinearChannel (
+  IN UINT8   P00,
+  IN UINT8   P01,
+  IN UINT8   P10,
+  IN UINT8   P11,
+  IN UINT32  WeightX,
+  IN UINT32  WeightY
+  )
+{
+  UINT32  Top;
+  UINT32  Bottom;
+
+  Top    = P00 * (256 - WeightX) + P01 * WeightX;
+  Bottom = P10 * (256 - WeightX) + P11 * WeightX;
+
+  return (UINT8) ((Top * (256 - WeightY) + Bottom * WeightY + 0x8000U) >> 16U);
+}
+
+EFI_STATUS
+GuiScaleImage (
+  OUT GUI_IMAGE        *Target,
+  IN  CONST GUI_IMAGE  *Source,
+  IN  UINT32           Width,
+  IN  UINT32           Height
+  )
+{
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL        *Buffer;
+  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Row0;
+  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Row1;
+  CONST EFI_GRAPHICS_OUTPUT_BLT_PIXEL  *Pixel;
+  UINTN                                BufferSize;
+  UINT32                               TargetX;
+  UINT32                               TargetY;
+  UINT32                               SourceX0;
+  UINT32                               SourceX1;
+  UINT32                               SourceY0;
+  UINT32                               SourceY1;
+  UINT32                               WeightX;
+  UINT32                               WeightY;
+  UINT32                               X;
+  UINT32                               Y;
+  UINT32                               Count;
+  UINT32                               Sum[4];
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL        *TargetPixel;
+
+  ASSERT (Target != NULL);
+  ASSERT (Source != NULL);
+  ASSERT (Source->Buffer != NULL);
+  ASSERT (Source->Width > 0);
+  ASSERT (Source->Height > 0);
+
+  if (Width == 0 || Height == 0
+    || OcOverflowTriMulUN (Width, Height, sizeof (*Buffer), &BufferSize)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Buffer = AllocatePool (BufferSize);
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  TargetPixel = Buffer;
+
+  //
+  // Images are premultiplied, so channels can be filtered independently.
+  // Downscaling averages the covered source area (box filter), upscaling
+  // interpolates between the closest source pixels (bilinear filter).
+  //
+  if (Width <= Source->Width && Height <= Source->Height) {
+    for (TargetY = 0; TargetY < Height; ++TargetY) {
+      SourceY0 = (TargetY * Source->Height) / Height;
+      SourceY1 = MAX (((TargetY + 1) * Source->Height) / Height, SourceY0 + 1);
+
+      for (TargetX = 0; TargetX < Width; ++TargetX, ++TargetPixel) {
+        SourceX0 = (TargetX * Source->Width) / Width;
+        SourceX1 = MAX (((TargetX + 1) * Source->Width) / Width, SourceX0 + 1);
+
+        ZeroMem (Sum, sizeof (Sum));
+        for (Y = SourceY0; Y < SourceY1; ++Y) {
+          Pixel = &Source->Buffer[Y * Source->Width + SourceX0];
+          for (X = SourceX0; X < SourceX1; ++X, ++Pixel) {
+            Sum[0] += Pixel->Blue;
+            Sum[1] += Pixel->Green;
+            Sum[2] += Pixel->Red;
+            Sum[3] += Pixel->Reserved;
+          }
+        }
+
+        Count = (SourceX1 - SourceX0) * (SourceY1 - SourceY0);
+        TargetPixel->Blue     = (UINT8) ((Sum[0] + Count / 2) / Count);
+        TargetPixel->Green    = (UINT8) ((Sum[1] + Count / 2) / Count);
+        TargetPixel->Red      = (UINT8) ((Sum[2] + Count / 2) / Count);
+        TargetPixel->Reserved = (UINT8) ((Sum[3] + Count / 2) / Count);
+      }
+    }
+  } else {
+    for (TargetY = 0; TargetY < Height; ++TargetY) {
+      InternalBilinearCoord (TargetY, Source->Height, Height, &SourceY0, &WeightY);
+      SourceY1 = MIN (SourceY0 + 1, Source->Height - 1);
+      Row0     = &Source->Buffer[SourceY0 * Source->Width];
+      Row1     = &Source->Buffer[SourceY1 * Source->Width];
+
+      for (TargetX = 0; TargetX < Width; ++TargetX, ++TargetPixel) {
+        InternalBilinearCoord (TargetX, Source->Width, Width, &SourceX0, &WeightX);
+        SourceX1 = MIN (SourceX0 + 1, Source->Width - 1);
+
+        TargetPixel->Blue = InternalBilinearChannel (
+          Row0[SourceX0].Blue,
+          Row0[SourceX1].Blue,
+          Row1[SourceX0].Blue,
+          Row1[SourceX1].Blue,
+          WeightX,
+          WeightY
+          );
+        TargetPixel->Green = InternalBilinearChannel (
+          Row0[SourceX0].Green,
+          Row0[SourceX1].Green,
+          Row1[SourceX0].Green,
+          Row1[SourceX1].Green,
+          WeightX,
+          WeightY
+          );
+        TargetPixel->Red = InternalBilinearChannel (
+          Row0[SourceX0].Red,
+          Row0[SourceX1].Red,
+          Row1[SourceX0].Red,
+          Row1[SourceX1].Red,
+          WeightX,
+          WeightY
+          );
+        TargetPixel->Reserved = InternalBilinearChannel (
+          Row0[SourceX0].Reserved,
+          Row0[SourceX1].Reserved,
+          Row1[SourceX0].Reserved,
+          Row1[SourceX1].Reserved,
+          WeightX,
+          WeightY
+          );
+      }
+    }
+  }
+
+  Target->Width  = Width;
+  Target->Height = Height;
+  Target->Buffer = Buffer;
+  return EFI_SUCCESS;
+}
+
 EFI_STATUS
 GuiIcnsToImageIcon (
   OUT GUI_IMAGE  *Image,
@@ -61,8 +280,14 @@ GuiIcnsToImageIcon (
   APPLE_ICNS_RECORD  *Record;
   APPLE_ICNS_RECORD  *RecordIT32;
   APPLE_ICNS_RECORD  *RecordT8MK;
+  APPLE_ICNS_RECORD  *ScaledRecords[ARRAY_SIZE (mIcnsRecordScales)];
+  UINT32             Index;
+  UINT32             BestIndex;
+  GUI_IMAGE          Source;
+  UINT32             TargetWidth;
+  UINT32             TargetHeight;
 
-  ASSERT (Scale == 1 || Scale == 2);
+  ASSERT (Scale > 0);
 
   //
   // We do not need to support 'it32' 128x128 icon format,
@@ -81,6 +306,7 @@ GuiIcnsToImageIcon (
 
   RecordIT32 = NULL;
   RecordT8MK = NULL;
+  ZeroMem (ScaledRecords, sizeof (ScaledRecords));
 
   Offset  = sizeof (APPLE_ICNS_RECORD);
   while (Offset < IcnsImageSize - sizeof (APPLE_ICNS_RECORD)) {
@@ -99,8 +325,14 @@ GuiIcnsToImageIcon (
       return EFI_SECURITY_VIOLATION;
     }
 
-    if ((Scale == 1 && Record->Type == APPLE_ICNS_IC07)
-      || (Scale == 2 && Record->Type == APPLE_ICNS_IC13)) {
+    for (Index = 0; Index < ARRAY_SIZE (mIcnsRecordScales); ++Index) {
+      if (Record->Type == mIcnsRecordTypes[Index]) {
+        ScaledRecords[Index] = Record;
+        break;
+      }
+    }
+
+    if (Index < ARRAY_SIZE (mIcnsRecordScales) && mIcnsRecordScales[Index] == Scale) {
       Status = GuiPngToImage (
         Image,
         Record->Data,
@@ -108,6 +340,25 @@ GuiIcnsToImageIcon (
         TRUE
         );
 
+      if (!EFI_ERROR (Status) && MatchWidth > 0 && MatchHeight > 0 && !AllowLess
+        && (Image->Width != MatchWidth * Scale || Image->Height != MatchHeight * Scale)
+        && (UINT64) Image->Width * MatchHeight == (UINT64) Image->Height * MatchWidth) {
+        //
+        // Resample icons of the right aspect ratio rather than rejecting them.
+        //
+        DEBUG ((
+          DEBUG_INFO,
+          "OCUI: Resampling %dx%d icon to %dx%d\n",
+          Image->Width,
+          Image->Height,
+          MatchWidth * Scale,
+          MatchHeight * Scale
+          ));
+        CopyMem (&Source, Image, sizeof (Source));
+        Status = GuiScaleImage (Image, &Source, MatchWidth * Scale, MatchHeight * Scale);
+        FreePool (Source.Buffer);
+      }
+
       if (!EFI_ERROR (Status) && MatchWidth > 0 && MatchHeight > 0) {
         if (AllowLess
           ? (Image->Width >  MatchWidth * Scale || Image->Height >  MatchWidth * Scale
@@ -170,7 +421,70 @@ GuiIcnsToImageIcon (
     }
   }
 
-  return EFI_NOT_FOUND;
+  //
+  // There is no record for the requested scale. Resample the smallest record
+  // of a larger scale, or the largest record available otherwise.
+  //
+  BestIndex = ARRAY_SIZE (mIcnsRecordScales);
+  for (Index = 0; Index < ARRAY_SIZE (mIcnsRecordScales); ++Index) {
+    if (ScaledRecords[Index] != NULL) {
+      BestIndex = Index;
+      if (mIcnsRecordScales[Index] >= Scale) {
+        break;
+      }
+    }
+  }
+
+  if (BestIndex == ARRAY_SIZE (mIcnsRecordScales)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Record = ScaledRecords[BestIndex];
+  Status = GuiPngToImage (
+    &Source,
+    Record->Data,
+    SwapBytes32 (Record->Size) - sizeof (APPLE_ICNS_RECORD),
+    TRUE
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (MatchWidth > 0 && MatchHeight > 0 && !AllowLess) {
+    TargetWidth  = MatchWidth  * Scale;
+    TargetHeight = MatchHeight * Scale;
+  } else {
+    TargetWidth  = MAX ((Source.Width  * Scale) / mIcnsRecordScales[BestIndex], 1);
+    TargetHeight = MAX ((Source.Height * Scale) / mIcnsRecordScales[BestIndex], 1);
+
+    if (MatchWidth > 0 && MatchHeight > 0
+      && (TargetWidth > MatchWidth * Scale || TargetHeight > MatchHeight * Scale)) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCUI: Expected at most %dx%d, resampled %dx%d\n",
+        MatchWidth * Scale,
+        MatchHeight * Scale,
+        TargetWidth,
+        TargetHeight
+        ));
+      FreePool (Source.Buffer);
+      return EFI_UNSUPPORTED;
+    }
+  }
+
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "OCUI: Resampling %dx%d icon for scale %u to %dx%d\n",
+    Source.Width,
+    Source.Height,
+    Scale,
+    TargetWidth,
+    TargetHeight
+    ));
+
+  Status = GuiScaleImage (Image, &Source, TargetWidth, TargetHeight);
+  FreePool (Source.Buffer);
+  return Status;
 }
 
 EFI_STATUS
@@ -243,6 +557,22 @@ GuiPngToImage (
   UINTN                            Index;
   UINT8                            TmpChannel;
 
+  Status = OcDecodePngToBlt (
+    &mPngContext,
+    ImageData,
+    ImageDataSize,
+    &Image->Buffer,
+    &Image->Width,
+    &Image->Height,
+    PremultiplyAlpha
+    );
+  if (Status != EFI_UNSUPPORTED) {
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "OCUI: DecodePNG fast - %r\n", Status));
+    }
+    return Status;
+  }
+
   Status = OcDecodePng (
     ImageData,
     ImageDataSize,
@@ -271,6 +601,14 @@ GuiPngToImage (
   return EFI_SUCCESS;
 }
 
+VOID
+GuiPngReleaseScratch (
+  VOID
+  )
+{
+  OcPngContextFree (&mPngContext);
+}
+
 EFI_STATUS
 GuiCreateHighlightedImage (
   OUT GUI_IMAGE                            *SelectedImage,
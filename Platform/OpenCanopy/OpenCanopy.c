@@ -36,6 +36,24 @@ typedef struct {
   UINT32 Height;
 } GUI_DRAW_REQUEST;
 
+//
+// Frame timing histogram buckets, bucket N covers [2^N, 2^(N+1)) microseconds
+// and the last bucket covers everything above.
+//
+#define GUI_FRAME_HISTOGRAM_BUCKETS  16U
+
+typedef struct {
+  UINT32 Interval[GUI_FRAME_HISTOGRAM_BUCKETS];
+  UINT32 Draw[GUI_FRAME_HISTOGRAM_BUCKETS];
+  UINT32 Blt[GUI_FRAME_HISTOGRAM_BUCKETS];
+  UINT64 IntervalTsc;
+  UINT64 DrawTsc;
+  UINT64 BltTsc;
+  UINT32 NumFrames;
+  UINT32 NumMissed;
+  UINT64 NumSkipped;
+} GUI_FRAME_STATS;
+
 //
 // I/O contexts
 //
@@ -52,6 +70,13 @@ STATIC UINT32                        mScreenBufferDelta = 0;
 //
 STATIC UINT64                        mDeltaTscTarget    = 0;
 STATIC UINT64                        mStartTsc          = 0;
+STATIC UINT64                        mLastFlushTsc      = 0;
+//
+// Adaptive frame pacing, only available when the timer event was created.
+//
+STATIC EFI_EVENT                     mFrameTimerEvent   = NULL;
+STATIC UINT64                        mFramesSkipped     = 0;
+STATIC GUI_FRAME_STATS               mFrameStats;
 //
 // Drawing rectangles information
 //
@@ -714,6 +739,122 @@ InternalCpuDelayTsc (
   return Tsc;
 }
 
+/**
+  Waits for at least the given number of ticks.
+
+  When adaptive pacing is enabled, the wait is performed on the frame timer
+  event, which lets the firmware idle and service its timer callbacks
+  (including pointer and key polling) in the meantime. Otherwise the CPU is
+  stalled.
+
+  @param  Delay     A period of time to delay in ticks.
+
+  @returns  The TSC value after waiting.
+**/
+STATIC
+UINT64
+InternalWaitFrame (
+  IN UINT64  Delay
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+  UINT64      Timeout;
+
+  if (mFrameTimerEvent != NULL) {
+    //
+    // Timer periods are in units of 100 ns.
+    //
+    Timeout = DivU64x32 (GetTimeInNanoSecond (Delay), 100);
+    if (Timeout > 0) {
+      Status = gBS->SetTimer (mFrameTimerEvent, TimerRelative, Timeout);
+      if (!EFI_ERROR (Status)) {
+        gBS->WaitForEvent (1, &mFrameTimerEvent, &Index);
+        return AsmReadTsc ();
+      }
+    }
+  }
+
+  return InternalCpuDelayTsc (Delay);
+}
+
+STATIC
+VOID
+InternalRecordFrameTime (
+  IN OUT UINT32  *Histogram,
+  IN OUT UINT64  *Total,
+  IN     UINT64  DeltaTsc
+  )
+{
+  UINT64  Microseconds;
+  UINTN   Bucket;
+
+  *Total += DeltaTsc;
+
+  Microseconds = DivU64x32 (GetTimeInNanoSecond (DeltaTsc), 1000);
+  if (Microseconds == 0) {
+    Bucket = 0;
+  } else {
+    Bucket = MIN ((UINTN) HighBitSet64 (Microseconds), GUI_FRAME_HISTOGRAM_BUCKETS - 1);
+  }
+
+  ++Histogram[Bucket];
+}
+
+STATIC
+VOID
+InternalReportFrameTime (
+  IN CONST CHAR8   *Name,
+  IN CONST UINT32  *Histogram,
+  IN UINT64        Total
+  )
+{
+  UINTN  Index;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCUI: Frame %a average %Lu us\n",
+    Name,
+    DivU64x32 (GetTimeInNanoSecond (Total), 1000 * MAX (mFrameStats.NumFrames, 1))
+    ));
+
+  for (Index = 0; Index < GUI_FRAME_HISTOGRAM_BUCKETS; ++Index) {
+    if (Histogram[Index] > 0) {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCUI: Frame %a %a%u us - %u\n",
+        Name,
+        Index == GUI_FRAME_HISTOGRAM_BUCKETS - 1 ? ">= " : "< ",
+        Index == GUI_FRAME_HISTOGRAM_BUCKETS - 1 ? 1U << Index : 1U << (Index + 1),
+        Histogram[Index]
+        ));
+    }
+  }
+}
+
+STATIC
+VOID
+InternalReportFrameStats (
+  VOID
+  )
+{
+  DEBUG ((
+    DEBUG_INFO,
+    "OCUI: Drew %u frames, %u missed deadline, %Lu animation steps skipped\n",
+    mFrameStats.NumFrames,
+    mFrameStats.NumMissed,
+    mFrameStats.NumSkipped
+    ));
+
+  if (mFrameStats.NumFrames == 0) {
+    return;
+  }
+
+  InternalReportFrameTime ("interval", mFrameStats.Interval, mFrameStats.IntervalTsc);
+  InternalReportFrameTime ("draw", mFrameStats.Draw, mFrameStats.DrawTsc);
+  InternalReportFrameTime ("BLT", mFrameStats.Blt, mFrameStats.BltTsc);
+}
+
 VOID
 GuiFlushScreen (
   IN OUT GUI_DRAWING_CONTEXT  *DrawContext
@@ -721,6 +862,10 @@ GuiFlushScreen (
 {
   UINTN   Index;
 
+  UINT64  DrawStartTsc;
+  UINT64  DrawTsc;
+  UINT64  BltStartTsc;
+  UINT64  BltEndTsc;
   UINT64  EndTsc;
   UINT64  DeltaTsc;
 
@@ -729,6 +874,9 @@ GuiFlushScreen (
   ASSERT (DrawContext->Screen->OffsetX == 0);
   ASSERT (DrawContext->Screen->OffsetY == 0);
   ASSERT (DrawContext->Screen->Draw != NULL);
+
+  DrawStartTsc = AsmReadTsc ();
+
   for (Index = 0; Index < mNumValidDrawReqs; ++Index) {
     DrawContext->Screen->Draw (
       DrawContext->Screen,
@@ -743,18 +891,33 @@ GuiFlushScreen (
       );
   }
   //
-  // Raise the TPL to not interrupt timing or flushing.
+  // Wait for the frame deadline before flushing.
   //
   EndTsc   = AsmReadTsc ();
+  DrawTsc  = EndTsc - DrawStartTsc;
   DeltaTsc = EndTsc - mStartTsc;
   if (DeltaTsc < mDeltaTscTarget) {
-    EndTsc = InternalCpuDelayTsc (mDeltaTscTarget - DeltaTsc);
+    EndTsc = InternalWaitFrame (mDeltaTscTarget - DeltaTsc);
+  } else if (mDeltaTscTarget > 0) {
+    ++mFrameStats.NumMissed;
+    //
+    // With adaptive pacing, report the frame periods that have been lost, so
+    // that animations are advanced accordingly instead of slowing down.
+    //
+    if (mFrameTimerEvent != NULL) {
+      mFramesSkipped = DivU64x64Remainder (DeltaTsc, mDeltaTscTarget, NULL) - 1;
+    }
   }
 
+  BltStartTsc = AsmReadTsc ();
+
   if (mPointerContext != NULL) {
     GuiOverlayPointer (DrawContext);
   }
 
+  DrawTsc    += AsmReadTsc () - BltStartTsc;
+  BltStartTsc = AsmReadTsc ();
+
   for (Index = 0; Index < mNumValidDrawReqs; ++Index) {
     GuiOutputBlt (
       mOutputContext,
@@ -771,6 +934,14 @@ GuiFlushScreen (
   }
 
   mNumValidDrawReqs = 0;
+
+  BltEndTsc = AsmReadTsc ();
+
+  ++mFrameStats.NumFrames;
+  InternalRecordFrameTime (mFrameStats.Interval, &mFrameStats.IntervalTsc, DrawStartTsc - mLastFlushTsc);
+  InternalRecordFrameTime (mFrameStats.Draw, &mFrameStats.DrawTsc, DrawTsc);
+  InternalRecordFrameTime (mFrameStats.Blt, &mFrameStats.BltTsc, BltEndTsc - BltStartTsc);
+  mLastFlushTsc = BltEndTsc;
   //
   // Explicitly include BLT time in the timing calculation.
   // FIXME: GOP takes inconsistently long depending on dimensions.
@@ -786,7 +957,7 @@ GuiRedrawAndFlushScreen (
   ASSERT (DrawContext != NULL);
   ASSERT (DrawContext->Screen != NULL);
 
-  mStartTsc = AsmReadTsc ();
+  mStartTsc = mLastFlushTsc = AsmReadTsc ();
 
   GuiRequestDraw (0, 0, DrawContext->Screen->Width, DrawContext->Screen->Height);
   GuiFlushScreen (DrawContext);
@@ -799,6 +970,7 @@ GuiLibConstruct (
   IN UINT32                   CursorDefaultY
   )
 {
+  EFI_STATUS                                 Status;
   CONST EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *OutputInfo;
 
   mOutputContext = GuiOutputConstruct ();
@@ -852,6 +1024,20 @@ GuiLibConstruct (
 
   mDeltaTscTarget =  DivU64x32 (OcGetTSCFrequency (), 60);
 
+  if ((GuiContext->PickerContext->PickerAttributes & OC_ATTR_USE_ADAPTIVE_PACING) != 0) {
+    Status = gBS->CreateEvent (
+      EVT_TIMER,
+      TPL_CALLBACK,
+      NULL,
+      NULL,
+      &mFrameTimerEvent
+      );
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_WARN, "OCUI: Failed to create frame timer - %r\n", Status));
+      mFrameTimerEvent = NULL;
+    }
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -874,6 +1060,11 @@ GuiLibDestruct (
     GuiKeyDestruct (mKeyContext);
     mKeyContext = NULL;
   }
+
+  if (mFrameTimerEvent != NULL) {
+    gBS->CloseEvent (mFrameTimerEvent);
+    mFrameTimerEvent = NULL;
+  }
 }
 
 VOID
@@ -998,8 +1189,10 @@ GuiDrawLoop (
   ASSERT (DrawContext != NULL);
 
   mNumValidDrawReqs = 0;
+  mFramesSkipped    = 0;
   FrameTime         = 0;
   HoldObject        = NULL;
+  ZeroMem (&mFrameStats, sizeof (mFrameStats));
   //
   // Clear previous inputs.
   //
@@ -1015,7 +1208,7 @@ GuiDrawLoop (
   //
   // Main drawing loop, time and derieve sub-frequencies as required.
   //
-  LastTsc = LoopStartTsc = mStartTsc = AsmReadTsc ();
+  LastTsc = LoopStartTsc = mStartTsc = mLastFlushTsc = AsmReadTsc ();
   do {
     if (mPointerContext != NULL) {
       //
@@ -1152,6 +1345,12 @@ GuiDrawLoop (
     // Flush the changes performed in this refresh iteration.
     //
     GuiFlushScreen (DrawContext);
+    //
+    // Skip the animation steps of frames that could not be drawn in time.
+    //
+    FrameTime              += mFramesSkipped;
+    mFrameStats.NumSkipped += mFramesSkipped;
+    mFramesSkipped          = 0;
 
     NewLastTsc = AsmReadTsc ();
 
@@ -1192,6 +1391,8 @@ GuiDrawLoop (
 
     LastTsc = NewLastTsc;
   } while (!DrawContext->ExitLoop (DrawContext->GuiContext));
+
+  InternalReportFrameStats ();
 }
 
 VOID
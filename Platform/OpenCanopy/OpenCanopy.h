@@ -152,7 +152,31 @@ GuiPngToImage (
   IN  UINTN      ImageDataSize,
   IN  BOOLEAN    PremultiplyAlpha
   );
+
+/**
+  Releases scratch memory retained for decoding theme images.
+**/
+VOID
+GuiPngReleaseScratch (
+  VOID
+  );
   
+/**
+  Resamples an image to the given dimensions.
+
+  @param[out] Target  Resampled image, the buffer is to be freed by the caller.
+  @param[in]  Source  Premultiplied source image.
+  @param[in]  Width   Target width.
+  @param[in]  Height  Target height.
+**/
+EFI_STATUS
+GuiScaleImage (
+  OUT GUI_IMAGE        *Target,
+  IN  CONST GUI_IMAGE  *Source,
+  IN  UINT32           Width,
+  IN  UINT32           Height
+  );
+
 EFI_STATUS
 GuiIcnsToImageIcon (
   OUT GUI_IMAGE  *Image,
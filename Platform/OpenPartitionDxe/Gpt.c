@@ -590,12 +590,7 @@ PartitionCheckGptEntryArrayCRC (
 
   Size    = ((UINTN) PartHeader->NumberOfPartitionEntries) * PartHeader->SizeOfPartitionEntry;
 
-  Status  = gBS->CalculateCrc32 (Ptr, Size, &Crc);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "CheckPEntryArrayCRC: Crc calculation failed\n"));
-    FreePool (Ptr);
-    return FALSE;
-  }
+  Crc     = OcCrc32 (0, Ptr, Size);
 
   FreePool (Ptr);
 
@@ -808,7 +803,7 @@ PartitionSetCrcAltSize (
   UINT32  Crc;
 
   Hdr->CRC32 = 0;
-  gBS->CalculateCrc32 ((UINT8 *) Hdr, Size, &Crc);
+  Crc        = OcCrc32 (0, Hdr, Size);
   Hdr->CRC32 = Crc;
 }
 
@@ -853,7 +848,6 @@ PartitionCheckCrcAltSize (
 {
   UINT32      Crc;
   UINT32      OrgCrc;
-  EFI_STATUS  Status;
 
   Crc = 0;
 
@@ -874,11 +868,8 @@ PartitionCheckCrcAltSize (
   OrgCrc      = Hdr->CRC32;
   Hdr->CRC32  = 0;
 
-  Status      = gBS->CalculateCrc32 ((UINT8 *) Hdr, Size, &Crc);
-  if (EFI_ERROR (Status)) {
-    DEBUG ((EFI_D_ERROR, "CheckCrc32: Crc calculation failed\n"));
-    return FALSE;
-  }
+  Crc         = OcCrc32 (0, Hdr, Size);
+
   //
   // set results
   //
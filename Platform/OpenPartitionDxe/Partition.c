@@ -375,6 +375,63 @@ Exit:
   return Status;
 }
 
+/**
+  Complete all queued read requests with an error. Must be called at TPL_NOTIFY.
+
+  @param  Private  Pointer to the PARTITION_PRIVATE_DATA instance.
+  @param  Status   Transaction status to report.
+**/
+STATIC
+VOID
+PartitionAbortReads (
+  IN PARTITION_PRIVATE_DATA  *Private,
+  IN EFI_STATUS              Status
+  )
+{
+  LIST_ENTRY              *Link;
+  PARTITION_READ_REQUEST  *Request;
+
+  while (!IsListEmpty (&Private->ReadQueue)) {
+    Link    = GetFirstNode (&Private->ReadQueue);
+    Request = PARTITION_READ_REQUEST_FROM_LINK (Link);
+    RemoveEntryList (Link);
+
+    Request->BlockIo2Token->TransactionStatus = Status;
+    gBS->SignalEvent (Request->BlockIo2Token->Event);
+    FreePool (Request);
+  }
+
+  Private->ReadsQueued = 0;
+}
+
+/**
+  Log partition read statistics.
+
+  @param  Private  Pointer to the PARTITION_PRIVATE_DATA instance.
+**/
+STATIC
+VOID
+PartitionReportStats (
+  IN PARTITION_PRIVATE_DATA  *Private
+  )
+{
+  Private->Stats.ReportedQueuedReads = Private->Stats.QueuedReads;
+
+  DEBUG ((
+    EFI_D_INFO,
+    "Partition: %p reads %Lu (%Lu KB) async %Lu queued %Lu coalesced %Lu parent %Lu max queued %u in flight %u\n",
+    Private,
+    Private->Stats.Reads,
+    DivU64x32 (Private->Stats.ReadBytes, SIZE_1KB),
+    Private->Stats.AsyncReads,
+    Private->Stats.QueuedReads,
+    Private->Stats.CoalescedReads,
+    Private->Stats.ParentReads,
+    Private->Stats.MaxQueued,
+    Private->Stats.MaxInFlight
+    ));
+}
+
 /**
   Stop this driver on ControllerHandle. Support stopping any child handles
   created by this driver.
@@ -406,6 +463,8 @@ PartitionDriverBindingStop (
   PARTITION_PRIVATE_DATA  *Private;
   EFI_DISK_IO_PROTOCOL    *DiskIo;
   EFI_GUID                *TypeGuid;
+  EFI_TPL                 OldTpl;
+  UINT32                  ReadsInFlight;
 
   BlockIo  = NULL;
   BlockIo2 = NULL;
@@ -483,6 +542,25 @@ PartitionDriverBindingStop (
     }
     Private->InStop = TRUE;
 
+    //
+    // Reads in flight still reference the private data, and will issue
+    // the queued reads once complete. Otherwise queued reads would never
+    // be issued.
+    //
+    OldTpl        = gBS->RaiseTPL (TPL_NOTIFY);
+    ReadsInFlight = Private->ReadsInFlight;
+    if (ReadsInFlight == 0) {
+      PartitionAbortReads (Private, EFI_ABORTED);
+    }
+    gBS->RestoreTPL (OldTpl);
+
+    if (ReadsInFlight > 0) {
+      DEBUG ((EFI_D_ERROR, "PartitionDriverBindingStop: %u reads in flight\n", ReadsInFlight));
+      Private->InStop    = FALSE;
+      AllChildrenStopped = FALSE;
+      continue;
+    }
+
     BlockIo->FlushBlocks (BlockIo);
 
     if (BlockIo2 != NULL) {
@@ -563,6 +641,10 @@ PartitionDriverBindingStop (
              EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER
              );
     } else {
+      if (Private->Stats.Reads > 0) {
+        PartitionReportStats (Private);
+      }
+
       FreePool (Private->DevicePath);
       FreePool (Private);
     }
@@ -689,6 +771,10 @@ PartitionReadBlocks (
   if (Offset + BufferSize > Private->End) {
     return ProbeMediaStatus (Private->DiskIo, MediaId, EFI_INVALID_PARAMETER);
   }
+
+  ++Private->Stats.Reads;
+  Private->Stats.ReadBytes += BufferSize;
+
   //
   // Because some kinds of partition have different block size from their parent
   // device, we call the Disk IO protocol on the parent device, not the Block IO
@@ -827,9 +913,17 @@ PartitionResetEx (
   )
 {
   PARTITION_PRIVATE_DATA  *Private;
+  EFI_TPL                 OldTpl;
 
   Private = PARTITION_DEVICE_FROM_BLOCK_IO2_THIS (This);
 
+  //
+  // Reads not yet issued to the parent are aborted by the reset.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  PartitionAbortReads (Private, EFI_ABORTED);
+  gBS->RestoreTPL (OldTpl);
+
   return Private->ParentBlockIo2->Reset (
                                     Private->ParentBlockIo2,
                                     ExtendedVerification
@@ -898,6 +992,239 @@ PartitionCreateAccessTask (
   return Task;
 }
 
+/**
+  Complete all read requests served by the parent read and free it.
+
+  @param  Batch   Pointer to the PARTITION_READ_BATCH instance.
+  @param  Status  Transaction status to report.
+**/
+STATIC
+VOID
+PartitionCompleteReadBatch (
+  IN PARTITION_READ_BATCH   *Batch,
+  IN EFI_STATUS             Status
+  )
+{
+  LIST_ENTRY              *Link;
+  PARTITION_READ_REQUEST  *Request;
+  UINT8                   *Data;
+
+  Data = Batch->Bounce;
+
+  while (!IsListEmpty (&Batch->Requests)) {
+    Link    = GetFirstNode (&Batch->Requests);
+    Request = PARTITION_READ_REQUEST_FROM_LINK (Link);
+    RemoveEntryList (Link);
+
+    if (Data != NULL) {
+      if (!EFI_ERROR (Status)) {
+        CopyMem (Request->Buffer, Data, Request->BufferSize);
+      }
+      Data += Request->BufferSize;
+    }
+
+    Request->BlockIo2Token->TransactionStatus = Status;
+    gBS->SignalEvent (Request->BlockIo2Token->Event);
+    FreePool (Request);
+  }
+
+  if (Batch->Bounce != NULL) {
+    FreePool (Batch->Bounce);
+  }
+
+  FreePool (Batch);
+}
+
+STATIC
+VOID
+PartitionPumpReads (
+  IN PARTITION_PRIVATE_DATA  *Private
+  );
+
+/**
+  The callback for the parent reads serving read requests.
+  @param  Event                 Event whose notification function is being invoked.
+  @param  Context               The pointer to the notification function's context,
+                                which points to the PARTITION_READ_BATCH instance.
+**/
+STATIC
+VOID
+EFIAPI
+PartitionOnReadComplete (
+  IN EFI_EVENT                 Event,
+  IN VOID                      *Context
+  )
+{
+  PARTITION_READ_BATCH    *Batch;
+  PARTITION_PRIVATE_DATA  *Private;
+
+  Batch   = (PARTITION_READ_BATCH *) Context;
+  Private = Batch->Private;
+
+  gBS->CloseEvent (Event);
+
+  --Private->ReadsInFlight;
+  PartitionCompleteReadBatch (Batch, Batch->DiskIo2Token.TransactionStatus);
+  PartitionPumpReads (Private);
+
+  //
+  // DriverBindingStop normally never runs before booting, so report
+  // once the queue drains after reads had to be queued.
+  //
+  if (Private->ReadsInFlight == 0
+    && IsListEmpty (&Private->ReadQueue)
+    && Private->Stats.QueuedReads != Private->Stats.ReportedQueuedReads) {
+    PartitionReportStats (Private);
+  }
+}
+
+/**
+  Issue a single parent read for all requests of the batch.
+  Must be called at TPL_NOTIFY.
+
+  @param  Private  Pointer to the PARTITION_PRIVATE_DATA instance.
+  @param  Batch    Pointer to the PARTITION_READ_BATCH instance.
+  @param  Size     Total size of the batch requests.
+
+  @retval EFI_SUCCESS  The parent read was queued.
+  @retval others       The parent read failed, requests were not completed.
+**/
+STATIC
+EFI_STATUS
+PartitionStartReadBatch (
+  IN PARTITION_PRIVATE_DATA  *Private,
+  IN PARTITION_READ_BATCH    *Batch,
+  IN UINTN                   Size
+  )
+{
+  EFI_STATUS              Status;
+  PARTITION_READ_REQUEST  *First;
+
+  First = PARTITION_READ_REQUEST_FROM_LINK (GetFirstNode (&Batch->Requests));
+
+  Status = gBS->CreateEvent (
+                  EVT_NOTIFY_SIGNAL,
+                  TPL_NOTIFY,
+                  PartitionOnReadComplete,
+                  Batch,
+                  &Batch->DiskIo2Token.Event
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Status = Private->DiskIo2->ReadDiskEx (
+                               Private->DiskIo2,
+                               First->MediaId,
+                               First->Offset,
+                               &Batch->DiskIo2Token,
+                               Size,
+                               Batch->Bounce != NULL ? Batch->Bounce : First->Buffer
+                               );
+  if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (Batch->DiskIo2Token.Event);
+    return Status;
+  }
+
+  ++Private->ReadsInFlight;
+  ++Private->Stats.ParentReads;
+  Private->Stats.MaxInFlight = MAX (Private->Stats.MaxInFlight, Private->ReadsInFlight);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Issue queued read requests while there are free parent read slots,
+  coalescing adjacent requests. Must be called at TPL_NOTIFY.
+
+  @param  Private  Pointer to the PARTITION_PRIVATE_DATA instance.
+**/
+STATIC
+VOID
+PartitionPumpReads (
+  IN PARTITION_PRIVATE_DATA  *Private
+  )
+{
+  EFI_STATUS              Status;
+  PARTITION_READ_BATCH    *Batch;
+  PARTITION_READ_REQUEST  *First;
+  PARTITION_READ_REQUEST  *Request;
+  LIST_ENTRY              *Link;
+  UINTN                   Size;
+  UINT32                  Count;
+  UINT32                  Index;
+  BOOLEAN                 Contiguous;
+
+  while (Private->ReadsInFlight < PARTITION_READ_QUEUE_DEPTH
+    && !IsListEmpty (&Private->ReadQueue)) {
+    Batch = AllocatePool (sizeof (*Batch));
+    if (Batch == NULL) {
+      //
+      // Nothing would issue the queued requests later.
+      //
+      if (Private->ReadsInFlight == 0) {
+        PartitionAbortReads (Private, EFI_OUT_OF_RESOURCES);
+      }
+      return;
+    }
+
+    Batch->Private = Private;
+    Batch->Bounce  = NULL;
+    InitializeListHead (&Batch->Requests);
+
+    //
+    // Find the run of queued requests following the first one on disk.
+    //
+    First      = PARTITION_READ_REQUEST_FROM_LINK (GetFirstNode (&Private->ReadQueue));
+    Size       = First->BufferSize;
+    Count      = 1;
+    Contiguous = TRUE;
+    for (Link = GetNextNode (&Private->ReadQueue, &First->Link);
+      !IsNull (&Private->ReadQueue, Link);
+      Link = GetNextNode (&Private->ReadQueue, Link)) {
+      Request = PARTITION_READ_REQUEST_FROM_LINK (Link);
+      if (Request->MediaId != First->MediaId
+        || Request->Offset != First->Offset + Size
+        || Size >= PARTITION_READ_MERGE_SIZE
+        || Request->BufferSize > PARTITION_READ_MERGE_SIZE - Size) {
+        break;
+      }
+
+      if ((UINT8 *) First->Buffer + Size != Request->Buffer) {
+        Contiguous = FALSE;
+      }
+
+      Size += Request->BufferSize;
+      ++Count;
+    }
+
+    //
+    // Requests with scattered buffers are read through a bounce buffer.
+    //
+    if (!Contiguous) {
+      Batch->Bounce = AllocatePool (Size);
+      if (Batch->Bounce == NULL) {
+        Size  = First->BufferSize;
+        Count = 1;
+      }
+    }
+
+    for (Index = 0; Index < Count; ++Index) {
+      Link = GetFirstNode (&Private->ReadQueue);
+      RemoveEntryList (Link);
+      InsertTailList (&Batch->Requests, Link);
+    }
+
+    Private->ReadsQueued          -= Count;
+    Private->Stats.CoalescedReads += Count - 1;
+
+    Status = PartitionStartReadBatch (Private, Batch, Size);
+    if (EFI_ERROR (Status)) {
+      PartitionCompleteReadBatch (Batch, Status);
+    }
+  }
+}
+
 /**
   Read BufferSize bytes from Lba into Buffer.
 
@@ -945,7 +1272,9 @@ PartitionReadBlocksEx (
   EFI_STATUS              Status;
   PARTITION_PRIVATE_DATA  *Private;
   UINT64                  Offset;
-  PARTITION_ACCESS_TASK   *Task;
+  PARTITION_READ_REQUEST  *Request;
+  PARTITION_READ_BATCH    *Batch;
+  EFI_TPL                 OldTpl;
 
   Private = PARTITION_DEVICE_FROM_BLOCK_IO2_THIS (This);
 
@@ -958,17 +1287,64 @@ PartitionReadBlocksEx (
     return ProbeMediaStatusEx (Private->DiskIo2, MediaId, EFI_INVALID_PARAMETER);
   }
 
+  ++Private->Stats.Reads;
+  Private->Stats.ReadBytes += BufferSize;
+
   if ((Token != NULL) && (Token->Event != NULL)) {
-    Task = PartitionCreateAccessTask (Token);
-    if (Task == NULL) {
+    Request = AllocatePool (sizeof (*Request));
+    if (Request == NULL) {
       return EFI_OUT_OF_RESOURCES;
     }
 
-    Status = Private->DiskIo2->ReadDiskEx (Private->DiskIo2, MediaId, Offset, &Task->DiskIo2Token, BufferSize, Buffer);
-    if (EFI_ERROR (Status)) {
-      gBS->CloseEvent (Task->DiskIo2Token.Event);
-      FreePool (Task);
+    Request->Signature     = PARTITION_READ_REQUEST_SIGNATURE;
+    Request->BlockIo2Token = Token;
+    Request->MediaId       = MediaId;
+    Request->Offset        = Offset;
+    Request->BufferSize    = BufferSize;
+    Request->Buffer        = Buffer;
+
+    //
+    // Completion callbacks update the queue, keep them out.
+    //
+    OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+    ++Private->Stats.AsyncReads;
+
+    if (Private->ReadsInFlight < PARTITION_READ_QUEUE_DEPTH && IsListEmpty (&Private->ReadQueue)) {
+      //
+      // Issue the read at once when there is a free slot, so that errors
+      // are reported to the caller directly.
+      //
+      Batch = AllocatePool (sizeof (*Batch));
+      if (Batch != NULL) {
+        Batch->Private = Private;
+        Batch->Bounce  = NULL;
+        InitializeListHead (&Batch->Requests);
+        InsertTailList (&Batch->Requests, &Request->Link);
+
+        Status = PartitionStartReadBatch (Private, Batch, BufferSize);
+        if (EFI_ERROR (Status)) {
+          FreePool (Batch);
+        }
+      } else {
+        Status = EFI_OUT_OF_RESOURCES;
+      }
+
+      if (EFI_ERROR (Status)) {
+        FreePool (Request);
+      }
+    } else {
+      //
+      // All slots are busy, wait for one in the queue where the request
+      // may be coalesced with its neighbours.
+      //
+      InsertTailList (&Private->ReadQueue, &Request->Link);
+      ++Private->ReadsQueued;
+      ++Private->Stats.QueuedReads;
+      Private->Stats.MaxQueued = MAX (Private->Stats.MaxQueued, Private->ReadsQueued);
+      Status = EFI_SUCCESS;
     }
+
+    gBS->RestoreTPL (OldTpl);
   } else {
     Status = Private->DiskIo2->ReadDiskEx (Private->DiskIo2, MediaId, Offset, NULL, BufferSize, Buffer);
   }
@@ -1165,6 +1541,8 @@ PartitionInstallChildHandle (
   Private->DiskIo           = ParentDiskIo;
   Private->DiskIo2          = ParentDiskIo2;
 
+  InitializeListHead (&Private->ReadQueue);
+
   //
   // Set the BlockIO into Private Data.
   //
@@ -32,12 +32,43 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/DevicePathLib.h>
+#include <Library/OcCrc32Lib.h>
 
 #include <IndustryStandard/Apm.h>
 #include <IndustryStandard/Mbr.h>
 #include <IndustryStandard/ElTorito.h>
 #include <IndustryStandard/Udf.h>
 
+//
+// Maximum number of parent reads in flight per partition. Further
+// asynchronous reads are queued, and adjacent queued reads are
+// coalesced into a single parent read once a slot is free.
+//
+#define PARTITION_READ_QUEUE_DEPTH  8
+
+//
+// Maximum size of a coalesced parent read.
+//
+#define PARTITION_READ_MERGE_SIZE   SIZE_1MB
+
+//
+// Partition I/O statistics
+//
+typedef struct {
+  UINT64                       Reads;
+  UINT64                       ReadBytes;
+  UINT64                       AsyncReads;
+  UINT64                       QueuedReads;
+  UINT64                       CoalescedReads;
+  UINT64                       ParentReads;
+  UINT32                       MaxQueued;
+  UINT32                       MaxInFlight;
+  //
+  // QueuedReads value at the last report.
+  //
+  UINT64                       ReportedQueuedReads;
+} PARTITION_IO_STATS;
+
 //
 // Partition private data
 //
@@ -65,6 +96,11 @@ typedef struct {
   EFI_GUID                     TypeGuid;
 
   APPLE_PARTITION_INFO_PROTOCOL ApplePartitionInfo;
+
+  LIST_ENTRY                   ReadQueue;
+  UINT32                       ReadsQueued;
+  UINT32                       ReadsInFlight;
+  PARTITION_IO_STATS           Stats;
 } PARTITION_PRIVATE_DATA;
 
 typedef struct {
@@ -72,6 +108,32 @@ typedef struct {
   EFI_BLOCK_IO2_TOKEN          *BlockIo2Token;
 } PARTITION_ACCESS_TASK;
 
+//
+// Asynchronous read request
+//
+#define PARTITION_READ_REQUEST_SIGNATURE  SIGNATURE_32 ('P', 'a', 'r', 'r')
+typedef struct {
+  UINT32                       Signature;
+  LIST_ENTRY                   Link;
+  EFI_BLOCK_IO2_TOKEN          *BlockIo2Token;
+  UINT32                       MediaId;
+  UINT64                       Offset;
+  UINTN                        BufferSize;
+  VOID                         *Buffer;
+} PARTITION_READ_REQUEST;
+
+#define PARTITION_READ_REQUEST_FROM_LINK(a) CR (a, PARTITION_READ_REQUEST, Link, PARTITION_READ_REQUEST_SIGNATURE)
+
+//
+// Parent read serving one or more adjacent read requests
+//
+typedef struct {
+  EFI_DISK_IO2_TOKEN           DiskIo2Token;
+  PARTITION_PRIVATE_DATA       *Private;
+  LIST_ENTRY                   Requests;
+  VOID                         *Bounce;
+} PARTITION_READ_BATCH;
+
 #define PARTITION_DEVICE_FROM_BLOCK_IO_THIS(a)  CR (a, PARTITION_PRIVATE_DATA, BlockIo, PARTITION_PRIVATE_DATA_SIGNATURE)
 #define PARTITION_DEVICE_FROM_BLOCK_IO2_THIS(a) CR (a, PARTITION_PRIVATE_DATA, BlockIo2, PARTITION_PRIVATE_DATA_SIGNATURE)
 
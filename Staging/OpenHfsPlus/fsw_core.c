@@ -42,7 +42,10 @@
 
 static void fsw_blockcache_free(struct fsw_volume *vol);
 
-#define MAX_CACHE_LEVEL (5)
+#define MAX_CACHE_LEVEL (FSW_BCACHE_LEVELS - 1)
+
+/** Spread physical block numbers across block cache hash buckets. */
+#define FSW_BCACHE_HASH(bno) ((fsw_u32)((bno) * 0x9E3779B1U) >> 8)
 
 
 /**
@@ -80,6 +83,8 @@ fsw_status_t fsw_mount(void *host_data,
     vol->host_table     = host_table;
     vol->fstype_table   = fstype_table;
     vol->host_string_type = host_table->native_string_type;
+    vol->bcache_budget  = FSW_BCACHE_BUDGET;
+    vol->bcache_free    = FSW_BCACHE_NONE;
     
     // let the fs driver mount the file system
     status = vol->fstype_table->volume_mount(vol);
@@ -112,6 +117,9 @@ void fsw_unmount(struct fsw_volume *vol)
     
     vol->fstype_table->volume_free(vol);
     
+    FSW_MSG_DEBUG((FSW_MSGSTR("fsw_unmount: block cache %d hits, %d misses, %d evictions, %d read ahead, %d direct\n"),
+                   vol->bcache_hits, vol->bcache_misses, vol->bcache_evictions, vol->bcache_readahead,
+                   vol->bcache_direct));
     fsw_blockcache_free(vol);
     fsw_strfree(&vol->label);
     fsw_free(vol);
@@ -159,6 +167,214 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
     vol->log_blocksize = log_blocksize;
 }
 
+/**
+ * Find a block in the block cache. Returns the entry index or FSW_BCACHE_NONE.
+ */
+
+static fsw_u32 fsw_blockcache_lookup(struct fsw_volume *vol, fsw_u32 phys_bno)
+{
+    fsw_u32 i;
+    
+    if (vol->bcache_hash == NULL)
+        return FSW_BCACHE_NONE;
+    
+    for (i = vol->bcache_hash[FSW_BCACHE_HASH(phys_bno) & vol->bcache_hash_mask];
+         i != FSW_BCACHE_NONE; i = vol->bcache[i].hash_next) {
+        if (vol->bcache[i].phys_bno == phys_bno)
+            return i;
+    }
+    return FSW_BCACHE_NONE;
+}
+
+/**
+ * Put a block cache entry at the head of the LRU list of its level.
+ */
+
+static void fsw_blockcache_lru_push(struct fsw_volume *vol, fsw_u32 i)
+{
+    struct fsw_blockcache *entry = &vol->bcache[i];
+    
+    entry->lru_prev = FSW_BCACHE_NONE;
+    entry->lru_next = vol->bcache_lru_head[entry->cache_level];
+    if (entry->lru_next != FSW_BCACHE_NONE)
+        vol->bcache[entry->lru_next].lru_prev = i;
+    else
+        vol->bcache_lru_tail[entry->cache_level] = i;
+    vol->bcache_lru_head[entry->cache_level] = i;
+}
+
+/**
+ * Remove a block cache entry from the LRU list of its level.
+ */
+
+static void fsw_blockcache_lru_remove(struct fsw_volume *vol, fsw_u32 i)
+{
+    struct fsw_blockcache *entry = &vol->bcache[i];
+    
+    if (entry->lru_prev != FSW_BCACHE_NONE)
+        vol->bcache[entry->lru_prev].lru_next = entry->lru_next;
+    else
+        vol->bcache_lru_head[entry->cache_level] = entry->lru_next;
+    if (entry->lru_next != FSW_BCACHE_NONE)
+        vol->bcache[entry->lru_next].lru_prev = entry->lru_prev;
+    else
+        vol->bcache_lru_tail[entry->cache_level] = entry->lru_prev;
+}
+
+/**
+ * Remove a block cache entry from its hash chain.
+ */
+
+static void fsw_blockcache_hash_remove(struct fsw_volume *vol, fsw_u32 i)
+{
+    fsw_u32 *link;
+    
+    link = &vol->bcache_hash[FSW_BCACHE_HASH(vol->bcache[i].phys_bno) & vol->bcache_hash_mask];
+    while (*link != i)
+        link = &vol->bcache[*link].hash_next;
+    *link = vol->bcache[i].hash_next;
+}
+
+/**
+ * Add an entry filled with block data to the block cache.
+ */
+
+static void fsw_blockcache_insert(struct fsw_volume *vol, fsw_u32 i, fsw_u32 phys_bno,
+                                  fsw_u32 cache_level, fsw_u32 refcount)
+{
+    fsw_u32 *bucket;
+    
+    bucket = &vol->bcache_hash[FSW_BCACHE_HASH(phys_bno) & vol->bcache_hash_mask];
+    
+    vol->bcache[i].phys_bno = phys_bno;
+    vol->bcache[i].cache_level = cache_level;
+    vol->bcache[i].refcount = refcount;
+    vol->bcache[i].hash_next = *bucket;
+    *bucket = i;
+    fsw_blockcache_lru_push(vol, i);
+}
+
+/**
+ * Return an entry obtained from fsw_blockcache_alloc to the free list unused.
+ */
+
+static void fsw_blockcache_discard(struct fsw_volume *vol, fsw_u32 i)
+{
+    vol->bcache[i].phys_bno = FSW_INVALID_BNO;
+    vol->bcache[i].hash_next = vol->bcache_free;
+    vol->bcache_free = i;
+}
+
+/**
+ * Enlarge the block cache entry array, creating it and the hash table on first use.
+ * New entries are put on the free list.
+ */
+
+static fsw_status_t fsw_blockcache_grow(struct fsw_volume *vol, fsw_u32 new_bcache_size)
+{
+    fsw_status_t    status;
+    fsw_u32         i, hash_size;
+    struct fsw_blockcache *new_bcache;
+    
+    if (vol->bcache_hash == NULL) {
+        // size the table for the budget, chains only get longer when going above it
+        for (hash_size = 16; hash_size < vol->bcache_budget / vol->phys_blocksize && hash_size < (1U << 20); hash_size <<= 1)
+            ;
+        status = fsw_alloc(hash_size * sizeof(fsw_u32), &vol->bcache_hash);
+        if (status)
+            return status;
+        for (i = 0; i < hash_size; i++)
+            vol->bcache_hash[i] = FSW_BCACHE_NONE;
+        vol->bcache_hash_mask = hash_size - 1;
+        for (i = 0; i < FSW_BCACHE_LEVELS; i++) {
+            vol->bcache_lru_head[i] = FSW_BCACHE_NONE;
+            vol->bcache_lru_tail[i] = FSW_BCACHE_NONE;
+        }
+        vol->bcache_free = FSW_BCACHE_NONE;
+    }
+    
+    status = fsw_alloc(new_bcache_size * sizeof(struct fsw_blockcache), &new_bcache);
+    if (status)
+        return status;
+    if (vol->bcache_size > 0)
+        fsw_memcpy(new_bcache, vol->bcache, vol->bcache_size * sizeof(struct fsw_blockcache));
+    for (i = new_bcache_size; i > vol->bcache_size; i--) {
+        new_bcache[i - 1].refcount = 0;
+        new_bcache[i - 1].cache_level = 0;
+        new_bcache[i - 1].phys_bno = FSW_INVALID_BNO;
+        new_bcache[i - 1].hash_next = vol->bcache_free;
+        new_bcache[i - 1].lru_prev = FSW_BCACHE_NONE;
+        new_bcache[i - 1].lru_next = FSW_BCACHE_NONE;
+        new_bcache[i - 1].data = NULL;
+        vol->bcache_free = i - 1;
+    }
+    
+    // switch caches
+    if (vol->bcache != NULL)
+        fsw_free(vol->bcache);
+    vol->bcache = new_bcache;
+    vol->bcache_size = new_bcache_size;
+    return FSW_SUCCESS;
+}
+
+/**
+ * Get an unused block cache entry. The cache grows up to its byte budget, after that
+ * the least recently used unreferenced block of the lowest level is evicted. The cache
+ * only goes above the budget when all blocks are referenced.
+ */
+
+static fsw_status_t fsw_blockcache_alloc(struct fsw_volume *vol, fsw_u32 *index_out)
+{
+    fsw_status_t    status;
+    fsw_u32         i, level, max_entries, new_bcache_size;
+    
+    max_entries = vol->bcache_budget / vol->phys_blocksize;
+    if (max_entries < 16)
+        max_entries = 16;
+    
+    if (vol->bcache_free == FSW_BCACHE_NONE && vol->bcache_size >= max_entries) {
+        for (level = 0; level < FSW_BCACHE_LEVELS; level++) {
+            for (i = vol->bcache_lru_tail[level]; i != FSW_BCACHE_NONE; i = vol->bcache[i].lru_prev) {
+                if (vol->bcache[i].refcount == 0) {
+                    fsw_blockcache_lru_remove(vol, i);
+                    fsw_blockcache_hash_remove(vol, i);
+                    vol->bcache[i].phys_bno = FSW_INVALID_BNO;
+                    vol->bcache_evictions++;
+                    *index_out = i;
+                    return FSW_SUCCESS;
+                }
+            }
+        }
+    }
+    
+    if (vol->bcache_free == FSW_BCACHE_NONE) {
+        // enlarge / create the cache
+        if (vol->bcache_size < max_entries)
+            new_bcache_size = vol->bcache_size < 16 ? 16 : vol->bcache_size << 1;
+        else
+            new_bcache_size = vol->bcache_size + 16;
+        if (vol->bcache_size < max_entries && new_bcache_size > max_entries)
+            new_bcache_size = max_entries;
+        status = fsw_blockcache_grow(vol, new_bcache_size);
+        if (status)
+            return status;
+    }
+    
+    i = vol->bcache_free;
+    vol->bcache_free = vol->bcache[i].hash_next;
+    
+    if (vol->bcache[i].data == NULL) {
+        status = fsw_alloc(vol->phys_blocksize, &vol->bcache[i].data);
+        if (status) {
+            fsw_blockcache_discard(vol, i);
+            return status;
+        }
+    }
+    
+    *index_out = i;
+    return FSW_SUCCESS;
+}
+
 /**
  * Get a block of data from the disk. This function is called by the file system driver
  * or by core functions. It calls through to the host driver's device access routine.
@@ -172,6 +388,8 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
  *  - 2: File system metadata
  *  - 3..5: File system metadata with a high rate of access
  *
+ * Within a level the least recently used blocks are purged first.
+ *
  * If this function returns successfully, the returned data pointer is valid until the
  * caller calls fsw_block_release.
  */
@@ -179,8 +397,7 @@ void fsw_set_blocksize(struct fsw_volume *vol, fsw_u32 phys_blocksize, fsw_u32 l
 fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out)
 {
     fsw_status_t    status;
-    fsw_u32         i, discard_level, new_bcache_size;
-    struct fsw_blockcache *new_bcache;
+    fsw_u32         i;
     
     // TODO: allow the host driver to do its own caching; just call through if
     //  the appropriate function pointers are set
@@ -189,72 +406,32 @@ fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32
         cache_level = MAX_CACHE_LEVEL;
     
     // check block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno) {
-            // cache hit!
-            if (vol->bcache[i].cache_level < cache_level)
-                vol->bcache[i].cache_level = cache_level;  // promote the entry
-            vol->bcache[i].refcount++;
-            *buffer_out = vol->bcache[i].data;
-            return FSW_SUCCESS;
-        }
+    i = fsw_blockcache_lookup(vol, phys_bno);
+    if (i != FSW_BCACHE_NONE) {
+        // cache hit!
+        vol->bcache_hits++;
+        fsw_blockcache_lru_remove(vol, i);
+        if (vol->bcache[i].cache_level < cache_level)
+            vol->bcache[i].cache_level = cache_level;  // promote the entry
+        fsw_blockcache_lru_push(vol, i);
+        vol->bcache[i].refcount++;
+        *buffer_out = vol->bcache[i].data;
+        return FSW_SUCCESS;
     }
     
-    // find a free entry in the cache table
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == FSW_INVALID_BNO)
-            break;
-    }
-    if (i >= vol->bcache_size) {
-        for (discard_level = 0; discard_level <= MAX_CACHE_LEVEL; discard_level++) {
-            for (i = 0; i < vol->bcache_size; i++) {
-                if (vol->bcache[i].refcount == 0 && vol->bcache[i].cache_level <= discard_level)
-                    break;
-            }
-            if (i < vol->bcache_size)
-                break;
-        }
-    }
-    if (i >= vol->bcache_size) {
-        // enlarge / create the cache
-        if (vol->bcache_size < 16)
-            new_bcache_size = 16;
-        else
-            new_bcache_size = vol->bcache_size << 1;
-        status = fsw_alloc(new_bcache_size * sizeof(struct fsw_blockcache), &new_bcache);
-        if (status)
-            return status;
-        if (vol->bcache_size > 0)
-            fsw_memcpy(new_bcache, vol->bcache, vol->bcache_size * sizeof(struct fsw_blockcache));
-        for (i = vol->bcache_size; i < new_bcache_size; i++) {
-            new_bcache[i].refcount = 0;
-            new_bcache[i].cache_level = 0;
-            new_bcache[i].phys_bno = FSW_INVALID_BNO;
-            new_bcache[i].data = NULL;
-        }
-        i = vol->bcache_size;
-        
-        // switch caches
-        if (vol->bcache != NULL)
-            fsw_free(vol->bcache);
-        vol->bcache = new_bcache;
-        vol->bcache_size = new_bcache_size;
-    }
-    vol->bcache[i].phys_bno = FSW_INVALID_BNO;
+    vol->bcache_misses++;
+    status = fsw_blockcache_alloc(vol, &i);
+    if (status)
+        return status;
     
     // read the data
-    if (vol->bcache[i].data == NULL) {
-        status = fsw_alloc(vol->phys_blocksize, &vol->bcache[i].data);
-        if (status)
-            return status;
-    }
     status = vol->host_table->read_block(vol, phys_bno, vol->bcache[i].data);
-    if (status)
+    if (status) {
+        fsw_blockcache_discard(vol, i);
         return status;
+    }
     
-    vol->bcache[i].phys_bno = phys_bno;
-    vol->bcache[i].cache_level = cache_level;
-    vol->bcache[i].refcount = 1;
+    fsw_blockcache_insert(vol, i, phys_bno, cache_level, 1);
     *buffer_out = vol->bcache[i].data;
     return FSW_SUCCESS;
 }
@@ -272,12 +449,76 @@ void fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer
     //  the appropriate function pointers are set
     
     // update block cache
-    for (i = 0; i < vol->bcache_size; i++) {
-        if (vol->bcache[i].phys_bno == phys_bno && vol->bcache[i].refcount > 0)
-            vol->bcache[i].refcount--;
+    i = fsw_blockcache_lookup(vol, phys_bno);
+    if (i != FSW_BCACHE_NONE && vol->bcache[i].refcount > 0)
+        vol->bcache[i].refcount--;
+}
+
+/**
+ * Fetch a run of consecutive blocks into the block cache with a single disk access.
+ * This function is called when the caller knows it is going to need the blocks
+ * following phys_bno soon. Reading stops at the first block already cached.
+ * Blocks are cached unreferenced with the given cache level. Failures are not
+ * reported, fsw_block_get will simply read the blocks on its own.
+ */
+
+void fsw_block_readahead(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 count, fsw_u32 cache_level)
+{
+    fsw_status_t    status;
+    fsw_u32         i, n, max_entries;
+    
+    if (vol->host_table->read_blocks == NULL)
+        return;
+    
+    if (cache_level > MAX_CACHE_LEVEL)
+        cache_level = MAX_CACHE_LEVEL;
+    
+    // never let read-ahead flush more than half of the cache
+    max_entries = vol->bcache_budget / vol->phys_blocksize / 2;
+    if (count > max_entries)
+        count = max_entries;
+    if (count > FSW_READAHEAD_BLOCKS)
+        count = FSW_READAHEAD_BLOCKS;
+    
+    for (n = 0; n < count && phys_bno + n >= phys_bno; n++) {
+        if (fsw_blockcache_lookup(vol, phys_bno + n) != FSW_BCACHE_NONE)
+            break;
+    }
+    if (n < 2)
+        return;
+    
+    if (vol->ra_buffer == NULL) {
+        status = fsw_alloc(FSW_READAHEAD_BLOCKS * vol->phys_blocksize, &vol->ra_buffer);
+        if (status)
+            return;
+    }
+    
+    status = vol->host_table->read_blocks(vol, phys_bno, n, vol->ra_buffer);
+    if (status)
+        return;
+    
+    for (count = 0; count < n; count++) {
+        status = fsw_blockcache_alloc(vol, &i);
+        if (status)
+            return;
+        fsw_memcpy(vol->bcache[i].data, (fsw_u8 *)vol->ra_buffer + count * vol->phys_blocksize,
+                   vol->phys_blocksize);
+        fsw_blockcache_insert(vol, i, phys_bno + count, cache_level, 0);
+        vol->bcache_readahead++;
     }
 }
 
+/**
+ * Set the block cache size limit in bytes. The cache is dropped, so this function
+ * must not be called while blocks obtained from fsw_block_get are held.
+ */
+
+void fsw_set_blockcache_budget(struct VOLSTRUCTNAME *vol, fsw_u32 budget)
+{
+    fsw_blockcache_free(vol);
+    vol->bcache_budget = budget;
+}
+
 /**
  * Release the block cache. Called internally when changing block sizes and when
  * unmounting the volume. It frees all data occupied by the generic block cache.
@@ -296,6 +537,15 @@ static void fsw_blockcache_free(struct fsw_volume *vol)
         vol->bcache = NULL;
     }
     vol->bcache_size = 0;
+    vol->bcache_free = FSW_BCACHE_NONE;
+    if (vol->bcache_hash != NULL) {
+        fsw_free(vol->bcache_hash);
+        vol->bcache_hash = NULL;
+    }
+    if (vol->ra_buffer != NULL) {
+        fsw_free(vol->ra_buffer);
+        vol->ra_buffer = NULL;
+    }
 }
 
 /**
@@ -833,6 +1083,7 @@ fsw_status_t fsw_shandle_open(struct fsw_dnode *dno, struct fsw_shandle *shand)
     
     shand->dnode = dno;
     shand->pos = 0;
+    shand->ra_pos = 0;
     shand->extent.type = FSW_EXTENT_TYPE_INVALID;
     
     return FSW_SUCCESS;
@@ -865,7 +1116,7 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     fsw_u8          *buffer, *block_buffer;
     fsw_u32         buflen, copylen, pos;
     fsw_u32         log_bno, pos_in_extent, phys_bno, pos_in_physblock;
-    fsw_u32         cache_level;
+    fsw_u32         cache_level, ra_count, ra_limit, ext_left;
     
     if (shand->pos >= dno->size) {   // already at EOF
         *buffer_size_inout = 0;
@@ -881,6 +1132,9 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     if (buflen > dno->size - pos)
         buflen = (fsw_u32)(dno->size - pos);
     
+    // continuing where the previous read ended, fetch ahead of the request
+    ra_limit = (pos == shand->ra_pos) ? FSW_READAHEAD_BLOCKS : 0;
+    
     while (buflen > 0) {
         // get extent for the current logical block
         log_bno = pos / vol->log_blocksize;
@@ -907,18 +1161,43 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
             // convert to physical block number and offset
             phys_bno = shand->extent.phys_start + pos_in_extent / vol->phys_blocksize;
             pos_in_physblock = pos_in_extent & (vol->phys_blocksize - 1);
-            copylen = vol->phys_blocksize - pos_in_physblock;
-            if (copylen > buflen)
-                copylen = buflen;
+            ext_left = shand->extent.log_count * (vol->log_blocksize / vol->phys_blocksize)
+                - pos_in_extent / vol->phys_blocksize;
             
-            // get one physical block
-            status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
-            if (status)
-                return status;
-            
-            // copy data from it
-            fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
-            fsw_block_release(vol, phys_bno, block_buffer);
+            if (cache_level == 0 && pos_in_physblock == 0 && vol->host_table->read_blocks != NULL
+                && buflen / vol->phys_blocksize >= FSW_DIRECT_READ_BLOCKS && ext_left > 1) {
+                // large file data read, transfer the whole blocks within the extent
+                // straight into the caller buffer with a single disk access
+                ra_count = buflen / vol->phys_blocksize;
+                if (ra_count > ext_left)
+                    ra_count = ext_left;
+                status = vol->host_table->read_blocks(vol, phys_bno, ra_count, buffer);
+                if (status)
+                    return status;
+                copylen = ra_count * vol->phys_blocksize;
+                vol->bcache_direct += ra_count;
+                
+            } else {
+                copylen = vol->phys_blocksize - pos_in_physblock;
+                if (copylen > buflen)
+                    copylen = buflen;
+                
+                // read the rest of the request within the extent at once
+                ra_count = (buflen - copylen + vol->phys_blocksize - 1) / vol->phys_blocksize + 1 + ra_limit;
+                if (ra_count > ext_left)
+                    ra_count = ext_left;
+                if (ra_count > 1)
+                    fsw_block_readahead(vol, phys_bno, ra_count, cache_level);
+                
+                // get one physical block
+                status = fsw_block_get(vol, phys_bno, cache_level, (void **)&block_buffer);
+                if (status)
+                    return status;
+                
+                // copy data from it
+                fsw_memcpy(buffer, block_buffer + pos_in_physblock, copylen);
+                fsw_block_release(vol, phys_bno, block_buffer);
+            }
             
         } else if (shand->extent.type == FSW_EXTENT_TYPE_BUFFER) {
             copylen = shand->extent.log_count * vol->log_blocksize - pos_in_extent;
@@ -941,6 +1220,7 @@ fsw_status_t fsw_shandle_read(struct fsw_shandle *shand, fsw_u32 *buffer_size_in
     
     *buffer_size_inout = (fsw_u32)(pos - shand->pos);
     shand->pos = pos;
+    shand->ra_pos = pos;
     
     return FSW_SUCCESS;
 }
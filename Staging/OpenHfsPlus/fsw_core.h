@@ -55,6 +55,27 @@
 /** Indicates that the block cache entry is empty. */
 #define FSW_INVALID_BNO (~0U)
 
+/** Terminates block cache hash chains and LRU lists. */
+#define FSW_BCACHE_NONE (~0U)
+
+/** Number of block cache levels, see fsw_block_get. */
+#define FSW_BCACHE_LEVELS (6)
+
+/** Default block cache size limit in bytes, see fsw_set_blockcache_budget. */
+#ifndef FSW_BCACHE_BUDGET
+#define FSW_BCACHE_BUDGET (2 * 1024 * 1024)
+#endif
+
+/** Maximum number of physical blocks fetched at once by read-ahead. */
+#ifndef FSW_READAHEAD_BLOCKS
+#define FSW_READAHEAD_BLOCKS (32)
+#endif
+
+/** Minimum file data read size in physical blocks to bypass the block cache. */
+#ifndef FSW_DIRECT_READ_BLOCKS
+#define FSW_DIRECT_READ_BLOCKS FSW_READAHEAD_BLOCKS
+#endif
+
 
 //
 // Byte-swapping macros
@@ -211,6 +232,9 @@ struct fsw_blockcache {
     fsw_u32     refcount;           //!< Reference count
     fsw_u32     cache_level;        //!< Level of importance of this block
     fsw_u32     phys_bno;           //!< Physical block number
+    fsw_u32     hash_next;          //!< Next entry in the hash chain or the free list
+    fsw_u32     lru_prev;           //!< More recently used entry of the same level
+    fsw_u32     lru_next;           //!< Less recently used entry of the same level
     void        *data;              //!< Block data buffer
 };
 
@@ -229,6 +253,18 @@ struct fsw_volume {
     
     struct fsw_blockcache *bcache;  //!< Array of block cache entries
     fsw_u32     bcache_size;        //!< Number of entries in the block cache array
+    fsw_u32     *bcache_hash;       //!< Hash buckets with first entry of each chain
+    fsw_u32     bcache_hash_mask;   //!< Number of hash buckets minus one
+    fsw_u32     bcache_lru_head[FSW_BCACHE_LEVELS]; //!< Most recently used entry per level
+    fsw_u32     bcache_lru_tail[FSW_BCACHE_LEVELS]; //!< Least recently used entry per level
+    fsw_u32     bcache_free;        //!< First unused entry
+    fsw_u32     bcache_budget;      //!< Block cache size limit in bytes
+    fsw_u32     bcache_hits;        //!< Number of blocks found in the cache
+    fsw_u32     bcache_misses;      //!< Number of blocks read from the disk
+    fsw_u32     bcache_evictions;   //!< Number of blocks dropped to make room
+    fsw_u32     bcache_readahead;   //!< Number of blocks fetched ahead of time
+    fsw_u32     bcache_direct;      //!< Number of blocks read bypassing the cache
+    void        *ra_buffer;         //!< Read-ahead buffer for FSW_READAHEAD_BLOCKS blocks
     
     void        *host_data;         //!< Hook for a host-specific data structure
     struct fsw_host_table *host_table;      //!< Dispatch table for host-specific functions
@@ -306,6 +342,7 @@ struct fsw_shandle {
     struct fsw_dnode *dnode;        //!< The dnode this handle reads data from
     
     fsw_u64     pos;                //!< Current file pointer in bytes
+    fsw_u64     ra_pos;             //!< File pointer after the last read, for read-ahead
     struct fsw_extent extent;       //!< Current extent
 };
 
@@ -350,6 +387,7 @@ struct fsw_host_table
                                      fsw_u32 old_phys_blocksize, fsw_u32 old_log_blocksize,
                                      fsw_u32 new_phys_blocksize, fsw_u32 new_log_blocksize);
     fsw_status_t (*read_block)(struct fsw_volume *vol, fsw_u32 phys_bno, void *buffer);
+    fsw_status_t (*read_blocks)(struct fsw_volume *vol, fsw_u32 phys_bno, fsw_u32 count, void *buffer); //!< Optional multi-block read
 };
 
 /**
@@ -398,6 +436,8 @@ fsw_status_t fsw_volume_stat(struct fsw_volume *vol, struct fsw_volume_stat *sb)
 void         fsw_set_blocksize(struct VOLSTRUCTNAME *vol, fsw_u32 phys_blocksize, fsw_u32 log_blocksize);
 fsw_status_t fsw_block_get(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 cache_level, void **buffer_out);
 void         fsw_block_release(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, void *buffer);
+void         fsw_block_readahead(struct VOLSTRUCTNAME *vol, fsw_u32 phys_bno, fsw_u32 count, fsw_u32 cache_level);
+void         fsw_set_blockcache_budget(struct VOLSTRUCTNAME *vol, fsw_u32 budget);
 
 /*@}*/
 
@@ -227,7 +227,8 @@ fsw_hfsplus_thread_cmp(HFSPlusBTKey *tk /* in */, HFSPlusBTKey *sk /* in */);
 
 /** Compare an on-disk catalog B-Tree trial key ('tk') with an in-memory
  * search key ('sk'). Precedence is parentID, nodeName (keyLength does not
- * factor into the comparison).
+ * factor into the comparison). The 'sk' nodeName must be case folded
+ * with fsw_hfsplus_fold_key().
  * @param sk search key
  * @param on-disk catalog B-Tree trial key
  * @return -1/0/1 if 'tk'is smaller/equal/larger than 'sk', respectively.
@@ -247,6 +248,32 @@ static fsw_status_t
 fsw_hfsplus_fswstr2unistr(HFSUniStr255* t /* out */,
                           struct fsw_string* src /* in */);
 
+/**
+ * Case fold catalog search key name in place, so that the fold is done
+ * once per lookup instead of on every key comparison.
+ * @param sk catalog search key
+ */
+static void
+fsw_hfsplus_fold_key(HFSPlusCatalogKey *sk /* in/out */);
+
+/**
+ * Find the catalog record for the child of 'parent_id' named 'name'.
+ * Results, including misses, are remembered in the volume catalog
+ * lookup cache, repeated lookups do not descend the B-Tree.
+ * @param v volume
+ * @param parent_id parent folder id
+ * @param name child name
+ * @param btnode caller-provided B-Tree node buffer
+ * @param rec_out catalog record, points into 'btnode'
+ * @return FSW_SUCCESS on success, FSW_NOT_FOUND if there is no such child
+ */
+static fsw_status_t
+fsw_hfsplus_cat_lookup(struct fsw_hfsplus_volume *v, /* in */
+                       fsw_u32 parent_id, /* in */
+                       struct fsw_string *name, /* in */
+                       BTNodeDescriptor *btnode, /* out */
+                       HFSPlusCatalogRecord **rec_out /* out */);
+
 /* Search an HFS+ special file's B-Tree (given by 'bt'), for a search key
  * matching 'sk', using comparison procedure 'k_cmp' to determine when a key
  * match occurs;
@@ -469,6 +496,11 @@ fsw_hfsplus_vol_mount(struct fsw_hfsplus_volume *v)
     if (status)
         return status;
 
+    // set up catalog lookup cache, lookups work without it
+    if (fsw_alloc_zero(FSW_HFSPLUS_DCACHE_SIZE * sizeof(struct fsw_hfsplus_dentry),
+                       (void **)&v->dcache))
+        v->dcache = NULL;
+
     // set up root folder:
     status = fsw_dnode_create_root(v, kHFSRootFolderID, &v->g.root);
     if (status)
@@ -512,6 +544,11 @@ fsw_hfsplus_vol_free(struct fsw_hfsplus_volume *v)
         fsw_free(v->vh);
     if (v->catf)
         fsw_dnode_release((struct fsw_dnode *)v->catf);
+    if (v->dcache) {
+        FSW_MSG_DEBUG((FSW_MSGSTR("FswHfsPlus: catalog lookup cache hits %d misses %d\n"),
+                       v->dcache_hits, v->dcache_misses));
+        fsw_free(v->dcache);
+    }
 }
 
 static fsw_status_t
@@ -530,9 +567,7 @@ fsw_hfsplus_dno_fill(struct fsw_hfsplus_volume *v, struct fsw_hfsplus_dnode *d)
 {
     fsw_status_t                status;
     struct fsw_hfsplus_dnode    *parent;
-    HFSPlusCatalogKey           sk, *tk;
     HFSPlusCatalogRecord        *rec;
-    fsw_u32                     rec_num;
     BTNodeDescriptor            *btnode;
 
     // pre-allocate bt-node buffer for use by search function:
@@ -541,20 +576,11 @@ fsw_hfsplus_dno_fill(struct fsw_hfsplus_volume *v, struct fsw_hfsplus_dnode *d)
         return status;
     }
 
-    sk.parentID = d->parent_id;
-    status = fsw_hfsplus_fswstr2unistr(&(sk.nodeName), &(d->g.name));
+    status = fsw_hfsplus_cat_lookup(v, d->parent_id, &(d->g.name), btnode, &rec);
     if (status) {
         goto done;
     }
 
-    status = fsw_hfsplus_bt_search(v->catf,
-                                   (HFSPlusBTKey *)&sk,
-                                   fsw_hfsplus_cat_cmp,
-                                   btnode, &rec_num);
-
-    tk = (HFSPlusCatalogKey *) fsw_hfsplus_btnode_get_rec(btnode, v->catf->bt_ndsz, rec_num);
-    rec = (HFSPlusCatalogRecord *) fsw_hfsplus_bt_rec_skip_key((HFSPlusBTKey *)tk);
-
     status = fsw_hfsplus_dnid2dnode(v, d->parent_id, &parent);
     if (status) {
        goto done;
@@ -758,9 +784,9 @@ fsw_hfsplus_cat_cmp(HFSPlusBTKey *tk, HFSPlusBTKey *sk)
             t_str++;
         }
 
-        // find next valid char from memory key string:
+        // find next valid char from memory key string (already folded):
         while (s_char == 0 && s_len > 0) {
-            s_char = fsw_hfsplus_ucblatin_tolower(*s_str);
+            s_char = *s_str;
             s_len--;
             s_str++;
         }
@@ -832,6 +858,106 @@ fsw_hfsplus_fswstr2unistr(HFSUniStr255* t, struct fsw_string* src)
     return status;
 }
 
+static void
+fsw_hfsplus_fold_key(HFSPlusCatalogKey *sk)
+{
+    fsw_u16 i;
+
+    for (i = 0; i < sk->nodeName.length; i++)
+        sk->nodeName.unicode[i] = fsw_hfsplus_ucblatin_tolower(sk->nodeName.unicode[i]);
+}
+
+static fsw_status_t
+fsw_hfsplus_cat_lookup(struct fsw_hfsplus_volume *v, fsw_u32 parent_id,
+                       struct fsw_string *name, BTNodeDescriptor *btnode,
+                       HFSPlusCatalogRecord **rec_out)
+{
+    HFSPlusCatalogKey           sk, *tk;
+    HFSPlusCatalogRecord        *rec;
+    struct fsw_hfsplus_dentry   *de;
+    fsw_status_t                status;
+    fsw_u32                     rec_num;
+    fsw_u32                     rec_size;
+    fsw_u32                     hash;
+    fsw_u16                     i;
+
+    sk.parentID = parent_id;
+    status = fsw_hfsplus_fswstr2unistr(&(sk.nodeName), name);
+    if (status)
+        return status;
+    fsw_hfsplus_fold_key(&sk);
+
+    FSW_MSG_DEBUG((FSW_MSGSTR("FswHfsPlus: cat_lookup: parent=%d name: "), parent_id));
+    for (i = 0; i < sk.nodeName.length; i++)
+        FSW_MSG_DEBUG((FSW_MSGSTR("%c"), sk.nodeName.unicode[i]));
+    FSW_MSG_DEBUG((FSW_MSGSTR("\n")));
+
+    // direct mapped cache slot, long names are never cached
+    de = NULL;
+    if (v->dcache != NULL && sk.nodeName.length <= FSW_HFSPLUS_DCACHE_NAME_MAX) {
+        hash = parent_id * 0x9E3779B1U;
+        for (i = 0; i < sk.nodeName.length; i++)
+            hash = (hash ^ sk.nodeName.unicode[i]) * 0x01000193U;
+        de = &v->dcache[(hash ^ (hash >> 16)) & (FSW_HFSPLUS_DCACHE_SIZE - 1)];
+
+        if (de->parent_id == parent_id && de->name_len == sk.nodeName.length &&
+            fsw_memeq(de->name, sk.nodeName.unicode, sk.nodeName.length * sizeof(fsw_u16))) {
+            v->dcache_hits++;
+            if (!de->found)
+                return FSW_NOT_FOUND;
+            fsw_memcpy(btnode, de->rec, sizeof(de->rec));
+            *rec_out = (HFSPlusCatalogRecord *)btnode;
+            return FSW_SUCCESS;
+        }
+    }
+
+    v->dcache_misses++;
+
+    status = fsw_hfsplus_bt_search(v->catf,
+                                   (HFSPlusBTKey *)&sk,
+                                   fsw_hfsplus_cat_cmp,
+                                   btnode, &rec_num);
+    if (status != FSW_SUCCESS && status != FSW_NOT_FOUND)
+        return status;
+
+    rec = NULL;
+    rec_size = 0;
+    if (status == FSW_SUCCESS) {
+        tk = (HFSPlusCatalogKey *)fsw_hfsplus_btnode_get_rec(btnode, v->catf->bt_ndsz, rec_num);
+        rec = (HFSPlusCatalogRecord *)fsw_hfsplus_bt_rec_skip_key((HFSPlusBTKey *)tk);
+
+        // only folder and file records are worth remembering,
+        // and only when they are wholly within the node
+        switch (fsw_u16_be_swap(rec->recordType)) {
+            case kHFSPlusFolderRecord:
+                rec_size = sizeof(HFSPlusCatalogFolder);
+                break;
+            case kHFSPlusFileRecord:
+                rec_size = sizeof(HFSPlusCatalogFile);
+                break;
+            default:
+                break;
+        }
+        if ((fsw_u8 *)rec + rec_size > (fsw_u8 *)btnode + v->catf->bt_ndsz)
+            rec_size = 0;
+    }
+
+    if (de != NULL && (status == FSW_NOT_FOUND || rec_size > 0)) {
+        de->parent_id = parent_id;
+        de->name_len = sk.nodeName.length;
+        de->found = (status == FSW_SUCCESS);
+        fsw_memcpy(de->name, sk.nodeName.unicode, sk.nodeName.length * sizeof(fsw_u16));
+        if (rec_size > 0)
+            fsw_memcpy(de->rec, rec, rec_size);
+    }
+
+    if (status)
+        return status;
+
+    *rec_out = rec;
+    return FSW_SUCCESS;
+}
+
 static fsw_status_t
 fsw_hfsplus_btree_get_rec(struct fsw_hfsplus_dnode *bt,
                         fsw_u32 parent_id,
@@ -997,23 +1123,8 @@ fsw_hfsplus_dir_get(struct fsw_hfsplus_volume *v, struct fsw_hfsplus_dnode *d,
                     struct fsw_string *name, struct fsw_hfsplus_dnode **d_out)
 {
     BTNodeDescriptor     *btnode;
-    HFSPlusCatalogKey    sk, *tk;
     HFSPlusCatalogRecord *rec;
     fsw_status_t         status;
-    fsw_u32              rec_num;
-    fsw_u32 i;
-
-    // search catalog file for child named by 'name':
-    sk.parentID = d->g.dnode_id;
-    status = fsw_hfsplus_fswstr2unistr(&(sk.nodeName), name);
-
-    if (status)
-        return status;
-
-    FSW_MSG_DEBUG((FSW_MSGSTR("FswHfsPlus: dir_get: parent=%d name: "), d->g.dnode_id));
-    for (i = 0; i < sk.nodeName.length; i++)
-        FSW_MSG_DEBUG((FSW_MSGSTR("%c"), ((fsw_u16 *)sk.nodeName.unicode)[i]));
-    FSW_MSG_DEBUG((FSW_MSGSTR("\n")));
 
     // pre-allocate bt-node buffer for use by search function:
     status = fsw_alloc(v->catf->bt_ndsz, &btnode);
@@ -1021,17 +1132,12 @@ fsw_hfsplus_dir_get(struct fsw_hfsplus_volume *v, struct fsw_hfsplus_dnode *d,
         return status;
     }
 
-    status = fsw_hfsplus_bt_search(v->catf,
-                                   (HFSPlusBTKey *)&sk,
-                                   fsw_hfsplus_cat_cmp,
-                                   btnode,
-                                   &rec_num);
+    // search catalog file for child named by 'name':
+    status = fsw_hfsplus_cat_lookup(v, d->g.dnode_id, name, btnode, &rec);
     if (status) {
         goto done;
     }
 
-    tk = (HFSPlusCatalogKey *)fsw_hfsplus_btnode_get_rec(btnode, v->catf->bt_ndsz, rec_num);
-    rec = fsw_hfsplus_bt_rec_skip_key((HFSPlusBTKey *)tk);
     status = fsw_hfsplus_dnode_create_full(rec, d, name, d_out);
 
 done:
@@ -1235,35 +1341,21 @@ fsw_hfsplus_thread2dnode(struct fsw_hfsplus_volume *v, HFSPlusCatalogThread *thr
 {
     fsw_status_t            status;
     struct fsw_string       name;
-    fsw_u32                 rec_num;
-    HFSPlusCatalogKey       sk, *tk;
     HFSPlusCatalogRecord    *rec;
 
-    // Prepare search key
-    sk.parentID = fsw_u32_be_swap(thread->parentID);
-
+    // Prepare search name
     name.len = fsw_u16_be_swap(thread->nodeName.length);
     name.size = sizeof(fsw_u16) * name.len;
     name.data = thread->nodeName.unicode;
     name.type = FSW_STRING_TYPE_UTF16_BE;
-    
-    status = fsw_hfsplus_fswstr2unistr(&(sk.nodeName), &name);
-    if (status) {
-        return status;
-    }
 
     // Try to find btree node by its parent id and name
-    status = fsw_hfsplus_bt_search(v->catf,
-                                   (HFSPlusBTKey *)&sk,
-                                   fsw_hfsplus_cat_cmp,
-                                   btnode, &rec_num);
+    status = fsw_hfsplus_cat_lookup(v, fsw_u32_be_swap(thread->parentID),
+                                    &name, btnode, &rec);
     if (status) {
         return status;
     }
-    
-    tk = (HFSPlusCatalogKey *) fsw_hfsplus_btnode_get_rec(btnode, v->catf->bt_ndsz, rec_num);
-    rec = (HFSPlusCatalogRecord *) fsw_hfsplus_bt_rec_skip_key((HFSPlusBTKey *)tk);
-    
+
     // Just a sanity check
     switch (fsw_u16_be_swap(rec->recordType)) {
         case kHFSPlusFolderRecord:
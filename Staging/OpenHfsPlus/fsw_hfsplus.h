@@ -287,6 +287,24 @@ typedef struct {
 /* FSW: key comparison procedure type */
 typedef int (*k_cmp_t)(HFSPlusBTKey*, HFSPlusBTKey*);
 
+// FSW: number of catalog lookup cache entries (power of two)
+#ifndef FSW_HFSPLUS_DCACHE_SIZE
+#define FSW_HFSPLUS_DCACHE_SIZE 256
+#endif
+
+// FSW: longest name kept in the catalog lookup cache
+#define FSW_HFSPLUS_DCACHE_NAME_MAX 48
+
+// FSW: catalog lookup cache entry, remembers the catalog record found
+// for a parent id and case folded name, or that there is none
+struct fsw_hfsplus_dentry {
+    fsw_u32 parent_id;              // parent folder id, 0 for unused entries
+    fsw_u16 name_len;               // folded name length
+    fsw_u16 found;                  // non-zero if rec holds the catalog record
+    fsw_u16 name[FSW_HFSPLUS_DCACHE_NAME_MAX]; // case folded name
+    fsw_u8  rec[sizeof(HFSPlusCatalogFile)];   // raw folder or file record
+};
+
 // FSW: HFS+ specific dnode
 struct fsw_hfsplus_dnode {
     struct fsw_dnode g;             // Generic (parent) dnode structure
@@ -309,6 +327,9 @@ struct fsw_hfsplus_volume {
     struct fsw_volume g;            // Generic (parent) volume structure
     HFSPlusVolumeHeader *vh;        // Raw HFS+ Volume Header
     struct fsw_hfsplus_dnode *catf; // Catalog file dnode
+    struct fsw_hfsplus_dentry *dcache; // Catalog lookup cache
+    fsw_u32 dcache_hits;            // Lookups answered from the cache
+    fsw_u32 dcache_misses;          // Lookups requiring a B-Tree search
 };
 
 #endif // _FSW_HFSPLUS_H_
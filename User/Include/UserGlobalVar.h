@@ -71,6 +71,7 @@ extern EFI_GUID     gEfiLegacyRegionProtocolGuid;
 extern EFI_GUID     gEfiLegacyRegion2ProtocolGuid;
 extern EFI_GUID     gEfiPciRootBridgeIoProtocolGuid;
 extern EFI_GUID     gEfiSmbiosTableGuid;
+extern EFI_GUID     gEfiMemoryAttributesTableGuid;
 
 extern EFI_GUID     gOcVendorVariableGuid;
 extern EFI_GUID     gOcCustomSmbios3TableGuid;
@@ -56,6 +56,7 @@ EFI_GUID gEfiLegacyRegionProtocolGuid        = { 0x0fc9013a, 0x0568, 0x4ba9, { 0
 EFI_GUID gEfiLegacyRegion2ProtocolGuid       = { 0x70101eaf, 0x85,   0x440c, { 0xb3, 0x56, 0x8e, 0xe3, 0x6f, 0xef, 0x24, 0xf0 }};
 EFI_GUID gEfiPciRootBridgeIoProtocolGuid     = { 0x2F707EBB, 0x4A1A, 0x11D4, { 0x9A, 0x38, 0x00, 0x90, 0x27, 0x3F, 0xC1, 0x4D }};
 EFI_GUID gEfiSmbiosTableGuid                 = { 0xEB9D2D31, 0x2D88, 0x11D3, { 0x9A, 0x16, 0x00, 0x90, 0x27, 0x3F, 0xC1, 0x4D }};
+EFI_GUID gEfiMemoryAttributesTableGuid       = { 0xDCFA911D, 0x26EB, 0x469F, { 0xA2, 0x20, 0x38, 0xB7, 0xDC, 0x46, 0x12, 0x20 }};
 
 EFI_GUID gOcVendorVariableGuid               = { 0x4D1FDA02, 0x38C7, 0x4A6A, { 0x9C, 0xC6, 0x4B, 0xCC, 0xA8, 0xB3, 0x01, 0x02 }};
 EFI_GUID gOcCustomSmbios3TableGuid           = { 0xF2FD1545, 0x9794, 0x4A2C, { 0x99, 0x2E, 0xE5, 0xBB, 0xCF, 0x20, 0xE3, 0x94 }};
@@ -0,0 +1,176 @@
+#!/usr/bin/env python3
+
+"""
+Decoder for OpenCore TraceBootServices log output.
+
+Copyright (c) 2021, vit9696
+
+All rights reserved.
+
+This program and the accompanying materials
+are licensed and made available under the terms and conditions of the BSD License
+which accompanies this distribution.  The full text of the license may be found at
+http://opensource.org/licenses/bsd-license.php
+
+THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+"""
+
+import argparse
+import re
+import sys
+
+TRACE_BEGIN = re.compile(r'OCABC: TR begin (\d+) events (\d+) kept TSC (\d+) Hz')
+TRACE_SUM   = re.compile(r'OCABC: TR sum (\w+) (\d+) calls (\d+) us')
+TRACE_ENTRY = re.compile(r'OCABC: TR (\d+) (\w+) ([0-9A-Fa-f]+) ([0-9A-Fa-f]+) ([0-9A-Fa-f]+) ([0-9A-Fa-f]+) ([0-9A-Fa-f]+) ([0-9A-Fa-f]+)')
+TRACE_END   = re.compile(r'OCABC: TR end')
+
+MEMORY_TYPES = [
+  'Reserved', 'LoaderCode', 'LoaderData', 'BootServicesCode', 'BootServicesData',
+  'RuntimeServicesCode', 'RuntimeServicesData', 'Conventional', 'Unusable',
+  'ACPIReclaim', 'ACPINVS', 'MMIO', 'MMIOPortSpace', 'PalCode', 'Persistent'
+]
+
+STATUS_CODES = {
+  0x00: 'Success',
+  0x81: 'Load Error',
+  0x82: 'Invalid Parameter',
+  0x83: 'Unsupported',
+  0x85: 'Buffer Too Small',
+  0x89: 'Out of Resources',
+  0x8E: 'Not Found'
+}
+
+def parse_traces(lines):
+  traces = []
+  trace  = None
+
+  for line in lines:
+    match = TRACE_BEGIN.search(line)
+    if match:
+      trace = {
+        'events': int(match.group(1)),
+        'kept': int(match.group(2)),
+        'frequency': int(match.group(3)),
+        'sums': [],
+        'entries': []
+      }
+      continue
+
+    if trace is None:
+      continue
+
+    match = TRACE_SUM.search(line)
+    if match:
+      trace['sums'].append((match.group(1), int(match.group(2)), int(match.group(3))))
+      continue
+
+    match = TRACE_ENTRY.search(line)
+    if match:
+      trace['entries'].append({
+        'index': int(match.group(1)),
+        'event': match.group(2),
+        'tsc': int(match.group(3), 16),
+        'duration': int(match.group(4), 16),
+        'status': int(match.group(5), 16),
+        'type': int(match.group(6), 16),
+        'address': int(match.group(7), 16),
+        'size': int(match.group(8), 16)
+      })
+      continue
+
+    if TRACE_END.search(line):
+      traces.append(trace)
+      trace = None
+
+  return traces
+
+def ticks_to_us(ticks, frequency):
+  if frequency == 0:
+    return 0.0
+  return ticks * 1000000.0 / frequency
+
+def describe(entry):
+  event = entry['event']
+  if event == 'GetMemoryMap':
+    return 'key 0x{:X} size 0x{:X}'.format(entry['address'], entry['size'])
+  if event == 'ExitBootServices':
+    return 'key 0x{:X}'.format(entry['address'])
+
+  text = '0x{:X}'.format(entry['address'])
+  if entry['size'] != 0:
+    text += ' size 0x{:X}'.format(entry['size'])
+  if event in ('AllocatePages', 'AllocatePool'):
+    memtype = entry['type']
+    text += ' ' + (MEMORY_TYPES[memtype] if memtype < len(MEMORY_TYPES) else '0x{:X}'.format(memtype))
+  return text
+
+def print_trace(trace, top):
+  frequency = trace['frequency']
+  entries   = trace['entries']
+
+  print('Trace of {} events, {} kept, TSC {} Hz'.format(trace['events'], trace['kept'], frequency))
+  print('')
+  print('{:<18} {:>8} {:>12} {:>10}'.format('Call', 'Count', 'Total (us)', 'Avg (us)'))
+  for name, calls, total in trace['sums']:
+    average = total / calls if calls != 0 else 0
+    print('{:<18} {:>8} {:>12} {:>10.2f}'.format(name, calls, total, average))
+  print('')
+
+  if len(entries) == 0:
+    return
+
+  base = entries[0]['tsc']
+  prev = base
+
+  print('{:>7} {:>12} {:>10} {:>10}  {:<18} {:<18} {}'.format(
+    'Index', 'Time (us)', 'Gap (us)', 'Dur (us)', 'Call', 'Status', 'Details'))
+  for entry in entries:
+    status = STATUS_CODES.get(entry['status'], '0x{:02X}'.format(entry['status']))
+    print('{:>7} {:>12.1f} {:>10.1f} {:>10.2f}  {:<18} {:<18} {}'.format(
+      entry['index'],
+      ticks_to_us(entry['tsc'] - base, frequency),
+      ticks_to_us(entry['tsc'] - prev, frequency),
+      ticks_to_us(entry['duration'], frequency),
+      entry['event'],
+      status,
+      describe(entry)
+      ))
+    prev = entry['tsc']
+
+  if top > 0:
+    print('')
+    print('Slowest {} calls:'.format(top))
+    for entry in sorted(entries, key=lambda e: e['duration'], reverse=True)[:top]:
+      print('{:>7} {:>10.2f} us  {:<18} {}'.format(
+        entry['index'],
+        ticks_to_us(entry['duration'], frequency),
+        entry['event'],
+        describe(entry)
+        ))
+
+def main():
+  parser = argparse.ArgumentParser(description='Decode OpenCore TraceBootServices output into a timeline.')
+  parser.add_argument('log', nargs='?', help='OpenCore log file, standard input when omitted')
+  parser.add_argument('--top', type=int, default=10, help='number of slowest calls to list')
+  args = parser.parse_args()
+
+  if args.log is None:
+    traces = parse_traces(sys.stdin)
+  else:
+    with open(args.log, 'r', errors='replace') as fd:
+      traces = parse_traces(fd)
+
+  if len(traces) == 0:
+    print('No complete boot services trace found')
+    return 1
+
+  for index, trace in enumerate(traces):
+    if index > 0:
+      print('')
+    print_trace(trace, args.top)
+
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,276 @@
+/** @file
+  Copyright (c) 2021, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <UserFile.h>
+
+#include "OcApfsInternal.h"
+
+//
+// Blocks per batch, roughly a small checkpoint descriptor area.
+//
+#define TEST_BATCH_BLOCKS  8
+
+STATIC UINT32  mRandomState = 0x1BADB002;
+
+STATIC
+UINT32
+TestRandom (
+  VOID
+  )
+{
+  //
+  // Xorshift32, keeps generated blocks identical between runs.
+  //
+  mRandomState ^= mRandomState << 13U;
+  mRandomState ^= mRandomState >> 17U;
+  mRandomState ^= mRandomState << 5U;
+  return mRandomState;
+}
+
+/**
+  Straightforward Fletcher-64 as described by APFS reference,
+  with modulo on every step.
+**/
+STATIC
+UINT64
+TestReferenceFletcher64 (
+  CONST UINT32  *Data,
+  UINTN         WordCount
+  )
+{
+  UINT64  Sum1;
+  UINT64  Sum2;
+  UINT64  Check1;
+  UINT64  Check2;
+  UINTN   Index;
+
+  Sum1 = 0;
+  Sum2 = 0;
+
+  for (Index = 0; Index < WordCount; ++Index) {
+    Sum1 = (Sum1 + Data[Index]) % MAX_UINT32;
+    Sum2 = (Sum2 + Sum1) % MAX_UINT32;
+  }
+
+  Check1 = MAX_UINT32 - ((Sum1 + Sum2) % MAX_UINT32);
+  Check2 = MAX_UINT32 - ((Sum1 + Check1) % MAX_UINT32);
+
+  return (Check2 << 32U) | Check1;
+}
+
+/**
+  Fill block with data and store matching checksum.
+  Pattern 0 is random, 1 is all ones to hit the upper sum bounds,
+  2 is all zeroes.
+**/
+STATIC
+VOID
+TestSealBlock (
+  APFS_OBJ_PHYS  *Block,
+  UINT32         BlockSize,
+  UINT32         Pattern
+  )
+{
+  UINT32  *Words;
+  UINTN   Index;
+
+  Words = (UINT32 *) Block;
+  for (Index = 0; Index < BlockSize / sizeof (UINT32); ++Index) {
+    Words[Index] = Pattern == 0 ? TestRandom () : (Pattern == 1 ? MAX_UINT32 : 0);
+  }
+
+  Block->Checksum = TestReferenceFletcher64 (
+    (UINT32 *) &Block->ObjectOid,
+    (BlockSize - sizeof (Block->Checksum)) / sizeof (UINT32)
+    );
+}
+
+STATIC
+INT32
+TestBlockSize (
+  UINT32  BlockSize
+  )
+{
+  UINT8          *Blocks;
+  APFS_OBJ_PHYS  *Block;
+  BOOLEAN        Valid[TEST_BATCH_BLOCKS];
+  UINTN          ValidCount;
+  UINTN          Index;
+  UINTN          Offset;
+  UINT32         Pattern;
+  INT32          Failures;
+
+  Blocks = AllocatePool (BlockSize * TEST_BATCH_BLOCKS);
+  if (Blocks == NULL) {
+    return 1;
+  }
+
+  Failures = 0;
+
+  //
+  // Every pattern must produce the reference checksum.
+  //
+  for (Pattern = 0; Pattern < 3; ++Pattern) {
+    Block = (APFS_OBJ_PHYS *) Blocks;
+    TestSealBlock (Block, BlockSize, Pattern);
+    if (!InternalApfsBlockChecksumVerify (Block, BlockSize)) {
+      printf ("%u: pattern %u checksum mismatch\n", BlockSize, Pattern);
+      ++Failures;
+    }
+  }
+
+  //
+  // Single bit flips anywhere past the checksum must be detected.
+  //
+  for (Index = 0; Index < 64; ++Index) {
+    Block  = (APFS_OBJ_PHYS *) Blocks;
+    TestSealBlock (Block, BlockSize, 0);
+    Offset = sizeof (Block->Checksum) + TestRandom () % (BlockSize - sizeof (Block->Checksum));
+    Blocks[Offset] ^= (UINT8) (1U << (TestRandom () % 8));
+    if (InternalApfsBlockChecksumVerify (Block, BlockSize)) {
+      printf ("%u: corruption at %u not detected\n", BlockSize, (UINT32) Offset);
+      ++Failures;
+    }
+  }
+
+  //
+  // Batch verification must report exactly the corrupted blocks.
+  //
+  for (Index = 0; Index < TEST_BATCH_BLOCKS; ++Index) {
+    TestSealBlock ((APFS_OBJ_PHYS *) (Blocks + Index * BlockSize), BlockSize, Index % 3);
+  }
+
+  Blocks[1 * BlockSize + BlockSize / 2] ^= 0x80;
+  Blocks[4 * BlockSize + BlockSize - 1] ^= 0x01;
+  Blocks[6 * BlockSize]                 ^= 0x10;
+
+  ValidCount = InternalApfsBlocksChecksumVerify (Blocks, BlockSize, TEST_BATCH_BLOCKS, Valid);
+  if (ValidCount != TEST_BATCH_BLOCKS - 3) {
+    printf ("%u: batch reported %u valid blocks\n", BlockSize, (UINT32) ValidCount);
+    ++Failures;
+  }
+
+  for (Index = 0; Index < TEST_BATCH_BLOCKS; ++Index) {
+    if (Valid[Index] != (Index != 1 && Index != 4 && Index != 6)) {
+      printf ("%u: batch block %u reported %d\n", BlockSize, (UINT32) Index, Valid[Index]);
+      ++Failures;
+    }
+  }
+
+  if (InternalApfsBlocksChecksumVerify (Blocks, BlockSize, TEST_BATCH_BLOCKS, NULL) != ValidCount) {
+    printf ("%u: batch without validity map mismatch\n", BlockSize);
+    ++Failures;
+  }
+
+  printf ("%u: %s\n", BlockSize, Failures == 0 ? "OK" : "FAILED");
+
+  FreePool (Blocks);
+  return Failures;
+}
+
+STATIC
+VOID
+TestBenchmark (
+  UINT32  BlockSize,
+  UINT32  Rounds
+  )
+{
+  UINT8    *Blocks;
+  UINTN    Index;
+  UINTN    ValidCount;
+  clock_t  Start;
+  double   Seconds;
+
+  Blocks = AllocatePool (BlockSize * TEST_BATCH_BLOCKS);
+  if (Blocks == NULL) {
+    return;
+  }
+
+  for (Index = 0; Index < TEST_BATCH_BLOCKS; ++Index) {
+    TestSealBlock ((APFS_OBJ_PHYS *) (Blocks + Index * BlockSize), BlockSize, 0);
+  }
+
+  ValidCount = 0;
+  Start      = clock ();
+  for (Index = 0; Index < Rounds; ++Index) {
+    ValidCount += InternalApfsBlocksChecksumVerify (Blocks, BlockSize, TEST_BATCH_BLOCKS, NULL);
+  }
+  Seconds = (double) (clock () - Start) / CLOCKS_PER_SEC;
+
+  printf (
+    "%u: %u blocks verified in %.3f s, %.1f MB/s\n",
+    BlockSize,
+    (UINT32) ValidCount,
+    Seconds,
+    Seconds > 0 ? (double) BlockSize * TEST_BATCH_BLOCKS * Rounds / Seconds / (1024 * 1024) : 0
+    );
+
+  FreePool (Blocks);
+}
+
+int ENTRY_POINT (int argc, char *argv[]) {
+  STATIC CONST UINT32  BlockSizes[] = { 4096, 16384, 65536 };
+  UINTN                Index;
+  UINT32               Rounds;
+  INT32                Failures;
+
+  Rounds = 0;
+  if (argc > 2 && strcmp (argv[1], "-b") == 0) {
+    Rounds = (UINT32) strtoul (argv[2], NULL, 0);
+  } else if (argc > 1) {
+    printf ("Usage: %s [-b rounds]\n", argv[0]);
+    printf ("  -b  benchmark batch verification for the given amount of rounds\n");
+    return -1;
+  }
+
+  Failures = 0;
+  for (Index = 0; Index < ARRAY_SIZE (BlockSizes); ++Index) {
+    Failures += TestBlockSize (BlockSizes[Index]);
+  }
+
+  if (Rounds > 0) {
+    for (Index = 0; Index < ARRAY_SIZE (BlockSizes); ++Index) {
+      TestBenchmark (BlockSizes[Index], Rounds);
+    }
+  }
+
+  return Failures == 0 ? 0 : -1;
+}
+
+INT32 LLVMFuzzerTestOneInput(CONST UINT8 *Data, UINTN Size) {
+  APFS_OBJ_PHYS  *Block;
+  UINT64         Checksum;
+
+  if (Size < APFS_NX_MINIMUM_BLOCK_SIZE) {
+    return 0;
+  }
+
+  Block = AllocatePool (APFS_NX_MINIMUM_BLOCK_SIZE);
+  if (Block == NULL) {
+    return 0;
+  }
+
+  CopyMem (Block, Data, APFS_NX_MINIMUM_BLOCK_SIZE);
+
+  Checksum = TestReferenceFletcher64 (
+    (UINT32 *) &Block->ObjectOid,
+    (APFS_NX_MINIMUM_BLOCK_SIZE - sizeof (Block->Checksum)) / sizeof (UINT32)
+    );
+  if (InternalApfsBlocksChecksumVerify (Block, APFS_NX_MINIMUM_BLOCK_SIZE, 1, NULL) != (Block->Checksum == Checksum)) {
+    abort ();
+  }
+
+  FreePool (Block);
+  return 0;
+}
@@ -0,0 +1,483 @@
+/** @file
+  Copyright (c) 2021, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <UserFile.h>
+
+#include "OcApfsInternal.h"
+
+#define TEST_MEDIA_BLOCK_SIZE  512
+#define TEST_BLOCK_SIZE        4096
+#define TEST_TOTAL_BLOCKS      16
+
+//
+// Synthetic container layout, in APFS blocks.
+//
+#define TEST_XP_DESC_BASE      1
+#define TEST_XP_DESC_BLOCKS    4
+#define TEST_OMAP              5
+#define TEST_OMAP_ROOT         7
+#define TEST_OMAP_LEAF1        8
+#define TEST_OMAP_LEAF2        9
+
+#define TEST_VOLUME_SYSTEM     0x402
+#define TEST_VOLUME_PREBOOT    0x404
+#define TEST_VOLUME_DELETED    0x406
+
+//
+// Normally provided by OcApfsConnect, which is not needed for metadata.
+//
+LIST_ENTRY  mApfsPrivateDataList = INITIALIZE_LIST_HEAD_VARIABLE (mApfsPrivateDataList);
+
+STATIC UINT8               *mImage;
+STATIC UINT64              mImageSize;
+STATIC UINT32              mReadCalls;
+STATIC EFI_BLOCK_IO_MEDIA  mMedia;
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestReadBlocks (
+  IN  EFI_BLOCK_IO_PROTOCOL  *This,
+  IN  UINT32                 MediaId,
+  IN  EFI_LBA                Lba,
+  IN  UINTN                  BufferSize,
+  OUT VOID                   *Buffer
+  )
+{
+  (VOID) This;
+  (VOID) MediaId;
+
+  ++mReadCalls;
+
+  if (Lba > mImageSize / TEST_MEDIA_BLOCK_SIZE
+    || BufferSize > mImageSize - Lba * TEST_MEDIA_BLOCK_SIZE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Buffer, mImage + Lba * TEST_MEDIA_BLOCK_SIZE, BufferSize);
+  return EFI_SUCCESS;
+}
+
+STATIC EFI_BLOCK_IO_PROTOCOL  mBlockIo = {
+  EFI_BLOCK_IO_PROTOCOL_REVISION,
+  &mMedia,
+  NULL,
+  TestReadBlocks,
+  NULL,
+  NULL
+};
+
+STATIC
+UINT64
+TestFletcher64 (
+  CONST UINT32  *Data,
+  UINTN         WordCount
+  )
+{
+  UINT64  Sum1;
+  UINT64  Sum2;
+  UINT64  Check1;
+  UINT64  Check2;
+  UINTN   Index;
+
+  Sum1 = 0;
+  Sum2 = 0;
+
+  for (Index = 0; Index < WordCount; ++Index) {
+    Sum1 = (Sum1 + Data[Index]) % MAX_UINT32;
+    Sum2 = (Sum2 + Sum1) % MAX_UINT32;
+  }
+
+  Check1 = MAX_UINT32 - ((Sum1 + Sum2) % MAX_UINT32);
+  Check2 = MAX_UINT32 - ((Sum1 + Check1) % MAX_UINT32);
+
+  return (Check2 << 32U) | Check1;
+}
+
+STATIC
+VOID *
+TestBlock (
+  UINT64  Paddr
+  )
+{
+  return mImage + Paddr * TEST_BLOCK_SIZE;
+}
+
+STATIC
+VOID
+TestSealObject (
+  UINT64  Paddr
+  )
+{
+  APFS_OBJ_PHYS  *Object;
+
+  Object           = TestBlock (Paddr);
+  Object->Checksum = TestFletcher64 (
+    (UINT32 *) &Object->ObjectOid,
+    (TEST_BLOCK_SIZE - sizeof (Object->Checksum)) / sizeof (UINT32)
+    );
+}
+
+STATIC
+VOID
+TestSetHeader (
+  UINT64  Paddr,
+  UINT64  Oid,
+  UINT64  Xid,
+  UINT32  Type,
+  UINT32  SubType
+  )
+{
+  APFS_OBJ_PHYS  *Object;
+
+  Object                = TestBlock (Paddr);
+  Object->ObjectOid     = Oid;
+  Object->ObjectXid     = Xid;
+  Object->ObjectType    = Type;
+  Object->ObjectSubType = SubType;
+}
+
+STATIC
+VOID
+TestWriteSuperBlock (
+  UINT64         Paddr,
+  UINT64         Xid,
+  CONST UINT64   *FileSystems,
+  UINT32         FileSystemCount
+  )
+{
+  APFS_NX_SUPERBLOCK  *SuperBlock;
+  STATIC CONST GUID   Uuid = { 0x11223344, 0x5566, 0x7788, { 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF, 0x00 } };
+
+  ZeroMem (TestBlock (Paddr), TEST_BLOCK_SIZE);
+  TestSetHeader (Paddr, 1, Xid, APFS_OBJ_EPHEMERAL | APFS_OBJECT_TYPE_NX_SUPERBLOCK, 0);
+
+  SuperBlock                 = TestBlock (Paddr);
+  SuperBlock->Magic          = APFS_NX_SIGNATURE;
+  SuperBlock->BlockSize      = TEST_BLOCK_SIZE;
+  SuperBlock->TotalBlocks    = TEST_TOTAL_BLOCKS;
+  SuperBlock->NextXid        = Xid + 1;
+  SuperBlock->XpDescBase     = TEST_XP_DESC_BASE;
+  SuperBlock->XpDescBlocks   = TEST_XP_DESC_BLOCKS;
+  SuperBlock->ObjectMapOid   = TEST_OMAP;
+  SuperBlock->MaxFileSystems = APFS_NX_MAX_FILE_SYSTEMS;
+  CopyGuid (&SuperBlock->Uuid, &Uuid);
+  CopyMem (SuperBlock->FileSystemOid, FileSystems, FileSystemCount * sizeof (*FileSystems));
+
+  TestSealObject (Paddr);
+}
+
+STATIC
+VOID
+TestWriteOmapNode (
+  UINT64               Paddr,
+  UINT16               Flags,
+  UINT16               Level,
+  CONST APFS_OMAP_KEY  *Keys,
+  CONST VOID           *Values,
+  UINT32               ValueSize,
+  UINT32               Count
+  )
+{
+  APFS_BTREE_NODE_PHYS  *Node;
+  APFS_KVOFF            *Toc;
+  UINT8                 *KeyArea;
+  UINT8                 *ValueEnd;
+  UINT32                Index;
+
+  ZeroMem (TestBlock (Paddr), TEST_BLOCK_SIZE);
+  TestSetHeader (
+    Paddr,
+    Paddr,
+    1,
+    APFS_OBJ_PHYSICAL | ((Flags & APFS_BTNODE_ROOT) != 0 ? APFS_OBJECT_TYPE_BTREE : APFS_OBJECT_TYPE_BTREE_NODE),
+    APFS_OBJECT_TYPE_OMAP
+    );
+
+  Node                    = TestBlock (Paddr);
+  Node->Flags             = Flags | APFS_BTNODE_FIXED_KV_SIZE;
+  Node->Level             = Level;
+  Node->KeyCount          = Count;
+  Node->TableSpace.Offset = 0;
+  Node->TableSpace.Length = 64;
+
+  Toc      = (APFS_KVOFF *) Node->Data;
+  KeyArea  = Node->Data + Node->TableSpace.Length;
+  ValueEnd = (UINT8 *) Node + TEST_BLOCK_SIZE;
+  if ((Flags & APFS_BTNODE_ROOT) != 0) {
+    ValueEnd -= sizeof (APFS_BTREE_INFO);
+  }
+
+  for (Index = 0; Index < Count; ++Index) {
+    Toc[Index].KeyOffset   = (UINT16) (Index * sizeof (*Keys));
+    Toc[Index].ValueOffset = (UINT16) ((Index + 1) * ValueSize);
+    CopyMem (KeyArea + Toc[Index].KeyOffset, &Keys[Index], sizeof (*Keys));
+    CopyMem (ValueEnd - Toc[Index].ValueOffset, (CONST UINT8 *) Values + Index * ValueSize, ValueSize);
+  }
+
+  TestSealObject (Paddr);
+}
+
+STATIC
+VOID
+TestWriteVolume (
+  UINT64       Paddr,
+  UINT64       Oid,
+  UINT64       Xid,
+  UINT32       FsIndex,
+  UINT16       Role,
+  BOOLEAN      Encrypted,
+  BOOLEAN      Sealed,
+  CONST CHAR8  *Name
+  )
+{
+  APFS_APFS_SUPERBLOCK  *Volume;
+
+  ZeroMem (TestBlock (Paddr), TEST_BLOCK_SIZE);
+  TestSetHeader (Paddr, Oid, Xid, APFS_OBJ_VIRTUAL | APFS_OBJECT_TYPE_FS, 0);
+
+  Volume                       = TestBlock (Paddr);
+  Volume->Magic                = APFS_SIGNATURE;
+  Volume->FsIndex              = FsIndex;
+  Volume->Role                 = Role;
+  Volume->FsFlags              = Encrypted ? 0 : APFS_FS_UNENCRYPTED;
+  Volume->IncompatibleFeatures = Sealed ? APFS_INCOMPAT_SEALED_VOLUME : 0;
+  Volume->VolumeUuid.Data1     = (UINT32) Oid;
+  AsciiStrCpyS ((CHAR8 *) Volume->VolumeName, sizeof (Volume->VolumeName), Name);
+
+  TestSealObject (Paddr);
+}
+
+/**
+  Build a container with two checkpoints, a two level object map
+  with stale, future and deleted mappings.
+**/
+STATIC
+VOID
+TestBuildContainer (
+  VOID
+  )
+{
+  APFS_OMAP_PHYS  *Omap;
+  UINT64          Block0Volumes[]     = { TEST_VOLUME_SYSTEM };
+  UINT64          CheckpointVolumes[] = { TEST_VOLUME_SYSTEM, TEST_VOLUME_PREBOOT, TEST_VOLUME_DELETED };
+  APFS_OMAP_KEY   RootKeys[]          = { { TEST_VOLUME_SYSTEM - 2, 0 }, { TEST_VOLUME_PREBOOT - 1, 0 } };
+  UINT64          RootValues[]        = { TEST_OMAP_LEAF1, TEST_OMAP_LEAF2 };
+  APFS_OMAP_KEY   Leaf1Keys[]         = { { TEST_VOLUME_SYSTEM, 3 }, { TEST_VOLUME_SYSTEM, 11 }, { TEST_VOLUME_SYSTEM, 13 } };
+  APFS_OMAP_VAL   Leaf1Values[]       = { { 0, TEST_BLOCK_SIZE, 10 }, { 0, TEST_BLOCK_SIZE, 11 }, { 0, TEST_BLOCK_SIZE, 12 } };
+  APFS_OMAP_KEY   Leaf2Keys[]         = { { TEST_VOLUME_PREBOOT, 5 }, { TEST_VOLUME_DELETED, 5 } };
+  APFS_OMAP_VAL   Leaf2Values[]       = { { 0, TEST_BLOCK_SIZE, 13 }, { APFS_OMAP_VAL_DELETED, TEST_BLOCK_SIZE, 14 } };
+
+  mImageSize = TEST_TOTAL_BLOCKS * TEST_BLOCK_SIZE;
+  mImage     = AllocateZeroPool (mImageSize);
+  ASSERT (mImage != NULL);
+
+  //
+  // Block 0 is older than the checkpoint at descriptor block 0,
+  // descriptor block 1 is garbage and descriptor block 2 is older.
+  //
+  TestWriteSuperBlock (0, 10, Block0Volumes, ARRAY_SIZE (Block0Volumes));
+  TestWriteSuperBlock (TEST_XP_DESC_BASE, 12, CheckpointVolumes, ARRAY_SIZE (CheckpointVolumes));
+  SetMem (TestBlock (TEST_XP_DESC_BASE + 1), TEST_BLOCK_SIZE, 0xA5);
+  TestWriteSuperBlock (TEST_XP_DESC_BASE + 2, 11, Block0Volumes, ARRAY_SIZE (Block0Volumes));
+
+  TestSetHeader (TEST_OMAP, TEST_OMAP, 12, APFS_OBJ_PHYSICAL | APFS_OBJECT_TYPE_OMAP, 0);
+  Omap           = TestBlock (TEST_OMAP);
+  Omap->TreeType = APFS_OBJ_PHYSICAL | APFS_OBJECT_TYPE_BTREE;
+  Omap->TreeOid  = TEST_OMAP_ROOT;
+  TestSealObject (TEST_OMAP);
+
+  TestWriteOmapNode (TEST_OMAP_ROOT, APFS_BTNODE_ROOT, 1, RootKeys, RootValues, sizeof (RootValues[0]), ARRAY_SIZE (RootKeys));
+  TestWriteOmapNode (TEST_OMAP_LEAF1, APFS_BTNODE_LEAF, 0, Leaf1Keys, Leaf1Values, sizeof (Leaf1Values[0]), ARRAY_SIZE (Leaf1Keys));
+  TestWriteOmapNode (TEST_OMAP_LEAF2, APFS_BTNODE_LEAF, 0, Leaf2Keys, Leaf2Values, sizeof (Leaf2Values[0]), ARRAY_SIZE (Leaf2Keys));
+
+  TestWriteVolume (10, TEST_VOLUME_SYSTEM, 3, 0, 1, FALSE, FALSE, "Stale");
+  TestWriteVolume (11, TEST_VOLUME_SYSTEM, 11, 0, 1, FALSE, TRUE, "Macintosh HD");
+  TestWriteVolume (12, TEST_VOLUME_SYSTEM, 13, 0, 1, FALSE, TRUE, "Future");
+  TestWriteVolume (13, TEST_VOLUME_PREBOOT, 5, 1, APPLE_APFS_VOLUME_ROLE_PREBOOT, TRUE, FALSE, "Preboot");
+  TestWriteVolume (14, TEST_VOLUME_DELETED, 5, 2, 0, FALSE, FALSE, "Deleted");
+}
+
+STATIC
+EFI_STATUS
+TestRead (
+  OC_APFS_VOLUME_METADATA  **Volumes,
+  UINT32                   *VolumeCount,
+  BOOLEAN                  Print
+  )
+{
+  EFI_STATUS  Status;
+  EFI_GUID    ContainerUuid;
+  UINT32      Index;
+
+  mMedia.MediaId      = 1;
+  mMedia.BlockSize    = TEST_MEDIA_BLOCK_SIZE;
+  mMedia.LastBlock    = mImageSize / TEST_MEDIA_BLOCK_SIZE - 1;
+  mMedia.MediaPresent = TRUE;
+  mReadCalls          = 0;
+
+  Status = InternalApfsReadContainerMetadata (&mBlockIo, &ContainerUuid, Volumes, VolumeCount);
+  if (EFI_ERROR (Status) || !Print) {
+    return Status;
+  }
+
+  DEBUG ((DEBUG_WARN, "Container %g, %u volumes, %u reads\n", &ContainerUuid, *VolumeCount, mReadCalls));
+  for (Index = 0; Index < *VolumeCount; ++Index) {
+    DEBUG ((
+      DEBUG_WARN,
+      "  %u: %g role %04X%a%a %a\n",
+      (*Volumes)[Index].FsIndex,
+      &(*Volumes)[Index].VolumeUuid,
+      (*Volumes)[Index].Role,
+      (*Volumes)[Index].Encrypted ? " encrypted" : "",
+      (*Volumes)[Index].Sealed ? " sealed" : "",
+      (*Volumes)[Index].Name
+      ));
+  }
+
+  return Status;
+}
+
+STATIC
+INT32
+TestSynthetic (
+  VOID
+  )
+{
+  EFI_STATUS               Status;
+  OC_APFS_VOLUME_METADATA  *Volumes;
+  UINT32                   VolumeCount;
+  UINT32                   FirstReads;
+  INT32                    Failures;
+  UINT64                   NewCheckpointVolumes[] = { TEST_VOLUME_SYSTEM, TEST_VOLUME_PREBOOT };
+
+  Failures = 0;
+  TestBuildContainer ();
+
+  //
+  // Newest checkpoint, newest visible mapping, no deleted volumes.
+  //
+  Status = TestRead (&Volumes, &VolumeCount, TRUE);
+  if (EFI_ERROR (Status) || VolumeCount != 2
+    || AsciiStrCmp (Volumes[0].Name, "Macintosh HD") != 0
+    || !Volumes[0].Sealed || Volumes[0].Encrypted || Volumes[0].Role != 1
+    || AsciiStrCmp (Volumes[1].Name, "Preboot") != 0
+    || Volumes[1].Sealed || !Volumes[1].Encrypted || Volumes[1].Role != APPLE_APFS_VOLUME_ROLE_PREBOOT
+    || Volumes[1].VolumeUuid.Data1 != TEST_VOLUME_PREBOOT) {
+    DEBUG ((DEBUG_WARN, "Unexpected metadata - %r\n", Status));
+    ++Failures;
+  }
+  FirstReads = mReadCalls;
+  if (!EFI_ERROR (Status)) {
+    FreePool (Volumes);
+  }
+
+  //
+  // Unchanged checkpoint must be served from cache. Corruption is not
+  // noticed, as the container is assumed unchanged within a transaction.
+  //
+  ++((UINT8 *) TestBlock (13))[100];
+  Status = TestRead (&Volumes, &VolumeCount, FALSE);
+  if (EFI_ERROR (Status) || VolumeCount != 2 || mReadCalls != 2 || mReadCalls >= FirstReads) {
+    DEBUG ((DEBUG_WARN, "Cache miss with %u reads of %u - %r\n", mReadCalls, FirstReads, Status));
+    ++Failures;
+  }
+  if (!EFI_ERROR (Status)) {
+    FreePool (Volumes);
+  }
+
+  //
+  // New checkpoint drops cached objects, finds the corrupted volume,
+  // and makes the previously future mapping visible.
+  //
+  TestWriteSuperBlock (TEST_XP_DESC_BASE + 3, 14, NewCheckpointVolumes, ARRAY_SIZE (NewCheckpointVolumes));
+  Status = TestRead (&Volumes, &VolumeCount, TRUE);
+  if (EFI_ERROR (Status) || VolumeCount != 1 || AsciiStrCmp (Volumes[0].Name, "Future") != 0) {
+    DEBUG ((DEBUG_WARN, "Corruption not detected - %r\n", Status));
+    ++Failures;
+  }
+  if (!EFI_ERROR (Status)) {
+    FreePool (Volumes);
+  }
+
+  //
+  // Broken object map leaves no volumes.
+  //
+  ++((UINT8 *) TestBlock (TEST_OMAP_ROOT))[200];
+  TestWriteSuperBlock (TEST_XP_DESC_BASE + 2, 15, NewCheckpointVolumes, ARRAY_SIZE (NewCheckpointVolumes));
+  Status = TestRead (&Volumes, &VolumeCount, FALSE);
+  if (Status != EFI_NOT_FOUND) {
+    DEBUG ((DEBUG_WARN, "Broken object map - %r\n", Status));
+    ++Failures;
+    if (!EFI_ERROR (Status)) {
+      FreePool (Volumes);
+    }
+  }
+
+  FreePool (mImage);
+
+  DEBUG ((DEBUG_WARN, "Synthetic container: %a\n", Failures == 0 ? "OK" : "FAILED"));
+  return Failures;
+}
+
+int ENTRY_POINT (int argc, char *argv[]) {
+  EFI_STATUS               Status;
+  OC_APFS_VOLUME_METADATA  *Volumes;
+  UINT32                   VolumeCount;
+  UINT32                   ImageSize;
+
+  if (argc < 2) {
+    return TestSynthetic () == 0 ? 0 : -1;
+  }
+
+  //
+  // Raw container image, e.g. dumped APFS partition.
+  //
+  if ((mImage = UserReadFile (argv[1], &ImageSize)) == NULL) {
+    DEBUG ((DEBUG_WARN, "Read fail\n"));
+    return -1;
+  }
+
+  mImageSize = ImageSize & ~(UINT64) (TEST_MEDIA_BLOCK_SIZE - 1);
+
+  Status = TestRead (&Volumes, &VolumeCount, TRUE);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "No volumes - %r\n", Status));
+  } else {
+    FreePool (Volumes);
+  }
+
+  FreePool (mImage);
+  return EFI_ERROR (Status) ? -1 : 0;
+}
+
+INT32 LLVMFuzzerTestOneInput(CONST UINT8 *Data, UINTN Size) {
+  OC_APFS_VOLUME_METADATA  *Volumes;
+  UINT32                   VolumeCount;
+
+  if (Size < TEST_BLOCK_SIZE || Size > BASE_16MB) {
+    return 0;
+  }
+
+  mImageSize = Size & ~(UINT64) (TEST_MEDIA_BLOCK_SIZE - 1);
+  mImage     = AllocatePool (mImageSize);
+  if (mImage == NULL) {
+    return 0;
+  }
+
+  CopyMem (mImage, Data, mImageSize);
+
+  if (!EFI_ERROR (TestRead (&Volumes, &VolumeCount, FALSE))) {
+    FreePool (Volumes);
+  }
+
+  FreePool (mImage);
+  return 0;
+}
@@ -7,7 +7,10 @@
 
 #include <UserFile.h>
 
+#include <sys/time.h>
+
 #include <Base.h>
+#include <Library/BaseLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/DebugLib.h>
 #include <Library/BmpSupportLib.h>
@@ -53,6 +56,78 @@ GuiBmpToImage (
   return EFI_SUCCESS;
 }
 
+STATIC
+UINT64
+GetTimeUsec (
+  VOID
+  )
+{
+  struct timeval  Time;
+
+  gettimeofday (&Time, NULL);
+  return (UINT64) Time.tv_sec * 1000000ULL + (UINT64) Time.tv_usec;
+}
+
+STATIC
+CONST CHAR16 *
+mBenchLabels[] = {
+  L"Macintosh HD",
+  L"Macintosh HD - Data",
+  L"Recovery 10.15.7",
+  L"Time Machine HD",
+  L"Windows",
+  L"EFI",
+  L"UEFI Shell",
+  L"Reset NVRAM"
+};
+
+STATIC
+VOID
+BenchmarkLabels (
+  IN GUI_FONT_CONTEXT  *Context,
+  IN UINT32            Iterations
+  )
+{
+  BOOLEAN   Result;
+  GUI_IMAGE Label;
+  UINT32    Index;
+  UINT32    Index2;
+  UINT64    Start;
+  UINT64    Cold;
+  UINT64    Warm;
+
+  Start = GetTimeUsec ();
+  for (Index = 0; Index < ARRAY_SIZE (mBenchLabels); ++Index) {
+    Result = GuiGetLabel (&Label, Context, mBenchLabels[Index], StrLen (mBenchLabels[Index]), FALSE);
+    if (Result) {
+      FreePool (Label.Buffer);
+    }
+  }
+  Cold = GetTimeUsec () - Start;
+
+  Start = GetTimeUsec ();
+  for (Index2 = 0; Index2 < Iterations; ++Index2) {
+    for (Index = 0; Index < ARRAY_SIZE (mBenchLabels); ++Index) {
+      Result = GuiGetLabel (&Label, Context, mBenchLabels[Index], StrLen (mBenchLabels[Index]), FALSE);
+      if (Result) {
+        FreePool (Label.Buffer);
+      }
+    }
+  }
+  Warm = GetTimeUsec () - Start;
+
+  DEBUG ((
+    DEBUG_WARN,
+    "Bench: %u labels, cold %Lu us, cached %Lu us per pass (%u passes), %u hits %u misses\n",
+    (UINT32) ARRAY_SIZE (mBenchLabels),
+    Cold,
+    Iterations > 0 ? Warm / Iterations : 0,
+    Iterations,
+    Context->LabelCacheHits,
+    Context->LabelCacheMisses
+    ));
+}
+
 int main (int argc, char** argv)
 {
   BOOLEAN Result;
@@ -83,6 +158,10 @@ int main (int argc, char** argv)
 
   DEBUG ((DEBUG_WARN, "Result: %u %u\n", Label.Height, Label.Width));
 
+  if (argc > 3) {
+    BenchmarkLabels (&Context, (UINT32) atoi (argv[3]));
+  }
+
   BmpImage     = NULL;
   BmpImageSize = 0;
   Status = TranslateGopBltToBmp (
@@ -104,8 +183,8 @@ int main (int argc, char** argv)
 
   FreePool (BmpImage);
 
-  FreePool (Context.FontImage.Buffer);
   FreePool (Label.Buffer);
+  GuiFontDestruct (&Context);
 
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,230 @@
+/** @file
+  Copyright (c) 2021, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcCrc32Lib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <UserFile.h>
+
+typedef struct {
+  CONST CHAR8  *Data;
+  UINT32       Size;
+  UINT32       Crc;
+} CRC32_VECTOR;
+
+//
+// Known answers of CRC-32/ISO-HDLC.
+//
+STATIC CONST CRC32_VECTOR mCrc32Vectors[] = {
+  { "",          0, 0x00000000 },
+  { "a",         1, 0xE8B7BE43 },
+  { "abc",       3, 0x352441C2 },
+  { "123456789", 9, 0xCBF43926 },
+  { "The quick brown fox jumps over the lazy dog", 43, 0x414FA339 },
+  { "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+    "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00", 32, 0x190A55AD },
+  { "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF"
+    "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF", 32, 0xFF6CAB0B }
+};
+
+//
+// Enough to cover a full 128 entry GPT partition array.
+//
+#define TEST_BUFFER_SIZE  (16 * 1024 + 64)
+
+/**
+  Bitwise CRC-32 used as reference.
+**/
+STATIC
+UINT32
+TestReferenceCrc32 (
+  CONST UINT8  *Data,
+  UINTN        Size
+  )
+{
+  UINT32  Crc;
+  UINTN   Index;
+  UINT32  Bit;
+
+  Crc = MAX_UINT32;
+  for (Index = 0; Index < Size; ++Index) {
+    Crc ^= Data[Index];
+    for (Bit = 0; Bit < 8; ++Bit) {
+      Crc = (Crc >> 1U) ^ ((Crc & 1U) != 0 ? 0xEDB88320U : 0);
+    }
+  }
+
+  return ~Crc;
+}
+
+STATIC
+INT32
+TestKnownAnswers (
+  VOID
+  )
+{
+  UINT8   Sequence[256];
+  UINTN   Index;
+  UINT32  Crc;
+  INT32   Failures;
+
+  Failures = 0;
+
+  for (Index = 0; Index < ARRAY_SIZE (mCrc32Vectors); ++Index) {
+    Crc = OcCrc32 (0, mCrc32Vectors[Index].Data, mCrc32Vectors[Index].Size);
+    if (Crc != mCrc32Vectors[Index].Crc) {
+      printf ("Vector %u: %08X != %08X\n", (UINT32) Index, Crc, mCrc32Vectors[Index].Crc);
+      ++Failures;
+    }
+  }
+
+  for (Index = 0; Index < sizeof (Sequence); ++Index) {
+    Sequence[Index] = (UINT8) Index;
+  }
+
+  Crc = OcCrc32 (0, Sequence, sizeof (Sequence));
+  if (Crc != 0x29058C73) {
+    printf ("Sequence: %08X != %08X\n", Crc, 0x29058C73);
+    ++Failures;
+  }
+
+  return Failures;
+}
+
+STATIC
+INT32
+TestReference (
+  VOID
+  )
+{
+  UINT8   *Buffer;
+  UINTN   Index;
+  UINTN   Offset;
+  UINTN   Size;
+  UINTN   Split;
+  UINT32  Expected;
+  UINT32  Crc;
+  INT32   Failures;
+
+  Buffer = AllocatePool (TEST_BUFFER_SIZE);
+  if (Buffer == NULL) {
+    return 1;
+  }
+
+  srand (0x1BADB002);
+  for (Index = 0; Index < TEST_BUFFER_SIZE; ++Index) {
+    Buffer[Index] = (UINT8) rand ();
+  }
+
+  Failures = 0;
+
+  //
+  // Every alignment and tail length of the slice-by-8 loop.
+  //
+  for (Offset = 0; Offset < 8; ++Offset) {
+    for (Size = 0; Size < 300; ++Size) {
+      Expected = TestReferenceCrc32 (Buffer + Offset, Size);
+      Crc      = OcCrc32 (0, Buffer + Offset, Size);
+      if (Crc != Expected) {
+        printf ("Offset %u size %u: %08X != %08X\n", (UINT32) Offset, (UINT32) Size, Crc, Expected);
+        ++Failures;
+      }
+    }
+  }
+
+  //
+  // Large buffer and incremental updates.
+  //
+  Size     = TEST_BUFFER_SIZE - 8;
+  Expected = TestReferenceCrc32 (Buffer + 3, Size);
+  if (OcCrc32 (0, Buffer + 3, Size) != Expected) {
+    printf ("Large buffer mismatch\n");
+    ++Failures;
+  }
+
+  for (Split = 1; Split < Size; Split += 997) {
+    Crc = OcCrc32 (0, Buffer + 3, Split);
+    Crc = OcCrc32 (Crc, Buffer + 3 + Split, Size - Split);
+    if (Crc != Expected) {
+      printf ("Split %u: %08X != %08X\n", (UINT32) Split, Crc, Expected);
+      ++Failures;
+    }
+  }
+
+  FreePool (Buffer);
+  return Failures;
+}
+
+STATIC
+VOID
+TestBenchmark (
+  UINT32  Rounds
+  )
+{
+  UINT8    *Buffer;
+  UINT32   Index;
+  UINT32   Crc;
+  clock_t  Start;
+  double   Seconds;
+
+  Buffer = AllocateZeroPool (TEST_BUFFER_SIZE);
+  if (Buffer == NULL) {
+    return;
+  }
+
+  Crc   = 0;
+  Start = clock ();
+  for (Index = 0; Index < Rounds; ++Index) {
+    Crc = OcCrc32 (Crc, Buffer, TEST_BUFFER_SIZE);
+  }
+  Seconds = (double) (clock () - Start) / CLOCKS_PER_SEC;
+
+  printf (
+    "%u rounds of %u bytes in %.3f s, %.1f MB/s (%08X)\n",
+    Rounds,
+    TEST_BUFFER_SIZE,
+    Seconds,
+    Seconds > 0 ? (double) TEST_BUFFER_SIZE * Rounds / Seconds / (1024 * 1024) : 0,
+    Crc
+    );
+
+  FreePool (Buffer);
+}
+
+int ENTRY_POINT (int argc, char *argv[]) {
+  INT32  Failures;
+
+  if (argc > 2 && strcmp (argv[1], "-b") == 0) {
+    TestBenchmark ((UINT32) strtoul (argv[2], NULL, 0));
+    return 0;
+  }
+
+  if (argc > 1) {
+    printf ("Usage: %s [-b rounds]\n", argv[0]);
+    printf ("  -b  benchmark instead of testing\n");
+    return -1;
+  }
+
+  Failures  = TestKnownAnswers ();
+  Failures += TestReference ();
+
+  printf ("CRC-32: %s\n", Failures == 0 ? "OK" : "FAILED");
+  return Failures == 0 ? 0 : -1;
+}
+
+INT32 LLVMFuzzerTestOneInput(CONST UINT8 *Data, UINTN Size) {
+  if (OcCrc32 (0, Data, Size) != TestReferenceCrc32 (Data, Size)) {
+    abort ();
+  }
+
+  return 0;
+}
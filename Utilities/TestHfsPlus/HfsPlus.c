@@ -0,0 +1,337 @@
+/** @file
+  Copyright (c) 2021, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <UserFile.h>
+
+#include "fsw_core.h"
+
+//
+// Read files in chunks to exercise sequential read-ahead by default.
+//
+#define TEST_READ_CHUNK  (64 * 1024)
+
+extern struct fsw_fstype_table FSW_FSTYPE_TABLE_NAME(hfsplus);
+
+STATIC CONST UINT8  *mImage;
+STATIC UINT32       mImageSize;
+STATIC UINT32       mReadCalls;
+STATIC UINT64       mReadBytes;
+STATIC UINT32       mReadChunk = TEST_READ_CHUNK;
+
+STATIC
+VOID
+TestChangeBlocksize (
+  struct fsw_volume  *vol,
+  fsw_u32            old_phys_blocksize,
+  fsw_u32            old_log_blocksize,
+  fsw_u32            new_phys_blocksize,
+  fsw_u32            new_log_blocksize
+  )
+{
+}
+
+STATIC
+fsw_status_t
+TestReadBlocks (
+  struct fsw_volume  *vol,
+  fsw_u32            phys_bno,
+  fsw_u32            count,
+  void               *buffer
+  )
+{
+  UINT64  Offset;
+  UINT64  Size;
+
+  Offset = (UINT64) phys_bno * vol->phys_blocksize;
+  Size   = (UINT64) count * vol->phys_blocksize;
+
+  if (Offset > mImageSize || Size > mImageSize - Offset) {
+    return FSW_IO_ERROR;
+  }
+
+  CopyMem (buffer, mImage + Offset, (UINTN) Size);
+  ++mReadCalls;
+  mReadBytes += Size;
+  return FSW_SUCCESS;
+}
+
+STATIC
+fsw_status_t
+TestReadBlock (
+  struct fsw_volume  *vol,
+  fsw_u32            phys_bno,
+  void               *buffer
+  )
+{
+  return TestReadBlocks (vol, phys_bno, 1, buffer);
+}
+
+STATIC struct fsw_host_table mHostTable = {
+  FSW_STRING_TYPE_UTF16,
+  TestChangeBlocksize,
+  TestReadBlock,
+  TestReadBlocks
+};
+
+STATIC
+VOID
+PrintName (
+  CONST CHAR8        *Prefix,
+  struct fsw_string  *Name
+  )
+{
+  struct fsw_string  Utf8;
+
+  if (fsw_strdup_coerce (&Utf8, FSW_STRING_TYPE_UTF8, Name) != FSW_SUCCESS) {
+    return;
+  }
+
+  printf ("%s%.*s\n", Prefix, Utf8.size, Utf8.data != NULL ? (CHAR8 *) Utf8.data : "");
+  fsw_strfree (&Utf8);
+}
+
+STATIC
+fsw_status_t
+ListDirectory (
+  struct fsw_dnode  *Dnode,
+  BOOLEAN           Print
+  )
+{
+  fsw_status_t        Status;
+  struct fsw_shandle  Shandle;
+  struct fsw_dnode    *Child;
+
+  Status = fsw_shandle_open (Dnode, &Shandle);
+  if (Status != FSW_SUCCESS) {
+    return Status;
+  }
+
+  while ((Status = fsw_dnode_dir_read (&Shandle, &Child)) == FSW_SUCCESS) {
+    if (Print) {
+      PrintName (Child->type == FSW_DNODE_TYPE_DIR ? "  d " : "  f ", &Child->name);
+    }
+
+    fsw_dnode_release (Child);
+  }
+
+  fsw_shandle_close (&Shandle);
+  return Status == FSW_NOT_FOUND ? FSW_SUCCESS : Status;
+}
+
+STATIC
+fsw_status_t
+ReadFile (
+  struct fsw_dnode  *Dnode,
+  UINT64            *Size,
+  UINT32            *Hash
+  )
+{
+  fsw_status_t        Status;
+  struct fsw_shandle  Shandle;
+  UINT8               *Buffer;
+  fsw_u32             Length;
+  fsw_u32             Index;
+
+  Buffer = AllocatePool (mReadChunk);
+  if (Buffer == NULL) {
+    return FSW_OUT_OF_MEMORY;
+  }
+
+  Status = fsw_shandle_open (Dnode, &Shandle);
+  if (Status != FSW_SUCCESS) {
+    FreePool (Buffer);
+    return Status;
+  }
+
+  *Size = 0;
+  *Hash = 2166136261U;
+
+  do {
+    Length = mReadChunk;
+    Status = fsw_shandle_read (&Shandle, &Length, Buffer);
+    for (Index = 0; Index < Length; ++Index) {
+      *Hash = (*Hash ^ Buffer[Index]) * 16777619U;
+    }
+
+    *Size += Length;
+  } while (Status == FSW_SUCCESS && Length == mReadChunk);
+
+  fsw_shandle_close (&Shandle);
+  FreePool (Buffer);
+  return Status;
+}
+
+STATIC
+fsw_status_t
+TestPath (
+  struct fsw_volume  *Volume,
+  CHAR8              *Path,
+  BOOLEAN            Print
+  )
+{
+  fsw_status_t       Status;
+  struct fsw_string  LookupPath;
+  struct fsw_dnode   *Dnode;
+  struct fsw_dnode   *Target;
+  UINT64             Size;
+  UINT32             Hash;
+
+  LookupPath.type = FSW_STRING_TYPE_ISO88591;
+  LookupPath.len  = (int) AsciiStrLen (Path);
+  LookupPath.size = LookupPath.len;
+  LookupPath.data = Path;
+
+  Status = fsw_dnode_lookup_path (Volume->root, &LookupPath, '/', &Dnode);
+  if (Status != FSW_SUCCESS) {
+    if (Print) {
+      printf ("%s: lookup failure %d\n", Path, Status);
+    }
+    return Status;
+  }
+
+  Status = fsw_dnode_resolve (Dnode, &Target);
+  fsw_dnode_release (Dnode);
+  if (Status != FSW_SUCCESS) {
+    return Status;
+  }
+
+  Status = fsw_dnode_fill (Target);
+  if (Status == FSW_SUCCESS) {
+    if (Target->type == FSW_DNODE_TYPE_DIR) {
+      if (Print) {
+        printf ("%s:\n", Path);
+      }
+      Status = ListDirectory (Target, Print);
+    } else {
+      Status = ReadFile (Target, &Size, &Hash);
+      if (Print && Status == FSW_SUCCESS) {
+        printf ("%s: %llu bytes, hash %08X\n", Path, (unsigned long long) Size, Hash);
+      }
+    }
+  }
+
+  fsw_dnode_release (Target);
+  return Status;
+}
+
+STATIC
+INT32
+TestImage (
+  CONST UINT8  *Image,
+  UINT32       ImageSize,
+  UINT32       Budget,
+  BOOLEAN      ReadAhead,
+  INT32        PathCount,
+  CHAR8        **Paths,
+  BOOLEAN      Print
+  )
+{
+  fsw_status_t       Status;
+  struct fsw_volume  *Volume;
+  INT32              Index;
+
+  mImage     = Image;
+  mImageSize = ImageSize;
+  mReadCalls = 0;
+  mReadBytes = 0;
+
+  mHostTable.read_blocks = ReadAhead ? TestReadBlocks : NULL;
+
+  Status = fsw_mount (NULL, &mHostTable, &FSW_FSTYPE_TABLE_NAME (hfsplus), &Volume);
+  if (Status != FSW_SUCCESS) {
+    if (Print) {
+      printf ("Mount failure %d\n", Status);
+    }
+    return 1;
+  }
+
+  if (Budget != 0) {
+    fsw_set_blockcache_budget (Volume, Budget);
+  }
+
+  if (PathCount == 0) {
+    ListDirectory (Volume->root, Print);
+  }
+
+  for (Index = 0; Index < PathCount; ++Index) {
+    TestPath (Volume, Paths[Index], Print);
+  }
+
+  if (Print) {
+    printf (
+      "Block cache: %u hits, %u misses, %u evictions, %u read ahead, %u direct\n",
+      Volume->bcache_hits,
+      Volume->bcache_misses,
+      Volume->bcache_evictions,
+      Volume->bcache_readahead,
+      Volume->bcache_direct
+      );
+    printf ("Disk reads: %u calls, %llu bytes\n", mReadCalls, (unsigned long long) mReadBytes);
+  }
+
+  fsw_unmount (Volume);
+  return 0;
+}
+
+int ENTRY_POINT (int argc, char *argv[]) {
+  UINT8    *Image;
+  UINT32   ImageSize;
+  UINT32   Budget;
+  BOOLEAN  ReadAhead;
+  INT32    Index;
+  INT32    Result;
+
+  if (argc < 2) {
+    printf ("Usage: %s [-c budget_kb] [-r chunk_kb] [-n] image.dmg [path ...]\n", argv[0]);
+    printf ("  -c  block cache budget in kilobytes\n");
+    printf ("  -r  file read size in kilobytes\n");
+    printf ("  -n  disable read-ahead and direct reads\n");
+    return -1;
+  }
+
+  Budget    = 0;
+  ReadAhead = TRUE;
+
+  for (Index = 1; Index < argc - 1; ++Index) {
+    if (strcmp (argv[Index], "-c") == 0) {
+      Budget = (UINT32) strtoul (argv[++Index], NULL, 0) * 1024;
+    } else if (strcmp (argv[Index], "-r") == 0) {
+      mReadChunk = (UINT32) strtoul (argv[++Index], NULL, 0) * 1024;
+      if (mReadChunk == 0) {
+        mReadChunk = TEST_READ_CHUNK;
+      }
+    } else if (strcmp (argv[Index], "-n") == 0) {
+      ReadAhead = FALSE;
+    } else {
+      break;
+    }
+  }
+
+  if ((Image = UserReadFile (argv[Index], &ImageSize)) == NULL) {
+    printf ("Read fail\n");
+    return -1;
+  }
+
+  Result = TestImage (Image, ImageSize, Budget, ReadAhead, argc - Index - 1, &argv[Index + 1], TRUE);
+
+  free (Image);
+
+  return Result;
+}
+
+INT32 LLVMFuzzerTestOneInput(CONST UINT8 *Data, UINTN Size) {
+  if (Size > 0 && Size <= MAX_UINT32) {
+    TestImage (Data, (UINT32) Size, 64 * 1024, TRUE, 0, NULL, FALSE);
+  }
+  return 0;
+}
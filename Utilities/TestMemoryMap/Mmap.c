@@ -0,0 +1,759 @@
+/** @file
+  Copyright (c) 2020, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <UserGlobalVar.h>
+#include <UserBootServices.h>
+
+#include <Guid/MemoryAttributesTable.h>
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcMemoryLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Real firmware reports descriptors larger than EFI_MEMORY_DESCRIPTOR,
+// make sure we do not rely on the structure size anywhere.
+//
+#define TEST_DESCRIPTOR_SIZE    48
+#define TEST_MAX_DESCRIPTORS    1024
+
+#define TEST_DESC(Map, Index) \
+  ((EFI_MEMORY_DESCRIPTOR *) ((UINT8 *) (Map) + (Index) * TEST_DESCRIPTOR_SIZE))
+
+#define TEST_IS_RT(Type) \
+  ((Type) == EfiRuntimeServicesCode || (Type) == EfiRuntimeServicesData)
+
+#define TEST_IS_FREE(Type) \
+  ((Type) == EfiBootServicesCode || (Type) == EfiBootServicesData \
+  || (Type) == EfiConventionalMemory || (Type) == EfiLoaderCode || (Type) == EfiLoaderData)
+
+STATIC UINT32  mRandomState;
+
+STATIC UINT8   mMap[TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE];
+STATIC UINT8   mExpected[TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE];
+STATIC UINT8   mSource[TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE];
+STATIC UINT8   mMat[sizeof (EFI_MEMORY_ATTRIBUTES_TABLE) + TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE];
+
+STATIC
+UINT32
+TestRandom (
+  UINT32  Limit
+  )
+{
+  mRandomState ^= mRandomState << 13;
+  mRandomState ^= mRandomState >> 17;
+  mRandomState ^= mRandomState << 5;
+  return mRandomState % Limit;
+}
+
+STATIC
+EFI_MEMORY_DESCRIPTOR *
+TestAddDesc (
+  VOID                  *Map,
+  UINTN                 *Count,
+  UINT32                Type,
+  EFI_PHYSICAL_ADDRESS  Start,
+  UINT64                Pages,
+  UINT64                Attribute
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+
+  Desc = TEST_DESC (Map, *Count);
+  SetMem (Desc, TEST_DESCRIPTOR_SIZE, 0xA5);
+  Desc->Type          = Type;
+  Desc->PhysicalStart = Start;
+  Desc->VirtualStart  = 0;
+  Desc->NumberOfPages = Pages;
+  Desc->Attribute     = Attribute;
+  ++(*Count);
+  return Desc;
+}
+
+/**
+  Generate a memory map resembling the ones produced by AMI and Insyde
+  firmware with runtime drivers described by the memory attributes table.
+**/
+STATIC
+UINTN
+TestGenerateMap (
+  UINT32  Seed,
+  UINTN   EntryCount,
+  UINTN   *MatCount
+  )
+{
+  STATIC CONST UINT32 Types[] = {
+    EfiConventionalMemory, EfiConventionalMemory, EfiBootServicesCode,
+    EfiBootServicesData, EfiBootServicesData, EfiLoaderCode, EfiLoaderData,
+    EfiRuntimeServicesCode, EfiRuntimeServicesData, EfiRuntimeServicesData,
+    EfiACPIReclaimMemory, EfiACPIMemoryNVS, EfiReservedMemoryType, EfiMemoryMappedIO
+  };
+
+  EFI_MEMORY_ATTRIBUTES_TABLE  *Mat;
+  EFI_PHYSICAL_ADDRESS         Address;
+  UINTN                        Count;
+  UINT32                       Type;
+  UINT64                       Pages;
+  UINT64                       Attribute;
+  UINT64                       Left;
+  UINT64                       SectionPages;
+  UINTN                        Section;
+
+  mRandomState = Seed;
+  Mat          = (EFI_MEMORY_ATTRIBUTES_TABLE *) mMat;
+  *MatCount    = 0;
+  Count        = 0;
+  Address      = 0;
+
+  while (Count < EntryCount) {
+    Type      = Types[TestRandom (ARRAY_SIZE (Types))];
+    Pages     = 1 + TestRandom (TestRandom (8) == 0 ? 0x4000 : 0x40);
+    Attribute = EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB;
+
+    if (TEST_IS_RT (Type) || Type == EfiMemoryMappedIO) {
+      Attribute |= EFI_MEMORY_RUNTIME;
+    }
+
+    if (Type == EfiMemoryMappedIO) {
+      Attribute = EFI_MEMORY_UC | EFI_MEMORY_RUNTIME;
+    }
+
+    //
+    // Occasional holes in the address space.
+    //
+    if (TestRandom (16) == 0) {
+      Address += EFI_PAGES_TO_SIZE (1 + TestRandom (0x100));
+    }
+
+    TestAddDesc (mSource, &Count, Type, Address, Pages, Attribute);
+
+    //
+    // Describe runtime images as PE sections: header, code, data, and so on.
+    // Some images are described by a single attribute, some are not described.
+    //
+    if (TEST_IS_RT (Type) && TestRandom (4) != 0) {
+      Left    = Pages;
+      Section = 0;
+      while (Left > 0) {
+        SectionPages = Left > 1 ? 1 + TestRandom ((UINT32) MIN (Left, 8)) : 1;
+        if (TestRandom (3) == 0 || Section == 5) {
+          SectionPages = Left;
+        }
+
+        TestAddDesc (
+          Mat + 1,
+          MatCount,
+          Type,
+          Address + EFI_PAGES_TO_SIZE (Pages - Left),
+          SectionPages,
+          EFI_MEMORY_RUNTIME | ((Section % 2) != 0 ? EFI_MEMORY_RO : EFI_MEMORY_XP)
+          );
+
+        Left -= SectionPages;
+        ++Section;
+      }
+    }
+
+    Address += EFI_PAGES_TO_SIZE (Pages);
+  }
+
+  Mat->Version         = EFI_MEMORY_ATTRIBUTES_TABLE_VERSION;
+  Mat->NumberOfEntries = (UINT32) *MatCount;
+  Mat->DescriptorSize  = TEST_DESCRIPTOR_SIZE;
+  Mat->Reserved        = 0;
+
+  return Count;
+}
+
+STATIC
+VOID
+TestShuffleMap (
+  VOID   *Map,
+  UINTN  Count
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  Temp;
+  UINTN                  Index;
+  UINTN                  Other;
+
+  for (Index = Count; Index > 1; --Index) {
+    Other = TestRandom ((UINT32) Index);
+    CopyMem (&Temp, TEST_DESC (Map, Index - 1), sizeof (Temp));
+    CopyMem (TEST_DESC (Map, Index - 1), TEST_DESC (Map, Other), sizeof (Temp));
+    CopyMem (TEST_DESC (Map, Other), &Temp, sizeof (Temp));
+  }
+}
+
+STATIC
+UINT32
+TestRealType (
+  EFI_MEMORY_DESCRIPTOR  *Attribute
+  )
+{
+  if ((Attribute->Attribute & EFI_MEMORY_RO) != 0) {
+    return EfiRuntimeServicesCode;
+  }
+
+  if ((Attribute->Attribute & EFI_MEMORY_XP) != 0) {
+    return EfiRuntimeServicesData;
+  }
+
+  return Attribute->Type;
+}
+
+/**
+  Straightforward split of a sorted memory map into a separate buffer.
+**/
+STATIC
+UINTN
+TestReferenceSplit (
+  VOID   *Map,
+  UINTN  Count,
+  VOID   *Out
+  )
+{
+  EFI_MEMORY_ATTRIBUTES_TABLE  *Mat;
+  EFI_MEMORY_DESCRIPTOR        Current;
+  EFI_MEMORY_DESCRIPTOR        *Attribute;
+  UINTN                        OutCount;
+  UINTN                        Index;
+  UINTN                        Index2;
+  UINT64                       Pages;
+
+  Mat      = (EFI_MEMORY_ATTRIBUTES_TABLE *) mMat;
+  OutCount = 0;
+
+  for (Index = 0; Index < Count; ++Index) {
+    CopyMem (&Current, TEST_DESC (Map, Index), sizeof (Current));
+
+    if (TEST_IS_RT (Current.Type)) {
+      for (Index2 = 0; Index2 < Mat->NumberOfEntries; ++Index2) {
+        Attribute = TEST_DESC (Mat + 1, Index2);
+        if (!TEST_IS_RT (Attribute->Type)
+          || Attribute->NumberOfPages == 0
+          || !AREA_WITHIN_DESCRIPTOR (&Current, Attribute->PhysicalStart, EFI_PAGES_TO_SIZE (Attribute->NumberOfPages))
+          || TestRealType (Attribute) == Current.Type) {
+          continue;
+        }
+
+        if (Attribute->PhysicalStart > Current.PhysicalStart) {
+          Pages = EFI_SIZE_TO_PAGES (Attribute->PhysicalStart - Current.PhysicalStart);
+          TestAddDesc (Out, &OutCount, Current.Type, Current.PhysicalStart, Pages, Current.Attribute);
+          Current.PhysicalStart  = Attribute->PhysicalStart;
+          Current.NumberOfPages -= Pages;
+        }
+
+        if (Current.NumberOfPages == Attribute->NumberOfPages) {
+          Current.Type = TestRealType (Attribute);
+        } else {
+          TestAddDesc (
+            Out,
+            &OutCount,
+            TestRealType (Attribute),
+            Current.PhysicalStart,
+            Attribute->NumberOfPages,
+            Current.Attribute
+            );
+          Current.PhysicalStart += EFI_PAGES_TO_SIZE (Attribute->NumberOfPages);
+          Current.NumberOfPages -= Attribute->NumberOfPages;
+        }
+      }
+    }
+
+    TestAddDesc (Out, &OutCount, Current.Type, Current.PhysicalStart, Current.NumberOfPages, Current.Attribute);
+  }
+
+  return OutCount;
+}
+
+/**
+  Straightforward join of a sorted memory map into a separate buffer.
+**/
+STATIC
+UINTN
+TestReferenceShrink (
+  VOID   *Map,
+  UINTN  Count,
+  VOID   *Out
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *Prev;
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+  UINTN                  OutCount;
+  UINTN                  Index;
+
+  OutCount = 0;
+  Prev     = NULL;
+
+  for (Index = 0; Index < Count; ++Index) {
+    Desc = TEST_DESC (Map, Index);
+
+    if (Prev != NULL
+      && Prev->Attribute == Desc->Attribute
+      && Prev->PhysicalStart + EFI_PAGES_TO_SIZE (Prev->NumberOfPages) == Desc->PhysicalStart) {
+      if (TEST_IS_FREE (Prev->Type) && TEST_IS_FREE (Desc->Type)) {
+        Prev->Type           = EfiConventionalMemory;
+        Prev->NumberOfPages += Desc->NumberOfPages;
+        continue;
+      }
+
+      if (TEST_IS_RT (Prev->Type) && Prev->Type == Desc->Type) {
+        Prev->NumberOfPages += Desc->NumberOfPages;
+        continue;
+      }
+    }
+
+    Prev = TestAddDesc (Out, &OutCount, Desc->Type, Desc->PhysicalStart, Desc->NumberOfPages, Desc->Attribute);
+  }
+
+  return OutCount;
+}
+
+STATIC
+BOOLEAN
+TestCompareMaps (
+  CONST CHAR8  *Name,
+  VOID         *Map,
+  UINTN        Count,
+  VOID         *Expected,
+  UINTN        ExpectedCount
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+  EFI_MEMORY_DESCRIPTOR  *ExpectedDesc;
+  UINTN                  Index;
+
+  if (Count != ExpectedCount) {
+    printf ("%s: got %u entries, expected %u\n", Name, (UINT32) Count, (UINT32) ExpectedCount);
+    return FALSE;
+  }
+
+  for (Index = 0; Index < Count; ++Index) {
+    Desc         = TEST_DESC (Map, Index);
+    ExpectedDesc = TEST_DESC (Expected, Index);
+    if (Desc->Type != ExpectedDesc->Type
+      || Desc->PhysicalStart != ExpectedDesc->PhysicalStart
+      || Desc->NumberOfPages != ExpectedDesc->NumberOfPages
+      || Desc->Attribute != ExpectedDesc->Attribute) {
+      printf (
+        "%s: entry %u mismatch %u %llx %llx vs %u %llx %llx\n",
+        Name,
+        (UINT32) Index,
+        Desc->Type,
+        (unsigned long long) Desc->PhysicalStart,
+        (unsigned long long) Desc->NumberOfPages,
+        ExpectedDesc->Type,
+        (unsigned long long) ExpectedDesc->PhysicalStart,
+        (unsigned long long) ExpectedDesc->NumberOfPages
+        );
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+TestPipeline (
+  UINT32  Seed,
+  UINTN   EntryCount,
+  UINTN   ExtraSlots
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Count;
+  UINTN       MatCount;
+  UINTN       ExpectedCount;
+  UINTN       MapSize;
+  UINTN       Index;
+  UINT64      Pages;
+  UINT64      ExpectedPages;
+  UINT8       SplitMap[TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE];
+
+  Count = TestGenerateMap (Seed, EntryCount, &MatCount);
+  CopyMem (mMap, mSource, Count * TEST_DESCRIPTOR_SIZE);
+  TestShuffleMap (mMap, Count);
+
+  OcSortMemoryMap (Count * TEST_DESCRIPTOR_SIZE, (EFI_MEMORY_DESCRIPTOR *) mMap, TEST_DESCRIPTOR_SIZE);
+  if (!TestCompareMaps ("sort", mMap, Count, mSource, Count)) {
+    return FALSE;
+  }
+
+  ExpectedCount = TestReferenceSplit (mSource, Count, SplitMap);
+  if (OcCountSplitDescriptorsByMap (Count * TEST_DESCRIPTOR_SIZE, (EFI_MEMORY_DESCRIPTOR *) mMap, TEST_DESCRIPTOR_SIZE)
+    != ExpectedCount - Count) {
+    printf ("count: seed %u expected %u new entries\n", Seed, (UINT32) (ExpectedCount - Count));
+    return FALSE;
+  }
+
+  if (ExtraSlots == 0 || Count + ExtraSlots >= ExpectedCount) {
+    MapSize = Count * TEST_DESCRIPTOR_SIZE;
+    Status  = OcSplitMemoryMapByAttributes (
+      sizeof (mMap),
+      &MapSize,
+      (EFI_MEMORY_DESCRIPTOR *) mMap,
+      TEST_DESCRIPTOR_SIZE
+      );
+    if (EFI_ERROR (Status)
+      || !TestCompareMaps ("split", mMap, MapSize / TEST_DESCRIPTOR_SIZE, SplitMap, ExpectedCount)) {
+      printf ("split: seed %u failed - %llx\n", Seed, (unsigned long long) Status);
+      return FALSE;
+    }
+
+    ExpectedCount = TestReferenceShrink (SplitMap, ExpectedCount, mExpected);
+    OcShrinkMemoryMap (&MapSize, (EFI_MEMORY_DESCRIPTOR *) mMap, TEST_DESCRIPTOR_SIZE);
+    if (!TestCompareMaps ("shrink", mMap, MapSize / TEST_DESCRIPTOR_SIZE, mExpected, ExpectedCount)) {
+      printf ("shrink: seed %u failed\n", Seed);
+      return FALSE;
+    }
+
+    return TRUE;
+  }
+
+  //
+  // Not enough slots: the map must stay valid and cover the same memory.
+  //
+  MapSize = Count * TEST_DESCRIPTOR_SIZE;
+  Status  = OcSplitMemoryMapByAttributes (
+    (Count + ExtraSlots) * TEST_DESCRIPTOR_SIZE,
+    &MapSize,
+    (EFI_MEMORY_DESCRIPTOR *) mMap,
+    TEST_DESCRIPTOR_SIZE
+    );
+  if (Status != EFI_OUT_OF_RESOURCES || MapSize > (Count + ExtraSlots) * TEST_DESCRIPTOR_SIZE) {
+    printf ("split: seed %u limited to %u got %llx\n", Seed, (UINT32) ExtraSlots, (unsigned long long) Status);
+    return FALSE;
+  }
+
+  Pages         = 0;
+  ExpectedPages = 0;
+  for (Index = 0; Index < MapSize / TEST_DESCRIPTOR_SIZE; ++Index) {
+    Pages += TEST_DESC (mMap, Index)->NumberOfPages;
+    if (Index > 0 && TEST_DESC (mMap, Index)->PhysicalStart <= LAST_DESCRIPTOR_ADDR (TEST_DESC (mMap, Index - 1))) {
+      printf ("split: seed %u overlapping entries at %u\n", Seed, (UINT32) Index);
+      return FALSE;
+    }
+  }
+
+  for (Index = 0; Index < Count; ++Index) {
+    ExpectedPages += TEST_DESC (mSource, Index)->NumberOfPages;
+  }
+
+  if (Pages != ExpectedPages) {
+    printf ("split: seed %u lost pages\n", Seed);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+STATIC UINTN  mGetMemoryMapCount;
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestGetMemoryMap (
+  IN OUT UINTN                  *MemoryMapSize,
+  OUT    EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  OUT    UINTN                  *MapKey,
+  OUT    UINTN                  *DescriptorSize,
+  OUT    UINT32                 *DescriptorVersion
+  )
+{
+  if (*MemoryMapSize < mGetMemoryMapCount * TEST_DESCRIPTOR_SIZE) {
+    *MemoryMapSize = mGetMemoryMapCount * TEST_DESCRIPTOR_SIZE;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (MemoryMap, mSource, mGetMemoryMapCount * TEST_DESCRIPTOR_SIZE);
+  TestShuffleMap (MemoryMap, mGetMemoryMapCount);
+  *MemoryMapSize     = mGetMemoryMapCount * TEST_DESCRIPTOR_SIZE;
+  *MapKey            = 0;
+  *DescriptorSize    = TEST_DESCRIPTOR_SIZE;
+  *DescriptorVersion = EFI_MEMORY_DESCRIPTOR_VERSION;
+  return EFI_SUCCESS;
+}
+
+/**
+  Straightforward expansion of sorted attributes by runtime memory map
+  entries into a separate buffer.
+**/
+STATIC
+UINTN
+TestReferenceExpand (
+  VOID   *Map,
+  UINTN  Count,
+  VOID   *Mat,
+  UINTN  MatCount,
+  VOID   *Out
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+  EFI_MEMORY_DESCRIPTOR  *Attribute;
+  EFI_MEMORY_DESCRIPTOR  Temp;
+  EFI_PHYSICAL_ADDRESS   Current;
+  EFI_PHYSICAL_ADDRESS   End;
+  UINT64                 GapAttribute;
+  UINTN                  OutCount;
+  UINTN                  Index;
+  UINTN                  Index2;
+
+  CopyMem (Out, Mat, MatCount * TEST_DESCRIPTOR_SIZE);
+  OutCount = MatCount;
+
+  for (Index = 0; Index < Count; ++Index) {
+    Desc = TEST_DESC (Map, Index);
+    if (!TEST_IS_RT (Desc->Type)) {
+      continue;
+    }
+
+    GapAttribute = EFI_MEMORY_RUNTIME
+      | (Desc->Type == EfiRuntimeServicesCode ? EFI_MEMORY_RO : EFI_MEMORY_XP);
+    Current = Desc->PhysicalStart;
+    End     = LAST_DESCRIPTOR_ADDR (Desc) + 1;
+
+    for (Index2 = 0; Index2 < MatCount; ++Index2) {
+      Attribute = TEST_DESC (Mat, Index2);
+      if (Attribute->PhysicalStart >= End || LAST_DESCRIPTOR_ADDR (Attribute) < Current) {
+        continue;
+      }
+
+      if (Attribute->PhysicalStart > Current) {
+        TestAddDesc (Out, &OutCount, Desc->Type, Current, EFI_SIZE_TO_PAGES (Attribute->PhysicalStart - Current), GapAttribute);
+      }
+
+      Current = LAST_DESCRIPTOR_ADDR (Attribute) + 1;
+    }
+
+    if (Current < End) {
+      TestAddDesc (Out, &OutCount, Desc->Type, Current, EFI_SIZE_TO_PAGES (End - Current), GapAttribute);
+    }
+  }
+
+  for (Index = 1; Index < OutCount; ++Index) {
+    for (Index2 = Index; Index2 > 0
+      && TEST_DESC (Out, Index2 - 1)->PhysicalStart > TEST_DESC (Out, Index2)->PhysicalStart; --Index2) {
+      CopyMem (&Temp, TEST_DESC (Out, Index2 - 1), sizeof (Temp));
+      CopyMem (TEST_DESC (Out, Index2 - 1), TEST_DESC (Out, Index2), sizeof (Temp));
+      CopyMem (TEST_DESC (Out, Index2), &Temp, sizeof (Temp));
+    }
+  }
+
+  return OutCount;
+}
+
+STATIC
+BOOLEAN
+TestExpandAttributes (
+  UINT32  Seed,
+  UINTN   EntryCount,
+  BOOLEAN Limited
+  )
+{
+  EFI_MEMORY_ATTRIBUTES_TABLE  *Mat;
+  UINTN                        Count;
+  UINTN                        MatCount;
+  UINTN                        KeptCount;
+  UINTN                        ExpectedCount;
+  UINTN                        DuplicateCount;
+  UINTN                        Index;
+  UINT8                        Kept[TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE];
+
+  Count = TestGenerateMap (Seed, EntryCount, &MatCount);
+  Mat   = (EFI_MEMORY_ATTRIBUTES_TABLE *) mMat;
+
+  //
+  // Drop some attributes to get holes to fill in.
+  //
+  KeptCount = 0;
+  for (Index = 0; Index < MatCount; ++Index) {
+    if (TestRandom (3) != 0) {
+      CopyMem (TEST_DESC (Kept, KeptCount), TEST_DESC (Mat + 1, Index), TEST_DESCRIPTOR_SIZE);
+      ++KeptCount;
+    }
+  }
+
+  if (KeptCount == 0) {
+    return TRUE;
+  }
+
+  ExpectedCount = TestReferenceExpand (mSource, Count, Kept, KeptCount, mExpected);
+
+  //
+  // Duplicates are the only source of free slots in the table.
+  //
+  DuplicateCount = ExpectedCount - KeptCount;
+  if (Limited) {
+    DuplicateCount /= 2;
+  }
+
+  if (DuplicateCount == 0 || KeptCount + DuplicateCount > TEST_MAX_DESCRIPTORS) {
+    return TRUE;
+  }
+
+  CopyMem (Mat + 1, Kept, KeptCount * TEST_DESCRIPTOR_SIZE);
+  for (Index = 0; Index < DuplicateCount; ++Index) {
+    CopyMem (TEST_DESC (Mat + 1, KeptCount + Index), TEST_DESC (Kept, Index % KeptCount), TEST_DESCRIPTOR_SIZE);
+  }
+
+  Mat->NumberOfEntries = (UINT32) (KeptCount + DuplicateCount);
+  TestShuffleMap (Mat + 1, Mat->NumberOfEntries);
+
+  mGetMemoryMapCount = Count;
+  OcRebuildAttributes (0, TestGetMemoryMap);
+
+  if (!Limited) {
+    if (!TestCompareMaps ("expand", Mat + 1, Mat->NumberOfEntries, mExpected, ExpectedCount)) {
+      printf ("expand: seed %u failed\n", Seed);
+      return FALSE;
+    }
+
+    return TRUE;
+  }
+
+  //
+  // Not enough slots: the table must be filled and stay sorted.
+  //
+  if (Mat->NumberOfEntries != KeptCount + DuplicateCount) {
+    printf ("expand: seed %u limited got %u entries\n", Seed, Mat->NumberOfEntries);
+    return FALSE;
+  }
+
+  for (Index = 1; Index < Mat->NumberOfEntries; ++Index) {
+    if (TEST_DESC (Mat + 1, Index)->PhysicalStart <= LAST_DESCRIPTOR_ADDR (TEST_DESC (Mat + 1, Index - 1))) {
+      printf ("expand: seed %u limited overlapping entries at %u\n", Seed, (UINT32) Index);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+TestTrailingMerge (
+  VOID
+  )
+{
+  UINTN   Count;
+  UINTN   MapSize;
+  UINT32  EntryCount;
+
+  //
+  // Trailing joined entries must not leave stale descriptors behind.
+  //
+  Count = 0;
+  TestAddDesc (mMap, &Count, EfiReservedMemoryType, 0, 1, EFI_MEMORY_WB);
+  TestAddDesc (mMap, &Count, EfiBootServicesData, BASE_4KB, 1, EFI_MEMORY_WB);
+  TestAddDesc (mMap, &Count, EfiConventionalMemory, BASE_8KB, 2, EFI_MEMORY_WB);
+  MapSize = Count * TEST_DESCRIPTOR_SIZE;
+  OcShrinkMemoryMap (&MapSize, (EFI_MEMORY_DESCRIPTOR *) mMap, TEST_DESCRIPTOR_SIZE);
+  if (MapSize != 2 * TEST_DESCRIPTOR_SIZE || TEST_DESC (mMap, 1)->NumberOfPages != 3) {
+    printf ("shrink: trailing merge left %u entries\n", (UINT32) (MapSize / TEST_DESCRIPTOR_SIZE));
+    return FALSE;
+  }
+
+  Count = 0;
+  TestAddDesc (mMap, &Count, EfiRuntimeServicesCode, 0, 1, EFI_MEMORY_RUNTIME);
+  TestAddDesc (mMap, &Count, EfiRuntimeServicesCode, 0, 1, EFI_MEMORY_RUNTIME);
+  EntryCount = (UINT32) Count;
+  OcDeduplicateDescriptors (&EntryCount, (EFI_MEMORY_DESCRIPTOR *) mMap, TEST_DESCRIPTOR_SIZE);
+  if (EntryCount != 1) {
+    printf ("dedup: trailing duplicate left %u entries\n", EntryCount);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+STATIC
+UINT64
+TestGetTimeUs (
+  VOID
+  )
+{
+  struct timeval  Time;
+
+  gettimeofday (&Time, NULL);
+  return (UINT64) Time.tv_sec * 1000000ULL + (UINT64) Time.tv_usec;
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  UINT32  Seed;
+  UINT32  Iterations;
+  UINT32  Index;
+  UINTN   Count;
+  UINTN   MatCount;
+  UINTN   MapSize;
+  UINT64  StartTime;
+  UINT8   *Map;
+
+  Iterations = argc > 1 ? (UINT32) strtoul (argv[1], NULL, 0) : 1000;
+
+  gBS->InstallConfigurationTable (&gEfiMemoryAttributesTableGuid, mMat);
+
+  if (!TestTrailingMerge ()) {
+    return -1;
+  }
+
+  for (Seed = 1; Seed <= 512; ++Seed) {
+    if (!TestPipeline (Seed, 8 + Seed % 320, 0)
+      || !TestPipeline (Seed * 7919, 8 + Seed % 320, Seed % 4)) {
+      return -1;
+    }
+  }
+
+  for (Seed = 1; Seed <= 256; ++Seed) {
+    if (!TestExpandAttributes (Seed, 8 + Seed % 160, FALSE)
+      || !TestExpandAttributes (Seed * 7919, 8 + Seed % 160, TRUE)) {
+      return -1;
+    }
+  }
+
+  printf ("All memory map tests passed\n");
+
+  //
+  // Measure a GetMemoryMap hook pass on a server-sized memory map.
+  //
+  Count = TestGenerateMap (0xC0FFEE, 320, &MatCount);
+  Map   = AllocatePool (sizeof (mMap));
+  if (Map == NULL) {
+    return -1;
+  }
+
+  StartTime = TestGetTimeUs ();
+  for (Index = 0; Index < Iterations; ++Index) {
+    CopyMem (Map, mSource, Count * TEST_DESCRIPTOR_SIZE);
+    TestShuffleMap (Map, Count);
+    MapSize = Count * TEST_DESCRIPTOR_SIZE;
+    OcSortMemoryMap (MapSize, (EFI_MEMORY_DESCRIPTOR *) Map, TEST_DESCRIPTOR_SIZE);
+    OcSplitMemoryMapByAttributes (sizeof (mMap), &MapSize, (EFI_MEMORY_DESCRIPTOR *) Map, TEST_DESCRIPTOR_SIZE);
+    OcShrinkMemoryMap (&MapSize, (EFI_MEMORY_DESCRIPTOR *) Map, TEST_DESCRIPTOR_SIZE);
+  }
+
+  printf (
+    "%u entries, %u attributes: %llu us per rebuild\n",
+    (UINT32) Count,
+    (UINT32) MatCount,
+    (unsigned long long) ((TestGetTimeUs () - StartTime) / MAX (Iterations, 1))
+    );
+
+  FreePool (Map);
+
+  return 0;
+}
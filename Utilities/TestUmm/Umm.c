@@ -0,0 +1,279 @@
+/** @file
+  Copyright (c) 2021, vit9696. All rights reserved.
+  SPDX-License-Identifier: BSD-3-Clause
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseMemoryLib.h>
+#include <Library/OcMemoryLib.h>
+
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_HEAP_SIZE     (BASE_16MB)
+#define TEST_SLOT_COUNT    4096
+
+typedef struct {
+  UINT8   *Pointer;
+  UINT32  Size;
+} TEST_SLOT;
+
+STATIC TEST_SLOT  mSlots[TEST_SLOT_COUNT];
+STATIC UINT32     mRandomState;
+
+STATIC
+UINT32
+TestRandom (
+  UINT32  Limit
+  )
+{
+  mRandomState ^= mRandomState << 13;
+  mRandomState ^= mRandomState >> 17;
+  mRandomState ^= mRandomState << 5;
+  return mRandomState % Limit;
+}
+
+/**
+  Mostly small XML and kext metadata sized allocations with occasional large ones.
+**/
+STATIC
+UINT32
+TestRandomSize (
+  VOID
+  )
+{
+  UINT32  Kind;
+
+  Kind = TestRandom (100);
+  if (Kind < 70) {
+    return 1 + TestRandom (64);
+  }
+
+  if (Kind < 95) {
+    return 1 + TestRandom (1024);
+  }
+
+  return 1 + TestRandom (BASE_64KB);
+}
+
+STATIC
+UINT64
+TestGetTimeUs (
+  VOID
+  )
+{
+  struct timeval  Time;
+
+  gettimeofday (&Time, NULL);
+  return (UINT64) Time.tv_sec * 1000000ULL + (UINT64) Time.tv_usec;
+}
+
+STATIC
+BOOLEAN
+TestFreeSlot (
+  UINT32  Index
+  )
+{
+  UINT32  Offset;
+
+  for (Offset = 0; Offset < mSlots[Index].Size; ++Offset) {
+    if (mSlots[Index].Pointer[Offset] != (UINT8) (Index + Offset)) {
+      printf ("Slot %u of %u bytes corrupted at %u\n", Index, mSlots[Index].Size, Offset);
+      return FALSE;
+    }
+  }
+
+  if (!UmmFree (mSlots[Index].Pointer)) {
+    printf ("Slot %u failed to free\n", Index);
+    return FALSE;
+  }
+
+  mSlots[Index].Pointer = NULL;
+  return TRUE;
+}
+
+STATIC
+BOOLEAN
+TestStress (
+  UINT8   *Heap,
+  UINT32  Iterations
+  )
+{
+  UMM_HEAP_STATS  Initial;
+  UMM_HEAP_STATS  Stats;
+  UINT32          Iteration;
+  UINT32          Index;
+  UINT32          Offset;
+  UINT32          Live;
+
+  UmmSetHeap (Heap, TEST_HEAP_SIZE);
+  UmmGetStatistics (&Initial);
+  ZeroMem (mSlots, sizeof (mSlots));
+  Live = 0;
+
+  if (UmmMalloc (0) != NULL || UmmFree (NULL) || UmmFree (Heap + TEST_HEAP_SIZE) || UmmFree (&Live)) {
+    printf ("Invalid requests are not rejected\n");
+    return FALSE;
+  }
+
+  for (Iteration = 0; Iteration < Iterations; ++Iteration) {
+    Index = TestRandom (TEST_SLOT_COUNT);
+
+    if (mSlots[Index].Pointer != NULL) {
+      if (!TestFreeSlot (Index)) {
+        return FALSE;
+      }
+
+      --Live;
+      continue;
+    }
+
+    mSlots[Index].Size    = TestRandomSize ();
+    mSlots[Index].Pointer = UmmMalloc (mSlots[Index].Size);
+    if (mSlots[Index].Pointer == NULL) {
+      continue;
+    }
+
+    if (mSlots[Index].Pointer < Heap
+      || mSlots[Index].Pointer + mSlots[Index].Size > Heap + TEST_HEAP_SIZE
+      || ((UINTN) mSlots[Index].Pointer & 7U) != 0) {
+      printf ("Allocation %p of %u bytes is out of heap\n", mSlots[Index].Pointer, mSlots[Index].Size);
+      return FALSE;
+    }
+
+    for (Offset = 0; Offset < mSlots[Index].Size; ++Offset) {
+      mSlots[Index].Pointer[Offset] = (UINT8) (Index + Offset);
+    }
+
+    ++Live;
+  }
+
+  UmmGetStatistics (&Stats);
+  printf (
+    "Live %u used %u peak %u free %u largest %u failed %u\n",
+    Stats.AllocationCount,
+    Stats.UsedSize,
+    Stats.PeakUsedSize,
+    Stats.FreeSize,
+    Stats.LargestFreeBlock,
+    Stats.FailedAllocations
+    );
+
+  if (Stats.AllocationCount != Live || Stats.UsedSize + Stats.FreeSize != Stats.TotalSize) {
+    printf ("Statistics mismatch, expected %u live allocations\n", Live);
+    return FALSE;
+  }
+
+  for (Index = 0; Index < TEST_SLOT_COUNT; ++Index) {
+    if (mSlots[Index].Pointer != NULL) {
+      Offset = (UINT32) (mSlots[Index].Pointer - Heap);
+      if (!TestFreeSlot (Index)) {
+        return FALSE;
+      }
+
+#ifndef OC_UMM_LEGACY_BEST_FIT
+      //
+      // Legacy backend does not detect frees of already merged blocks.
+      //
+      if (UmmFree (Heap + Offset)) {
+        printf ("Double free of slot %u is not rejected\n", Index);
+        return FALSE;
+      }
+#endif
+    }
+  }
+
+  //
+  // Everything must merge back into the single initial block.
+  //
+  UmmGetStatistics (&Stats);
+  if (Stats.AllocationCount != 0 || Stats.UsedSize != 0
+    || Stats.LargestFreeBlock != Initial.LargestFreeBlock) {
+    printf ("Heap did not coalesce, largest %u vs %u\n", Stats.LargestFreeBlock, Initial.LargestFreeBlock);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+STATIC
+VOID
+TestBenchmark (
+  UINT8   *Heap,
+  UINT32  Iterations
+  )
+{
+  UINT32  Iteration;
+  UINT32  Index;
+  UINT64  StartTime;
+  UINT64  EndTime;
+
+  UmmSetHeap (Heap, TEST_HEAP_SIZE);
+  ZeroMem (mSlots, sizeof (mSlots));
+
+  //
+  // Fragment the heap first, then measure steady state churn.
+  //
+  for (Index = 0; Index < TEST_SLOT_COUNT; ++Index) {
+    mSlots[Index].Pointer = UmmMalloc (1 + TestRandom (256));
+  }
+
+  for (Index = 0; Index < TEST_SLOT_COUNT; Index += 2) {
+    UmmFree (mSlots[Index].Pointer);
+    mSlots[Index].Pointer = NULL;
+  }
+
+  StartTime = TestGetTimeUs ();
+  for (Iteration = 0; Iteration < Iterations; ++Iteration) {
+    Index = TestRandom (TEST_SLOT_COUNT);
+    if (mSlots[Index].Pointer != NULL) {
+      UmmFree (mSlots[Index].Pointer);
+      mSlots[Index].Pointer = NULL;
+    } else {
+      mSlots[Index].Pointer = UmmMalloc (TestRandomSize ());
+    }
+  }
+  EndTime = TestGetTimeUs ();
+
+  printf (
+    "%u operations in %llu us (%llu ns per operation)\n",
+    Iterations,
+    (unsigned long long) (EndTime - StartTime),
+    (unsigned long long) ((EndTime - StartTime) * 1000ULL / MAX (Iterations, 1))
+    );
+}
+
+int
+main (
+  int   argc,
+  char  *argv[]
+  )
+{
+  UINT8   *Heap;
+  UINT32  Iterations;
+  UINT32  Seed;
+
+  Iterations = argc > 1 ? (UINT32) strtoul (argv[1], NULL, 0) : 1000000;
+  Seed       = argc > 2 ? (UINT32) strtoul (argv[2], NULL, 0) : 0x1234567;
+
+  Heap = malloc (TEST_HEAP_SIZE);
+  if (Heap == NULL) {
+    return -1;
+  }
+
+  mRandomState = Seed != 0 ? Seed : 1;
+  if (!TestStress (Heap, Iterations)) {
+    free (Heap);
+    return -1;
+  }
+
+  printf ("Stress test passed\n");
+
+  TestBenchmark (Heap, Iterations);
+
+  free (Heap);
+  return 0;
+}